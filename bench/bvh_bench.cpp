@@ -0,0 +1,221 @@
+#include "dynamic_bvh.hpp"
+#include "frustum_cull.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/*
+ * Dynamic BVH against brute force over boxes scattered through a cube two
+ * kilometres wide: inserting them, moving a tenth of them every frame for a
+ * while, then box queries, frustum culls and rays, each checked against a
+ * plain loop over every box. Tree quality is the summed area of the
+ * internal nodes over the root area, reported after inserting, after the
+ * moves and for a tree freshly built from the final boxes.
+ *
+ * usage: bvh_bench [boxes]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+{
+    return glm::all(glm::lessThanEqual(minA, maxB)) && glm::all(glm::lessThanEqual(minB, maxA));
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t count { argc > 1 ? uint32_t(std::max(1, std::atoi(argv[1]))) : 100000u };
+
+    std::mt19937 random { 7 };
+    std::uniform_real_distribution<float> position { -1000.0f, 1000.0f };
+    std::uniform_real_distribution<float> size { 1.0f, 8.0f };
+    std::uniform_real_distribution<float> speed { -2.0f, 2.0f };
+
+    std::vector<glm::vec3> mins(count);
+    std::vector<glm::vec3> sizes(count);
+    std::vector<glm::vec3> velocities(count);
+    for (uint32_t i { 0 }; i < count; i++) {
+        mins[i] = { position(random), position(random), position(random) };
+        sizes[i] = { size(random), size(random), size(random) };
+        velocities[i] = { speed(random), speed(random), speed(random) };
+    }
+
+    VoKel::JobSystem jobs;
+    VoKel::DynamicBvh tree;
+    std::vector<uint32_t> leaves(count);
+
+    auto start = Clock::now();
+    for (uint32_t i { 0 }; i < count; i++) {
+        leaves[i] = tree.insert(mins[i], mins[i] + sizes[i], i);
+    }
+    double seconds = secondsSince(start);
+    VoKel::DynamicBvh::Stats stats = tree.getStats();
+    std::cout << count << " boxes inserted: " << seconds * 1e9 / count << " ns per insert, height " << stats.height << ", cost " << stats.cost << "\n";
+
+    // a tenth of the boxes move each frame, rebuilding what degraded
+    int frames { 120 };
+    uint32_t moves { 0 };
+    double moveSeconds { 0.0 };
+    double optimizeSeconds { 0.0 };
+    double pairSeconds { 0.0 };
+    size_t pairCount { 0 };
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    std::uniform_int_distribution<uint32_t> pick { 0, count - 1 };
+
+    for (int frame { 0 }; frame < frames; frame++) {
+        std::vector<uint32_t> moving;
+        for (uint32_t i { 0 }; i < count / 10; i++) {
+            moving.push_back(pick(random));
+        }
+
+        start = Clock::now();
+        for (uint32_t i : moving) {
+            mins[i] += velocities[i];
+            tree.move(leaves[i], mins[i], mins[i] + sizes[i], velocities[i]);
+        }
+        moveSeconds += secondsSince(start);
+        moves += static_cast<uint32_t>(moving.size());
+
+        start = Clock::now();
+        tree.optimize();
+        optimizeSeconds += secondsSince(start);
+
+        start = Clock::now();
+        tree.collectPairs(jobs, pairs);
+        pairSeconds += secondsSince(start);
+        pairCount += pairs.size();
+    }
+
+    stats = tree.getStats();
+    std::cout << moves << " moves: " << moveSeconds * 1e9 / moves << " ns per move, " << stats.refits << " refits, " << stats.reinserts
+              << " reinserts, " << optimizeSeconds / frames * 1e3 << " ms per frame rebuilding " << stats.rebuiltNodes << " nodes in total\n";
+    std::cout << "broadphase: " << pairSeconds / frames * 1e3 << " ms per frame, " << pairCount / frames << " pairs\n";
+
+    VoKel::DynamicBvh fresh;
+    for (uint32_t i { 0 }; i < count; i++) {
+        fresh.insert(mins[i], mins[i] + sizes[i], i);
+    }
+    std::cout << "cost after moving " << stats.cost << ", height " << stats.height << ", a fresh tree " << fresh.getStats().cost << ", height "
+              << fresh.getStats().height << "\n";
+
+    bool match { true };
+
+    // box queries, a few hits each
+    std::vector<VoKel::DynamicBvh::BoxQuery> queries;
+    for (int i { 0 }; i < 10000; i++) {
+        glm::vec3 min { position(random), position(random), position(random) };
+        queries.push_back({ min, min + 64.0f });
+    }
+
+    std::vector<std::vector<uint32_t>> hits(queries.size());
+    start = Clock::now();
+    for (size_t q { 0 }; q < queries.size(); q++) {
+        hits[q].clear();
+        tree.query(queries[q].min, queries[q].max, hits[q]);
+    }
+    double treeSeconds = secondsSince(start);
+
+    std::vector<std::vector<uint32_t>> batchHits;
+    start = Clock::now();
+    tree.queryBatch(jobs, queries, batchHits);
+    double batchSeconds = secondsSince(start);
+
+    size_t hitCount { 0 };
+    start = Clock::now();
+    for (size_t q { 0 }; q < queries.size(); q++) {
+        std::vector<uint32_t> expected;
+        for (uint32_t i { 0 }; i < count; i++) {
+            if (overlaps(mins[i], mins[i] + sizes[i], queries[q].min, queries[q].max)) {
+                expected.push_back(i);
+            }
+        }
+
+        std::sort(hits[q].begin(), hits[q].end());
+        std::sort(batchHits[q].begin(), batchHits[q].end());
+        match = match && hits[q] == expected && batchHits[q] == expected;
+        hitCount += expected.size();
+    }
+    double bruteSeconds = secondsSince(start);
+
+    std::cout << "box queries: " << treeSeconds * 1e6 / queries.size() << " us each, batched on " << jobs.getThreadCount() + 1 << " threads "
+              << batchSeconds * 1e6 / queries.size() << " us, brute force " << bruteSeconds * 1e6 / queries.size() << " us, "
+              << hitCount / queries.size() << " hits per query\n";
+
+    // frustum culls against the simd brute force culler
+    VoKel::BoundsList bounds;
+    for (uint32_t i { 0 }; i < count; i++) {
+        bounds.add(mins[i], mins[i] + sizes[i]);
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 800.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3 { 0.0f, 0.0f, 0.0f }, glm::vec3 { 1.0f, 0.2f, 0.5f }, glm::vec3 { 0.0f, 1.0f, 0.0f });
+    VoKel::Frustum frustum = VoKel::Frustum::fromMatrix(projection * view);
+
+    int rounds { 32 };
+    std::vector<uint32_t> visible;
+    start = Clock::now();
+    for (int round { 0 }; round < rounds; round++) {
+        visible.clear();
+        tree.cull(frustum, visible);
+    }
+    treeSeconds = secondsSince(start) / rounds;
+
+    VoKel::FrustumCuller culler;
+    start = Clock::now();
+    for (int round { 0 }; round < rounds; round++) {
+        culler.cull(jobs, frustum, bounds);
+    }
+    bruteSeconds = secondsSince(start) / rounds;
+
+    std::sort(visible.begin(), visible.end());
+    match = match && visible == culler.getVisible();
+    std::cout << "frustum cull: " << treeSeconds * 1e3 << " ms, simd brute force " << bruteSeconds * 1e3 << " ms, " << visible.size() << " visible\n";
+
+    // rays from the middle, the nearest box along each
+    int rays { 1000 };
+    std::vector<glm::vec3> directions;
+    for (int i { 0 }; i < rays; i++) {
+        directions.push_back(glm::normalize(glm::vec3 { speed(random), speed(random), speed(random) }));
+    }
+
+    std::vector<uint32_t> rayHits(rays);
+    start = Clock::now();
+    for (int i { 0 }; i < rays; i++) {
+        float distance;
+        rayHits[i] = tree.raycast(glm::vec3 { 0.0f }, directions[i], 4000.0f, distance);
+    }
+    treeSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (int i { 0 }; i < rays; i++) {
+        glm::vec3 inverse = 1.0f / directions[i];
+        uint32_t nearest { VoKel::DynamicBvh::NULL_NODE };
+        float best { 4000.0f };
+
+        for (uint32_t b { 0 }; b < count; b++) {
+            glm::vec3 t0 = mins[b] * inverse;
+            glm::vec3 t1 = (mins[b] + sizes[b]) * inverse;
+            float entry = std::max({ glm::min(t0, t1).x, glm::min(t0, t1).y, glm::min(t0, t1).z, 0.0f });
+            float exit = std::min({ glm::max(t0, t1).x, glm::max(t0, t1).y, glm::max(t0, t1).z, best });
+            if (entry <= exit && (nearest == VoKel::DynamicBvh::NULL_NODE || entry < best)) {
+                nearest = b;
+                best = entry;
+            }
+        }
+        match = match && nearest == rayHits[i];
+    }
+    bruteSeconds = secondsSince(start);
+
+    std::cout << "rays: " << treeSeconds * 1e6 / rays << " us each, brute force " << bruteSeconds * 1e6 / rays << " us\n";
+    std::cout << (match ? "all queries match brute force\n" : "MISMATCH\n");
+
+    return match ? 0 : 1;
+}
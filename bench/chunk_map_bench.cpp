@@ -0,0 +1,163 @@
+#include "chunk_map.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Chunk lookups of ChunkMap against std::unordered_map and std::map, keyed
+ * the way the world keys its chunks. The keys are a streaming volume around
+ * the origin, lookups are random hits, misses just outside the volume and
+ * the 27 chunk neighborhoods the light propagator gathers. Churn erases and
+ * inserts a slab of chunks per round, as the streamer does while the camera
+ * moves. Values are plain indices, so only the container is measured.
+ *
+ * usage: chunk_map_bench [view radius in chunks]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Workload {
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> hits;
+    std::vector<uint64_t> misses;
+    std::vector<VoKel::ChunkCoord> centers;
+    int radius;
+};
+
+// ns per operation of insert, hit, miss, neighborhood gather and churn
+template <typename Insert, typename Find, typename Erase>
+static void measure(const std::string& name, const Workload& work, Insert&& insert, Find&& find, Erase&& erase)
+{
+    uint64_t checksum { 0 };
+
+    auto start = Clock::now();
+    for (size_t i { 0 }; i < work.keys.size(); i++) {
+        insert(work.keys[i], uint32_t(i));
+    }
+    double insertNs = secondsSince(start) * 1e9 / work.keys.size();
+
+    start = Clock::now();
+    for (uint64_t key : work.hits) {
+        const uint32_t* value = find(key);
+        checksum += value == nullptr ? 0 : *value;
+    }
+    double hitNs = secondsSince(start) * 1e9 / work.hits.size();
+
+    start = Clock::now();
+    for (uint64_t key : work.misses) {
+        checksum += find(key) != nullptr;
+    }
+    double missNs = secondsSince(start) * 1e9 / work.misses.size();
+
+    start = Clock::now();
+    for (const VoKel::ChunkCoord& center : work.centers) {
+        for (int i { 0 }; i < 27; i++) {
+            const uint32_t* value = find(VoKel::packChunkCoord(center + VoKel::ChunkCoord { i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1 }));
+            checksum += value == nullptr ? 0 : *value;
+        }
+    }
+    double neighborhoodNs = secondsSince(start) * 1e9 / work.centers.size();
+
+    // the volume slides along x one slab at a time and back
+    int rounds { 64 };
+    uint64_t churned { 0 };
+    start = Clock::now();
+    for (int round { 0 }; round < rounds; round++) {
+        int leaving = round % 2 == 0 ? -work.radius : work.radius + 1;
+        int entering = round % 2 == 0 ? work.radius + 1 : -work.radius;
+        for (int y { -work.radius }; y <= work.radius; y++) {
+            for (int z { -work.radius }; z <= work.radius; z++) {
+                erase(VoKel::packChunkCoord({ leaving, y, z }));
+                insert(VoKel::packChunkCoord({ entering, y, z }), uint32_t(round));
+                churned += 2;
+            }
+        }
+    }
+    double churnNs = secondsSince(start) * 1e9 / double(churned);
+
+    std::cout << name << ": insert " << insertNs << " ns, hit " << hitNs << " ns, miss " << missNs << " ns, neighborhood "
+              << neighborhoodNs << " ns, churn " << churnNs << " ns (checksum " << checksum << ")\n";
+}
+
+int main(int argc, char** argv)
+{
+    Workload work;
+    work.radius = argc > 1 ? std::max(1, std::atoi(argv[1])) : 16;
+
+    for (int y { -work.radius }; y <= work.radius; y++) {
+        for (int z { -work.radius }; z <= work.radius; z++) {
+            for (int x { -work.radius }; x <= work.radius; x++) {
+                work.keys.push_back(VoKel::packChunkCoord({ x, y, z }));
+            }
+        }
+    }
+
+    std::mt19937 random { 7 };
+    std::shuffle(work.keys.begin(), work.keys.end(), random);
+
+    std::uniform_int_distribution<size_t> pickKey { 0, work.keys.size() - 1 };
+    std::uniform_int_distribution<int> pickInside { -work.radius, work.radius };
+    std::uniform_int_distribution<int> pickOutside { work.radius + 2, work.radius * 4 };
+
+    for (int i { 0 }; i < 1 << 22; i++) {
+        work.hits.push_back(work.keys[pickKey(random)]);
+        work.misses.push_back(VoKel::packChunkCoord({ pickOutside(random), pickInside(random), pickInside(random) }));
+    }
+    for (int i { 0 }; i < 1 << 18; i++) {
+        work.centers.push_back({ pickInside(random), pickInside(random), pickInside(random) });
+    }
+
+    std::cout << work.keys.size() << " chunks, " << work.hits.size() << " lookups\n";
+
+    VoKel::ChunkMap<uint32_t> flat;
+    measure(
+        "ChunkMap", work,
+        [&](uint64_t key, uint32_t value) { flat[key] = value; },
+        [&](uint64_t key) { return flat.find(key); },
+        [&](uint64_t key) { flat.erase(key); });
+    std::cout << "  " << flat.capacity() << " slots, longest probe " << flat.maxProbe() << "\n";
+
+    // the batched gather the world and the light propagator use
+    uint64_t checksum { 0 };
+    auto start = Clock::now();
+    for (const VoKel::ChunkCoord& center : work.centers) {
+        std::array<const uint32_t*, 27> neighborhood;
+        static_cast<const VoKel::ChunkMap<uint32_t>&>(flat).gatherNeighborhood(center, neighborhood);
+        for (const uint32_t* value : neighborhood) {
+            checksum += value == nullptr ? 0 : *value;
+        }
+    }
+    std::cout << "  gatherNeighborhood " << secondsSince(start) * 1e9 / work.centers.size() << " ns (checksum " << checksum << ")\n";
+
+    std::unordered_map<uint64_t, uint32_t> unordered;
+    measure(
+        "std::unordered_map", work,
+        [&](uint64_t key, uint32_t value) { unordered[key] = value; },
+        [&](uint64_t key) -> const uint32_t* {
+            auto it = unordered.find(key);
+            return it == unordered.end() ? nullptr : &it->second;
+        },
+        [&](uint64_t key) { unordered.erase(key); });
+
+    std::map<uint64_t, uint32_t> ordered;
+    measure(
+        "std::map", work,
+        [&](uint64_t key, uint32_t value) { ordered[key] = value; },
+        [&](uint64_t key) -> const uint32_t* {
+            auto it = ordered.find(key);
+            return it == ordered.end() ? nullptr : &it->second;
+        },
+        [&](uint64_t key) { ordered.erase(key); });
+
+    return 0;
+}
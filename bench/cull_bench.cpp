@@ -0,0 +1,115 @@
+#include "frustum_cull.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/*
+ * Frustum culling cost per million boxes, on one thread for every
+ * instruction set and on the whole job system with the best one. The boxes
+ * are chunk sized and scattered around a camera, about a quarter of them end
+ * up in view. Every path has to return the same visible list.
+ *
+ * usage: cull_bench [boxes]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t count { argc > 1 ? uint32_t(std::max(1, std::atoi(argv[1]))) : 1u << 20 };
+
+    std::mt19937 random { 3 };
+    std::uniform_real_distribution<float> position { -2048.0f, 2048.0f };
+    std::uniform_real_distribution<float> size { 1.0f, 64.0f };
+
+    VoKel::BoundsList bounds;
+    for (uint32_t i { 0 }; i < count; i++) {
+        glm::vec3 min { position(random), position(random) * 0.25f, position(random) };
+        bounds.add(min, min + glm::vec3 { size(random), size(random), size(random) });
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 2048.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3 { 10.0f, 40.0f, -20.0f }, glm::vec3 { 400.0f, 0.0f, 300.0f }, glm::vec3 { 0.0f, 1.0f, 0.0f });
+    VoKel::Frustum frustum = VoKel::Frustum::fromMatrix(projection * view);
+
+    float planes[6][4];
+    for (int p { 0 }; p < 6; p++) {
+        for (int c { 0 }; c < 4; c++) {
+            planes[p][c] = frustum.planes[p][c];
+        }
+    }
+
+    // plain corner test against the same planes
+    std::vector<uint32_t> reference;
+    for (uint32_t i { 0 }; i < count; i++) {
+        bool inside { true };
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = plane.w;
+            for (int a { 0 }; a < 3; a++) {
+                distance += plane[a] * (plane[a] >= 0.0f ? bounds.getMax(a)[i] : bounds.getMin(a)[i]);
+            }
+            inside = inside && distance >= 0.0f;
+        }
+        if (inside) {
+            reference.push_back(i);
+        }
+    }
+    std::cout << count << " boxes, " << reference.size() << " visible\n";
+
+    int rounds { 32 };
+    bool match { true };
+    std::vector<uint32_t> visible(count);
+
+    VoKel::SimdLevel best = VoKel::getSimdLevel();
+    for (VoKel::SimdLevel level : { VoKel::SimdLevel::Scalar, VoKel::SimdLevel::SSE4, VoKel::SimdLevel::AVX2 }) {
+        if (level > best) {
+            continue;
+        }
+
+        VoKel::CullBatch batch {
+            { bounds.getMin(0), bounds.getMin(1), bounds.getMin(2) },
+            { bounds.getMax(0), bounds.getMax(1), bounds.getMax(2) },
+            0,
+            count,
+            planes,
+            6,
+            visible.data(),
+        };
+
+        size_t written { 0 };
+        auto start = Clock::now();
+        for (int round { 0 }; round < rounds; round++) {
+            written = VoKel::cullBoxes(batch, level);
+        }
+        double seconds = secondsSince(start) / rounds;
+
+        bool same = written == reference.size() && std::equal(reference.begin(), reference.end(), visible.begin());
+        match = match && same;
+        std::cout << VoKel::getSimdLevelName(level) << ": " << seconds * 1e3 * (1 << 20) / count << " ms per million boxes on one thread"
+                  << (same ? "" : ", MISMATCH") << "\n";
+    }
+
+    VoKel::JobSystem jobs;
+    VoKel::FrustumCuller culler;
+
+    auto start = Clock::now();
+    for (int round { 0 }; round < rounds; round++) {
+        culler.cull(jobs, frustum, bounds);
+    }
+    double seconds = secondsSince(start) / rounds;
+
+    bool same = culler.getVisible() == reference;
+    match = match && same;
+    std::cout << "FrustumCuller (" << VoKel::getSimdLevelName(best) << ", " << jobs.getThreadCount() + 1 << " threads): " << seconds * 1e3 * (1 << 20) / count
+              << " ms per million boxes" << (same ? "" : ", MISMATCH") << "\n";
+
+    return match ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include "job_system.hpp"
+#include "terrain_generator.hpp"
+#include "voxel_dag.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+/*
+ * Builds a sparse voxel DAG over a block of generated terrain and reports
+ * its size against the palette chunks holding the same voxels. The block
+ * starts 128 voxels below the surface, 64 8 64 chunks are about a billion
+ * voxels and 256 8 256 about sixteen. Terrain is generated on the fly by
+ * the build, so a separate generation pass is timed too. A sample of voxels
+ * and rays is checked against the generator.
+ *
+ * usage: dag_bench [horizontal chunks] [vertical chunks]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    int horizontal { argc > 1 ? std::max(1, std::atoi(argv[1])) : 64 };
+    int vertical { argc > 2 ? std::max(1, std::atoi(argv[2])) : 8 };
+
+    VoKel::JobSystem jobs;
+    VoKel::TerrainGenerator terrain;
+
+    VoKel::ChunkCoord first { 0, -4, 0 };
+    glm::ivec3 count { horizontal, vertical, horizontal };
+    uint32_t chunkCount = uint32_t(count.x) * count.y * count.z;
+
+    auto chunkAt = [&](uint32_t i) {
+        return first + glm::ivec3 { int(i % count.x), int(i / (count.x * count.z)), int(i / count.x % count.z) };
+    };
+
+    std::atomic<uint64_t> paletteBytes { 0 };
+
+    auto start = Clock::now();
+    jobs.parallelFor(chunkCount, [&](uint32_t i) {
+        VoKel::Chunk chunk;
+        terrain.generate(chunk, chunkAt(i), 0);
+        paletteBytes += chunk.memoryUsage();
+    });
+    double generateSeconds = secondsSince(start);
+
+    VoKel::SparseVoxelDag dag;
+    dag.build(jobs, first, count, [&terrain](const VoKel::ChunkCoord& coord, VoKel::Chunk& scratch) {
+        terrain.generate(scratch, coord, 0);
+        return &scratch;
+    });
+
+    const VoKel::SparseVoxelDag::Stats& stats = dag.getStats();
+    std::cout << chunkCount << " chunks, " << stats.voxels / 1e9 << " billion voxels, " << stats.solidVoxels / 1e9 << " billion solid\n";
+    std::cout << "generation alone " << generateSeconds << " s, build " << stats.buildSeconds << " s on "
+              << jobs.getThreadCount() + 1 << " threads, " << (stats.buildSeconds - generateSeconds) * 1e9 / double(stats.voxels) << " ns per voxel beyond generation\n";
+    std::cout << "palette chunks " << paletteBytes / double(1 << 20) << " MiB, octree " << stats.treeWords * 4 / double(1 << 20) << " MiB, dag "
+              << stats.bytes() / double(1 << 20) << " MiB\n";
+    std::cout << "dag " << stats.nodes << " nodes, " << stats.leaves << " leaves, " << stats.bitsPerVoxel() << " bits per voxel, "
+              << stats.bitsPerSolidVoxel() << " bits per solid voxel\n";
+
+    // spot checks against freshly generated chunks
+    std::mt19937 random { 5 };
+    std::uniform_int_distribution<uint32_t> pickChunk { 0, chunkCount - 1 };
+    std::uniform_int_distribution<int> pickVoxel { 0, VoKel::CHUNK_VOLUME - 1 };
+
+    int mismatches { 0 };
+    for (int i { 0 }; i < 256; i++) {
+        VoKel::ChunkCoord coord = chunkAt(pickChunk(random));
+        VoKel::Chunk chunk;
+        terrain.generate(chunk, coord, 0);
+
+        for (int j { 0 }; j < 256; j++) {
+            int index = pickVoxel(random);
+            glm::ivec3 local { index & 31, index >> 10, (index >> 5) & 31 };
+            VoKel::Voxel expected = std::min<VoKel::Voxel>(chunk.getIndex(index), 0xff);
+            mismatches += dag.getVoxel(coord * VoKel::CHUNK_SIZE + local) != expected;
+        }
+    }
+    std::cout << mismatches << " of 65536 sampled voxels differ\n";
+
+    float extent = float(horizontal * VoKel::CHUNK_SIZE);
+    std::uniform_real_distribution<float> across { 0.0f, extent };
+    std::uniform_real_distribution<float> height { 64.0f, 160.0f };
+    std::normal_distribution<float> direction;
+
+    int rays { 1 << 18 };
+    int hits { 0 };
+    start = Clock::now();
+    for (int i { 0 }; i < rays; i++) {
+        glm::vec3 origin { across(random), height(random), across(random) };
+        glm::vec3 dir { direction(random), direction(random), direction(random) };
+        hits += dag.cast(origin, dir, 512.0f).hit;
+    }
+    double castSeconds = secondsSince(start);
+    std::cout << rays / castSeconds / 1e6 << " M rays/s on one thread, " << hits << " of " << rays << " hit\n";
+
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+#include "isosurface_mesher.hpp"
+#include "job_system.hpp"
+#include "terrain_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+/*
+ * Smooth terrain meshing over a block of chunks around the surface: density
+ * sampling, then marching cubes and dual contouring on the job system. The
+ * meshes are checked for open edges inside the block, which would be cracks
+ * between chunks, for triangles facing into a sphere, for the corners of a
+ * box that dual contouring keeps sharper, and for single chunks closed by
+ * caps on all six faces.
+ *
+ * usage: isosurface_bench [chunks across]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static glm::dvec3 position(const vkMesh::ChunkVertex& vertex, const glm::ivec3& origin)
+{
+    return glm::dvec3 { origin * int(vkMesh::CHUNK_VERTEX_SCALE) + glm::ivec3 { vertex.x, vertex.y, vertex.z } } / double(vkMesh::CHUNK_VERTEX_SCALE);
+}
+
+// directed edges without their reverse, leaving out those near the outer faces of the block
+static size_t openEdges(const std::vector<VoKel::ChunkMeshData>& meshes, const std::vector<glm::ivec3>& origins, const glm::ivec3& min, const glm::ivec3& max)
+{
+    auto pack = [](const glm::ivec3& p) {
+        constexpr int bias { 1 << 20 };
+        return uint64_t(p.x + bias) | (uint64_t(p.y + bias) << 21) | (uint64_t(p.z + bias) << 42);
+    };
+
+    struct PairHash {
+        size_t operator()(const std::pair<uint64_t, uint64_t>& edge) const { return std::hash<uint64_t> {}(edge.first * 0x9e3779b97f4a7c15ull ^ edge.second); }
+    };
+
+    constexpr int SCALE { int(vkMesh::CHUNK_VERTEX_SCALE) };
+    glm::ivec3 low = min * SCALE + SCALE;
+    glm::ivec3 high = max * SCALE - SCALE;
+
+    std::unordered_map<std::pair<uint64_t, uint64_t>, int, PairHash> balance;
+
+    for (size_t m { 0 }; m < meshes.size(); m++) {
+        const VoKel::ChunkMeshData& mesh = meshes[m];
+        auto fixed = [&](uint32_t index) {
+            const vkMesh::ChunkVertex& v = mesh.vertices[index];
+            return origins[m] * SCALE + glm::ivec3 { v.x, v.y, v.z };
+        };
+
+        for (size_t i { 0 }; i < mesh.indices.size(); i += 3) {
+            for (int e { 0 }; e < 3; e++) {
+                glm::ivec3 a = fixed(mesh.indices[i + e]);
+                glm::ivec3 b = fixed(mesh.indices[i + (e + 1) % 3]);
+                if (a == b || glm::any(glm::lessThanEqual(glm::min(a, b), low)) || glm::any(glm::greaterThanEqual(glm::max(a, b), high))) {
+                    continue;
+                }
+
+                uint64_t ka = pack(a);
+                uint64_t kb = pack(b);
+                if (ka < kb) {
+                    balance[{ ka, kb }]++;
+                } else {
+                    balance[{ kb, ka }]--;
+                }
+            }
+        }
+    }
+
+    size_t open { 0 };
+    for (const auto& [edge, count] : balance) {
+        open += size_t(std::abs(count));
+    }
+    return open;
+}
+
+// length of the summed area vectors over the summed areas, zero for a closed surface
+static double openness(const VoKel::ChunkMeshData& mesh)
+{
+    glm::dvec3 sum { 0.0 };
+    double total { 0.0 };
+    for (size_t i { 0 }; i < mesh.indices.size(); i += 3) {
+        glm::dvec3 a = position(mesh.vertices[mesh.indices[i]], glm::ivec3 { 0 });
+        glm::dvec3 b = position(mesh.vertices[mesh.indices[i + 1]], glm::ivec3 { 0 });
+        glm::dvec3 c = position(mesh.vertices[mesh.indices[i + 2]], glm::ivec3 { 0 });
+        glm::dvec3 area = glm::cross(b - a, c - a);
+        sum += area;
+        total += glm::length(area);
+    }
+    return total > 0.0 ? glm::length(sum) / total : 0.0;
+}
+
+template <typename Density>
+static void fillField(VoKel::DensityField& field, Density density)
+{
+    for (int y { VoKel::DensityField::MIN }; y < VoKel::DensityField::MIN + VoKel::DensityField::SIZE; y++) {
+        for (int z { VoKel::DensityField::MIN }; z < VoKel::DensityField::MIN + VoKel::DensityField::SIZE; z++) {
+            for (int x { VoKel::DensityField::MIN }; x < VoKel::DensityField::MIN + VoKel::DensityField::SIZE; x++) {
+                int i = VoKel::DensityField::index(x, y, z);
+                field.density[i] = density(glm::vec3(x, y, z));
+                field.material[i] = field.density[i] > 0.0f ? VoKel::MATERIAL_STONE : VoKel::AIR;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int across { argc > 1 ? std::max(2, std::atoi(argv[1])) : 6 };
+
+    VoKel::JobSystem jobs;
+    VoKel::TerrainGenerator terrain;
+    bool match { true };
+
+    // heights stay within about -64 to 128 voxels
+    std::vector<glm::ivec3> coords;
+    for (int y { -2 }; y <= 4; y++) {
+        for (int z { 0 }; z < across; z++) {
+            for (int x { 0 }; x < across; x++) {
+                coords.push_back({ x, y, z });
+            }
+        }
+    }
+    uint32_t count = static_cast<uint32_t>(coords.size());
+
+    std::vector<VoKel::DensityField> fields(count);
+    auto start = Clock::now();
+    jobs.parallelFor(count, [&](uint32_t i) {
+        terrain.generateDensity(fields[i], coords[i], 0);
+    });
+    double seconds = secondsSince(start);
+    std::cout << count << " chunks (" << VoKel::getSimdLevelName(terrain.getSimdLevel()) << ", " << jobs.getThreadCount() + 1 << " threads): density "
+              << seconds * 1e3 / count << " ms per chunk\n";
+
+    std::vector<glm::ivec3> origins;
+    for (const glm::ivec3& coord : coords) {
+        origins.push_back(coord * VoKel::CHUNK_SIZE);
+    }
+    glm::ivec3 blockMin { 0, -2 * VoKel::CHUNK_SIZE, 0 };
+    glm::ivec3 blockMax { across * VoKel::CHUNK_SIZE, 5 * VoKel::CHUNK_SIZE, across * VoKel::CHUNK_SIZE };
+
+    for (VoKel::IsosurfaceMode mode : { VoKel::IsosurfaceMode::MarchingCubes, VoKel::IsosurfaceMode::DualContouring }) {
+        const char* name = mode == VoKel::IsosurfaceMode::MarchingCubes ? "marching cubes" : "dual contouring";
+
+        std::vector<VoKel::ChunkMeshData> meshes(count);
+        int rounds { 4 };
+        start = Clock::now();
+        for (int round { 0 }; round < rounds; round++) {
+            jobs.parallelFor(count, [&](uint32_t i) {
+                meshes[i] = VoKel::meshIsosurface({ &fields[i], mode, 0 });
+            });
+        }
+        seconds = secondsSince(start) / rounds;
+
+        size_t triangles { 0 };
+        size_t bytes { 0 };
+        for (const VoKel::ChunkMeshData& mesh : meshes) {
+            triangles += mesh.indices.size() / 3;
+            bytes += mesh.byteSize();
+        }
+
+        size_t open = openEdges(meshes, origins, blockMin, blockMax);
+        match = match && open == 0;
+        std::cout << name << ": " << seconds * 1e3 / count << " ms per chunk, " << triangles << " triangles, " << bytes / 1024 << " KiB, " << open
+                  << " open edges between chunks\n";
+    }
+
+    // every triangle of a sphere faces out, the vertices lie on it
+    VoKel::DensityField field;
+    glm::vec3 center { 16.3f, 15.8f, 16.1f };
+    fillField(field, [&](const glm::vec3& p) { return 10.0f - glm::length(p - center); });
+
+    for (VoKel::IsosurfaceMode mode : { VoKel::IsosurfaceMode::MarchingCubes, VoKel::IsosurfaceMode::DualContouring }) {
+        VoKel::ChunkMeshData mesh = VoKel::meshIsosurface({ &field, mode, 0 });
+
+        size_t inward { 0 };
+        for (size_t i { 0 }; i < mesh.indices.size(); i += 3) {
+            glm::dvec3 a = position(mesh.vertices[mesh.indices[i]], glm::ivec3 { 0 });
+            glm::dvec3 b = position(mesh.vertices[mesh.indices[i + 1]], glm::ivec3 { 0 });
+            glm::dvec3 c = position(mesh.vertices[mesh.indices[i + 2]], glm::ivec3 { 0 });
+            if (glm::dot(glm::cross(b - a, c - a), (a + b + c) / 3.0 - glm::dvec3 { center }) <= 0.0) {
+                inward++;
+            }
+        }
+
+        double error { 0.0 };
+        for (const vkMesh::ChunkVertex& vertex : mesh.vertices) {
+            error = std::max(error, std::abs(glm::length(position(vertex, glm::ivec3 { 0 }) - glm::dvec3 { center }) - 10.0));
+        }
+
+        match = match && inward == 0 && openness(mesh) < 1e-6;
+        std::cout << "sphere, " << (mode == VoKel::IsosurfaceMode::MarchingCubes ? "marching cubes" : "dual contouring") << ": " << mesh.indices.size() / 3
+                  << " triangles, " << inward << " facing in, max radius error " << error << ", openness " << openness(mesh) << "\n";
+    }
+
+    // a box whose corners fall between the grid points
+    glm::vec3 boxCenter { 16.3f, 15.6f, 16.2f };
+    float half { 7.5f };
+    fillField(field, [&](const glm::vec3& p) {
+        glm::vec3 d = glm::abs(p - boxCenter);
+        return half - std::max({ d.x, d.y, d.z });
+    });
+
+    std::array<double, 2> cornerError {};
+    for (VoKel::IsosurfaceMode mode : { VoKel::IsosurfaceMode::MarchingCubes, VoKel::IsosurfaceMode::DualContouring }) {
+        VoKel::ChunkMeshData mesh = VoKel::meshIsosurface({ &field, mode, 0 });
+
+        double& error = cornerError[int(mode)];
+        for (int corner { 0 }; corner < 8; corner++) {
+            glm::dvec3 target = glm::dvec3 { boxCenter } + glm::dvec3 { corner & 1 ? half : -half, corner & 2 ? half : -half, corner & 4 ? half : -half };
+            double nearest { 1e9 };
+            for (const vkMesh::ChunkVertex& vertex : mesh.vertices) {
+                nearest = std::min(nearest, glm::length(position(vertex, glm::ivec3 { 0 }) - target));
+            }
+            error += nearest / 8.0;
+        }
+
+        std::cout << "box, " << (mode == VoKel::IsosurfaceMode::MarchingCubes ? "marching cubes" : "dual contouring") << ": corners " << error
+                  << " voxels from the nearest vertex on average\n";
+    }
+
+    // normals come from central differences, which blur within a voxel of the edge, so corners come closer but are not exact
+    match = match && cornerError[1] < cornerError[0];
+
+    // terrain chunks capped on every face enclose their solid
+    double worst { 0.0 };
+    size_t capTriangles { 0 };
+    size_t surfaceTriangles { 0 };
+    start = Clock::now();
+    for (uint32_t i { 0 }; i < count; i++) {
+        VoKel::ChunkMeshData capped = VoKel::meshIsosurface({ &fields[i], VoKel::IsosurfaceMode::MarchingCubes, 0x3f });
+        VoKel::ChunkMeshData surface = VoKel::meshIsosurface({ &fields[i], VoKel::IsosurfaceMode::MarchingCubes, 0 });
+        worst = std::max(worst, openness(capped));
+        capTriangles += (capped.indices.size() - surface.indices.size()) / 3;
+        surfaceTriangles += surface.indices.size() / 3;
+    }
+    match = match && worst < 1e-6;
+    std::cout << "capped chunks: " << capTriangles * 100 / std::max<size_t>(surfaceTriangles, 1) << "% extra triangles with all six faces capped, worst openness " << worst
+              << "\n";
+
+    std::cout << (match ? "all meshes closed\n" : "MISMATCH\n");
+    return match ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include "job_system.hpp"
+#include "light_propagator.hpp"
+#include "terrain_generator.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/*
+ * Light propagation cost: lights a block of generated terrain from scratch,
+ * then places and removes lamps one update at a time. Every removal clears
+ * the whole area the lamp lit and refills it from the surrounding light, the
+ * slowest one is the worst case a single edit can cost a frame.
+ *
+ * usage: light_bench [chunks per axis] [lamps]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    int extent { argc > 1 ? std::max(1, std::atoi(argv[1])) : 12 };
+    int lamps { argc > 2 ? std::max(1, std::atoi(argv[2])) : 200 };
+
+    VoKel::JobSystem jobs;
+    VoKel::TerrainGenerator terrain;
+    VoKel::World world;
+    VoKel::LightPropagator light { world, jobs };
+
+    light.setEmission(VoKel::MATERIAL_LAMP, VoKel::MAX_LIGHT_LEVEL);
+
+    world.setChunkHandler([&light](const VoKel::ChunkCoord& coord, const VoKel::Chunk* chunk) {
+        if (chunk != nullptr) {
+            light.chunkInserted(coord);
+        } else {
+            light.chunkRemoved(coord);
+        }
+    });
+
+    world.setEditHandler([&light](const glm::ivec3& voxel, VoKel::Voxel previous, VoKel::Voxel value) {
+        light.voxelChanged(voxel, previous, value);
+    });
+
+    std::vector<VoKel::ChunkCoord> coords;
+    for (int y { -1 }; y < 5; y++) {
+        for (int z { 0 }; z < extent; z++) {
+            for (int x { 0 }; x < extent; x++) {
+                coords.push_back({ x, y, z });
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<VoKel::Chunk>> chunks = terrain.generateChunks(jobs, coords, 0);
+    for (size_t i { 0 }; i < coords.size(); i++) {
+        world.insertChunk(coords[i], std::move(chunks[i]));
+    }
+
+    auto start = Clock::now();
+    light.update();
+    double seconds = secondsSince(start);
+
+    VoKel::LightPropagator::Stats stats = light.getStats();
+    std::cout << "initial light for " << coords.size() << " chunks in " << seconds << "s, " << stats.updates << " voxel updates, "
+              << stats.updatesPerSecond() / 1e6 << "M updates/s, " << stats.rounds << " rounds on " << jobs.getThreadCount() + 1 << " threads\n";
+    light.takeChangedChunks();
+
+    // lamps go into air right above the ground, where they light the most
+    std::mt19937 random { 7 };
+    std::uniform_int_distribution<int> horizontal { 16, extent * VoKel::CHUNK_SIZE - 16 };
+
+    std::vector<glm::ivec3> placed;
+    for (int attempt { 0 }; int(placed.size()) < lamps && attempt < lamps * 16; attempt++) {
+        glm::ivec3 voxel { horizontal(random), 5 * VoKel::CHUNK_SIZE - 1, horizontal(random) };
+        while (voxel.y > -VoKel::CHUNK_SIZE && world.getVoxel(voxel - glm::ivec3 { 0, 1, 0 }) == VoKel::AIR) {
+            voxel.y--;
+        }
+
+        if (voxel.y > -VoKel::CHUNK_SIZE && world.getVoxel(voxel) == VoKel::AIR) {
+            placed.push_back(voxel);
+        }
+    }
+
+    auto measure = [&](const char* name, VoKel::Voxel value) {
+        VoKel::LightPropagator::Stats before = light.getStats();
+        double worst { 0.0 };
+
+        for (const glm::ivec3& voxel : placed) {
+            world.setVoxel(voxel, value);
+
+            auto edit = Clock::now();
+            light.update();
+            worst = std::max(worst, secondsSince(edit));
+        }
+
+        VoKel::LightPropagator::Stats after = light.getStats();
+        uint64_t updates = after.updates - before.updates;
+        double total = double(after.nanoseconds - before.nanoseconds) * 1e-9;
+
+        std::cout << name << " " << placed.size() << " lamps: " << total / placed.size() * 1e3 << " ms average, "
+                  << worst * 1e3 << " ms worst, " << updates / placed.size() << " voxel updates each, "
+                  << updates / total / 1e6 << "M updates/s\n";
+    };
+
+    measure("placing", VoKel::MATERIAL_LAMP);
+    measure("removing", VoKel::AIR);
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "asset_pack.hpp"
+#include "job_system.hpp"
+#include "mesh_import.hpp"
+#include "mesh_optimizer.hpp"
+#include "obj_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <numbers>
+#include <random>
+
+/*
+ * Vertex cache, overdraw and vertex fetch optimization of tori with their
+ * triangles and vertices shuffled, as exporters leave them, or of .obj
+ * files. Every mesh must keep its triangles with their winding, and the
+ * meshes optimized one job each must match those optimized one after the
+ * other. The tori are then imported from .obj files twice through an asset
+ * pack, the second import must come from the pack and give the same meshes.
+ *
+ * usage: mesh_optimizer_bench [model.obj...]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static VoKel::ObjMesh torus(uint32_t rings, uint32_t sides, uint32_t seed)
+{
+    VoKel::ObjMesh mesh;
+    for (uint32_t i { 0 }; i < rings; i++) {
+        float u = 2.0f * std::numbers::pi_v<float> * float(i) / float(rings);
+        for (uint32_t j { 0 }; j < sides; j++) {
+            float v = 2.0f * std::numbers::pi_v<float> * float(j) / float(sides);
+            float distance = 200.0f + 70.0f * std::cos(v);
+            mesh.positions.push_back({ distance * std::cos(u), 70.0f * std::sin(v), distance * std::sin(u) });
+        }
+    }
+
+    for (uint32_t i { 0 }; i < rings; i++) {
+        for (uint32_t j { 0 }; j < sides; j++) {
+            uint32_t a = i * sides + j;
+            uint32_t b = (i + 1) % rings * sides + j;
+            uint32_t c = (i + 1) % rings * sides + (j + 1) % sides;
+            uint32_t d = i * sides + (j + 1) % sides;
+            mesh.indices.insert(mesh.indices.end(), { a, c, b, a, d, c });
+        }
+    }
+
+    std::mt19937 random { seed };
+    for (size_t t = mesh.indices.size() / 3 - 1; t > 0; t--) {
+        size_t other = random() % (t + 1);
+        std::swap_ranges(&mesh.indices[t * 3], &mesh.indices[t * 3 + 3], &mesh.indices[other * 3]);
+    }
+
+    std::vector<uint32_t> remap(mesh.positions.size());
+    for (uint32_t v { 0 }; v < remap.size(); v++) {
+        remap[v] = v;
+    }
+    std::shuffle(remap.begin(), remap.end(), random);
+
+    std::vector<glm::vec3> positions(mesh.positions.size());
+    for (size_t v { 0 }; v < remap.size(); v++) {
+        positions[remap[v]] = mesh.positions[v];
+    }
+    mesh.positions = std::move(positions);
+    for (uint32_t& index : mesh.indices) {
+        index = remap[index];
+    }
+    return mesh;
+}
+
+// the triangles by their corner positions, starting at the smallest corner so the winding is kept
+static std::vector<std::array<float, 9>> triangles(const VoKel::ObjMesh& mesh)
+{
+    std::vector<std::array<float, 9>> result;
+    for (size_t t { 0 }; t < mesh.indices.size(); t += 3) {
+        std::array<glm::vec3, 3> corners { mesh.positions[mesh.indices[t]], mesh.positions[mesh.indices[t + 1]], mesh.positions[mesh.indices[t + 2]] };
+        auto less = [](const glm::vec3& a, const glm::vec3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); };
+        std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+
+        result.push_back({ corners[0].x, corners[0].y, corners[0].z, corners[1].x, corners[1].y, corners[1].z, corners[2].x, corners[2].y, corners[2].z });
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static bool same(const VoKel::ObjMesh& a, const VoKel::ObjMesh& b)
+{
+    return a.indices == b.indices && a.positions == b.positions;
+}
+
+static void writeObj(const std::filesystem::path& path, const VoKel::ObjMesh& mesh)
+{
+    std::ofstream file { path };
+    for (const glm::vec3& position : mesh.positions) {
+        file << "v " << position.x << ' ' << position.y << ' ' << position.z << '\n';
+    }
+    for (size_t t { 0 }; t < mesh.indices.size(); t += 3) {
+        file << "f " << mesh.indices[t] + 1 << ' ' << mesh.indices[t + 1] + 1 << ' ' << mesh.indices[t + 2] + 1 << '\n';
+    }
+}
+
+static void printStats(const char* label, const VoKel::MeshDrawStats& stats)
+{
+    std::cout << label << " acmr " << stats.acmr << ", atvr " << stats.atvr << ", overdraw " << stats.overdraw;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<VoKel::ObjMesh> meshes;
+    for (int i { 1 }; i < argc; i++) {
+        meshes.push_back(VoKel::loadObj(argv[i]));
+    }
+    if (meshes.empty()) {
+        for (uint32_t i { 0 }; i < 8; i++) {
+            meshes.push_back(torus(256 + 64 * i, 128 + 16 * i, i + 1));
+        }
+    }
+
+    VoKel::JobSystem jobs;
+
+    std::vector<VoKel::ObjMesh> serial = meshes;
+    std::vector<VoKel::MeshOptimization> serialResults(meshes.size());
+    auto start = Clock::now();
+    for (size_t i { 0 }; i < serial.size(); i++) {
+        serialResults[i] = VoKel::optimizeMesh(serial[i]);
+    }
+    double serialSeconds = secondsSince(start);
+
+    std::vector<VoKel::ObjMesh> parallel = meshes;
+    std::vector<VoKel::MeshOptimization> results(meshes.size());
+    start = Clock::now();
+    jobs.parallelFor(static_cast<uint32_t>(parallel.size()), [&](uint32_t i) { results[i] = VoKel::optimizeMesh(parallel[i]); });
+    double parallelSeconds = secondsSince(start);
+
+    size_t errors { 0 };
+    size_t triangleCount { 0 };
+    for (size_t i { 0 }; i < meshes.size(); i++) {
+        errors += same(serial[i], parallel[i]) ? 0 : 1;
+        errors += triangles(meshes[i]) == triangles(parallel[i]) ? 0 : 1;
+        triangleCount += meshes[i].indices.size() / 3;
+
+        std::cout << meshes[i].indices.size() / 3 << " triangles: ";
+        printStats("before", results[i].before);
+        printStats(" | after", results[i].after);
+        std::cout << " | " << results[i].seconds * 1e3 << " ms\n";
+    }
+
+    std::cout << meshes.size() << " meshes, " << triangleCount << " triangles: " << parallelSeconds * 1e3 << " ms on " << jobs.getThreadCount() + 1
+              << " threads with the analysis, " << serialSeconds * 1e3 << " ms one after the other, " << errors << " errors\n";
+
+    // the same meshes as files, imported fresh and then from the pack
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "vokel_mesh_optimizer_bench";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    std::vector<std::filesystem::path> paths;
+    for (size_t i { 0 }; i < meshes.size(); i++) {
+        paths.push_back(directory / ("mesh" + std::to_string(i) + ".obj"));
+        writeObj(paths.back(), meshes[i]);
+    }
+
+    std::filesystem::path packPath = directory / "assets.pack";
+    std::vector<VoKel::ImportedMesh> fresh;
+    std::vector<VoKel::ImportedMesh> cached;
+    double freshSeconds { 0.0 };
+    double cachedSeconds { 0.0 };
+    {
+        VoKel::AssetPack pack { packPath };
+        start = Clock::now();
+        fresh = VoKel::importMeshes(paths, pack, jobs);
+        freshSeconds = secondsSince(start);
+        pack.save();
+    }
+    {
+        VoKel::AssetPack pack { packPath };
+        start = Clock::now();
+        cached = VoKel::importMeshes(paths, pack, jobs);
+        cachedSeconds = secondsSince(start);
+    }
+
+    size_t packErrors { 0 };
+    for (size_t i { 0 }; i < paths.size(); i++) {
+        packErrors += fresh[i].error.empty() && cached[i].error.empty() ? 0 : 1;
+        packErrors += !fresh[i].cached && cached[i].cached ? 0 : 1;
+        packErrors += same(fresh[i].mesh, cached[i].mesh) ? 0 : 1;
+    }
+
+    std::cout << "import of " << paths.size() << " files: " << freshSeconds * 1e3 << " ms optimizing, " << cachedSeconds * 1e3 << " ms from the pack of "
+              << std::filesystem::file_size(packPath) / (1 << 20) << " MiB, " << packErrors << " errors\n";
+    std::filesystem::remove_all(directory);
+
+    bool match = errors == 0 && packErrors == 0;
+    std::cout << (match ? "all meshes valid\n" : "MISMATCH\n");
+    return match ? 0 : 1;
+}
@@ -0,0 +1,183 @@
+#include "frustum_cull.hpp"
+#include "job_system.hpp"
+#include "meshlet_builder.hpp"
+#include "obj_file.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <numbers>
+#include <random>
+
+/*
+ * Meshlet building of a finely tessellated torus with its triangles
+ * shuffled, as exporters leave them, or of a .obj file. The meshlets are
+ * built on all threads and on one, which must give the same result, then
+ * checked to hold every triangle once within the vertex and triangle
+ * limits. The torus is a regular grid, where 64 vertices hold up to 98
+ * triangles, its meshlets must hold at least 80 on average. From cameras
+ * around the mesh the culling of meshlet_cull.comp is run on the cpu, no
+ * culled meshlet may hold a triangle facing the camera.
+ *
+ * usage: meshlet_bench [model.obj]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static VoKel::ObjMesh torus(uint32_t rings, uint32_t sides)
+{
+    VoKel::ObjMesh mesh;
+    for (uint32_t i { 0 }; i < rings; i++) {
+        float u = 2.0f * std::numbers::pi_v<float> * float(i) / float(rings);
+        for (uint32_t j { 0 }; j < sides; j++) {
+            float v = 2.0f * std::numbers::pi_v<float> * float(j) / float(sides);
+            float distance = 200.0f + 70.0f * std::cos(v);
+            mesh.positions.push_back({ distance * std::cos(u), 70.0f * std::sin(v), distance * std::sin(u) });
+        }
+    }
+
+    for (uint32_t i { 0 }; i < rings; i++) {
+        for (uint32_t j { 0 }; j < sides; j++) {
+            uint32_t a = i * sides + j;
+            uint32_t b = (i + 1) % rings * sides + j;
+            uint32_t c = (i + 1) % rings * sides + (j + 1) % sides;
+            uint32_t d = i * sides + (j + 1) % sides;
+            mesh.indices.insert(mesh.indices.end(), { a, c, b, a, d, c });
+        }
+    }
+
+    std::mt19937 random { 1 };
+    for (size_t t = mesh.indices.size() / 3 - 1; t > 0; t--) {
+        size_t other = random() % (t + 1);
+        std::swap_ranges(&mesh.indices[t * 3], &mesh.indices[t * 3 + 3], &mesh.indices[other * 3]);
+    }
+    return mesh;
+}
+
+static bool same(const VoKel::MeshletMesh& a, const VoKel::MeshletMesh& b)
+{
+    return a.vertices == b.vertices && a.triangles == b.triangles && a.meshlets.size() == b.meshlets.size()
+        && std::memcmp(a.meshlets.data(), b.meshlets.data(), a.meshlets.size() * sizeof(VoKel::Meshlet)) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    VoKel::ObjMesh mesh = argc > 1 ? VoKel::loadObj(argv[1]) : torus(1024, 512);
+    size_t triangleCount = mesh.indices.size() / 3;
+
+    VoKel::JobSystem jobs;
+    VoKel::JobSystem single { 1 };
+
+    int rounds { 4 };
+    VoKel::MeshletMesh meshlets;
+    auto start = Clock::now();
+    for (int round { 0 }; round < rounds; round++) {
+        meshlets = VoKel::buildMeshlets(mesh.positions, mesh.indices, jobs);
+    }
+    double seconds = secondsSince(start) / rounds;
+
+    start = Clock::now();
+    VoKel::MeshletMesh serial = VoKel::buildMeshlets(mesh.positions, mesh.indices, single);
+    double serialSeconds = secondsSince(start);
+
+    bool deterministic = same(meshlets, serial);
+    std::cout << triangleCount << " triangles: " << seconds * 1e3 << " ms on " << jobs.getThreadCount() + 1 << " threads, " << serialSeconds * 1e3
+              << " ms on one, " << (deterministic ? "same" : "DIFFERENT") << " meshlets\n";
+
+    // every triangle exactly once, with its winding
+    std::map<std::array<uint32_t, 3>, int> remaining;
+    for (size_t t { 0 }; t < triangleCount; t++) {
+        remaining[{ mesh.indices[t * 3], mesh.indices[t * 3 + 1], mesh.indices[t * 3 + 2] }]++;
+    }
+
+    size_t errors { 0 };
+    size_t vertices { 0 };
+    for (const VoKel::Meshlet& meshlet : meshlets.meshlets) {
+        errors += meshlet.vertexCount > VoKel::MESHLET_MAX_VERTICES || meshlet.triangleCount > VoKel::MESHLET_MAX_TRIANGLES ? 1 : 0;
+        vertices += meshlet.vertexCount;
+
+        for (uint32_t t { 0 }; t < meshlet.triangleCount; t++) {
+            const uint8_t* triangle = &meshlets.triangles[size_t(meshlet.triangleOffset + t) * 3];
+            if (std::max({ triangle[0], triangle[1], triangle[2] }) >= meshlet.vertexCount) {
+                errors++;
+                continue;
+            }
+            std::array<uint32_t, 3> key {};
+            for (int k { 0 }; k < 3; k++) {
+                key[k] = meshlets.vertices[meshlet.vertexOffset + triangle[k]];
+            }
+            errors += --remaining[key] < 0 ? 1 : 0;
+        }
+    }
+    for (const auto& [triangle, count] : remaining) {
+        errors += count != 0 ? 1 : 0;
+    }
+
+    // growth that strands islands of triangles leaves many small meshlets behind
+    size_t meshletCount = meshlets.meshlets.size();
+    double fill = double(triangleCount) / meshletCount;
+    bool full = argc > 1 || fill >= 80.0;
+    std::cout << meshletCount << " meshlets, " << double(vertices) / meshletCount << " vertices and " << fill << " triangles on average"
+              << (full ? "" : " (UNDERFILLED)") << ", " << errors << " errors\n";
+
+    glm::vec3 min { std::numeric_limits<float>::max() };
+    glm::vec3 max { -std::numeric_limits<float>::max() };
+    for (const glm::vec3& position : mesh.positions) {
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    glm::vec3 center = (min + max) * 0.5f;
+    float size = glm::length(max - min);
+
+    // cameras on a ring around the mesh looking at its center, as meshlet_cull.comp culls
+    size_t drawnMeshlets { 0 };
+    size_t drawnTriangles { 0 };
+    size_t frontTriangles { 0 };
+    size_t unsound { 0 };
+    int views { 16 };
+    start = Clock::now();
+    for (int view { 0 }; view < views; view++) {
+        float angle = 2.0f * std::numbers::pi_v<float> * float(view) / float(views);
+        glm::vec3 eye = center + size * glm::vec3 { std::cos(angle), 0.3f, std::sin(angle) };
+        glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 4.0f * size) * glm::lookAt(eye, center, glm::vec3 { 0.0f, 1.0f, 0.0f });
+        VoKel::Frustum frustum = VoKel::Frustum::fromMatrix(viewProjection);
+
+        for (const VoKel::Meshlet& meshlet : meshlets.meshlets) {
+            bool visible = std::all_of(frustum.planes.begin(), frustum.planes.end(), [&](const glm::vec4& plane) {
+                return glm::dot(glm::vec3 { plane }, meshlet.center) + plane.w >= -meshlet.radius;
+            });
+            bool backfacing = VoKel::isMeshletBackfacing(meshlet, eye);
+
+            for (uint32_t t { 0 }; t < meshlet.triangleCount; t++) {
+                const uint8_t* triangle = &meshlets.triangles[size_t(meshlet.triangleOffset + t) * 3];
+                glm::vec3 a = mesh.positions[meshlets.vertices[meshlet.vertexOffset + triangle[0]]];
+                glm::vec3 b = mesh.positions[meshlets.vertices[meshlet.vertexOffset + triangle[1]]];
+                glm::vec3 c = mesh.positions[meshlets.vertices[meshlet.vertexOffset + triangle[2]]];
+                bool front = glm::dot(glm::cross(b - a, c - a), a - eye) < 0.0f;
+                frontTriangles += front ? 1 : 0;
+                unsound += front && backfacing ? 1 : 0;
+            }
+
+            if (visible && !backfacing) {
+                drawnMeshlets++;
+                drawnTriangles += meshlet.triangleCount;
+            }
+        }
+    }
+    double cullSeconds = secondsSince(start);
+
+    std::cout << "from " << views << " cameras: " << drawnMeshlets * 100 / (meshletCount * views) << "% of meshlets and " << drawnTriangles * 100 / (triangleCount * views)
+              << "% of triangles drawn, " << frontTriangles * 100 / (triangleCount * views) << "% face the camera, " << unsound << " front facing triangles culled, "
+              << cullSeconds * 1e3 / views << " ms per view with the triangle checks\n";
+
+    bool match = deterministic && full && errors == 0 && unsound == 0;
+    std::cout << (match ? "all meshlets valid\n" : "MISMATCH\n");
+    return match ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#include "job_system.hpp"
+#include "raycast.hpp"
+#include "terrain_generator.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+/*
+ * Ray query throughput over a block of generated terrain. Rays start above
+ * the ground and point in random directions, so most of them cross empty
+ * chunks and bricks before they find the surface or run out of distance.
+ * Single casts, batches on one thread per instruction set, and batches split
+ * between the job threads are timed, and every batch is checked against the
+ * single casts.
+ *
+ * usage: raycast_bench [chunks per axis] [rays]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool sameHit(const VoKel::RayHit& a, const VoKel::RayHit& b)
+{
+    return a.hit == b.hit && (!a.hit || (a.voxel == b.voxel && a.face == b.face && a.distance == b.distance));
+}
+
+int main(int argc, char** argv)
+{
+    int extent { argc > 1 ? std::max(1, std::atoi(argv[1])) : 12 };
+    int count { argc > 2 ? std::max(1, std::atoi(argv[2])) : 1 << 20 };
+
+    VoKel::JobSystem jobs;
+    VoKel::TerrainGenerator terrain;
+    VoKel::World world;
+    VoKel::VoxelRaycaster raycaster { world, jobs };
+
+    world.setChunkHandler([&raycaster](const VoKel::ChunkCoord& coord, const VoKel::Chunk*) {
+        raycaster.chunkChanged(coord);
+    });
+
+    std::vector<VoKel::ChunkCoord> coords;
+    for (int y { -1 }; y < 5; y++) {
+        for (int z { 0 }; z < extent; z++) {
+            for (int x { 0 }; x < extent; x++) {
+                coords.push_back({ x, y, z });
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<VoKel::Chunk>> chunks = terrain.generateChunks(jobs, coords, 0);
+    for (size_t i { 0 }; i < coords.size(); i++) {
+        world.insertChunk(coords[i], std::move(chunks[i]));
+    }
+
+    auto start = Clock::now();
+    raycaster.update();
+    std::cout << "occupancy for " << coords.size() << " chunks in " << secondsSince(start) * 1e3 << " ms, "
+              << raycaster.getChunkCount() << " not empty\n";
+
+    std::mt19937 random { 11 };
+    std::uniform_real_distribution<float> horizontal { 0.0f, float(extent * VoKel::CHUNK_SIZE) };
+    std::uniform_real_distribution<float> height { float(2 * VoKel::CHUNK_SIZE), float(5 * VoKel::CHUNK_SIZE) };
+    std::normal_distribution<float> direction;
+
+    std::vector<VoKel::Ray> rays(count);
+    for (VoKel::Ray& ray : rays) {
+        ray.origin = { horizontal(random), height(random), horizontal(random) };
+        ray.direction = { direction(random), direction(random), direction(random) };
+        ray.maxDistance = 256.0f;
+    }
+
+    std::vector<VoKel::RayHit> single(rays.size());
+
+    start = Clock::now();
+    for (size_t i { 0 }; i < rays.size(); i++) {
+        single[i] = raycaster.cast(rays[i].origin, rays[i].direction, rays[i].maxDistance);
+    }
+    double seconds = secondsSince(start);
+
+    size_t hitCount = std::count_if(single.begin(), single.end(), [](const VoKel::RayHit& hit) { return hit.hit; });
+    std::cout << "single casts: " << rays.size() / seconds / 1e6 << "M rays/s, " << hitCount * 100 / rays.size() << "% hit\n";
+
+    // raw batches run on the calling thread only
+    std::vector<float> input[7];
+    for (std::vector<float>& values : input) {
+        values.resize(rays.size());
+    }
+
+    for (size_t i { 0 }; i < rays.size(); i++) {
+        glm::vec3 normalized = rays[i].direction / glm::length(rays[i].direction);
+        for (int a { 0 }; a < 3; a++) {
+            input[a][i] = rays[i].origin[a];
+            input[3 + a][i] = normalized[a];
+        }
+        input[6][i] = rays[i].maxDistance;
+    }
+
+    std::vector<int32_t> voxel[3];
+    for (std::vector<int32_t>& values : voxel) {
+        values.resize(rays.size());
+    }
+    std::vector<float> distance(rays.size());
+    std::vector<uint8_t> face(rays.size());
+
+    VoKel::RayBatch batch {
+        { input[0].data(), input[1].data(), input[2].data() },
+        { input[3].data(), input[4].data(), input[5].data() },
+        input[6].data(),
+        rays.size(),
+        nullptr,
+        nullptr,
+        { voxel[0].data(), voxel[1].data(), voxel[2].data() },
+        distance.data(),
+        face.data()
+    };
+
+    auto report = [&](const std::string& name, double elapsed, size_t different) {
+        std::cout << name << rays.size() / elapsed / 1e6 << "M rays/s" << (different == 0 ? "" : ", MISMATCH with single casts") << "\n";
+    };
+
+    std::vector<VoKel::SimdLevel> levels { VoKel::SimdLevel::Scalar };
+    if (VoKel::getSimdLevel() >= VoKel::SimdLevel::SSE4) {
+        levels.push_back(VoKel::SimdLevel::SSE4);
+    }
+    if (VoKel::getSimdLevel() >= VoKel::SimdLevel::AVX2) {
+        levels.push_back(VoKel::SimdLevel::AVX2);
+    }
+
+    for (VoKel::SimdLevel level : levels) {
+        start = Clock::now();
+        raycaster.trace(batch, level);
+        seconds = secondsSince(start);
+
+        size_t different { 0 };
+        for (size_t i { 0 }; i < rays.size(); i++) {
+            VoKel::RayHit hit { face[i] != VoKel::RAY_MISS, { voxel[0][i], voxel[1][i], voxel[2][i] }, face[i], distance[i], VoKel::AIR };
+            different += sameHit(single[i], hit) ? 0 : 1;
+        }
+
+        std::string name = std::string("batch ") + VoKel::getSimdLevelName(level) + ", 1 thread: ";
+        report(name, seconds, different);
+    }
+
+    std::vector<VoKel::RayHit> hits;
+    start = Clock::now();
+    raycaster.cast(rays, hits, VoKel::getSimdLevel());
+    seconds = secondsSince(start);
+
+    size_t different { 0 };
+    for (size_t i { 0 }; i < rays.size(); i++) {
+        different += sameHit(single[i], hits[i]) ? 0 : 1;
+    }
+
+    std::string name = std::string("batch ") + VoKel::getSimdLevelName(VoKel::getSimdLevel()) + ", " + std::to_string(jobs.getThreadCount() + 1) + " threads: ";
+    report(name, seconds, different);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "async_io.hpp"
+#include "job_system.hpp"
+#include "region_file.hpp"
+#include "terrain_generator.hpp"
+
+#include <chrono>
+#include <iostream>
+
+/*
+ * Region file throughput: generates a block of terrain, saves it, reopens the
+ * store and reads every chunk back on one thread and on the whole job system.
+ * The files are freshly written so reads mostly hit the page cache, this
+ * measures mapping, checksums and decoding rather than the disk. The async
+ * pass issues every read up front, VOKEL_IO=threads compares the fallback.
+ *
+ * usage: region_bench [directory] [chunks per axis]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path directory { argc > 1 ? argv[1] : "region_bench_world" };
+    int extent { argc > 2 ? std::max(1, std::atoi(argv[2])) : 24 };
+
+    std::filesystem::remove_all(directory);
+
+    VoKel::JobSystem jobs;
+    VoKel::TerrainGenerator terrain;
+
+    std::vector<VoKel::ChunkCoord> coords;
+    for (int y { -1 }; y < 5; y++) {
+        for (int z { 0 }; z < extent; z++) {
+            for (int x { 0 }; x < extent; x++) {
+                coords.push_back({ x, y, z });
+            }
+        }
+    }
+
+    auto start = Clock::now();
+    std::vector<std::unique_ptr<VoKel::Chunk>> chunks = terrain.generateChunks(jobs, coords, 0);
+    std::cout << "generated " << chunks.size() << " chunks in " << secondsSince(start) << "s\n";
+
+    size_t memory { 0 };
+    std::vector<std::pair<VoKel::ChunkCoord, const VoKel::Chunk*>> batch;
+    for (size_t i { 0 }; i < chunks.size(); i++) {
+        batch.emplace_back(coords[i], chunks[i].get());
+        memory += chunks[i]->memoryUsage();
+    }
+
+    {
+        VoKel::RegionStore store { directory };
+
+        start = Clock::now();
+        store.save(batch);
+        double seconds = secondsSince(start);
+
+        VoKel::RegionStore::Stats stats = store.getStats();
+        std::cout << "saved " << stats.chunksWritten << " chunks in " << seconds << "s, "
+                  << stats.bytesWritten / 1e6 << " MB of payloads\n";
+
+        uint64_t raw = uint64_t(chunks.size()) * VoKel::CHUNK_VOLUME * sizeof(VoKel::Voxel);
+        uint64_t disk = store.getDiskUsage();
+        std::cout << "on disk " << disk / 1e6 << " MB, " << disk / chunks.size() << " bytes/chunk, palette memory "
+                  << memory / 1e6 << " MB, raw voxels " << raw / 1e6 << " MB (" << double(raw) / double(disk) << "x)\n";
+    }
+
+    auto verify = [&](const std::vector<std::unique_ptr<VoKel::Chunk>>& loaded) {
+        std::vector<VoKel::Voxel> expected(VoKel::CHUNK_VOLUME), actual(VoKel::CHUNK_VOLUME);
+        for (size_t i { 0 }; i < chunks.size(); i++) {
+            if (loaded[i] == nullptr) {
+                return false;
+            }
+            chunks[i]->decode(expected.data());
+            loaded[i]->decode(actual.data());
+            if (expected != actual) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (bool parallel : { false, true }) {
+        VoKel::RegionStore store { directory };
+        std::vector<std::unique_ptr<VoKel::Chunk>> loaded(coords.size());
+
+        start = Clock::now();
+        if (parallel) {
+            jobs.parallelFor(static_cast<uint32_t>(coords.size()), [&](uint32_t i) {
+                loaded[i] = store.load(coords[i]);
+            });
+        } else {
+            for (size_t i { 0 }; i < coords.size(); i++) {
+                loaded[i] = store.load(coords[i]);
+            }
+        }
+        double seconds = secondsSince(start);
+
+        VoKel::RegionStore::Stats stats = store.getStats();
+        std::cout << (parallel ? "parallel" : "single thread") << " load: " << stats.chunksRead / seconds << " chunks/s, "
+                  << stats.bytesRead / seconds / 1e6 << " MB/s compressed, "
+                  << stats.chunksRead * VoKel::CHUNK_VOLUME * sizeof(VoKel::Voxel) / seconds / 1e6 << " MB/s voxels"
+                  << (verify(loaded) ? "" : " MISMATCH") << "\n";
+    }
+
+    // streaming path, reads go through the async service into registered staging slots
+    {
+        VoKel::AsyncIo io;
+        VoKel::RegionStore store { directory };
+        store.enableAsync(io, 256);
+
+        std::vector<std::unique_ptr<VoKel::Chunk>> loaded(coords.size());
+
+        start = Clock::now();
+        for (size_t i { 0 }; i < coords.size(); i++) {
+            store.loadAsync(coords[i], [&loaded, i](std::unique_ptr<VoKel::Chunk> chunk) {
+                loaded[i] = std::move(chunk);
+            });
+        }
+        io.wait();
+        double seconds = secondsSince(start);
+
+        VoKel::RegionStore::Stats stats = store.getStats();
+        std::cout << "async load (" << io.getBackendName() << "): " << stats.chunksRead / seconds << " chunks/s, "
+                  << stats.bytesRead / seconds / 1e6 << " MB/s compressed"
+                  << (verify(loaded) ? "" : " MISMATCH") << "\n";
+    }
+
+    // rewriting relocates every payload, freed sectors are reused by the next batch
+    {
+        VoKel::RegionStore store { directory };
+        store.save(batch);
+        uint64_t once = store.getDiskUsage();
+        store.save(batch);
+        std::cout << "after two rewrites " << store.getDiskUsage() / 1e6 << " MB on disk (" << once / 1e6 << " MB after one)\n";
+    }
+
+    return 0;
+}
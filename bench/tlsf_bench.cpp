@@ -0,0 +1,216 @@
+#include "tlsf_allocator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+
+/*
+ * TLSF allocator against a first fit free list kept in an ordered map, under
+ * the churn of chunk meshes streaming in and out: ranges the size of chunk
+ * vertex counts allocated into a fixed capacity and a random one freed for
+ * every one added. Every live range is checked for overlaps and alignment
+ * along the way. Afterwards the highest ranges are moved down into the holes
+ * the way the chunk mesh pool compacts, reporting the fragmentation before
+ * and after and how much had to move.
+ *
+ * usage: tlsf_bench [operations]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// free ranges by offset, the first one large enough is taken
+class FirstFit {
+public:
+    explicit FirstFit(uint64_t capacity) { free[0] = capacity; }
+
+    uint64_t allocate(uint64_t size)
+    {
+        for (auto it = free.begin(); it != free.end(); ++it) {
+            if (it->second >= size) {
+                uint64_t offset = it->first;
+                uint64_t rest = it->second - size;
+                free.erase(it);
+                if (rest > 0) {
+                    free[offset + size] = rest;
+                }
+                return offset;
+            }
+        }
+        return ~0ull;
+    }
+
+    void release(uint64_t offset, uint64_t size)
+    {
+        auto next = free.lower_bound(offset);
+        if (next != free.end() && next->first == offset + size) {
+            size += next->second;
+            next = free.erase(next);
+        }
+        if (next != free.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+        free[offset] = size;
+    }
+
+private:
+    std::map<uint64_t, uint64_t> free;
+};
+
+static bool disjoint(std::vector<std::pair<uint64_t, uint64_t>> ranges, uint64_t capacity)
+{
+    std::sort(ranges.begin(), ranges.end());
+    for (size_t i { 0 }; i < ranges.size(); i++) {
+        if (ranges[i].first + ranges[i].second > (i + 1 < ranges.size() ? ranges[i + 1].first : capacity)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t operations { argc > 1 ? uint32_t(std::max(1, std::atoi(argv[1]))) : 200000u };
+
+    // chunk meshes run from a few hundred to tens of thousands of vertices
+    std::mt19937 random { 11 };
+    std::lognormal_distribution<double> meshSize { 8.5, 1.0 };
+    auto nextSize = [&]() { return std::clamp<uint64_t>(uint64_t(meshSize(random)), 16, 200000); };
+
+    constexpr uint64_t CAPACITY { 64ull << 20 };
+    constexpr uint32_t LIVE { 4000 };
+
+    std::vector<uint64_t> sizes(operations);
+    std::vector<uint32_t> victims(operations);
+    for (uint32_t i { 0 }; i < operations; i++) {
+        sizes[i] = nextSize();
+        victims[i] = uint32_t(random());
+    }
+
+    bool match { true };
+
+    VoKel::TlsfAllocator tlsf { CAPACITY };
+    std::vector<uint32_t> live;
+    size_t failed { 0 };
+    size_t misaligned { 0 };
+
+    auto start = Clock::now();
+    for (uint32_t i { 0 }; i < operations; i++) {
+        if (live.size() >= LIVE) {
+            uint32_t victim = victims[i] % live.size();
+            tlsf.free(live[victim]);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+
+        uint64_t alignment = i % 7 == 0 ? 64 : 1;
+        uint32_t allocation = tlsf.allocate(sizes[i], alignment);
+        if (allocation == VoKel::TlsfAllocator::NO_ALLOCATION) {
+            failed++;
+        } else {
+            misaligned += tlsf.getOffset(allocation) % alignment != 0;
+            live.push_back(allocation);
+        }
+    }
+    double tlsfSeconds = secondsSince(start);
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    uint64_t used { 0 };
+    for (uint32_t i { 0 }; i < live.size(); i++) {
+        ranges.push_back({ tlsf.getOffset(live[i]), tlsf.getSize(live[i]) });
+        used += tlsf.getSize(live[i]);
+    }
+    match = match && disjoint(ranges, CAPACITY) && used == tlsf.getUsedSize() && misaligned == 0;
+
+    std::cout << "tlsf: " << tlsfSeconds * 1e9 / operations << " ns per allocation and free, " << failed << " failed, " << used * 100 / CAPACITY << "% used, fragmentation "
+              << tlsf.getFragmentation() << "\n";
+
+    FirstFit firstFit { CAPACITY };
+    std::vector<std::pair<uint64_t, uint64_t>> firstFitLive;
+    size_t firstFitFailed { 0 };
+
+    start = Clock::now();
+    for (uint32_t i { 0 }; i < operations; i++) {
+        if (firstFitLive.size() >= LIVE) {
+            uint32_t victim = victims[i] % firstFitLive.size();
+            firstFit.release(firstFitLive[victim].first, firstFitLive[victim].second);
+            firstFitLive[victim] = firstFitLive.back();
+            firstFitLive.pop_back();
+        }
+
+        uint64_t offset = firstFit.allocate(sizes[i]);
+        if (offset == ~0ull) {
+            firstFitFailed++;
+        } else {
+            firstFitLive.push_back({ offset, sizes[i] });
+        }
+    }
+    double firstFitSeconds = secondsSince(start);
+    match = match && disjoint(firstFitLive, CAPACITY);
+
+    std::cout << "first fit: " << firstFitSeconds * 1e9 / operations << " ns per allocation and free, " << firstFitFailed << " failed\n";
+
+    // aligned allocations land aligned
+    VoKel::TlsfAllocator aligned { 1 << 20 };
+    for (uint32_t i { 0 }; i < 1000; i++) {
+        uint64_t alignment = 1ull << (i % 9);
+        uint32_t allocation = aligned.allocate(1 + i % 37, alignment);
+        match = match && allocation != VoKel::TlsfAllocator::NO_ALLOCATION && aligned.getOffset(allocation) % alignment == 0;
+        if (i % 3 == 0) {
+            aligned.free(allocation);
+        }
+    }
+
+    // moving the highest ranges down into holes until the free space is one range again
+    std::map<uint32_t, uint32_t> slots;
+    for (uint32_t i { 0 }; i < live.size(); i++) {
+        slots[live[i]] = i;
+    }
+
+    float before = tlsf.getFragmentation();
+    uint64_t moved { 0 };
+    uint32_t moves { 0 };
+    start = Clock::now();
+    while (tlsf.getFragmentation() > 0.05f) {
+        uint32_t last = tlsf.getLastAllocation();
+        uint32_t target = tlsf.allocate(tlsf.getSize(last));
+        if (target == VoKel::TlsfAllocator::NO_ALLOCATION || tlsf.getOffset(target) > tlsf.getOffset(last)) {
+            if (target != VoKel::TlsfAllocator::NO_ALLOCATION) {
+                tlsf.free(target);
+            }
+            break;
+        }
+
+        moved += tlsf.getSize(last);
+        moves++;
+
+        uint32_t slot = slots[last];
+        slots.erase(last);
+        tlsf.free(last);
+        slots[target] = slot;
+        live[slot] = target;
+    }
+    double compactSeconds = secondsSince(start);
+
+    ranges.clear();
+    for (uint32_t allocation : live) {
+        ranges.push_back({ tlsf.getOffset(allocation), tlsf.getSize(allocation) });
+    }
+    match = match && disjoint(ranges, CAPACITY) && tlsf.getUsedSize() == used;
+
+    std::cout << "compaction: fragmentation " << before << " to " << tlsf.getFragmentation() << " in " << moves << " moves, " << moved * 100 / std::max<uint64_t>(used, 1)
+              << "% of the used space moved, " << compactSeconds * 1e3 << " ms\n";
+
+    std::cout << (match ? "all ranges disjoint\n" : "MISMATCH\n");
+    return match ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#include "entity_store.hpp"
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/*
+ * World matrices of a million entities: the compose kernel on one thread
+ * for every instruction set, checked against glm, then the entity store's
+ * update with everything dirty, with nothing dirty and with one entity in a
+ * hundred moved, which is what a frame of mostly static objects costs.
+ *
+ * usage: transform_bench [entities]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t count { argc > 1 ? uint32_t(std::max(1, std::atoi(argv[1]))) : 1u << 20 };
+
+    std::mt19937 random { 5 };
+    std::uniform_real_distribution<float> position { -1000.0f, 1000.0f };
+    std::uniform_real_distribution<float> unit { -1.0f, 1.0f };
+    std::uniform_real_distribution<float> size { 0.5f, 4.0f };
+
+    std::array<std::vector<float>, 3> positions;
+    std::array<std::vector<float>, 4> rotations;
+    std::array<std::vector<float>, 3> scales;
+    std::vector<glm::mat4> reference(count);
+
+    for (uint32_t i { 0 }; i < count; i++) {
+        glm::vec3 p { position(random), position(random), position(random) };
+        glm::quat q = glm::normalize(glm::quat { unit(random), unit(random), unit(random), unit(random) });
+        glm::vec3 s { size(random), size(random), size(random) };
+
+        for (int a { 0 }; a < 3; a++) {
+            positions[a].push_back(p[a]);
+            scales[a].push_back(s[a]);
+        }
+        rotations[0].push_back(q.x);
+        rotations[1].push_back(q.y);
+        rotations[2].push_back(q.z);
+        rotations[3].push_back(q.w);
+
+        reference[i] = glm::scale(glm::translate(glm::mat4 { 1.0f }, p) * glm::mat4_cast(q), s);
+    }
+
+    int rounds { 16 };
+    bool match { true };
+    std::vector<glm::mat4> matrices(count);
+
+    VoKel::SimdLevel best = VoKel::getSimdLevel();
+    for (VoKel::SimdLevel level : { VoKel::SimdLevel::Scalar, VoKel::SimdLevel::SSE4, VoKel::SimdLevel::AVX2 }) {
+        if (level > best) {
+            continue;
+        }
+
+        VoKel::TransformBatch batch {
+            { positions[0].data(), positions[1].data(), positions[2].data() },
+            { rotations[0].data(), rotations[1].data(), rotations[2].data(), rotations[3].data() },
+            { scales[0].data(), scales[1].data(), scales[2].data() },
+            0,
+            count,
+            &matrices[0][0][0],
+        };
+
+        auto start = Clock::now();
+        for (int round { 0 }; round < rounds; round++) {
+            VoKel::composeTransforms(batch, level);
+        }
+        double seconds = secondsSince(start) / rounds;
+
+        // glm rounds the quaternion products in another order
+        float error { 0.0f };
+        for (uint32_t i { 0 }; i < count; i++) {
+            for (int c { 0 }; c < 4; c++) {
+                glm::vec4 difference = glm::abs(matrices[i][c] - reference[i][c]);
+                error = std::max({ error, difference.x, difference.y, difference.z, difference.w });
+            }
+        }
+
+        bool same = error < 1e-4f;
+        match = match && same;
+        std::cout << VoKel::getSimdLevelName(level) << ": " << seconds * 1e3 * (1 << 20) / count << " ms per million matrices on one thread, max error "
+                  << error << (same ? "" : ", MISMATCH") << "\n";
+    }
+
+    VoKel::JobSystem jobs;
+    VoKel::EntityStore entities;
+
+    std::vector<VoKel::EntityId> ids;
+    for (uint32_t i { 0 }; i < count; i++) {
+        glm::quat q { rotations[3][i], rotations[0][i], rotations[1][i], rotations[2][i] };
+        ids.push_back(entities.create(VoKel::COMPONENT_BOUNDS | VoKel::COMPONENT_MESH, { positions[0][i], positions[1][i], positions[2][i] }, q,
+            { scales[0][i], scales[1][i], scales[2][i] }));
+        entities.setBounds(ids.back(), glm::vec3 { -0.5f }, glm::vec3 { 0.5f });
+    }
+
+    auto start = Clock::now();
+    entities.update(jobs);
+    std::cout << "EntityStore (" << VoKel::getSimdLevelName(best) << ", " << jobs.getThreadCount() + 1 << " threads): " << entities.getUpdatedCount()
+              << " new entities in " << secondsSince(start) * 1e3 << " ms\n";
+
+    for (uint32_t i { 0 }; i < count; i += 997) {
+        match = match && entities.getWorldMatrix(ids[i]) == matrices[i];
+    }
+
+    start = Clock::now();
+    for (int round { 0 }; round < rounds; round++) {
+        entities.update(jobs);
+    }
+    std::cout << "nothing changed: " << secondsSince(start) / rounds * 1e6 << " us, revision " << entities.getRevision() << "\n";
+
+    std::uniform_int_distribution<uint32_t> pick { 0, count - 1 };
+    double moveSeconds { 0.0 };
+    size_t changed { 0 };
+    for (int round { 0 }; round < rounds; round++) {
+        for (uint32_t i { 0 }; i < count / 100; i++) {
+            VoKel::EntityId entity = ids[pick(random)];
+            entities.setPosition(entity, entities.getPosition(entity) + glm::vec3 { 0.0f, 1.0f, 0.0f });
+        }
+
+        start = Clock::now();
+        entities.update(jobs);
+        moveSeconds += secondsSince(start);
+        changed += entities.getChangedInstances().size();
+    }
+    std::cout << "one in a hundred moved: " << moveSeconds / rounds * 1e3 << " ms, " << changed / rounds << " instances to upload\n";
+
+    // removals move the last instances into the holes
+    start = Clock::now();
+    for (uint32_t i { 0 }; i < count; i += 100) {
+        entities.destroy(ids[i]);
+    }
+    entities.update(jobs);
+    std::cout << "one in a hundred destroyed: " << secondsSince(start) * 1e3 << " ms, " << entities.getChangedInstances().size() << " instances to upload\n";
+
+    // the surviving instances still hold the matrices of the surviving entities
+    glm::dvec3 instanceSum { 0.0 };
+    for (const glm::mat4& matrix : entities.getInstanceMatrices()) {
+        instanceSum += glm::dvec3 { matrix[3] };
+    }
+    glm::dvec3 entitySum { 0.0 };
+    for (uint32_t i { 0 }; i < count; i++) {
+        if (entities.isAlive(ids[i])) {
+            entitySum += glm::dvec3 { entities.getPosition(ids[i]) };
+        }
+    }
+    match = match && entities.getInstanceCount() == entities.getEntityCount() && glm::all(glm::lessThan(glm::abs(instanceSum - entitySum), glm::dvec3 { 1.0 }));
+
+    std::cout << (match ? "all paths match\n" : "MISMATCH\n");
+    return match ? 0 : 1;
+}
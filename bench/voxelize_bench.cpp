@@ -0,0 +1,90 @@
+#include "job_system.hpp"
+#include "terrain_generator.hpp"
+#include "voxelizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numbers>
+
+/*
+ * Voxelizes a finely tessellated torus into an empty world with every fill
+ * mode and reports triangles and voxels per second. Radii are in voxels, the
+ * defaults give about a million triangles and twenty million solid voxels.
+ * The solid fills are checked against each other and against the volume of
+ * the torus, a closed mesh has to give the same interior either way.
+ *
+ * usage: voxelize_bench [major radius] [minor radius] [rings]
+ */
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    float major { argc > 1 ? float(std::max(2, std::atoi(argv[1]))) : 200.0f };
+    float minor { argc > 2 ? float(std::max(1, std::atoi(argv[2]))) : 70.0f };
+    uint32_t rings { argc > 3 ? uint32_t(std::max(3, std::atoi(argv[3]))) : 1024 };
+    uint32_t sides { std::max<uint32_t>(3, rings / 2) };
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    for (uint32_t i { 0 }; i < rings; i++) {
+        float u = 2.0f * std::numbers::pi_v<float> * i / rings;
+        for (uint32_t j { 0 }; j < sides; j++) {
+            float v = 2.0f * std::numbers::pi_v<float> * j / sides;
+            float distance = major + minor * std::cos(v);
+            positions.push_back({ distance * std::cos(u), minor * std::sin(v), distance * std::sin(u) });
+        }
+    }
+
+    for (uint32_t i { 0 }; i < rings; i++) {
+        for (uint32_t j { 0 }; j < sides; j++) {
+            uint32_t a = i * sides + j;
+            uint32_t b = (i + 1) % rings * sides + j;
+            uint32_t c = (i + 1) % rings * sides + (j + 1) % sides;
+            uint32_t d = i * sides + (j + 1) % sides;
+            indices.insert(indices.end(), { a, b, c, a, c, d });
+        }
+    }
+
+    // off the voxel grid, so no vertex or edge lies exactly on a voxel center
+    glm::mat4 transform = glm::translate(glm::mat4 { 1.0f }, glm::vec3 { 0.37f, 0.21f, 0.13f });
+
+    VoKel::JobSystem jobs;
+    std::cout << indices.size() / 3 << " triangles on " << jobs.getThreadCount() + 1 << " threads\n";
+
+    const char* names[3] { "surface", "parity", "flood fill" };
+    uint64_t solid[3] { 0 };
+
+    for (int mode { 0 }; mode < 3; mode++) {
+        VoKel::World world;
+        VoKel::MeshVoxelizer voxelizer { world, jobs };
+
+        auto stats = voxelizer.voxelize(positions, indices, transform, VoKel::MATERIAL_STONE, VoKel::MeshVoxelizer::Fill(mode));
+
+        auto start = Clock::now();
+        world.forEachChunk([&](const VoKel::ChunkCoord&, VoKel::Chunk& chunk) {
+            solid[mode] += chunk.getSolidCount();
+        });
+        double countSeconds = secondsSince(start);
+
+        std::cout << names[mode] << ": " << stats.surfaceVoxels << " surface, " << stats.interiorVoxels << " interior voxels in " << stats.chunks << " chunks\n";
+        std::cout << "  surface " << stats.surfaceSeconds << " s, fill " << stats.fillSeconds << " s, write " << stats.writeSeconds << " s, total " << stats.seconds << " s\n";
+        std::cout << "  " << stats.trianglesPerSecond() / 1e6 << " M triangles/s, " << stats.voxelsPerSecond() / 1e6 << " M voxels/s, counted back in "
+                  << countSeconds << " s\n";
+    }
+
+    double volume = 2.0 * std::numbers::pi * std::numbers::pi * major * minor * minor;
+    std::cout << "torus volume " << uint64_t(volume) << ", parity solid " << solid[1] << ", flood fill solid " << solid[2] << "\n";
+
+    bool agree = solid[1] == solid[2] && solid[1] > uint64_t(volume * 0.98);
+    std::cout << (agree ? "fills agree\n" : "fills disagree\n");
+    return agree ? 0 : 1;
+}
@@ -17,7 +17,13 @@ private:
     int numFrames;
     float frameTime;
 
+    bool renderModeKeyDown { false };
+    bool meshShadingKeyDown { false };
+
     void calculateFrameRate();
+    void updateCamera(float deltaTime);
+    void updateRenderMode();
+    void setRenderMode(VoKel::Engine::RenderMode mode);
 
 public:
     App(int width, int height);
@@ -0,0 +1,48 @@
+#pragma once
+#include "config.hpp"
+
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace VoKel {
+
+// FNV-1a, to key assets by the content of their source files
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+/*
+ * Processed assets cached in one file, keyed by a hash of their source and
+ * of how they were processed, so an edited source or a changed processing
+ * step simply misses. Entries are never removed, deleting the file clears
+ * the cache.
+ *
+ * The whole pack is read when opened and kept in memory, a pack of another
+ * version is ignored and reading stops at a damaged entry. save() writes a
+ * temporary file next to the pack and renames it over the old one, the
+ * pack is never seen half written. Lookups and additions may come from any
+ * thread.
+ */
+class AssetPack {
+public:
+    // an empty pack when the file is missing or unreadable, it is only created by save()
+    explicit AssetPack(const std::filesystem::path& path);
+
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+
+    // false when the key is not in the pack
+    bool read(uint64_t key, std::vector<uint8_t>& data);
+    void write(uint64_t key, std::vector<uint8_t> data);
+
+    // nothing to do unless entries were added, throws std::runtime_error when the file cannot be written
+    void save();
+
+private:
+    std::filesystem::path path;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> entries;
+    bool dirty { false };
+    std::mutex mutex;
+};
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace VoKel {
+
+struct ReadResult {
+    uint8_t* data;
+
+    // bytes actually read, short at the end of the file
+    uint32_t size;
+
+    // 0 or the errno of the failed read
+    int error;
+};
+
+struct ReadRequest {
+    uint32_t file;
+    uint64_t offset;
+    uint32_t size;
+
+    // the read lands here directly, must stay valid until the callback ran
+    void* destination;
+
+    // registered buffer containing destination, -1 for ordinary memory
+    int32_t buffer { -1 };
+
+    // runs on the completion thread, keep it short or hand the work to the job system
+    std::function<void(const ReadResult& result)> callback;
+};
+
+class IoBackend;
+
+/*
+ * Asynchronous file reads for streaming.
+ *
+ * On Linux requests go through an io_uring submission queue and complete on
+ * a single completion thread, registered buffers are read with fixed buffer
+ * reads so the kernel skips mapping them for every request. Where io_uring
+ * is missing or not permitted, a small pool of blocking reader threads takes
+ * the same requests. Neither path ever runs on the job system, so hundreds
+ * of reads can be in flight without blocking a worker.
+ */
+class AsyncIo {
+public:
+    static constexpr uint32_t INVALID_FILE { ~0u };
+
+    // queueDepth bounds the reads in flight, further requests wait in a backlog
+    explicit AsyncIo(uint32_t queueDepth = 256);
+    ~AsyncIo();
+
+    AsyncIo(const AsyncIo&) = delete;
+    AsyncIo& operator=(const AsyncIo&) = delete;
+
+    // read only, INVALID_FILE when the file cannot be opened
+    uint32_t openFile(const std::filesystem::path& path);
+
+    // reads still in flight on the file complete first
+    void closeFile(uint32_t file);
+
+    /*
+     * Register memory the reads will land in, typically staging buffers that
+     * live for the whole session. Buffer i of the list is referenced as
+     * ReadRequest::buffer i. Replaces every previous registration and waits
+     * for the reads in flight first.
+     */
+    void registerBuffers(const std::vector<std::pair<void*, size_t>>& buffers);
+
+    void read(ReadRequest request);
+
+    // one submission for the whole batch
+    void read(std::vector<ReadRequest> requests);
+
+    // blocks until every submitted read has completed and its callback returned
+    void wait();
+
+    const char* getBackendName() const;
+
+private:
+    // native descriptor or handle, closed once the last read on it completed
+    struct File {
+        intptr_t handle;
+        uint32_t pending;
+        bool closing;
+    };
+
+    std::unique_ptr<IoBackend> backend;
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    uint32_t inFlight { 0 };
+
+    std::vector<File> files;
+    std::vector<uint32_t> freeFiles;
+
+    friend class IoBackend;
+    void complete(ReadRequest& request, const ReadResult& result);
+};
+
+}
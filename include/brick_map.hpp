@@ -0,0 +1,97 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace VoKel {
+
+constexpr int BRICK_SIZE_LOG2 { 3 };
+constexpr int BRICK_SIZE { 1 << BRICK_SIZE_LOG2 };
+constexpr int BRICK_VOLUME { BRICK_SIZE * BRICK_SIZE * BRICK_SIZE };
+constexpr int BRICKS_PER_CHUNK { CHUNK_SIZE / BRICK_SIZE };
+
+// 8-bit materials, four to a word
+constexpr int BRICK_WORDS { BRICK_VOLUME / 4 };
+
+// grid cells hold BRICK_EMPTY, BRICK_UNIFORM | material, or the brick slot + 1
+constexpr uint32_t BRICK_EMPTY { 0 };
+constexpr uint32_t BRICK_UNIFORM { 0x80000000u };
+
+/*
+ * Two level sparse copy of the voxels around the camera, laid out for a GPU
+ * raymarcher. The top level is a dense grid with one cell per 8x8x8 brick
+ * of a window of chunks. Bricks that are all air or all one material live in
+ * their cell, every other brick takes a slot of BRICK_WORDS words holding
+ * one byte per voxel, x | z << 3 | y << 6 like the chunks.
+ *
+ * The window follows the camera a chunk at a time. Cells are addressed
+ * modulo the window size, so moving the window only rewrites the chunks that
+ * entered it. Each update records the cells and slots it wrote, letting the
+ * renderer upload just those. Materials above 255 are clamped.
+ */
+class BrickMap {
+public:
+    // window size in chunks
+    BrickMap(World& world, JobSystem& jobs, const glm::ivec3& extent = { 16, 8, 16 });
+
+    BrickMap(const BrickMap&) = delete;
+    BrickMap& operator=(const BrickMap&) = delete;
+
+    // a disabled map drops its bricks and ignores notifications, enabling it rebuilds the window
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled; }
+
+    // world notifications, the bricks are rebuilt on the next update
+    void chunkChanged(const ChunkCoord& coord);
+    void voxelChanged(const glm::ivec3& voxel);
+
+    // centers the window on the given position and rebuilds every changed brick in parallel
+    void update(const glm::vec3& center);
+
+    // first brick of the window, window size and the cell the first brick is stored in, all in bricks
+    glm::ivec3 getOrigin() const { return originChunk * BRICKS_PER_CHUNK; }
+    glm::ivec3 getExtent() const { return extent * BRICKS_PER_CHUNK; }
+    glm::ivec3 getWrap() const;
+
+    const std::vector<uint32_t>& getCells() const { return cells; }
+
+    // BRICK_WORDS per slot, free slots keep stale data
+    const std::vector<uint32_t>& getBricks() const { return bricks; }
+    uint32_t getBrickCount() const { return uint32_t(bricks.size() / BRICK_WORDS - freeSlots.size()); }
+
+    // cells and slots written by the last update that changed anything, which bumped the revision
+    const std::vector<uint32_t>& getChangedCells() const { return changedCells; }
+    const std::vector<uint32_t>& getChangedBricks() const { return changedBricks; }
+    uint64_t getRevision() const { return revision; }
+
+    uint32_t cellIndex(const glm::ivec3& brick) const;
+
+private:
+    World& world;
+    JobSystem& jobs;
+
+    glm::ivec3 extent;
+    glm::ivec3 originChunk { 0 };
+    bool enabled { false };
+    bool placed { false };
+
+    std::vector<uint32_t> cells;
+    std::vector<uint32_t> bricks;
+    std::vector<uint32_t> freeSlots;
+
+    // bricks to rebuild per chunk, one bit per brick of the chunk
+    std::unordered_map<uint64_t, uint64_t> dirtyChunks;
+
+    std::vector<uint32_t> changedCells;
+    std::vector<uint32_t> changedBricks;
+    uint64_t revision { 0 };
+
+    bool inWindow(const ChunkCoord& coord) const;
+    void rebuild(std::vector<std::pair<ChunkCoord, uint64_t>>& work);
+};
+
+}
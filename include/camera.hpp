@@ -0,0 +1,30 @@
+#pragma once
+#include "config.hpp"
+
+namespace VoKel {
+
+class Camera {
+public:
+    Camera();
+
+    glm::vec3 position;
+
+    // radians, yaw around +y starting from -z, pitch clamped short of the poles
+    float yaw, pitch;
+
+    float fieldOfView;
+    float nearPlane, farPlane;
+
+    glm::vec3 forward() const;
+    glm::vec3 right() const;
+
+    glm::mat4 view() const;
+
+    // vulkan clip space, y pointing down
+    glm::mat4 projection(float aspectRatio) const;
+
+    void move(const glm::vec3& localDirection, float distance);
+    void rotate(float deltaYaw, float deltaPitch);
+};
+
+}
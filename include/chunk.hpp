@@ -0,0 +1,89 @@
+#pragma once
+#include "config.hpp"
+
+#include <stdint.h>
+#include <vector>
+
+namespace VoKel {
+
+// voxel material id, 0 is always air
+using Voxel = uint16_t;
+constexpr Voxel AIR { 0 };
+
+constexpr int CHUNK_SIZE_LOG2 { 5 };
+constexpr int CHUNK_SIZE { 1 << CHUNK_SIZE_LOG2 };
+constexpr int CHUNK_AREA { CHUNK_SIZE * CHUNK_SIZE };
+constexpr int CHUNK_VOLUME { CHUNK_AREA * CHUNK_SIZE };
+
+using ChunkCoord = glm::ivec3;
+
+// 21 bits per axis, two's complement, fits in a single 64-bit key
+uint64_t packChunkCoord(const ChunkCoord& coord);
+ChunkCoord unpackChunkCoord(uint64_t key);
+
+ChunkCoord worldToChunk(const glm::ivec3& voxel);
+glm::ivec3 worldToLocal(const glm::ivec3& voxel);
+
+/*
+ * Palette compressed voxel storage.
+ *
+ * Every voxel stores an index into a small palette of distinct materials,
+ * the indices are bit packed using 0, 1, 2, 4, 8 or 16 bits so that a single
+ * index never straddles two words. A chunk filled with a single material
+ * (air most of the time) costs only its palette.
+ *
+ * Voxels are laid out x-fastest, then z, then y: index = x | z << 5 | y << 10.
+ */
+class Chunk {
+public:
+    Chunk();
+    explicit Chunk(Voxel fill);
+
+    static constexpr int index(int x, int y, int z) { return x | (z << CHUNK_SIZE_LOG2) | (y << (2 * CHUNK_SIZE_LOG2)); }
+
+    Voxel get(int x, int y, int z) const { return getIndex(index(x, y, z)); }
+    Voxel getIndex(int i) const;
+
+    void set(int x, int y, int z, Voxel voxel) { setIndex(index(x, y, z), voxel); }
+    void setIndex(int i, Voxel voxel);
+
+    void fill(Voxel voxel);
+
+    // decode the whole chunk into a dense CHUNK_VOLUME array
+    void decode(Voxel* out) const;
+
+    // drop palette entries that are no longer referenced and shrink the indices
+    void compact();
+
+    bool isEmpty() const { return solidCount == 0; }
+    bool isFull() const { return solidCount == CHUNK_VOLUME; }
+    uint32_t getSolidCount() const { return solidCount; }
+
+    const std::vector<Voxel>& getPalette() const { return palette; }
+    uint32_t getBitsPerIndex() const { return bitsPerIndex; }
+
+    // packed palette indices, CHUNK_VOLUME * bitsPerIndex bits in 64-bit words
+    const std::vector<uint64_t>& getIndices() const { return indices; }
+
+    /*
+     * Replace the storage with serialized data and return the index words,
+     * sized for bitsPerIndex, for the caller to fill in place. Throws when
+     * the palette does not fit the index width.
+     */
+    uint64_t* restore(const Voxel* palette, uint32_t paletteSize, uint32_t bitsPerIndex, uint32_t solidCount);
+    size_t memoryUsage() const;
+
+private:
+    std::vector<Voxel> palette;
+    std::vector<uint64_t> indices;
+    uint32_t bitsPerIndex;
+    uint32_t solidCount;
+
+    uint32_t findOrAddPaletteEntry(Voxel voxel);
+    void resizeIndices(uint32_t newBits);
+
+    uint32_t readIndex(int i) const;
+    void writeIndex(int i, uint32_t paletteIndex);
+};
+
+}
@@ -0,0 +1,362 @@
+#pragma once
+#include "chunk.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <stdexcept>
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Flat hash map from packed chunk coordinates to values.
+ *
+ * Open addressing with Robin Hood linear probing: an insert displaces any
+ * entry that sits closer to its home slot than the one being placed, so probe
+ * lengths stay short and even, and a lookup stops as soon as it meets an
+ * entry closer to home than the key would be. Erasing shifts the following
+ * run back by one slot instead of leaving tombstones, so the table never
+ * degrades under the constant load and unload of streaming.
+ *
+ * Keys, probe distances and values are kept in separate arrays, a probe
+ * walks contiguous keys and only touches the value it returns. Values move
+ * when the table grows or entries are erased, pointers into the map are
+ * only valid until the next insert or erase. Concurrent lookups are safe as
+ * long as nothing modifies the map.
+ */
+template <typename Value>
+class ChunkMap {
+public:
+    // offsets of the 3x3x3 block around a chunk, index = (x + 1) + (y + 1) * 3 + (z + 1) * 9
+    static constexpr int NEIGHBORHOOD { 27 };
+
+    ChunkMap() = default;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return keys.size(); }
+
+    void clear()
+    {
+        keys.clear();
+        distances.clear();
+        values.clear();
+        count = 0;
+        shift = 64;
+    }
+
+    void reserve(size_t entries)
+    {
+        size_t slots { MIN_SLOTS };
+        while (slots * MAX_LOAD_NUM < entries * MAX_LOAD_DEN) {
+            slots *= 2;
+        }
+        if (slots > keys.size()) {
+            rehash(slots);
+        }
+    }
+
+    Value* find(uint64_t key)
+    {
+        size_t slot = locate(key);
+        return slot == NOT_FOUND ? nullptr : &values[slot];
+    }
+
+    const Value* find(uint64_t key) const
+    {
+        size_t slot = locate(key);
+        return slot == NOT_FOUND ? nullptr : &values[slot];
+    }
+
+    bool contains(uint64_t key) const { return locate(key) != NOT_FOUND; }
+
+    // inserts a default value when the key is missing
+    Value& operator[](uint64_t key)
+    {
+        size_t slot = locate(key);
+        if (slot != NOT_FOUND) {
+            return values[slot];
+        }
+
+        if ((count + 1) * MAX_LOAD_DEN > keys.size() * MAX_LOAD_NUM) {
+            rehash(keys.empty() ? MIN_SLOTS : keys.size() * 2);
+        }
+
+        // a probe this long means the hash is failing, a larger table spreads it out
+        while (!fits(key)) {
+            if (keys.size() >= MAX_SPREAD * (count + 1)) {
+                throw std::runtime_error { "Chunk map probe too long" };
+            }
+            rehash(keys.size() * 2);
+        }
+
+        return values[place(values, key, Value {})];
+    }
+
+    bool erase(uint64_t key)
+    {
+        size_t slot = locate(key);
+        if (slot == NOT_FOUND) {
+            return false;
+        }
+
+        // backward shift, every entry of the run moves one slot closer to home
+        size_t mask = keys.size() - 1;
+        size_t next = (slot + 1) & mask;
+        while (distances[next] > 1) {
+            keys[slot] = keys[next];
+            distances[slot] = distances[next] - 1;
+            values[slot] = std::move(values[next]);
+            slot = next;
+            next = (next + 1) & mask;
+        }
+
+        distances[slot] = 0;
+        values[slot] = Value {};
+        count--;
+        return true;
+    }
+
+    /*
+     * Values of the chunk and its 26 neighbors, nullptr where there is none.
+     * Every home slot is prefetched before the first probe, so the 27 cache
+     * misses overlap instead of being taken one after another.
+     */
+    void gatherNeighborhood(const ChunkCoord& center, std::array<Value*, NEIGHBORHOOD>& out)
+    {
+        std::array<size_t, NEIGHBORHOOD> slots;
+        locateNeighborhood(center, slots);
+        for (int i { 0 }; i < NEIGHBORHOOD; i++) {
+            out[i] = slots[i] == NOT_FOUND ? nullptr : &values[slots[i]];
+        }
+    }
+
+    void gatherNeighborhood(const ChunkCoord& center, std::array<const Value*, NEIGHBORHOOD>& out) const
+    {
+        std::array<size_t, NEIGHBORHOOD> slots;
+        locateNeighborhood(center, slots);
+        for (int i { 0 }; i < NEIGHBORHOOD; i++) {
+            out[i] = slots[i] == NOT_FOUND ? nullptr : &values[slots[i]];
+        }
+    }
+
+    // visits every entry, the map must not be modified meanwhile
+    template <typename Function>
+    void forEach(Function&& function)
+    {
+        for (size_t slot { 0 }; slot < keys.size(); slot++) {
+            if (distances[slot] != 0) {
+                function(keys[slot], values[slot]);
+            }
+        }
+    }
+
+    template <typename Function>
+    void forEach(Function&& function) const
+    {
+        for (size_t slot { 0 }; slot < keys.size(); slot++) {
+            if (distances[slot] != 0) {
+                function(keys[slot], values[slot]);
+            }
+        }
+    }
+
+    // longest probe of any entry, for benchmarks
+    uint32_t maxProbe() const
+    {
+        uint32_t longest { 0 };
+        for (uint8_t distance : distances) {
+            longest = std::max<uint32_t>(longest, distance);
+        }
+        return longest;
+    }
+
+private:
+    static constexpr size_t NOT_FOUND { ~size_t(0) };
+    static constexpr size_t MIN_SLOTS { 16 };
+
+    // grow past 7/8 full, Robin Hood keeps probes short up to there
+    static constexpr size_t MAX_LOAD_NUM { 7 };
+    static constexpr size_t MAX_LOAD_DEN { 8 };
+
+    // slots per entry the table may grow to for probes to fit before the keys are deemed unhashable
+    static constexpr size_t MAX_SPREAD { 64 };
+
+    std::vector<uint64_t> keys;
+    // probe distance plus one, 0 marks an empty slot
+    std::vector<uint8_t> distances;
+    std::vector<Value> values;
+
+    size_t count { 0 };
+    int shift { 64 };
+
+    // fibonacci hashing, the top bits mix all three packed axes
+    size_t home(uint64_t key) const
+    {
+        return size_t((key * 0x9e3779b97f4a7c15ull) >> shift);
+    }
+
+    size_t locate(uint64_t key) const
+    {
+        if (count == 0) {
+            return NOT_FOUND;
+        }
+
+        return probe(key, home(key));
+    }
+
+    size_t probe(uint64_t key, size_t slot) const
+    {
+        size_t mask = keys.size() - 1;
+
+        for (uint32_t distance { 1 };; distance++) {
+            if (distances[slot] < distance) {
+                return NOT_FOUND;
+            }
+            if (keys[slot] == key) {
+                return slot;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    // whether placing the key keeps every probe distance within a byte, walks the displacement without moving anything
+    bool fits(uint64_t key) const
+    {
+        size_t mask = keys.size() - 1;
+        size_t slot = home(key);
+
+        for (uint32_t distance { 1 }; distance < 0xff; distance++) {
+            if (distances[slot] == 0) {
+                return true;
+            }
+            if (distances[slot] < distance) {
+                distance = distances[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        return false;
+    }
+
+    // key must be missing, a slot free and the key must fit, returns the slot the key ended up in,
+    // the payloads are the values or, while rehashing, the slots the entries came from
+    template <typename Payload>
+    size_t place(std::vector<Payload>& payloads, uint64_t key, Payload payload)
+    {
+        size_t mask = keys.size() - 1;
+        size_t slot = home(key);
+        size_t placed { NOT_FOUND };
+        uint32_t distance { 1 };
+
+        while (true) {
+            if (distances[slot] == 0) {
+                keys[slot] = key;
+                distances[slot] = uint8_t(distance);
+                payloads[slot] = std::move(payload);
+                count++;
+                return placed == NOT_FOUND ? slot : placed;
+            }
+
+            // take the slot from an entry closer to its home and carry that one on
+            if (distances[slot] < distance) {
+                std::swap(keys[slot], key);
+                std::swap(payloads[slot], payload);
+                uint32_t displaced = distances[slot];
+                distances[slot] = uint8_t(distance);
+                distance = displaced;
+
+                if (placed == NOT_FOUND) {
+                    placed = slot;
+                }
+            }
+
+            slot = (slot + 1) & mask;
+            distance++;
+        }
+    }
+
+    // keys first, carrying the slots they came from, so a size too small for some probe is retried larger
+    // before any value has moved
+    void rehash(size_t slots)
+    {
+        std::vector<uint64_t> oldKeys = std::move(keys);
+        std::vector<uint8_t> oldDistances = std::move(distances);
+        size_t oldCount = count;
+        int oldShift = shift;
+        std::vector<size_t> sources;
+
+        while (!placeKeys(oldKeys, oldDistances, slots, sources)) {
+            slots *= 2;
+
+            // keys this clustered defeat the hash at any size, the map is left as it was
+            if (slots > MAX_SPREAD * std::max(oldCount, MIN_SLOTS)) {
+                keys = std::move(oldKeys);
+                distances = std::move(oldDistances);
+                count = oldCount;
+                shift = oldShift;
+                throw std::runtime_error { "Chunk map probe too long" };
+            }
+        }
+
+        std::vector<Value> oldValues = std::move(values);
+        values.clear();
+        values.resize(slots);
+        for (size_t slot { 0 }; slot < slots; slot++) {
+            if (distances[slot] != 0) {
+                values[slot] = std::move(oldValues[sources[slot]]);
+            }
+        }
+    }
+
+    bool placeKeys(const std::vector<uint64_t>& oldKeys, const std::vector<uint8_t>& oldDistances, size_t slots, std::vector<size_t>& sources)
+    {
+        keys.assign(slots, 0);
+        distances.assign(slots, 0);
+        sources.assign(slots, 0);
+        count = 0;
+        shift = 64 - std::countr_zero(slots);
+
+        for (size_t slot { 0 }; slot < oldKeys.size(); slot++) {
+            if (oldDistances[slot] != 0) {
+                if (!fits(oldKeys[slot])) {
+                    return false;
+                }
+                place(sources, oldKeys[slot], slot);
+            }
+        }
+        return true;
+    }
+
+    void locateNeighborhood(const ChunkCoord& center, std::array<size_t, NEIGHBORHOOD>& out) const
+    {
+        if (count == 0) {
+            out.fill(NOT_FOUND);
+            return;
+        }
+
+        // the packed axes are separate bit fields, three packs give every combination
+        constexpr uint64_t FIELD { (1ull << 21) - 1 };
+        uint64_t packed[3] {
+            packChunkCoord(center - 1),
+            packChunkCoord(center),
+            packChunkCoord(center + 1),
+        };
+
+        std::array<uint64_t, NEIGHBORHOOD> neighborKeys;
+        for (int i { 0 }; i < NEIGHBORHOOD; i++) {
+            neighborKeys[i] = (packed[i % 3] & FIELD) | (packed[(i / 3) % 3] & (FIELD << 21)) | (packed[i / 9] & (FIELD << 42));
+            out[i] = home(neighborKeys[i]);
+#if defined(__GNUC__)
+            __builtin_prefetch(&distances[out[i]]);
+            __builtin_prefetch(&keys[out[i]]);
+#endif
+        }
+
+        for (int i { 0 }; i < NEIGHBORHOOD; i++) {
+            out[i] = probe(neighborKeys[i], out[i]);
+        }
+    }
+};
+
+}
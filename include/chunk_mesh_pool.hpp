@@ -0,0 +1,169 @@
+#pragma once
+#include "chunk_mesher.hpp"
+#include "config.hpp"
+#include "memory.hpp"
+#include "tlsf_allocator.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace VoKel {
+
+struct ChunkMeshPoolSettings {
+    // first size of the buffers, they double whenever an allocation does not fit
+    uint64_t initialVertices { 1 << 20 };
+    uint64_t initialIndices { 1 << 20 };
+
+    // share of the free space outside the largest free range above which meshes are moved down
+    float compactionThreshold { 0.25f };
+    size_t compactionBytesPerFrame { 4 << 20 };
+};
+
+/*
+ * Every chunk mesh in one device local vertex buffer and one index buffer,
+ * so the terrain binds them once and draws each chunk at its offsets. The
+ * ranges come from two TLSF allocators counted in vertices and indices,
+ * indices stay relative to their mesh and the draws pass vertexOffset.
+ * Voxel meshes keep their faces in the vertex slots and take no indices,
+ * the vertex shaders pull both kinds from the vertex buffer as storage.
+ *
+ * Meshes added between frames are copied in by record through that frame's
+ * staging buffer. Ranges of removed meshes stay reserved until the frames
+ * in flight that may still draw them are done. A buffer that runs out of
+ * room is reallocated twice as large and its contents copied over on the
+ * gpu. When the free space of a buffer breaks up past the threshold, record
+ * moves the highest meshes down into the holes a few megabytes per frame,
+ * so the free space gathers at the end again.
+ */
+class ChunkMeshPool {
+public:
+    static constexpr uint32_t NO_MESH { ~0u };
+
+    struct DrawRange {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+
+        // faces of a voxel mesh starting at vertexOffset, drawn as six vertices each, 0 for indexed meshes
+        uint32_t faceCount;
+    };
+
+    struct Stats {
+        uint32_t meshes;
+        uint64_t usedVertices;
+        uint64_t vertexCapacity;
+        uint64_t usedIndices;
+        uint64_t indexCapacity;
+        float vertexFragmentation;
+        float indexFragmentation;
+
+        // copied by the last record, from the staging buffer and within the pool
+        size_t uploadedBytes;
+        size_t movedBytes;
+    };
+
+    // framesInFlight is how many records pass before a freed range can no longer be read
+    ChunkMeshPool(vk::Device device, vk::PhysicalDevice physicalDevice, int framesInFlight, const ChunkMeshPoolSettings& settings = {});
+    ~ChunkMeshPool();
+
+    ChunkMeshPool(const ChunkMeshPool&) = delete;
+    ChunkMeshPool& operator=(const ChunkMeshPool&) = delete;
+
+    // NO_MESH for an empty mesh, the data is copied and uploaded by the next record
+    uint32_t add(const ChunkMeshData& data);
+
+    // ranges for a mesh the gpu writes itself, at the offsets of its draw range after the next record,
+    // vertexCount counts the faces of a voxel mesh, which has no indices
+    uint32_t reserve(uint64_t vertexCount, uint64_t indexCount);
+    void remove(uint32_t mesh);
+
+    DrawRange getDrawRange(uint32_t mesh) const;
+
+    // records growth, uploads and compaction with the barrier before the vertex stage reads them,
+    // outside a render pass, frame is the frame in flight whose fence was waited on
+    void record(vk::CommandBuffer commandBuffer, uint32_t frame);
+
+    // binds the index buffer, the vertices are read through getVertexBuffer
+    void bind(vk::CommandBuffer commandBuffer) const;
+
+    // current buffers, both storage buffers, they change when record grows them
+    vk::Buffer getVertexBuffer() const { return vertices.buffer.buffer; }
+    vk::Buffer getIndexBuffer() const { return indices.buffer.buffer; }
+
+    Stats getStats() const;
+
+private:
+    // one of the two buffers, counted in elements of elementSize bytes
+    struct Arena {
+        TlsfAllocator allocator;
+        vkUtil::Buffer buffer;
+        uint64_t bufferCapacity;
+        size_t elementSize;
+        vk::BufferUsageFlags usage;
+
+        // mesh owning each live allocation, compaction finds the mesh of the highest range through it
+        std::unordered_map<uint32_t, uint32_t> owners;
+    };
+
+    struct Mesh {
+        uint32_t vertexAllocation;
+
+        // NO_ALLOCATION for voxel meshes
+        uint32_t indexAllocation;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+    };
+
+    struct Upload {
+        uint32_t mesh;
+        std::vector<vkMesh::ChunkVertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<vkMesh::ChunkFace> faces;
+    };
+
+    struct RetiredRange {
+        Arena* arena;
+        uint32_t allocation;
+        int framesLeft;
+    };
+
+    struct RetiredBuffer {
+        vkUtil::Buffer buffer;
+        int framesLeft;
+    };
+
+    struct Frame {
+        vkUtil::Buffer staging;
+        size_t stagingSize;
+    };
+
+    vk::Device device;
+    vk::PhysicalDevice physicalDevice;
+    int framesInFlight;
+    ChunkMeshPoolSettings settings;
+
+    Arena vertices;
+    Arena indices;
+
+    std::vector<Mesh> meshes;
+    std::vector<uint32_t> freeMeshes;
+    std::vector<Upload> uploads;
+
+    std::vector<RetiredRange> retiredRanges;
+    std::vector<RetiredBuffer> retiredBuffers;
+    std::vector<Frame> frames;
+
+    size_t uploadedBytes { 0 };
+    size_t movedBytes { 0 };
+
+    uint32_t allocate(Arena& arena, uint64_t count, uint32_t mesh);
+    void retire(Arena& arena, uint32_t allocation);
+
+    // reallocates the buffer when the allocator grew past it, with the copy of the old contents
+    bool growBuffer(vk::CommandBuffer commandBuffer, Arena& arena);
+
+    // moves the highest meshes down, the copies go into moves and the draw ranges change right away
+    void compact(Arena& arena, std::vector<vk::BufferCopy>& moves);
+};
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "mesh.hpp"
+
+#include <array>
+#include <vector>
+
+namespace VoKel {
+
+// face order used for neighbors, skirt masks and vertex normals
+enum class Face : uint8_t {
+    PositiveX,
+    NegativeX,
+    PositiveY,
+    NegativeY,
+    PositiveZ,
+    NegativeZ
+};
+
+constexpr std::array<glm::ivec3, 6> FACE_DIRECTIONS {
+    glm::ivec3 { 1, 0, 0 }, glm::ivec3 { -1, 0, 0 },
+    glm::ivec3 { 0, 1, 0 }, glm::ivec3 { 0, -1, 0 },
+    glm::ivec3 { 0, 0, 1 }, glm::ivec3 { 0, 0, -1 }
+};
+
+// voxel meshes are faces only, smooth meshes indexed vertices
+struct ChunkMeshData {
+    std::vector<vkMesh::ChunkVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<vkMesh::ChunkFace> faces;
+
+    bool empty() const { return indices.empty() && faces.empty(); }
+    size_t byteSize() const
+    {
+        return vertices.size() * sizeof(vkMesh::ChunkVertex) + indices.size() * sizeof(uint32_t) + faces.size() * sizeof(vkMesh::ChunkFace);
+    }
+};
+
+struct ChunkMeshInput {
+    const Chunk* chunk;
+
+    // same level of detail neighbors in Face order, nullptr reads as air
+    std::array<const Chunk*, 6> neighbors;
+
+    /*
+     * Faces bordering a chunk of a different level of detail. Border voxels on
+     * these sides always emit their outward face, acting as a skirt that hides
+     * the crack between the two resolutions.
+     */
+    uint8_t skirtMask;
+
+    /*
+     * Light of the chunk and its face neighbors in chunk voxel order, sky
+     * light in the high nibble and block light in the low one. Without light
+     * every face gets full sky light, missing neighbors repeat the border.
+     */
+    const uint8_t* light;
+    std::array<const uint8_t*, 6> neighborLight;
+};
+
+/*
+ * Everything the mesher reads: the chunk with a one voxel border from its
+ * neighbors and the light of the same cells, from -1 to CHUNK_SIZE on every
+ * axis, x fastest, then z, then y. Once filled it meshes on any thread, or
+ * goes to the gpu mesher as it is.
+ */
+struct ChunkMeshVolume {
+    static constexpr int SIZE { CHUNK_SIZE + 2 };
+    static constexpr int VOLUME { SIZE * SIZE * SIZE };
+
+    std::vector<Voxel> voxels = std::vector<Voxel>(VOLUME);
+    std::vector<uint8_t> light = std::vector<uint8_t>(VOLUME);
+
+    // unlit volumes leave the light cells unfilled, every face gets full sky light
+    bool lit { false };
+
+    static constexpr int index(int x, int y, int z) { return (x + 1) + (z + 1) * SIZE + (y + 1) * SIZE * SIZE; }
+};
+
+// false when the chunk is missing or empty and there is nothing to mesh
+bool fillChunkMeshVolume(const ChunkMeshInput& input, ChunkMeshVolume& volume);
+
+/*
+ * Greedy mesh of the chunk in chunk-local voxel units of its own level of detail.
+ *
+ * Every corner carries the classic voxel ambient occlusion, from the two
+ * side and the diagonal voxel in front of the face, and the smoothed light
+ * of the open cells around it. Faces merge only when all of that matches.
+ * Each merged quad is one ChunkFace, the vertex shader expands it and splits
+ * quads whose occlusion is uneven along one diagonal along the other, so the
+ * shading stays symmetric.
+ */
+ChunkMeshData meshChunk(const ChunkMeshInput& input);
+
+// the same mesh from a filled volume
+ChunkMeshData meshChunkVolume(const ChunkMeshVolume& volume);
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace VoKel {
+
+struct StreamingSettings {
+    // chunks whose center is within loadRadius chunks of the camera are kept resident
+    float loadRadius { 8.0f };
+
+    // resident chunks are unloaded only past loadRadius + hysteresis so walking along a border does not thrash
+    float hysteresis { 2.0f };
+
+    // chunks straight behind the camera are loaded as if they were 1 + directionWeight times farther away
+    float directionWeight { 1.0f };
+
+    // loads running on the job system at once
+    uint32_t maxPendingLoads { 64 };
+
+    // finished loads inserted into the world and chunks dropped from it per update
+    uint32_t loadsPerUpdate { 16 };
+    uint32_t unloadsPerUpdate { 32 };
+};
+
+/*
+ * Keeps a sphere of full resolution chunks resident around the camera.
+ *
+ * Missing chunks are sorted by distance, weighted by the view direction, and
+ * loaded on the job system a few at a time. Finished chunks are inserted into
+ * the world on the calling thread, at most loadsPerUpdate of them per update,
+ * so moving fast only delays chunks instead of stalling a frame. Chunks are
+ * read through the async loader or the loader first and generated when they
+ * have nothing for them. An async read does not hold a job while it waits.
+ */
+class ChunkStreamer {
+public:
+    // returns nullptr when the chunk has never been stored, called from worker threads
+    using Loader = std::function<std::unique_ptr<Chunk>(const ChunkCoord& coord)>;
+
+    // starts reading a stored chunk and returns true, done then runs once with the chunk or nullptr, false when nothing is stored
+    using AsyncLoader = std::function<bool(const ChunkCoord& coord, std::function<void(std::unique_ptr<Chunk> chunk)> done)>;
+
+    // receives every chunk leaving the world, called on the updating thread
+    using UnloadHandler = std::function<void(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)>;
+
+    struct Stats {
+        uint64_t loaded;
+        uint64_t unloaded;
+        uint32_t pending;
+        uint32_t queued;
+    };
+
+    ChunkStreamer(World& world, JobSystem& jobs, StreamingSettings settings = {});
+    ~ChunkStreamer();
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    void setLoader(Loader loader) { this->loader = std::move(loader); }
+    void setAsyncLoader(AsyncLoader loader) { asyncLoader = std::move(loader); }
+    void setUnloadHandler(UnloadHandler handler) { unloadHandler = std::move(handler); }
+
+    void update(const glm::vec3& cameraPosition, const glm::vec3& viewDirection);
+
+    // hands every resident chunk to the unload handler, used before shutting down
+    void unloadAll();
+
+    bool isWanted(const ChunkCoord& coord) const;
+
+    Stats getStats() const;
+    const StreamingSettings& getSettings() const { return settings; }
+
+private:
+    struct Result {
+        ChunkCoord coord;
+        std::unique_ptr<Chunk> chunk;
+    };
+
+    World& world;
+    JobSystem& jobs;
+    StreamingSettings settings;
+
+    Loader loader;
+    AsyncLoader asyncLoader;
+    UnloadHandler unloadHandler;
+
+    ChunkCoord cameraChunk;
+    glm::vec3 cameraPosition { 0.0f };
+    glm::vec3 viewDirection { 0.0f, 0.0f, -1.0f };
+    bool queueValid { false };
+
+    // missing chunks, highest priority at the back
+    std::vector<ChunkCoord> loadQueue;
+    std::unordered_set<uint64_t> pendingLoads;
+    std::vector<ChunkCoord> unloadQueue;
+
+    // shared with the load jobs
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::vector<Result> results;
+    uint32_t running { 0 };
+    bool stopping { false };
+
+    uint64_t loadedCount { 0 };
+    uint64_t unloadedCount { 0 };
+
+    float priority(const ChunkCoord& coord) const;
+    void rebuildQueues();
+    void dispatchLoads();
+    void insertResults();
+    void unloadChunks();
+
+    void startLoad(const ChunkCoord& coord);
+    void generateChunk(const ChunkCoord& coord);
+    void finishLoad(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+};
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "chunk_mesher.hpp"
+#include "config.hpp"
+#include "frustum_cull.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <unordered_set>
+#include <vector>
+
+namespace VoKel {
+
+// bit per pair of faces in Face order, set when open voxels connect the two
+uint16_t faceConnectivity(const Chunk& chunk);
+
+// bit of faceConnectivity for two distinct faces
+uint16_t facePairBit(int a, int b);
+
+/*
+ * Occlusion culling through the air of the world.
+ *
+ * Every resident chunk records which of its faces are connected through
+ * open voxels, found by flood filling the chunk once when it arrives or is
+ * edited. Each frame a breadth first search starts at the camera chunk and
+ * only leaves a chunk through a face connected to the one it came in by,
+ * and never in the direction opposite to a step it already took, so it
+ * moves away from the camera. Every path to a chunk then has the same
+ * length, the faces it is entered through all arrive in one layer of the
+ * search and the chunk is crossed once, leaving by the faces connected to
+ * any of them. Chunks it never reaches cannot be seen through air and
+ * are culled, a mountain hides everything behind it and a cave only shows
+ * the passages it opens into.
+ *
+ * Chunks that are not resident are reached but not crossed. The search
+ * covers a cube of the given radius in chunks around the camera, chunks
+ * outside it are never culled.
+ */
+class ChunkVisibility {
+public:
+    struct Stats {
+        uint32_t steps;
+        uint32_t connectivityUpdates;
+        double searchSeconds;
+    };
+
+    ChunkVisibility(World& world, JobSystem& jobs, int radius = 32);
+
+    ChunkVisibility(const ChunkVisibility&) = delete;
+    ChunkVisibility& operator=(const ChunkVisibility&) = delete;
+
+    // world notifications, the connectivity is recomputed on the next update
+    void chunkChanged(const ChunkCoord& coord);
+    void voxelChanged(const glm::ivec3& voxel);
+
+    // flood fills every changed chunk in parallel
+    void update();
+
+    // new search from the camera, chunks outside the frustum are not entered either
+    void traverse(const glm::vec3& cameraPosition, const Frustum& frustum);
+
+    // result of the last search
+    bool isVisible(const ChunkCoord& coord) const;
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    World& world;
+    JobSystem& jobs;
+
+    ChunkMap<uint16_t> connectivity;
+    std::unordered_set<uint64_t> dirtyChunks;
+
+    // search cube around the camera chunk, a chunk has the cell at its coordinate modulo the extent,
+    // indexed (y * extent + z) * extent + x. A cell keeps its chunk while the camera moves, only the
+    // layers of cells the cube moves onto are given new chunks
+    int radius;
+    int extent;
+    ChunkCoord center { 0 };
+    uint16_t search { 0 };
+
+    // a cell caches the connectivity of its chunk, filled from the map when the chunk is first reached and
+    // written through by update. It is reached when it holds the current search, then it has the faces it
+    // was entered through, all in one place for the step that looks at it and small enough for the cube to
+    // stay in cache
+    struct Cell {
+        uint16_t search;
+        uint16_t connected;
+        uint8_t entries;
+    };
+    std::vector<Cell> cube;
+
+    // per axis and cell coordinate the part of every frustum plane's distance to a cell that comes from
+    // that axis, the planes of one coordinate side by side, so a cell is tested with three rows of additions
+    std::vector<float> planeDistances;
+
+    // per face and cell coordinate along its axis the index offset of the neighbor, wrapped like the cube
+    std::vector<int32_t> faceSteps;
+
+    size_t cellIndex(const ChunkCoord& coord) const;
+    void moveCube(const ChunkCoord& camera);
+
+    // cells by their position in the search cube and by index
+    struct Step {
+        glm::ivec3 local;
+        uint32_t index;
+        uint8_t directions;
+    };
+    std::vector<Step> queue;
+
+    Stats stats {};
+};
+
+}
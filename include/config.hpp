@@ -31,5 +31,7 @@ const bool DEBUG_MODE = true;
 #include <string>
 #include <vector>
 
+// vulkan clip space uses a [0, 1] depth range
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -23,8 +23,15 @@ bool checkDeviceExtensionSupport(const vk::PhysicalDevice& physicalDevice, const
 
 vk::PhysicalDevice choosePhysicalDevice(const vk::Instance& instance);
 
+// task and mesh shaders through VK_EXT_mesh_shader, which needs Vulkan 1.1 from the instance and the device
+bool supportsMeshShaders(const vk::PhysicalDevice& physicalDevice);
+
+// enables mesh shaders where supported
 vk::Device createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface);
 
+// null unless the device was created with mesh shaders
+PFN_vkCmdDrawMeshTasksEXT loadDrawMeshTasks(const vk::Device& device);
+
 std::tuple<vk::Queue, vk::Queue> getQueue(const vk::PhysicalDevice& physicalDevice, const vk::Device& device, const vk::SurfaceKHR& surface);
 
 }
\ No newline at end of file
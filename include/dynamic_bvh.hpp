@@ -0,0 +1,134 @@
+#pragma once
+#include "config.hpp"
+#include "frustum_cull.hpp"
+#include "job_system.hpp"
+
+#include <utility>
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Dynamic bounding volume hierarchy over moving boxes, for culling, picking
+ * and the collision broadphase.
+ *
+ * Every box is a leaf holding its exact bounds and a fattened copy the tree
+ * is built from, so small moves stay inside the fat box and cost nothing.
+ * A box that leaves it gets a new fat box, grown along its displacement,
+ * and its ancestors are refit on the way up. Leaves are inserted next to
+ * the sibling that adds the least surface area to the tree, found with a
+ * branch and bound search. Refits only ever patch the tree, every internal
+ * node remembers its area when it was built and those that grow past twice
+ * that are rebuilt by optimize with a binned surface area split. Boxes that
+ * jump far are removed and inserted again instead.
+ *
+ * Nodes live in one array with a free list, indices stay valid until the
+ * leaf is removed. Queries are const and may run on several threads, the
+ * batch versions spread a list of queries over the job system.
+ */
+class DynamicBvh {
+public:
+    static constexpr uint32_t NULL_NODE { ~0u };
+
+    struct Stats {
+        uint32_t leaves;
+        uint32_t height;
+        uint32_t refits;
+        uint32_t reinserts;
+        uint32_t rebuiltNodes;
+
+        // sum of the internal node areas over the root area, lower is better
+        float cost;
+    };
+
+    // fat boxes grow by margin times their size on every side
+    explicit DynamicBvh(float margin = 0.1f);
+
+    // returns the leaf, data comes back from the queries
+    uint32_t insert(const glm::vec3& min, const glm::vec3& max, uint32_t data);
+    void remove(uint32_t leaf);
+
+    // true when the leaf left its fat box and the tree changed, displacement predicts the next move
+    bool move(uint32_t leaf, const glm::vec3& min, const glm::vec3& max, const glm::vec3& displacement = glm::vec3 { 0.0f });
+
+    // rebuilds the subtrees that grew too much since they were built
+    void optimize();
+
+    void clear();
+
+    uint32_t getData(uint32_t leaf) const { return nodes[leaf].data; }
+    uint32_t getLeafCount() const { return leafCount; }
+
+    // data of every box overlapping the query, appended to hits
+    void query(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& hits) const;
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // data of the first box along the ray, NULL_NODE if none is hit before maxDistance
+    uint32_t raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+    struct BoxQuery {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    void queryBatch(JobSystem& jobs, const std::vector<BoxQuery>& queries, std::vector<std::vector<uint32_t>>& hits) const;
+
+    // overlapping pairs of data, each with at least one box moved since the last call, smaller data first
+    void collectPairs(JobSystem& jobs, std::vector<std::pair<uint32_t, uint32_t>>& pairs);
+
+    Stats getStats() const;
+
+private:
+    struct Node {
+        glm::vec3 min;
+        uint32_t parent;
+        glm::vec3 max;
+        uint32_t left;
+        uint32_t right;
+        uint32_t data;
+
+        // surface area when the node was created or last rebuilt
+        float buildArea;
+
+        uint16_t height;
+        bool degraded;
+        bool moved;
+
+        bool isLeaf() const { return left == NULL_NODE; }
+    };
+
+    float margin;
+
+    std::vector<Node> nodes;
+    uint32_t freeList { NULL_NODE };
+    uint32_t root { NULL_NODE };
+    uint32_t leafCount { 0 };
+
+    // exact bounds of the leaves, by node
+    std::vector<glm::vec3> tightMin;
+    std::vector<glm::vec3> tightMax;
+
+    std::vector<uint32_t> degradedNodes;
+    std::vector<uint32_t> movedLeaves;
+
+    uint32_t refits { 0 };
+    uint32_t reinserts { 0 };
+    uint32_t rebuiltNodes { 0 };
+
+    uint32_t allocateNode();
+    void freeNode(uint32_t node);
+
+    void insertLeaf(uint32_t leaf);
+    void removeLeaf(uint32_t leaf);
+    uint32_t findSibling(const glm::vec3& min, const glm::vec3& max) const;
+    void refit(uint32_t node, bool patch);
+
+    // leaves whose exact box overlaps the query, stack is scratch space of the caller
+    template <typename Visit>
+    void forEachOverlap(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& stack, Visit&& visit) const;
+
+    uint32_t build(std::vector<uint32_t>& leaves, size_t begin, size_t end);
+    void rebuild(uint32_t node);
+};
+
+}
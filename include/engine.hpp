@@ -1,5 +1,12 @@
 #pragma once
 
+#include "chunk_mesh_pool.hpp"
+#include "frustum_cull.hpp"
+#include "gpu_chunk_mesher.hpp"
+#include "instance_buffer.hpp"
+#include "material_atlas.hpp"
+#include "meshlet_renderer.hpp"
+#include "raymarch_renderer.hpp"
 #include "render_structs.hpp"
 #include "scene.hpp"
 #include "swapchain.hpp"
@@ -7,6 +14,7 @@
 #include "window.hpp"
 
 #include <stdint.h>
+#include <unordered_map>
 #include <vulkan/vulkan_handles.hpp>
 
 namespace VoKel {
@@ -16,7 +24,38 @@ public:
     Engine(int width, int height, Window& window);
     ~Engine();
 
-    void render(const Scene& scene);
+    // non const only for the scene's job system, the culling runs on it
+    void render(Scene& scene);
+
+    enum class RenderMode {
+        Raster,
+        Raymarch
+    };
+
+    // false when the device cannot raymarch, the mode is left unchanged then
+    bool setRenderMode(RenderMode mode);
+    RenderMode getRenderMode() const { return renderMode; }
+
+    // last frame's culling of the chunk meshes, drawn excludes the chunks hidden from the camera
+    const FrustumCuller::Stats& getChunkCullStats() const { return chunkCuller.getStats(); }
+    uint32_t getDrawnChunkCount() const { return drawnChunks; }
+    ChunkMeshPool::Stats getChunkMeshStats() const { return chunkMeshPool->getStats(); }
+
+    // meshes of nodes built with gpu meshing, verification compares each with the cpu mesher
+    const GpuChunkMesher::Stats& getGpuMeshStats() const { return chunkMesher->getStats(); }
+    void setGpuMeshVerification(bool verify) { chunkMesher->setVerify(verify); }
+
+    // places a mesh built into meshlets, false when the device cannot draw meshlets
+    bool addMeshletMesh(const std::vector<glm::vec3>& positions, const MeshletMesh& mesh, const glm::mat4& transform);
+    MeshletRenderer::Stats getMeshletStats() const { return meshletRenderer ? meshletRenderer->getStats() : MeshletRenderer::Stats {}; }
+
+    // voxel faces and meshlets through task and mesh shaders rather than the vertex path,
+    // false when the device has no mesh shaders, the path is left unchanged then
+    bool setMeshShading(bool enabled);
+    bool getMeshShading() const { return useMeshShading; }
+
+    // gpu time of the chunk and meshlet draws of the last frame read back, 0 when the device cannot time them
+    double getGeometryMilliseconds() const { return geometryMilliseconds; }
 
 private:
     int width, height;
@@ -36,23 +75,94 @@ private:
     vk::SwapchainKHR swapchain;
     std::vector<vkInit::SwapchainFrame> swapchainFrames;
     vk::Format swapchainFormat;
+    vk::Format depthFormat;
     vk::Extent2D swapchainExtent;
 
     // pipeline-related variables
     vk::PipelineLayout layout;
     vk::RenderPass renderpass;
     vk::Pipeline pipeline;
+    vk::PipelineLayout chunkLayout;
+    vk::Pipeline chunkPipeline;
+    vk::PipelineLayout chunkFaceLayout;
+    vk::Pipeline chunkFacePipeline;
+    vk::PipelineLayout meshletLayout { nullptr };
+    vk::Pipeline meshletPipeline { nullptr };
+
+    // task and mesh shader pipelines of the chunk faces and meshlets, null without mesh shaders
+    bool meshShading { false };
+    bool useMeshShading { false };
+    PFN_vkCmdDrawMeshTasksEXT drawMeshTasks { nullptr };
+    vk::PipelineLayout chunkFaceMeshLayout { nullptr };
+    vk::Pipeline chunkFaceMeshPipeline { nullptr };
+    vk::PipelineLayout meshletMeshLayout { nullptr };
+    vk::Pipeline meshletMeshPipeline { nullptr };
+
+    // two timestamps per frame around the chunk and meshlet draws, null when the queue cannot time graphics
+    vk::QueryPool geometryQueries { nullptr };
+    double timestampPeriod { 0.0 };
+    std::vector<bool> geometryTimed;
+    double geometryMilliseconds { 0.0 };
+
+    // buffers the vertex shaders pull from, a set per frame in flight as they are rewritten when the buffers grow
+    vk::DescriptorSetLayout overlayGeometryLayout;
+    vk::DescriptorSetLayout chunkGeometryLayout;
+    vk::DescriptorPool geometryDescriptorPool;
+    std::vector<vk::DescriptorSet> overlayGeometrySets;
+    std::vector<vk::DescriptorSet> chunkGeometrySets;
 
     // command-related variables
     vk::CommandPool commandPool;
     vk::CommandBuffer mainCommandBuffer;
 
-    // synchronization-related variables
-    int maxFrameInFlight, frameNumber;
+    // synchronization-related variables, frames in flight are fixed by the first swapchain
+    int maxFrameInFlight { 0 }, frameNumber { 0 };
 
     // asset pointers
     TriangleMesh* triangleMesh;
 
+    // gpu copies of the level of detail nodes, keyed like the scene nodes
+    struct GpuChunk {
+        uint64_t key;
+        ChunkCoord coord;
+        uint32_t lod;
+        uint32_t mesh;
+        uint64_t revision;
+        glm::vec4 origin;
+    };
+
+    // dense so the bounds line up with the meshes, removals swap the last chunk in
+    std::vector<GpuChunk> chunkMeshes;
+    BoundsList chunkBounds;
+    std::unordered_map<uint64_t, uint32_t> chunkSlots;
+    FrustumCuller chunkCuller;
+    std::vector<uint32_t> chunkDraws;
+    uint32_t drawnChunks { 0 };
+
+    // world matrices of the scene's entities, the overlay triangles are culled against the screen
+    InstanceBuffer* instanceBuffer { nullptr };
+    std::vector<uint32_t> overlayVisible;
+
+    // every chunk mesh in one vertex and one index buffer, GpuChunk::mesh is the handle into it,
+    // voxel meshes are faces drawn by the face pipeline, smooth meshes indexed vertices
+    ChunkMeshPool* chunkMeshPool { nullptr };
+
+    // meshes nodes that come with a volume, pending maps their keys to the revision being meshed
+    GpuChunkMesher* chunkMesher { nullptr };
+    std::unordered_map<uint64_t, uint64_t> pendingChunkMeshes;
+
+    // block textures of the chunk meshes, created with the pipelines that sample them
+    MaterialAtlas* materialAtlas { nullptr };
+    size_t chunkUploadBytesPerFrame { 8 << 20 };
+
+    // meshes culled per meshlet before their indirect draws, null when unsupported, created with its pipeline
+    MeshletRenderer* meshletRenderer { nullptr };
+
+    // compute raymarching over the scene's brick map, null when unsupported
+    RaymarchRenderer* raymarcher { nullptr };
+    RenderMode renderMode { RenderMode::Raster };
+    float raymarchDistance { 512.0f };
+
     void createInstance();
     void createDevice();
     void createSwapchain();
@@ -60,13 +170,18 @@ private:
     void createPipeline();
 
     void finalizeSetup();
+    void createDepthBuffers();
     void createFramebuffers();
     void createFrameSyncObj();
 
     void createAssets();
     void prepareScene(vk::CommandBuffer commandBuffer);
+    void writeGeometrySets(uint32_t frame);
+    void syncChunkMeshes(Scene& scene);
+    void setChunkMesh(uint64_t key, const LodNode& node, uint32_t mesh);
+    void removeChunkMesh(uint32_t slot);
 
-    void recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t imageIndex, const Scene& scene);
+    void recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t imageIndex, Scene& scene);
 
     void cleanupSwapchain();
 };
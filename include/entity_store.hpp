@@ -0,0 +1,156 @@
+#pragma once
+#include "config.hpp"
+#include "frustum_cull.hpp"
+#include "job_system.hpp"
+#include "transform_kernel.hpp"
+
+#include <array>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace VoKel {
+
+// slot in the low 32 bits, generation of the slot in the high ones
+using EntityId = uint64_t;
+
+constexpr EntityId NO_ENTITY { ~0ull };
+
+// every entity has a transform, these are optional
+enum Component : uint32_t {
+    // box around the mesh in model space, without it the entity is culled as a point
+    COMPONENT_BOUNDS = 1u << 0,
+
+    // drawn, the entity gets a slot in the instance arrays
+    COMPONENT_MESH = 1u << 1,
+};
+
+/*
+ * Entities grouped by the components they have.
+ *
+ * Each archetype stores its entities' components as parallel arrays, one
+ * per float of a component, so the transform pass reads positions,
+ * rotations and scales with plain vector loads. Setting a component marks
+ * the entity's row dirty, rows are tracked in blocks of 64 and update only
+ * visits the blocks that hold a dirty row. Their world matrices are
+ * composed in parallel with the widest instruction set the cpu has, a
+ * world of static entities costs nothing per frame.
+ *
+ * Entities with a mesh also own a slot in dense instance arrays, the world
+ * matrices, world bounds and mesh ids the renderer reads. Update lists the
+ * slots it rewrote and bumps the revision when there were any, so the gpu
+ * copy only receives what changed. Removing an entity moves the last
+ * instance into its slot, which then counts as changed.
+ */
+class EntityStore {
+public:
+    // rows per dirty word, blocks are composed as a whole
+    static constexpr uint32_t BLOCK_SIZE { 64 };
+
+    explicit EntityStore(SimdLevel level = getSimdLevel());
+
+    EntityStore(const EntityStore&) = delete;
+    EntityStore& operator=(const EntityStore&) = delete;
+
+    EntityId create(uint32_t components, const glm::vec3& position, const glm::quat& rotation = glm::quat { 1.0f, 0.0f, 0.0f, 0.0f },
+        const glm::vec3& scale = glm::vec3 { 1.0f });
+    void destroy(EntityId entity);
+    bool isAlive(EntityId entity) const;
+
+    // moves the entity to the archetype of the new set, components it keeps keep their values
+    void setComponents(EntityId entity, uint32_t components);
+    uint32_t getComponents(EntityId entity) const;
+
+    void setPosition(EntityId entity, const glm::vec3& position);
+    void setRotation(EntityId entity, const glm::quat& rotation);
+    void setScale(EntityId entity, const glm::vec3& scale);
+
+    // ignored without the component
+    void setBounds(EntityId entity, const glm::vec3& min, const glm::vec3& max);
+    void setMesh(EntityId entity, uint32_t mesh);
+
+    glm::vec3 getPosition(EntityId entity) const;
+    glm::quat getRotation(EntityId entity) const;
+    glm::vec3 getScale(EntityId entity) const;
+
+    // as of the last update
+    const glm::mat4& getWorldMatrix(EntityId entity) const;
+
+    // composes the world matrices of the dirty rows in parallel
+    void update(JobSystem& jobs);
+
+    uint32_t getEntityCount() const { return entityCount; }
+
+    // dense arrays of the entities with a mesh, as of the last update
+    uint32_t getInstanceCount() const { return static_cast<uint32_t>(instanceMeshes.size()); }
+    const std::vector<glm::mat4>& getInstanceMatrices() const { return instanceMatrices; }
+    const BoundsList& getInstanceBounds() const { return instanceBounds; }
+    const std::vector<uint32_t>& getInstanceMeshes() const { return instanceMeshes; }
+
+    // instances written by the last update that changed anything, which bumped the revision
+    const std::vector<uint32_t>& getChangedInstances() const { return changedInstances; }
+    uint64_t getRevision() const { return revision; }
+
+    // rows composed by the last update
+    uint32_t getUpdatedCount() const { return updatedRows; }
+
+    void setSimdLevel(SimdLevel level) { this->level = level; }
+
+private:
+    struct Archetype {
+        uint32_t components;
+        std::vector<EntityId> entities;
+
+        std::array<std::vector<float>, 3> position;
+        std::array<std::vector<float>, 4> rotation;
+        std::array<std::vector<float>, 3> scale;
+
+        // only filled with the matching component
+        std::array<std::vector<float>, 3> boundsMin;
+        std::array<std::vector<float>, 3> boundsMax;
+        std::vector<uint32_t> mesh;
+        std::vector<uint32_t> instance;
+
+        std::vector<glm::mat4> world;
+
+        // bit per row, and the blocks with any bit set, each listed once
+        std::vector<uint64_t> dirty;
+        std::vector<uint32_t> dirtyBlocks;
+
+        uint32_t size() const { return static_cast<uint32_t>(entities.size()); }
+    };
+
+    struct Record {
+        uint32_t archetype;
+        uint32_t row;
+        uint32_t generation;
+        bool alive;
+    };
+
+    SimdLevel level;
+
+    std::vector<Archetype> archetypes;
+    std::vector<Record> records;
+    std::vector<uint32_t> freeSlots;
+    uint32_t entityCount { 0 };
+
+    std::vector<glm::mat4> instanceMatrices;
+    BoundsList instanceBounds;
+    std::vector<uint32_t> instanceMeshes;
+    std::vector<EntityId> instanceEntities;
+
+    std::vector<uint32_t> changedInstances;
+    uint64_t revision { 0 };
+    uint32_t updatedRows { 0 };
+
+    const Record& getRecord(EntityId entity) const;
+    uint32_t findArchetype(uint32_t components);
+
+    uint32_t addRow(uint32_t archetype, EntityId entity);
+    void removeRow(uint32_t archetype, uint32_t row);
+    void markDirty(Archetype& archetype, uint32_t row);
+
+    uint32_t addInstance(EntityId entity, uint32_t mesh);
+    void removeInstance(uint32_t instance);
+};
+
+}
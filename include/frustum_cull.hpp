@@ -0,0 +1,74 @@
+#pragma once
+#include "config.hpp"
+#include "frustum_cull_kernel.hpp"
+#include "job_system.hpp"
+
+#include <array>
+#include <vector>
+
+namespace VoKel {
+
+// the six clip planes of a view projection, normals pointing inwards
+struct Frustum {
+    std::array<glm::vec4, 6> planes;
+
+    // vulkan clip space, depth from 0 to 1
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+};
+
+/*
+ * Axis aligned boxes in structure of arrays layout, the input of the cull.
+ * Removing a box moves the last one into its slot, owners that keep
+ * something per box do the same with theirs.
+ */
+class BoundsList {
+public:
+    uint32_t add(const glm::vec3& min, const glm::vec3& max);
+    void set(uint32_t index, const glm::vec3& min, const glm::vec3& max);
+    void removeSwap(uint32_t index);
+    void clear();
+
+    uint32_t size() const { return static_cast<uint32_t>(min[0].size()); }
+
+    const float* getMin(int axis) const { return min[axis].data(); }
+    const float* getMax(int axis) const { return max[axis].data(); }
+
+private:
+    std::array<std::vector<float>, 3> min;
+    std::array<std::vector<float>, 3> max;
+};
+
+/*
+ * Culls a BoundsList against a frustum with the widest instruction set the
+ * cpu has. Large lists are split into blocks that are tested in parallel,
+ * each block writes the indices of its visible boxes to its own range of
+ * the output and the ranges are then packed together, so the visible list
+ * comes out compact and in box order.
+ */
+class FrustumCuller {
+public:
+    struct Stats {
+        uint32_t boxes;
+        uint32_t visible;
+        double seconds;
+    };
+
+    explicit FrustumCuller(SimdLevel level = getSimdLevel());
+
+    // indices of the boxes touching the frustum, valid until the next cull
+    const std::vector<uint32_t>& cull(JobSystem& jobs, const Frustum& frustum, const BoundsList& bounds);
+
+    const std::vector<uint32_t>& getVisible() const { return visible; }
+    const Stats& getStats() const { return stats; }
+
+    void setSimdLevel(SimdLevel level) { this->level = level; }
+
+private:
+    SimdLevel level;
+
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> blockCounts;
+    Stats stats {};
+};
+
+}
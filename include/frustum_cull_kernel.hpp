@@ -0,0 +1,124 @@
+#pragma once
+
+#include "noise.hpp"
+
+#include <bit>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Frustum culling kernels, shared by the scalar and the SIMD code paths.
+ * Like noise.hpp this header stays free of config.hpp, it is compiled with
+ * -msse4.1 / -mavx2 as well.
+ */
+
+namespace VoKel {
+
+/*
+ * Axis aligned boxes as separate arrays, one per bound and axis, so a group
+ * of boxes loads with plain vector loads. Indices of the visible boxes are
+ * written to visible in increasing order, it needs room for count entries.
+ */
+struct CullBatch {
+    const float* min[3];
+    const float* max[3];
+    size_t first;
+    size_t count;
+
+    // a x + b y + c z + d >= 0 inside, normals pointing into the frustum
+    const float (*planes)[4];
+    int planeCount;
+
+    uint32_t* visible;
+};
+
+// returns the number of visible boxes written, safe to call from several threads
+size_t cullBoxes(const CullBatch& batch, SimdLevel level);
+
+namespace cull {
+
+    /*
+     * Kernels written against a small vector interface V:
+     *
+     *   V::F / V::M        float lanes and lane masks, V::WIDTH lanes each
+     *   load, set          float lanes, with add and mul
+     *   greaterEqual, all  masks from a float compare or with every lane set, combined with andm
+     *   bits               one bit per lane of a mask, lane 0 in bit 0
+     *
+     * Each plane only needs the box corner furthest along its normal. The
+     * sign of the normal is the same for every box, so the corner is picked
+     * once per plane by choosing the min or max array, and the test of a
+     * group of boxes is three multiply adds and a compare per plane.
+     */
+
+    // one box, also the tail of the vector paths
+    inline bool boxVisible(const CullBatch& batch, size_t box)
+    {
+        for (int p { 0 }; p < batch.planeCount; p++) {
+            const float* plane = batch.planes[p];
+            float distance = plane[3];
+            for (int a { 0 }; a < 3; a++) {
+                distance += plane[a] * (plane[a] >= 0.0f ? batch.max[a][box] : batch.min[a][box]);
+            }
+            if (!(distance >= 0.0f)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename V>
+    inline size_t runCullBoxes(const CullBatch& batch)
+    {
+        constexpr size_t W { V::WIDTH };
+
+        using F = typename V::F;
+        using M = typename V::M;
+
+        const float* corner[6][3];
+        F planes[6][4];
+        for (int p { 0 }; p < batch.planeCount; p++) {
+            for (int a { 0 }; a < 3; a++) {
+                corner[p][a] = batch.planes[p][a] >= 0.0f ? batch.max[a] : batch.min[a];
+            }
+            for (int c { 0 }; c < 4; c++) {
+                planes[p][c] = V::set(batch.planes[p][c]);
+            }
+        }
+
+        size_t written { 0 };
+        size_t box { batch.first };
+        size_t end { batch.first + batch.count };
+
+        for (; box + W <= end; box += W) {
+            M inside = V::all();
+
+            for (int p { 0 }; p < batch.planeCount; p++) {
+                F distance = planes[p][3];
+                for (int a { 0 }; a < 3; a++) {
+                    distance = V::add(distance, V::mul(planes[p][a], V::load(corner[p][a] + box)));
+                }
+                inside = V::andm(inside, V::greaterEqual(distance, V::set(0.0f)));
+            }
+
+            // compaction, one store per visible box
+            for (uint32_t bits = V::bits(inside); bits != 0; bits &= bits - 1) {
+                batch.visible[written++] = static_cast<uint32_t>(box + std::countr_zero(bits));
+            }
+        }
+
+        for (; box < end; box++) {
+            if (boxVisible(batch, box)) {
+                batch.visible[written++] = static_cast<uint32_t>(box);
+            }
+        }
+
+        return written;
+    }
+
+    size_t cullBoxesSse4(const CullBatch& batch);
+    size_t cullBoxesAvx2(const CullBatch& batch);
+
+}
+
+}
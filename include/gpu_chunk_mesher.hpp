@@ -0,0 +1,133 @@
+#pragma once
+#include "chunk_mesh_pool.hpp"
+#include "chunk_mesher.hpp"
+#include "config.hpp"
+#include "memory.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace VoKel {
+
+struct GpuChunkMesherSettings {
+    // chunks counted per frame, each takes about 118 kilobytes of the frame's volume buffer
+    uint32_t chunksPerBatch { 32 };
+
+    // reads every mesh back and compares it with the cpu mesher, which is timed on the same volumes
+    bool verify { false };
+};
+
+/*
+ * Greedy meshes chunk volumes in a compute shader straight into the chunk
+ * mesh pool, producing the same faces as meshChunkVolume.
+ *
+ * A batch takes two submissions of the same frame in flight. The first
+ * uploads the padded volumes and counts the quads of every face slice, one
+ * workgroup each, then a scan pass turns the counts into each slice's first
+ * quad and writes the draw arguments of each chunk. Once the frame's fence
+ * was waited on, collect reads the face count from those arguments and
+ * reserves exactly that much in the pool. The next record writes the faces
+ * in place at their ranges, the cpu never sees one.
+ *
+ * The pool ranges are suballocated on the cpu, so chunks keep their direct
+ * draws and only the counts travel back, one frame in flight later.
+ */
+class GpuChunkMesher {
+public:
+    struct Result {
+        uint64_t key;
+        uint64_t revision;
+
+        // pool handle, NO_MESH for chunks without faces
+        uint32_t mesh;
+    };
+
+    struct Stats {
+        uint64_t meshedChunks;
+        uint64_t verifiedChunks;
+        uint64_t mismatchedChunks;
+
+        // gpu time of all passes per counted chunk and of meshChunkVolume per verified chunk, 0 until measured
+        double gpuMillisecondsPerChunk;
+        double cpuMillisecondsPerChunk;
+    };
+
+    GpuChunkMesher(vk::Device device, vk::PhysicalDevice physicalDevice, int framesInFlight, const GpuChunkMesherSettings& settings = {});
+    ~GpuChunkMesher();
+
+    GpuChunkMesher(const GpuChunkMesher&) = delete;
+    GpuChunkMesher& operator=(const GpuChunkMesher&) = delete;
+
+    // queued for the next record, false when the next batch is full
+    bool submit(uint64_t key, uint64_t revision, std::shared_ptr<const ChunkMeshVolume> volume);
+
+    // meshes counted by this frame's last submission, reserved in the pool and written by the next record,
+    // call after the frame's fence was waited on. Meshes that keep rejects went stale while they were counted,
+    // they get no range and record skips them
+    std::vector<Result> collect(uint32_t frame, ChunkMeshPool& pool, const std::function<bool(uint64_t key, uint64_t revision)>& keep);
+
+    // records the writes of the collected meshes and the counting of the next batch, after the pool's record
+    // so the ranges are final, outside a render pass
+    void record(vk::CommandBuffer commandBuffer, uint32_t frame, const ChunkMeshPool& pool);
+
+    void setVerify(bool verify) { settings.verify = verify; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Job {
+        uint64_t key;
+        uint64_t revision;
+        std::shared_ptr<const ChunkMeshVolume> volume;
+
+        uint32_t mesh;
+        uint32_t faceCount;
+
+        // byte offset of the mesh in the frame's readback buffer when verifying
+        size_t readbackOffset;
+    };
+
+    struct Frame {
+        // two banks of chunksPerBatch slots, the batch being written reads one while the next is counted in the other
+        vkUtil::Buffer volumes;
+        vkUtil::Buffer meshes;
+        uint32_t bank;
+
+        vk::DescriptorSet descriptorSet;
+
+        std::vector<Job> counted;
+        std::vector<Job> emitted;
+
+        vkUtil::Buffer readback;
+        size_t readbackSize;
+
+        bool timed;
+        uint32_t timedChunks;
+    };
+
+    vk::Device device;
+    vk::PhysicalDevice physicalDevice;
+    GpuChunkMesherSettings settings;
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::DescriptorPool descriptorPool;
+    vk::PipelineLayout layout;
+    vk::Pipeline pipeline;
+
+    // four timestamps per frame around the write and the count passes, null when the queue cannot time compute
+    vk::QueryPool queryPool { nullptr };
+    double timestampPeriod { 0.0 };
+
+    std::vector<Frame> frames;
+    std::vector<Job> queued;
+
+    Stats stats {};
+    double gpuMilliseconds { 0.0 };
+    uint64_t timedChunks { 0 };
+    double cpuMilliseconds { 0.0 };
+
+    void dispatch(vk::CommandBuffer commandBuffer, const Frame& frame, uint32_t pass, uint32_t bank, uint32_t groups, uint32_t chunks);
+    void verify(Frame& frame);
+};
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "config.hpp"
+
+namespace vkImage {
+
+struct ImageInput {
+    vk::Device device;
+    vk::PhysicalDevice physicalDevice;
+    uint32_t width, height;
+    vk::ImageTiling tiling;
+    vk::ImageUsageFlags usage;
+    vk::MemoryPropertyFlags memoryProperties;
+    vk::Format format;
+
+    // texture arrays and mip chains, plain 2D images leave these at 1
+    uint32_t mipLevels { 1 };
+    uint32_t arrayLayers { 1 };
+};
+
+vk::Image createImage(const ImageInput& input);
+
+vk::DeviceMemory createImageMemory(const ImageInput& input, const vk::Image& image);
+
+vk::ImageView createImageView(const vk::Device& device, const vk::Image& image, vk::Format format, vk::ImageAspectFlags aspect,
+    vk::ImageViewType viewType = vk::ImageViewType::e2D, uint32_t mipLevels = 1, uint32_t arrayLayers = 1);
+
+vk::Format findSupportedFormat(const vk::PhysicalDevice& physicalDevice, const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
+
+}
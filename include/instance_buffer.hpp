@@ -0,0 +1,55 @@
+#pragma once
+#include "config.hpp"
+#include "entity_store.hpp"
+#include "memory.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * World matrices of the entity store's instances in a storage buffer, the
+ * overlay's vertex shader reads one per instance index.
+ *
+ * Like the raymarcher's buffers, every frame only the instances the last
+ * store update rewrote are copied in through that frame's staging buffer,
+ * and a missed update or a grown buffer uploads everything once. Static
+ * entities are never copied again.
+ */
+class InstanceBuffer {
+public:
+    InstanceBuffer(vk::Device device, vk::PhysicalDevice physicalDevice);
+    ~InstanceBuffer();
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    // records the copies and the barrier before the vertex shader reads them, outside a render pass,
+    // frame is the frame in flight whose fence was waited on
+    void record(vk::CommandBuffer commandBuffer, uint32_t frame, const EntityStore& entities);
+
+    vk::Buffer getBuffer() const { return buffer.buffer; }
+
+    // bytes copied to the gpu by the last record
+    size_t getUploadedBytes() const { return uploadedBytes; }
+
+private:
+    vk::Device device;
+    vk::PhysicalDevice physicalDevice;
+
+    struct Frame {
+        vkUtil::Buffer staging;
+        size_t stagingSize;
+    };
+
+    std::vector<Frame> frames;
+
+    vkUtil::Buffer buffer {};
+    size_t bufferSize { 0 };
+
+    bool synced { false };
+    uint64_t uploadedRevision { 0 };
+    size_t uploadedBytes { 0 };
+};
+
+}
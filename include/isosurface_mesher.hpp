@@ -0,0 +1,64 @@
+#pragma once
+#include "chunk.hpp"
+#include "chunk_mesher.hpp"
+#include "config.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+enum class IsosurfaceMode : uint8_t {
+    // vertices on the grid edges, shared between neighboring cells, rounds off sharp edges
+    MarchingCubes,
+
+    // one vertex per cell placed by the edge normals, keeps sharp edges and corners
+    DualContouring
+};
+
+/*
+ * Density of a chunk sampled on its voxel corners, solid where positive.
+ * Corners run from MIN to CHUNK_SIZE - MIN - 1 on every axis, the border
+ * beyond the chunk's own 33 corners feeds the gradients and the dual
+ * contouring cells shared with the neighbors. Samples are laid out x
+ * fastest, then z, then y, like the chunks.
+ */
+struct DensityField {
+    static constexpr int MIN { -2 };
+    static constexpr int SIZE { CHUNK_SIZE + 4 };
+    static constexpr int VOLUME { SIZE * SIZE * SIZE };
+
+    std::vector<float> density = std::vector<float>(VOLUME);
+    std::vector<Voxel> material = std::vector<Voxel>(VOLUME);
+
+    static constexpr int index(int x, int y, int z) { return (x - MIN) + (z - MIN) * SIZE + (y - MIN) * SIZE * SIZE; }
+
+    float at(int x, int y, int z) const { return density[index(x, y, z)]; }
+};
+
+struct IsosurfaceInput {
+    const DensityField* field;
+    IsosurfaceMode mode;
+
+    /*
+     * Faces bordering a node of another level of detail. The solid cross
+     * section of the field on these faces is capped, facing out, so the
+     * crack between the two resolutions always shows a surface, the same
+     * way the blocky mesher's skirts do.
+     */
+    uint8_t skirtMask;
+};
+
+/*
+ * Smooth mesh of the field in chunk-local voxel units, in the compact chunk
+ * vertex format with smooth normals from the density gradient. Vertices on
+ * a face shared by two chunks of the same level come out bit identical on
+ * both sides, so those seams are watertight.
+ *
+ * Each slice of corners is classified at once, a row of signs per 64 bit
+ * word, and only the cells whose row bits differ are visited, so empty and
+ * solid space costs a few word operations per row. Thread safe, meshing
+ * several chunks is a parallelFor over this.
+ */
+ChunkMeshData meshIsosurface(const IsosurfaceInput& input);
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "config.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Small fixed size thread pool.
+ *
+ * Jobs are plain callables pulled from a single shared queue. parallelFor
+ * splits an index range between the workers and the calling thread and
+ * blocks until every index has been processed, so it can be called from a
+ * job as well. Its helpers jump ahead of submitted background jobs so a
+ * frame never waits behind streaming work.
+ */
+class JobSystem {
+public:
+    // 0 picks one worker per hardware thread minus the calling thread
+    explicit JobSystem(uint32_t threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // background work, runs after everything queued before it
+    void submit(std::function<void()> job);
+
+    void parallelFor(uint32_t count, const std::function<void(uint32_t)>& function);
+
+    // blocks until the queue is drained and no job is running
+    void wait();
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+
+    uint32_t running { 0 };
+    bool stopping { false };
+
+    void enqueue(std::function<void()> job, bool urgent);
+    void workerLoop();
+};
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace VoKel {
+
+constexpr uint8_t MAX_LIGHT_LEVEL { 15 };
+
+// packed light of a voxel, sky light in the high nibble and block light in the low one
+constexpr uint8_t packLight(uint8_t sky, uint8_t block) { return uint8_t(sky << 4) | block; }
+constexpr uint8_t skyLight(uint8_t light) { return light >> 4; }
+constexpr uint8_t blockLight(uint8_t light) { return light & 0xf; }
+
+/*
+ * Light of every voxel of a chunk. Like the palette of a chunk, a chunk
+ * where every voxel has the same light (open sky or solid rock) stores only
+ * that value, the array is allocated on the first differing write.
+ */
+class ChunkLight {
+public:
+    uint8_t get(int i) const { return levels.empty() ? uniform : levels[i]; }
+
+    // returns false when the voxel already had that light
+    bool set(int i, uint8_t light);
+
+    void fill(uint8_t light);
+
+    // CHUNK_VOLUME values, stays uniform when they are all the same
+    void assign(const uint8_t* light);
+
+    // falls back to a single value once the light became uniform again
+    void compact();
+
+    // CHUNK_VOLUME values, nullptr when uniform
+    const uint8_t* data() const { return levels.empty() ? nullptr : levels.data(); }
+    uint8_t getUniform() const { return uniform; }
+
+    bool changed { false };
+
+private:
+    std::vector<uint8_t> levels;
+    uint8_t uniform { 0 };
+};
+
+/*
+ * Flood fill sky and block light over the resident chunks.
+ *
+ * Light spreads breadth first through air, losing a level per voxel, except
+ * full sky light which travels straight down without loss. Opaque blocks
+ * stop light, emitting blocks keep their own level. Turning a source off runs
+ * a removal pass first: it clears every voxel that was lit by the old source
+ * and collects the brighter voxels at its border, which then refill the
+ * cleared area in the addition pass. Chunks above the resident area count as
+ * open sky until they are streamed in, then the columns below are corrected.
+ *
+ * Both passes are split by chunk: the queued voxels of a chunk are processed
+ * by one job which may touch that chunk and its 26 neighbors. Chunks are
+ * scheduled in 27 phases by their coordinates modulo 3, so jobs running at
+ * the same time never share a chunk and need no locking. Light that leaves a
+ * job's neighborhood is handed to the next round. Streamed in chunks are
+ * seeded the same way, top layer first, with their sky columns filled
+ * directly so only the voxels at the edge of the light need the queue.
+ */
+class LightPropagator {
+public:
+    struct Stats {
+        // voxels whose light changed, summed over every update
+        uint64_t updates;
+        uint64_t nanoseconds;
+        uint64_t rounds;
+
+        double updatesPerSecond() const { return nanoseconds == 0 ? 0.0 : double(updates) * 1e9 / double(nanoseconds); }
+    };
+
+    LightPropagator(World& world, JobSystem& jobs);
+
+    LightPropagator(const LightPropagator&) = delete;
+    LightPropagator& operator=(const LightPropagator&) = delete;
+
+    // light emitted by a material, 0 for everything not set
+    void setEmission(Voxel material, uint8_t level);
+    uint8_t getEmission(Voxel material) const { return material < emission.size() ? emission[material] : 0; }
+
+    // world notifications, the work is deferred to the next update
+    void chunkInserted(const ChunkCoord& coord);
+    void chunkRemoved(const ChunkCoord& coord);
+    void voxelChanged(const glm::ivec3& voxel, Voxel previous, Voxel value);
+
+    // seeds the queued changes and propagates them until the light is stable
+    void update();
+
+    uint8_t getLight(const glm::ivec3& voxel) const;
+
+    // CHUNK_VOLUME packed values for the mesher, nullptr when the chunk is not resident
+    const uint8_t* getLevels(const ChunkCoord& coord);
+
+    // chunks whose light changed since the last call, their meshes are stale
+    std::vector<ChunkCoord> takeChangedChunks();
+
+    Stats getStats() const { return { updateCount, updateTime, roundCount }; }
+
+    // a queued voxel, removal nodes carry the level the voxel had before it was cleared
+    struct Node {
+        glm::ivec3 voxel;
+        uint8_t level;
+        uint8_t channel;
+    };
+
+private:
+    World& world;
+    JobSystem& jobs;
+
+    std::vector<uint8_t> emission;
+
+    ChunkMap<std::unique_ptr<ChunkLight>> lights;
+    std::unordered_set<uint64_t> insertedChunks;
+    std::vector<std::pair<glm::ivec3, Voxel>> edits;
+    std::vector<ChunkCoord> changedChunks;
+
+    std::unordered_map<uint8_t, std::vector<uint8_t>> uniformLevels;
+
+    uint64_t updateCount { 0 };
+    uint64_t updateTime { 0 };
+    uint64_t roundCount { 0 };
+
+    ChunkLight* findLight(const ChunkCoord& coord);
+
+    void seedChunk(const ChunkCoord& coord, std::vector<Node>& removals, std::vector<Node>& additions);
+    void seedEdit(const glm::ivec3& voxel, Voxel previous, std::vector<Node>& removals, std::vector<Node>& additions);
+
+    // runs rounds until nothing is left, removal passes return their refill nodes in relight
+    void propagate(std::vector<Node> nodes, bool removal, std::vector<Node>& relight);
+};
+
+}
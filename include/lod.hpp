@@ -0,0 +1,149 @@
+#pragma once
+#include "chunk.hpp"
+#include "chunk_mesher.hpp"
+#include "config.hpp"
+#include "isosurface_mesher.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace VoKel {
+
+struct LodSettings {
+    // number of detail levels, level n covers CHUNK_SIZE << n voxels per node
+    uint32_t levels { 5 };
+
+    // radius in coarsest nodes kept around the camera horizontally and vertically
+    int horizontalRadius { 3 };
+    int verticalRadius { 1 };
+
+    // a node splits while the camera is closer than splitDistance node sizes to its bounds
+    float splitDistance { 1.5f };
+
+    // node meshes rebuilt per update, keeps camera movement incremental, built in parallel
+    uint32_t rebuildsPerUpdate { 8 };
+
+    // level 0 nodes wait until their chunk and its neighbors are streamed in instead of generating them
+    bool waitForResidentChunks { true };
+
+    // nodes are meshed as smooth isosurfaces of the density source instead of voxel faces
+    bool smoothSurface { false };
+    IsosurfaceMode isosurfaceMode { IsosurfaceMode::MarchingCubes };
+
+    // voxel nodes only fill their mesher volume and leave the meshing to the renderer's gpu mesher
+    bool gpuMeshing { false };
+};
+
+struct LodNode {
+    ChunkCoord coord;
+    uint32_t lod;
+    uint8_t skirtMask;
+
+    // bumped every time the mesh is rebuilt so the renderer can tell stale uploads
+    uint64_t revision;
+
+    ChunkMeshData mesh;
+
+    // set instead of the mesh while gpu meshing, until the renderer takes it with releaseVolume
+    std::shared_ptr<const ChunkMeshVolume> volume;
+
+    glm::vec3 origin() const { return glm::vec3(coord * (CHUNK_SIZE << lod)); }
+    float voxelSize() const { return float(1u << lod); }
+};
+
+uint64_t packLodKey(const ChunkCoord& coord, uint32_t lod);
+
+/*
+ * Geometric clipmap over the chunk grid.
+ *
+ * The coarsest level is tiled around the camera and each node is split into
+ * its eight children while the camera is close to it, so detail halves with
+ * every ring moving away from the viewer. Selection is redone only when the
+ * camera crosses a chunk border, and the resulting node meshes are rebuilt a
+ * few at a time. Stale nodes stay visible until all their replacements are
+ * built so the terrain never has holes while the rings move, only nodes that
+ * left the clipmap entirely are dropped right away. Full resolution
+ * nodes are only built once the chunk streamer has made their chunks
+ * resident, its load radius has to cover the finest ring plus one chunk.
+ */
+class ChunkLodManager {
+public:
+    // packed light of a resident chunk for the mesher, nullptr when there is none
+    using LightLookup = std::function<const uint8_t*(const ChunkCoord& coord)>;
+
+    // density of a node for smooth surfaces, thread safe, nodes are sampled in parallel
+    using DensitySource = std::function<void(DensityField& field, const ChunkCoord& coord, uint32_t lod)>;
+
+    ChunkLodManager(World& world, JobSystem& jobs, LodSettings settings = {});
+
+    // full resolution nodes are meshed with this light, coarser ones under open sky
+    void setLightLookup(LightLookup lookup) { lightLookup = std::move(lookup); }
+
+    // used instead of the voxels while settings.smoothSurface is set, smooth nodes ignore voxel edits
+    void setDensitySource(DensitySource source) { densitySource = std::move(source); }
+
+    void update(const glm::vec3& cameraPosition);
+
+    const std::unordered_map<uint64_t, LodNode>& getActiveNodes() const { return activeNodes; }
+    size_t getPendingCount() const { return buildQueue.size() + waitingNodes.size(); }
+    const LodSettings& getSettings() const { return settings; }
+
+    // applies to nodes built from now on
+    void setGpuMeshing(bool enabled) { settings.gpuMeshing = enabled; }
+
+    // drops the node's volume once the gpu mesher has its own reference
+    void releaseVolume(uint64_t key);
+
+    // forces a fresh selection on the next update
+    void invalidate() { selectionValid = false; }
+
+    // rebuilds the built nodes of the finest levels covering these chunks or touching them, whenever they are next desired
+    void invalidateChunks(const std::vector<ChunkCoord>& chunks, uint32_t levels = MAX_LOD_LEVELS);
+
+private:
+    struct DesiredNode {
+        ChunkCoord coord;
+        uint32_t lod;
+        uint8_t skirtMask;
+    };
+
+    World& world;
+    JobSystem& jobs;
+    LodSettings settings;
+    LightLookup lightLookup;
+    DensitySource densitySource;
+
+    std::unordered_map<uint64_t, DesiredNode> desiredNodes;
+    std::unordered_map<uint64_t, LodNode> activeNodes;
+    std::vector<uint64_t> buildQueue;
+    std::unordered_set<uint64_t> waitingNodes;
+
+    // built nodes whose chunks changed since, they outlive reselection and leave only once rebuilt
+    std::unordered_set<uint64_t> dirtyNodes;
+
+    ChunkCoord cameraChunk;
+    ChunkCoord topCenter;
+    bool selectionValid { false };
+    uint64_t nextRevision { 1 };
+
+    uint32_t topLevel() const { return settings.levels - 1; }
+    bool isSmooth() const { return settings.smoothSurface && densitySource; }
+    void selectNodes(const glm::vec3& cameraPosition);
+    void refine(const ChunkCoord& coord, uint32_t lod, const glm::vec3& cameraPosition);
+    void computeSkirts();
+    void queueBuilds(const glm::vec3& cameraPosition);
+    bool isResident(const DesiredNode& node) const;
+    void buildNodes(const std::vector<DesiredNode>& nodes);
+    std::vector<ChunkMeshInput> gatherVoxelInputs(const std::vector<DesiredNode>& nodes);
+    std::vector<ChunkMeshData> meshVoxelNodes(const std::vector<DesiredNode>& nodes);
+    std::vector<std::shared_ptr<const ChunkMeshVolume>> fillVoxelVolumes(const std::vector<DesiredNode>& nodes);
+    std::vector<ChunkMeshData> meshSmoothNodes(const std::vector<DesiredNode>& nodes);
+    void retireStaleNodes();
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "config.hpp"
+#include "memory.hpp"
+#include "terrain_generator.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+// texels per side of a material texture and the layers of the array, one per material index
+constexpr uint32_t MATERIAL_TEXTURE_SIZE { 32 };
+constexpr uint32_t MATERIAL_LAYER_COUNT { MATERIAL_LAMP + 1 };
+
+/*
+ * Rgba8 texels of a material's block texture, rows of size texels. The
+ * patterns are procedural noise around the material's color and wrap around
+ * on both axes, so neighboring blocks show no seam. Material 0 and unknown
+ * materials get a magenta checker.
+ */
+std::vector<uint32_t> generateMaterialTexture(Voxel material, uint32_t size);
+
+/*
+ * The block textures of every material as layers of one 2D texture array,
+ * sampled by the chunk shader with the material index as the layer. Unlike
+ * tiles of an atlas, layers never bleed into each other when filtered and
+ * every mip of a layer stays a plain square.
+ *
+ * The textures are uploaded through a staging buffer by the first record,
+ * which then blits each mip level down from the one above for all layers at
+ * once. Devices that cannot blit the format with linear filtering get the
+ * mips averaged on the cpu and uploaded with the base level instead.
+ */
+class MaterialAtlas {
+public:
+    MaterialAtlas(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t textureSize = MATERIAL_TEXTURE_SIZE);
+    ~MaterialAtlas();
+
+    MaterialAtlas(const MaterialAtlas&) = delete;
+    MaterialAtlas& operator=(const MaterialAtlas&) = delete;
+
+    // records the upload and the mip generation once, leaving the texture ready for the fragment stage,
+    // outside a render pass, later calls record nothing
+    void record(vk::CommandBuffer commandBuffer);
+
+    // one combined image sampler at binding 0 for the fragment stage
+    vk::DescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+    vk::DescriptorSet getDescriptorSet() const { return descriptorSet; }
+
+    uint32_t getMipLevels() const { return mipLevels; }
+    bool hasGpuMips() const { return gpuMips; }
+
+private:
+    static constexpr vk::Format FORMAT { vk::Format::eR8G8B8A8Unorm };
+
+    vk::Device device;
+
+    uint32_t textureSize;
+    uint32_t mipLevels;
+    bool gpuMips;
+    bool uploaded { false };
+
+    vk::Image image;
+    vk::DeviceMemory imageMemory;
+    vk::ImageView imageView;
+    vk::Sampler sampler;
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+
+    // every level the cpu filled, layer after layer, kept until destruction as it is only a few kilobytes
+    vkUtil::Buffer staging;
+    std::vector<vk::BufferImageCopy> copies;
+};
+
+}
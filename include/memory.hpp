@@ -10,6 +10,9 @@ struct BufferInput {
     vk::BufferUsageFlags usage;
     vk::Device device;
     vk::PhysicalDevice physicalDevice;
+
+    // mappable by default, device local buffers are only filled by copies
+    vk::MemoryPropertyFlags memoryProperties { vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent };
 };
 
 struct Buffer {
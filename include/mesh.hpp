@@ -2,11 +2,71 @@
 
 #include "config.hpp"
 #include <array>
+#include <stdint.h>
 
 namespace vkMesh {
 
-vk::VertexInputBindingDescription getPosColorBindingDescription();
+// chunk-local positions are stored in fixed point, CHUNK_VERTEX_SCALE units per voxel
+constexpr float CHUNK_VERTEX_SCALE { 256.0f };
 
-std::array<vk::VertexInputAttributeDescription, 2> getPosColorAttributeDescriptions();
+/*
+ * Compact 12 byte vertex of the smooth chunk meshes, indexed and pulled from
+ * the chunk mesh pool by the vertex shader.
+ *
+ * normal:     face index (+x, -x, +y, -y, +z, -z) for flat caps,
+ *             SMOOTH_NORMAL_BIT | octahedral normal for smooth ones
+ * attributes: material (16 bits) | ambient occlusion (2 bits) | sky light (4 bits) | block light (4 bits)
+ */
+struct ChunkVertex {
+    int16_t x, y, z;
+    uint16_t normal;
+    uint32_t attributes;
+};
 
-}
\ No newline at end of file
+constexpr uint32_t packChunkAttributes(uint32_t material, uint32_t ao, uint32_t skyLight, uint32_t blockLight)
+{
+    return (material & 0xffff) | ((ao & 0x3) << 16) | ((skyLight & 0xf) << 18) | ((blockLight & 0xf) << 22);
+}
+
+// top bit of a smooth normal, the low 14 bits hold 7 bits per octahedral coordinate
+constexpr uint16_t SMOOTH_NORMAL_BIT { 0x8000 };
+
+inline uint16_t packSmoothNormal(const glm::vec3& normal)
+{
+    glm::vec3 n = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) + 1e-20f);
+    glm::vec2 p { n.x, n.y };
+    if (n.z < 0.0f) {
+        p = (1.0f - glm::abs(glm::vec2 { p.y, p.x })) * glm::vec2 { p.x < 0.0f ? -1.0f : 1.0f, p.y < 0.0f ? -1.0f : 1.0f };
+    }
+
+    glm::uvec2 q { glm::clamp(glm::round((p * 0.5f + 0.5f) * 127.0f), 0.0f, 127.0f) };
+    return static_cast<uint16_t>(SMOOTH_NORMAL_BIT | q.x | (q.y << 7));
+}
+
+/*
+ * One greedy merged face of a voxel chunk, the whole quad in 12 bytes. The
+ * vertex shader pulls it once per vertex of its two triangles and expands
+ * the corners itself, so voxel meshes need no index buffer.
+ *
+ * geometry:   u (5 bits) | v (5 bits) | slice (5 bits) | face (3 bits) | width - 1 (5 bits) | height - 1 (5 bits),
+ *             u and v of the lowest corner on the two axes following the face's axis
+ * attributes: material (16 bits) | ambient occlusion (2 bits per corner)
+ * light:      sky light (4 bits per corner) | block light (4 bits per corner)
+ *
+ * Corners go (-u, -v), (+u, -v), (+u, +v), (-u, +v).
+ */
+struct ChunkFace {
+    uint32_t geometry;
+    uint32_t attributes;
+    uint32_t light;
+};
+
+// faces share the vertex slots of the chunk mesh pool
+static_assert(sizeof(ChunkFace) == sizeof(ChunkVertex));
+
+constexpr uint32_t packChunkFaceGeometry(uint32_t face, uint32_t slice, uint32_t u, uint32_t v, uint32_t width, uint32_t height)
+{
+    return u | (v << 5) | (slice << 10) | (face << 15) | ((width - 1) << 18) | ((height - 1) << 23);
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "asset_pack.hpp"
+#include "job_system.hpp"
+#include "mesh_optimizer.hpp"
+#include "obj_file.hpp"
+
+#include <string>
+
+namespace VoKel {
+
+struct ImportedMesh {
+    std::filesystem::path path;
+    ObjMesh mesh;
+
+    // from the run that optimized the mesh when it came out of the pack
+    MeshOptimization optimization;
+    bool cached;
+
+    // empty unless the file could not be loaded, the mesh is empty then
+    std::string error;
+};
+
+/*
+ * Loads .obj files and optimizes their index and vertex order with
+ * optimizeMesh, one job per file. The optimized meshes are looked up in
+ * and added to the pack by the hash of the file contents, a file seen
+ * before skips parsing and optimization. The pack is not saved.
+ */
+std::vector<ImportedMesh> importMeshes(const std::vector<std::filesystem::path>& paths, AssetPack& pack, JobSystem& jobs);
+
+}
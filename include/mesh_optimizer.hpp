@@ -0,0 +1,54 @@
+#pragma once
+#include "config.hpp"
+#include "obj_file.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+// the post transform cache the statistics are measured with, a FIFO as on most hardware
+constexpr uint32_t ANALYSIS_CACHE_SIZE { 16 };
+
+struct MeshDrawStats {
+    // vertices transformed per triangle and per referenced vertex through the analysis cache, 0.5 and 1 at best
+    float acmr;
+    float atvr;
+
+    // pixels shaded over pixels covered, averaged over views along the six axis directions, 1 at best
+    float overdraw;
+};
+
+MeshDrawStats analyzeMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+/*
+ * Reorders the triangles for the post transform cache after Tom Forsyth's
+ * linear speed optimizer: the next triangle is the one whose vertices score
+ * highest, a vertex scoring by its position in a simulated LRU cache and by
+ * how few of its triangles are left, so vertices are finished off while
+ * they are still cached.
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+/*
+ * Reorders runs of cache optimized triangles to draw the outside of the
+ * mesh first. The triangles are cut into clusters where the cache would be
+ * flushed anyway, or where a cluster's own miss ratio falls within
+ * threshold of its run's, and the clusters are sorted by how far out along
+ * their average normal they lie from the mesh's centroid. The miss ratio
+ * grows by at most about the threshold.
+ */
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, float threshold = 1.05f);
+
+// renumbers the vertices in the order the triangles first use them, unreferenced vertices are dropped
+void optimizeVertexFetch(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices);
+
+struct MeshOptimization {
+    MeshDrawStats before;
+    MeshDrawStats after;
+    double seconds;
+};
+
+// vertex cache, overdraw and vertex fetch order in turn, the triangles keep their winding
+MeshOptimization optimizeMesh(ObjMesh& mesh);
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "config.hpp"
+#include "job_system.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+// 124 triangles keep a meshlet's local indices within 372 bytes and under a 128 wide workgroup
+constexpr uint32_t MESHLET_MAX_VERTICES { 64 };
+constexpr uint32_t MESHLET_MAX_TRIANGLES { 124 };
+
+struct Meshlet {
+    // ranges of MeshletMesh::vertices and MeshletMesh::triangles, the latter counted in triangles
+    uint32_t vertexOffset;
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+
+    // bounding sphere of the vertices
+    glm::vec3 center;
+    float radius;
+
+    /*
+     * Normal cone of the triangles. All of them face away from an eye where
+     * dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius, a
+     * cutoff of 1 marks meshlets whose normals spread too far to ever cull.
+     */
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+/*
+ * Index buffer of a mesh split into meshlets. vertices maps every meshlet
+ * vertex to the vertex of the mesh, triangles holds three meshlet local
+ * vertex indices per triangle.
+ */
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+
+    size_t triangleCount() const { return triangles.size() / 3; }
+};
+
+// true when every triangle of the meshlet faces away from the eye
+bool isMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& eye);
+
+/*
+ * Splits an indexed triangle list into meshlets of at most
+ * MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles.
+ *
+ * A meshlet grows from a seed triangle by the unused triangle sharing one
+ * of its vertices that adds the fewest new vertices. As in meshoptimizer, a
+ * triangle that is the last unused one of any of its vertices goes right
+ * after those adding none, so growth does not strand single triangles.
+ * Ties go to the one closest to the meshlet's centroid and then to the
+ * lower triangle. The next meshlet is seeded from the border triangle of
+ * the last one whose vertices have the fewest unused triangles left, so
+ * the unused area is eaten from its corners rather than cut into islands,
+ * and meshlets stay full, compact and with narrow normal cones.
+ *
+ * The triangles are sorted along a morton curve of their centroids and cut
+ * into fixed ranges that are built in parallel and joined in order. The
+ * ranges do not depend on the number of threads, so every job system builds
+ * the same meshlets.
+ */
+MeshletMesh buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, JobSystem& jobs);
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "config.hpp"
+#include "memory.hpp"
+#include "meshlet_builder.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Draws static triangle meshes split into meshlets, culled one meshlet at a
+ * time on the gpu.
+ *
+ * Every meshlet is an indexed draw of its own. A compute pass tests the
+ * meshlets of all instances against the view frustum and their normal cone
+ * against the eye, and writes the frame's indirect draw arguments with an
+ * instance count of one or zero. Without draw count buffers at Vulkan 1.0
+ * the culled draws stay in the array rather than being compacted, the gpu
+ * skips them at the cost of reading their arguments.
+ *
+ * The vertex shader pulls positions and normals by index and the world
+ * matrix by instance index, the meshes and instances live in storage
+ * buffers that are rebuilt whenever a mesh is added.
+ *
+ * Where the device has mesh shaders the meshlets can instead be drawn by
+ * task and mesh shaders: a task invocation culls each meshlet and the kept
+ * ones are expanded by a mesh workgroup each, shading every meshlet vertex
+ * once, with no cull pass and no indirect arguments.
+ */
+class MeshletRenderer {
+public:
+    struct Stats {
+        uint32_t meshlets;
+        uint64_t triangles;
+
+        // what the cull of this frame in flight kept, read once its fence was waited on
+        uint32_t drawnMeshlets;
+        uint64_t drawnTriangles;
+    };
+
+    // throws when the device cannot take the instance from the indirect arguments,
+    // mesh shading only where the device was created with mesh shaders
+    MeshletRenderer(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t framesInFlight, bool meshShading);
+    ~MeshletRenderer();
+
+    MeshletRenderer(const MeshletRenderer&) = delete;
+    MeshletRenderer& operator=(const MeshletRenderer&) = delete;
+
+    // one instance of a mesh, the transform should scale uniformly for the bounds to hold, waits for the device
+    void addMesh(const std::vector<glm::vec3>& positions, const MeshletMesh& mesh, const glm::mat4& transform);
+
+    // the vertex shader's positions, normals and world matrices
+    vk::DescriptorSetLayout getGeometryLayout() const { return geometryLayout; }
+
+    // the task and mesh shaders' meshlets, their vertices and triangles and the counters, null without mesh shading
+    vk::DescriptorSetLayout getTaskLayout() const { return taskLayout; }
+
+    // records the cull of the frame's draws, outside a render pass, after the frame's fence was waited on,
+    // for mesh shading only the counters are cleared as the task shader culls
+    void record(vk::CommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProjection, const glm::vec3& eye, bool meshShading = false);
+
+    // draws what the frame's cull kept with a bound pipeline of the given layout, the geometry is set 0
+    void draw(vk::CommandBuffer commandBuffer, uint32_t frame, vk::PipelineLayout layout);
+
+    // culls and draws with a bound mesh shading pipeline of the given layout, the geometry is set 0 and the task set 1,
+    // pushes MeshletTaskData to the task and mesh stages
+    void drawMeshTasks(vk::CommandBuffer commandBuffer, uint32_t frame, vk::PipelineLayout layout, const glm::mat4& viewProjection, const glm::vec3& eye);
+
+    bool empty() const { return meshletCount == 0; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Frame {
+        vkUtil::Buffer draws;
+        vkUtil::Buffer counters;
+        vk::DescriptorSet cullSet;
+        vk::DescriptorSet taskSet;
+        bool recorded;
+    };
+
+    vk::Device device;
+    vk::PhysicalDevice physicalDevice;
+    uint32_t drawsPerCall;
+
+    vk::DescriptorSetLayout geometryLayout;
+    vk::DescriptorSetLayout cullLayout;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet geometrySet;
+    vk::PipelineLayout cullPipelineLayout;
+    vk::Pipeline cullPipeline;
+
+    vk::DescriptorSetLayout taskLayout { nullptr };
+    PFN_vkCmdDrawMeshTasksEXT drawMeshTasksCommand { nullptr };
+
+    // mirrors meshlet.vert, the normal is octahedral in two snorm16
+    struct Vertex {
+        glm::vec3 position;
+        uint32_t normal;
+    };
+
+    // mirrors meshlet_cull.comp and meshlet.task, the bounds are in mesh space,
+    // the meshlet's triangles start at firstIndex / 3 in the triangle buffer of the mesh shaders
+    struct GpuMeshlet {
+        glm::vec4 sphere;
+        glm::vec4 cone;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t instance;
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+        uint32_t padding[3];
+    };
+
+    // cpu copies of everything added, the buffers are built from them,
+    // the meshlet vertices and packed local triangles only for mesh shading
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<GpuMeshlet> meshlets;
+    std::vector<glm::mat4> transforms;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> meshletTriangles;
+
+    vkUtil::Buffer vertexBuffer {};
+    vkUtil::Buffer indexBuffer {};
+    vkUtil::Buffer meshletBuffer {};
+    vkUtil::Buffer transformBuffer {};
+    vkUtil::Buffer meshletVertexBuffer {};
+    vkUtil::Buffer meshletTriangleBuffer {};
+    uint32_t meshletCount { 0 };
+
+    std::vector<Frame> frames;
+    Stats stats {};
+
+    void destroyBuffers();
+    void createBuffers();
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Gradient noise shared by the scalar and the SIMD code paths.
+ *
+ * This header stays free of config.hpp on purpose: it is included by the
+ * translation units built with -msse4.1 / -mavx2, which must not instantiate
+ * any inline function that the rest of the engine also uses.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VOKEL_X86 1
+#else
+#define VOKEL_X86 0
+#endif
+
+namespace VoKel {
+
+enum class SimdLevel : uint8_t {
+    Scalar,
+    SSE4,
+    AVX2
+};
+
+// best level supported by the cpu, capped by the VOKEL_SIMD environment variable (scalar, sse4, avx2)
+SimdLevel getSimdLevel();
+const char* getSimdLevelName(SimdLevel level);
+
+struct FbmSettings {
+    uint32_t octaves { 1 };
+    float frequency { 1.0f };
+    float lacunarity { 2.0f };
+    float gain { 0.5f };
+
+    // input coordinates are displaced by a noise of this amplitude and frequency first
+    float warpStrength { 0.0f };
+    float warpFrequency { 0.0f };
+};
+
+/*
+ * Batched fractal gradient noise, every path performs the exact same float
+ * operations in the same order, so the results are bit identical whatever
+ * SimdLevel is picked. Output is roughly in [-1, 1] per octave.
+ */
+void fbm2D(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed, SimdLevel level);
+void fbm3D(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed, SimdLevel level);
+
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "noise.hpp"
+
+/*
+ * Noise kernels written once against a tiny vector interface V:
+ *
+ *   V::F / V::I     float and 32-bit unsigned lanes, V::WIDTH lanes each
+ *   arithmetic      add, sub, mul, floor, toInt, addi, muli, xori, andi, srli, slli
+ *   masks           less / equal return all-ones lanes, select(mask, a, b)
+ *   flipSign(a, s)  xor of the float bits with s, an exact negation when s is the sign bit
+ *
+ * No fused multiply-add, no reciprocal approximations: the operation
+ * sequence is the whole determinism contract between the paths.
+ */
+
+namespace VoKel {
+
+namespace noise {
+
+    template <typename V>
+    inline typename V::F fade(typename V::F t)
+    {
+        using F = typename V::F;
+
+        F inner = V::add(V::mul(t, V::sub(V::mul(t, V::set(6.0f)), V::set(15.0f))), V::set(10.0f));
+        return V::mul(V::mul(V::mul(t, t), t), inner);
+    }
+
+    template <typename V>
+    inline typename V::F lerp(typename V::F a, typename V::F b, typename V::F t)
+    {
+        return V::add(a, V::mul(t, V::sub(b, a)));
+    }
+
+    template <typename V>
+    inline typename V::I finalizeHash(typename V::I h)
+    {
+        h = V::xori(h, V::srli(h, 15));
+        h = V::muli(h, V::seti(0x2c1b3c6du));
+        h = V::xori(h, V::srli(h, 12));
+        h = V::muli(h, V::seti(0x297a2d39u));
+        return V::xori(h, V::srli(h, 15));
+    }
+
+    template <typename V>
+    inline typename V::I hash2(typename V::I x, typename V::I y, uint32_t seed)
+    {
+        typename V::I h = V::xori(V::muli(x, V::seti(0x8da6b343u)), V::muli(y, V::seti(0xd8163841u)));
+        return finalizeHash<V>(V::xori(h, V::seti(seed)));
+    }
+
+    template <typename V>
+    inline typename V::I hash3(typename V::I x, typename V::I y, typename V::I z, uint32_t seed)
+    {
+        typename V::I h = V::xori(V::muli(x, V::seti(0x8da6b343u)), V::muli(y, V::seti(0xd8163841u)));
+        h = V::xori(h, V::muli(z, V::seti(0xcb1ab31fu)));
+        return finalizeHash<V>(V::xori(h, V::seti(seed)));
+    }
+
+    // diagonal gradients (+-1, +-1)
+    template <typename V>
+    inline typename V::F gradient2(typename V::I h, typename V::F x, typename V::F y)
+    {
+        typename V::F u = V::flipSign(x, V::slli(V::andi(h, V::seti(1)), 31));
+        typename V::F v = V::flipSign(y, V::slli(V::andi(h, V::seti(2)), 30));
+        return V::add(u, v);
+    }
+
+    // the twelve cube edge gradients of improved perlin noise, padded to sixteen
+    template <typename V>
+    inline typename V::F gradient3(typename V::I h, typename V::F x, typename V::F y, typename V::F z)
+    {
+        using I = typename V::I;
+
+        h = V::andi(h, V::seti(15));
+        I h8 = V::less(h, V::seti(8));
+        I h4 = V::less(h, V::seti(4));
+        I hx = V::ori(V::equal(h, V::seti(12)), V::equal(h, V::seti(14)));
+
+        typename V::F u = V::select(h8, x, y);
+        typename V::F v = V::select(h4, y, V::select(hx, x, z));
+
+        u = V::flipSign(u, V::slli(V::andi(h, V::seti(1)), 31));
+        v = V::flipSign(v, V::slli(V::andi(h, V::seti(2)), 30));
+        return V::add(u, v);
+    }
+
+    template <typename V>
+    inline typename V::F noise2(typename V::F x, typename V::F y, uint32_t seed)
+    {
+        using F = typename V::F;
+        using I = typename V::I;
+
+        F fx = V::floor(x);
+        F fy = V::floor(y);
+        I ix = V::toInt(fx);
+        I iy = V::toInt(fy);
+        I ix1 = V::addi(ix, V::seti(1));
+        I iy1 = V::addi(iy, V::seti(1));
+
+        F dx = V::sub(x, fx);
+        F dy = V::sub(y, fy);
+        F dx1 = V::sub(dx, V::set(1.0f));
+        F dy1 = V::sub(dy, V::set(1.0f));
+
+        F u = fade<V>(dx);
+        F v = fade<V>(dy);
+
+        F g00 = gradient2<V>(hash2<V>(ix, iy, seed), dx, dy);
+        F g10 = gradient2<V>(hash2<V>(ix1, iy, seed), dx1, dy);
+        F g01 = gradient2<V>(hash2<V>(ix, iy1, seed), dx, dy1);
+        F g11 = gradient2<V>(hash2<V>(ix1, iy1, seed), dx1, dy1);
+
+        return lerp<V>(lerp<V>(g00, g10, u), lerp<V>(g01, g11, u), v);
+    }
+
+    template <typename V>
+    inline typename V::F noise3(typename V::F x, typename V::F y, typename V::F z, uint32_t seed)
+    {
+        using F = typename V::F;
+        using I = typename V::I;
+
+        F fx = V::floor(x);
+        F fy = V::floor(y);
+        F fz = V::floor(z);
+        I ix = V::toInt(fx);
+        I iy = V::toInt(fy);
+        I iz = V::toInt(fz);
+        I ix1 = V::addi(ix, V::seti(1));
+        I iy1 = V::addi(iy, V::seti(1));
+        I iz1 = V::addi(iz, V::seti(1));
+
+        F dx = V::sub(x, fx);
+        F dy = V::sub(y, fy);
+        F dz = V::sub(z, fz);
+        F dx1 = V::sub(dx, V::set(1.0f));
+        F dy1 = V::sub(dy, V::set(1.0f));
+        F dz1 = V::sub(dz, V::set(1.0f));
+
+        F u = fade<V>(dx);
+        F v = fade<V>(dy);
+        F w = fade<V>(dz);
+
+        F g000 = gradient3<V>(hash3<V>(ix, iy, iz, seed), dx, dy, dz);
+        F g100 = gradient3<V>(hash3<V>(ix1, iy, iz, seed), dx1, dy, dz);
+        F g010 = gradient3<V>(hash3<V>(ix, iy1, iz, seed), dx, dy1, dz);
+        F g110 = gradient3<V>(hash3<V>(ix1, iy1, iz, seed), dx1, dy1, dz);
+        F g001 = gradient3<V>(hash3<V>(ix, iy, iz1, seed), dx, dy, dz1);
+        F g101 = gradient3<V>(hash3<V>(ix1, iy, iz1, seed), dx1, dy, dz1);
+        F g011 = gradient3<V>(hash3<V>(ix, iy1, iz1, seed), dx, dy1, dz1);
+        F g111 = gradient3<V>(hash3<V>(ix1, iy1, iz1, seed), dx1, dy1, dz1);
+
+        F y0 = lerp<V>(lerp<V>(g000, g100, u), lerp<V>(g010, g110, u), v);
+        F y1 = lerp<V>(lerp<V>(g001, g101, u), lerp<V>(g011, g111, u), v);
+        return lerp<V>(y0, y1, w);
+    }
+
+    constexpr uint32_t WARP_SEED_X { 0x5f3759dfu };
+    constexpr uint32_t WARP_SEED_Y { 0x9e3779b9u };
+    constexpr uint32_t WARP_SEED_Z { 0x7f4a7c15u };
+
+    template <typename V>
+    inline typename V::F fbm2(typename V::F x, typename V::F y, const FbmSettings& settings, uint32_t seed)
+    {
+        using F = typename V::F;
+
+        if (settings.warpStrength != 0.0f) {
+            F wf = V::set(settings.warpFrequency);
+            F ws = V::set(settings.warpStrength);
+            F wx = noise2<V>(V::mul(x, wf), V::mul(y, wf), seed ^ WARP_SEED_X);
+            F wy = noise2<V>(V::mul(x, wf), V::mul(y, wf), seed ^ WARP_SEED_Y);
+            x = V::add(x, V::mul(wx, ws));
+            y = V::add(y, V::mul(wy, ws));
+        }
+
+        F sum = V::set(0.0f);
+        float frequency { settings.frequency };
+        float amplitude { 1.0f };
+
+        for (uint32_t octave { 0 }; octave < settings.octaves; octave++) {
+            F f = V::set(frequency);
+            F n = noise2<V>(V::mul(x, f), V::mul(y, f), seed + octave);
+            sum = V::add(sum, V::mul(n, V::set(amplitude)));
+            frequency *= settings.lacunarity;
+            amplitude *= settings.gain;
+        }
+
+        return sum;
+    }
+
+    template <typename V>
+    inline typename V::F fbm3(typename V::F x, typename V::F y, typename V::F z, const FbmSettings& settings, uint32_t seed)
+    {
+        using F = typename V::F;
+
+        if (settings.warpStrength != 0.0f) {
+            F wf = V::set(settings.warpFrequency);
+            F ws = V::set(settings.warpStrength);
+            F sx = V::mul(x, wf);
+            F sy = V::mul(y, wf);
+            F sz = V::mul(z, wf);
+            F wx = noise3<V>(sx, sy, sz, seed ^ WARP_SEED_X);
+            F wy = noise3<V>(sx, sy, sz, seed ^ WARP_SEED_Y);
+            F wz = noise3<V>(sx, sy, sz, seed ^ WARP_SEED_Z);
+            x = V::add(x, V::mul(wx, ws));
+            y = V::add(y, V::mul(wy, ws));
+            z = V::add(z, V::mul(wz, ws));
+        }
+
+        F sum = V::set(0.0f);
+        float frequency { settings.frequency };
+        float amplitude { 1.0f };
+
+        for (uint32_t octave { 0 }; octave < settings.octaves; octave++) {
+            F f = V::set(frequency);
+            F n = noise3<V>(V::mul(x, f), V::mul(y, f), V::mul(z, f), seed + octave);
+            sum = V::add(sum, V::mul(n, V::set(amplitude)));
+            frequency *= settings.lacunarity;
+            amplitude *= settings.gain;
+        }
+
+        return sum;
+    }
+
+    // full vectors first, the tail goes through one zero padded vector
+    template <typename V>
+    inline void runFbm2D(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed)
+    {
+        size_t i { 0 };
+        for (; i + V::WIDTH <= count; i += V::WIDTH) {
+            V::store(out + i, fbm2<V>(V::load(x + i), V::load(y + i), settings, seed));
+        }
+
+        if (i < count) {
+            alignas(32) float tx[V::WIDTH] {};
+            alignas(32) float ty[V::WIDTH] {};
+            alignas(32) float to[V::WIDTH] {};
+
+            for (size_t j { 0 }; i + j < count; j++) {
+                tx[j] = x[i + j];
+                ty[j] = y[i + j];
+            }
+
+            V::store(to, fbm2<V>(V::load(tx), V::load(ty), settings, seed));
+
+            for (size_t j { 0 }; i + j < count; j++) {
+                out[i + j] = to[j];
+            }
+        }
+    }
+
+    template <typename V>
+    inline void runFbm3D(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed)
+    {
+        size_t i { 0 };
+        for (; i + V::WIDTH <= count; i += V::WIDTH) {
+            V::store(out + i, fbm3<V>(V::load(x + i), V::load(y + i), V::load(z + i), settings, seed));
+        }
+
+        if (i < count) {
+            alignas(32) float tx[V::WIDTH] {};
+            alignas(32) float ty[V::WIDTH] {};
+            alignas(32) float tz[V::WIDTH] {};
+            alignas(32) float to[V::WIDTH] {};
+
+            for (size_t j { 0 }; i + j < count; j++) {
+                tx[j] = x[i + j];
+                ty[j] = y[i + j];
+                tz[j] = z[i + j];
+            }
+
+            V::store(to, fbm3<V>(V::load(tx), V::load(ty), V::load(tz), settings, seed));
+
+            for (size_t j { 0 }; i + j < count; j++) {
+                out[i + j] = to[j];
+            }
+        }
+    }
+
+    void fbm2DSse4(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed);
+    void fbm3DSse4(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed);
+
+    void fbm2DAvx2(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed);
+    void fbm3DAvx2(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed);
+
+}
+
+}
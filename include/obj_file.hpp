@@ -0,0 +1,26 @@
+#pragma once
+#include "config.hpp"
+
+#include <filesystem>
+#include <vector>
+
+namespace VoKel {
+
+// positions and triangles of a Wavefront .obj file
+struct ObjMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+};
+
+/*
+ * Reads the vertex positions and faces of a .obj file, everything else is
+ * skipped. Texture and normal references of a face are ignored, negative
+ * indices count back from the last vertex and polygons are split into a
+ * fan of triangles around their first vertex.
+ *
+ * Throws std::runtime_error when the file cannot be read or a face refers
+ * to a vertex that does not exist.
+ */
+ObjMesh loadObj(const std::filesystem::path& path);
+
+}
@@ -8,8 +8,29 @@ struct GraphicsPipelineInBundle {
     vk::Device device;
     std::string vertFilePath;
     std::string fragFilePath;
+
+    // mesh shading pipelines set a mesh shader and optionally a task shader in place of the vertex shader,
+    // the device needs VK_EXT_mesh_shader, see supportsMeshShaders
+    std::string taskFilePath;
+    std::string meshFilePath;
+
     vk::Extent2D swapchainExtent;
     vk::Format format;
+    vk::Format depthFormat;
+
+    // empty for vertex pulling, the vertex shader then reads storage buffers by vertex and instance index
+    std::vector<vk::VertexInputBindingDescription> bindingDescriptions;
+    std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
+    uint32_t pushConstantSize;
+
+    // descriptor sets in set order, the pulled vertex buffers and the fragment stage's resources
+    std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+
+    vk::FrontFace frontFace { vk::FrontFace::eClockwise };
+    bool depthTest { true };
+
+    // pipelines sharing a render pass pass the existing one, otherwise a new one is created
+    vk::RenderPass renderpass { nullptr };
 };
 
 struct GraphicsPipelineOutBundle {
@@ -18,10 +39,28 @@ struct GraphicsPipelineOutBundle {
     vk::Pipeline pipeline;
 };
 
+struct ComputePipelineInBundle {
+    vk::Device device;
+    std::string compFilePath;
+    vk::DescriptorSetLayout descriptorSetLayout;
+    uint32_t pushConstantSize;
+};
+
+struct ComputePipelineOutBundle {
+    vk::PipelineLayout layout;
+    vk::Pipeline pipeline;
+};
+
 GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle& specification, vk::Pipeline oldPipeline = nullptr);
 
-vk::PipelineLayout createPipelineLayout(const vk::Device& device);
+ComputePipelineOutBundle createComputePipeline(const ComputePipelineInBundle& specification);
+
+vk::PipelineLayout createPipelineLayout(const vk::Device& device, uint32_t pushConstantSize, const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts = {},
+    vk::ShaderStageFlags pushConstantStages = vk::ShaderStageFlagBits::eVertex);
+
+// bindingCount storage buffers at bindings 0 onwards, the layout of the buffers a vertex pulling shader reads
+vk::DescriptorSetLayout createStorageBufferSetLayout(const vk::Device& device, uint32_t bindingCount, vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex);
 
-vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swapchainImageFormat);
+vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swapchainImageFormat, const vk::Format& depthFormat);
 
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+#include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "raycast_kernel.hpp"
+#include "world.hpp"
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace VoKel {
+
+struct Ray {
+    glm::vec3 origin;
+    // any length, hit distances are in voxels
+    glm::vec3 direction;
+    float maxDistance;
+};
+
+struct RayHit {
+    bool hit;
+    glm::ivec3 voxel;
+
+    // side the ray entered through in Face order, RAY_INSIDE when it started in a solid voxel
+    uint8_t face;
+    float distance;
+    Voxel material;
+};
+
+/*
+ * Ray queries against the resident chunks, for picking, line of sight and
+ * anything else that needs the first solid voxel along a line.
+ *
+ * Rays walk the voxel grid with the Amanatides-Woo DDA over a per-chunk
+ * occupancy bitset. Missing or empty chunks are crossed in a single step, as
+ * are empty 8x8x8 bricks inside a chunk, so long rays through open terrain
+ * only touch the voxels near a surface. Batches trace SSE4 or AVX2 packets of
+ * 4 or 8 rays stepping in lockstep.
+ *
+ * The occupancy mirrors the world as of the last update(), queries are const
+ * and may run on any number of threads between updates.
+ */
+class VoxelRaycaster {
+public:
+    VoxelRaycaster(World& world, JobSystem& jobs);
+
+    VoxelRaycaster(const VoxelRaycaster&) = delete;
+    VoxelRaycaster& operator=(const VoxelRaycaster&) = delete;
+
+    // world notifications, the occupancy is rebuilt on the next update
+    void chunkChanged(const ChunkCoord& coord);
+    void voxelChanged(const glm::ivec3& voxel);
+
+    // rebuilds the occupancy of every changed chunk in parallel
+    void update();
+
+    RayHit cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+    // traces rays in packets of the given width, split between the job threads when there are enough of them
+    void cast(const std::vector<Ray>& rays, std::vector<RayHit>& hits, SimdLevel level = getSimdLevel()) const;
+
+    // raw batch, lookup and context are filled in, directions must be normalized
+    void trace(RayBatch batch, SimdLevel level = getSimdLevel()) const;
+
+    const ChunkOccupancy* findOccupancy(const ChunkCoord& coord) const;
+
+    size_t getChunkCount() const { return occupancy.size(); }
+
+private:
+    World& world;
+    JobSystem& jobs;
+
+    ChunkMap<std::unique_ptr<ChunkOccupancy>> occupancy;
+    std::unordered_set<uint64_t> dirtyChunks;
+};
+
+}
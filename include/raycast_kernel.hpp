@@ -0,0 +1,364 @@
+#pragma once
+
+#include "noise.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Ray traversal kernels, shared by the scalar and the SIMD code paths. Like
+ * noise.hpp this header stays free of config.hpp, it is compiled with
+ * -msse4.1 / -mavx2 as well.
+ */
+
+namespace VoKel {
+
+/*
+ * Solid voxels of one chunk for ray queries. One bit per voxel, rows are
+ * indexed z | y << 5 and hold x in their bits, like the voxel order of a
+ * chunk. One more bit per 8x8x8 brick, bx | bz << 2 | by << 4, is set when
+ * the brick holds anything at all.
+ */
+struct ChunkOccupancy {
+    static constexpr int SIZE_LOG2 { 5 };
+    static constexpr int BRICK_SIZE_LOG2 { 3 };
+
+    uint64_t bricks;
+    uint32_t rows[1 << (2 * SIZE_LOG2)];
+};
+
+// nullptr for chunks without solid voxels, called concurrently from every tracing thread
+using OccupancyLookup = const ChunkOccupancy* (*)(const void* context, int32_t x, int32_t y, int32_t z);
+
+/*
+ * Rays and results as separate arrays so a packet loads with plain vector
+ * loads. Directions are expected normalized, distances are in voxels.
+ */
+struct RayBatch {
+    const float* origin[3];
+    const float* direction[3];
+    const float* maxDistance;
+    size_t count;
+
+    OccupancyLookup lookup;
+    const void* context;
+
+    // hit voxel, or where the ray stopped
+    int32_t* voxel[3];
+    float* distance;
+
+    // side the ray entered the voxel through, in Face order, RAY_INSIDE or RAY_MISS
+    uint8_t* face;
+};
+
+constexpr uint8_t RAY_INSIDE { 6 };
+constexpr uint8_t RAY_MISS { 0xff };
+
+// traces every ray of the batch with the given instruction set, safe to call from several threads
+void traceRays(const RayBatch& batch, SimdLevel level);
+
+namespace raycast {
+
+    /*
+     * Kernels written against a small vector interface V:
+     *
+     *   V::F / V::I / V::M          float lanes, int32 lanes and lane masks, V::WIDTH lanes each
+     *   load, store, set            float lanes, with add, sub, mul, maxf and floor
+     *   loadi, storei, seti         int32 lanes, with addi, subi, andi, mini and maxi
+     *   toFloat, toInt              conversions, toInt truncates
+     *   lessEqual, maski            masks from a float compare or from an all ones int32 lane,
+     *                               combined with andm, andnotm and orm
+     *   select, selecti             mask ? a : b for both lane types
+     *
+     * The packet steps in lockstep. Every iteration each live lane looks at
+     * its current voxel with scalar code: a solid voxel ends the ray, an
+     * empty voxel in an occupied brick moves one voxel, an empty brick or
+     * chunk moves past the whole 8^3 or 32^3 block. The move itself is done
+     * for all lanes at once with vector code, single voxel moves follow the
+     * incremental Amanatides-Woo boundaries, block moves restart the walk
+     * at the point where the ray leaves the block.
+     */
+
+    constexpr float FAR { 3.0e38f };
+
+    template <typename V>
+    inline int32_t floorToInt(float v)
+    {
+        int32_t i = static_cast<int32_t>(v);
+        return i - (v < static_cast<float>(i) ? 1 : 0);
+    }
+
+    template <typename V>
+    struct Packet {
+        static constexpr size_t W { V::WIDTH };
+
+        alignas(32) float origin[3][W];
+        alignas(32) float direction[3][W];
+        alignas(32) float inverse[3][W];
+        alignas(32) float tMax[3][W];
+        alignas(32) float tDelta[3][W];
+        alignas(32) float t[W];
+        alignas(32) int32_t cell[3][W];
+        alignas(32) int32_t step[3][W];
+        alignas(32) int32_t axis[W];
+
+        // all ones per lane and axis, for a positive or a non zero direction
+        alignas(32) int32_t up[3][W];
+        alignas(32) int32_t moving[3][W];
+
+        // block the lane moves out of next, all ones in fine when it is a single voxel
+        alignas(32) int32_t blockMask[W];
+        alignas(32) int32_t blockSize[W];
+        alignas(32) int32_t fine[W];
+
+        float maxDistance[W];
+        bool active[W];
+        const ChunkOccupancy* chunk[W];
+        int32_t chunkCell[3][W];
+    };
+
+    template <typename V>
+    inline void setBlock(Packet<V>& p, size_t lane, int sizeLog2)
+    {
+        p.blockMask[lane] = ~((1 << sizeLog2) - 1);
+        p.blockSize[lane] = 1 << sizeLog2;
+        p.fine[lane] = sizeLog2 == 0 ? -1 : 0;
+    }
+
+    // scalar part of an iteration, false once the lane hit something or ran out of distance
+    template <typename V>
+    inline bool probe(const RayBatch& batch, Packet<V>& p, size_t lane, size_t ray)
+    {
+        constexpr int SIZE_LOG2 { ChunkOccupancy::SIZE_LOG2 };
+        constexpr int BRICK_LOG2 { ChunkOccupancy::BRICK_SIZE_LOG2 };
+        constexpr int32_t MASK { (1 << SIZE_LOG2) - 1 };
+
+        if (p.t[lane] > p.maxDistance[lane]) {
+            for (int a { 0 }; a < 3; a++) {
+                batch.voxel[a][ray] = p.cell[a][lane];
+            }
+
+            batch.face[ray] = RAY_MISS;
+            batch.distance[ray] = p.maxDistance[lane];
+            return false;
+        }
+
+        int32_t chunkCell[3] { p.cell[0][lane] >> SIZE_LOG2, p.cell[1][lane] >> SIZE_LOG2, p.cell[2][lane] >> SIZE_LOG2 };
+
+        if (chunkCell[0] != p.chunkCell[0][lane] || chunkCell[1] != p.chunkCell[1][lane] || chunkCell[2] != p.chunkCell[2][lane]) {
+            for (int a { 0 }; a < 3; a++) {
+                p.chunkCell[a][lane] = chunkCell[a];
+            }
+            p.chunk[lane] = batch.lookup(batch.context, chunkCell[0], chunkCell[1], chunkCell[2]);
+        }
+
+        const ChunkOccupancy* chunk = p.chunk[lane];
+        if (chunk == nullptr) {
+            setBlock(p, lane, SIZE_LOG2);
+            return true;
+        }
+
+        int32_t x = p.cell[0][lane] & MASK;
+        int32_t y = p.cell[1][lane] & MASK;
+        int32_t z = p.cell[2][lane] & MASK;
+
+        int brick = (x >> BRICK_LOG2) | ((z >> BRICK_LOG2) << 2) | ((y >> BRICK_LOG2) << 4);
+        if ((chunk->bricks & (1ull << brick)) == 0) {
+            setBlock(p, lane, BRICK_LOG2);
+            return true;
+        }
+
+        if ((chunk->rows[z | (y << SIZE_LOG2)] >> x) & 1u) {
+            for (int a { 0 }; a < 3; a++) {
+                batch.voxel[a][ray] = p.cell[a][lane];
+            }
+
+            batch.distance[ray] = p.t[lane];
+
+            int axis = p.axis[lane];
+            batch.face[ray] = axis < 0 ? RAY_INSIDE : uint8_t(axis * 2 + (p.step[axis][lane] > 0 ? 1 : 0));
+            return false;
+        }
+
+        setBlock(p, lane, 0);
+        return true;
+    }
+
+    // moves every lane out of its current block
+    template <typename V>
+    inline void advance(Packet<V>& p)
+    {
+        using F = typename V::F;
+        using I = typename V::I;
+        using M = typename V::M;
+
+        F t = V::load(p.t);
+        I mask = V::loadi(p.blockMask);
+        I size = V::loadi(p.blockSize);
+        M fine = V::maski(V::loadi(p.fine));
+        F far = V::set(FAR);
+
+        I base[3];
+        F tMax[3];
+        F exit[3];
+
+        for (int a { 0 }; a < 3; a++) {
+            base[a] = V::andi(V::loadi(p.cell[a]), mask);
+            tMax[a] = V::load(p.tMax[a]);
+
+            // voxel moves keep the incremental boundary so they match a plain walk bit for bit
+            I bound = V::addi(base[a], V::andi(size, V::loadi(p.up[a])));
+            F blockExit = V::mul(V::sub(V::toFloat(bound), V::load(p.origin[a])), V::load(p.inverse[a]));
+            blockExit = V::select(V::maski(V::loadi(p.moving[a])), blockExit, far);
+            exit[a] = V::select(fine, tMax[a], blockExit);
+        }
+
+        M xMin = V::andm(V::lessEqual(exit[0], exit[1]), V::lessEqual(exit[0], exit[2]));
+        M yMin = V::andnotm(xMin, V::lessEqual(exit[1], exit[2]));
+        M xyMin = V::orm(xMin, yMin);
+        M exitAxis[3] { xMin, yMin, V::andnotm(xyMin, V::maski(V::seti(-1))) };
+
+        t = V::maxf(V::select(xMin, exit[0], V::select(yMin, exit[1], exit[2])), t);
+        V::store(p.t, t);
+
+        for (int a { 0 }; a < 3; a++) {
+            I cell = V::loadi(p.cell[a]);
+            I up = V::loadi(p.up[a]);
+            F origin = V::load(p.origin[a]);
+            F inverse = V::load(p.inverse[a]);
+
+            // the exit point may round a hair outside the block on the other axes
+            I last = V::subi(V::addi(base[a], size), V::seti(1));
+            I crossed = V::selecti(V::maski(up), V::addi(base[a], size), V::subi(base[a], V::seti(1)));
+            I inside = V::toInt(V::floor(V::add(origin, V::mul(V::load(p.direction[a]), t))));
+            inside = V::maxi(V::mini(inside, last), base[a]);
+
+            cell = V::selecti(exitAxis[a], crossed, V::selecti(fine, cell, inside));
+            V::storei(p.cell[a], cell);
+
+            F fineMax = V::select(exitAxis[a], V::add(tMax[a], V::load(p.tDelta[a])), tMax[a]);
+            F blockMax = V::maxf(V::mul(V::sub(V::toFloat(V::subi(cell, up)), origin), inverse), t);
+            blockMax = V::select(V::maski(V::loadi(p.moving[a])), blockMax, far);
+            V::store(p.tMax[a], V::select(fine, fineMax, blockMax));
+        }
+
+        V::storei(p.axis, V::selecti(xMin, V::seti(0), V::selecti(yMin, V::seti(1), V::seti(2))));
+    }
+
+    // loads a ray into a lane, false when the ray has no direction and its result is already written
+    template <typename V>
+    inline bool startRay(const RayBatch& batch, Packet<V>& p, size_t lane, size_t ray)
+    {
+        constexpr int SIZE_LOG2 { ChunkOccupancy::SIZE_LOG2 };
+
+        p.t[lane] = 0.0f;
+        p.axis[lane] = -1;
+        p.maxDistance[lane] = batch.maxDistance[ray];
+        p.chunk[lane] = nullptr;
+        setBlock(p, lane, 0);
+
+        for (int a { 0 }; a < 3; a++) {
+            float o = batch.origin[a][ray];
+            float d = batch.direction[a][ray];
+            int32_t cell = floorToInt<V>(o);
+
+            p.origin[a][lane] = o;
+            p.direction[a][lane] = d;
+            p.cell[a][lane] = cell;
+            p.step[a][lane] = d > 0.0f ? 1 : (d < 0.0f ? -1 : 0);
+            p.up[a][lane] = d > 0.0f ? -1 : 0;
+            p.moving[a][lane] = d != 0.0f ? -1 : 0;
+            p.inverse[a][lane] = d != 0.0f ? 1.0f / d : 0.0f;
+
+            if (d > 0.0f) {
+                p.tMax[a][lane] = (static_cast<float>(cell + 1) - o) * p.inverse[a][lane];
+                p.tDelta[a][lane] = p.inverse[a][lane];
+            } else if (d < 0.0f) {
+                p.tMax[a][lane] = (static_cast<float>(cell) - o) * p.inverse[a][lane];
+                p.tDelta[a][lane] = -p.inverse[a][lane];
+            } else {
+                p.tMax[a][lane] = FAR;
+                p.tDelta[a][lane] = FAR;
+            }
+
+            // forces a lookup on the first probe
+            p.chunkCell[a][lane] = (cell >> SIZE_LOG2) + 1;
+        }
+
+        if (p.step[0][lane] == 0 && p.step[1][lane] == 0 && p.step[2][lane] == 0) {
+            for (int a { 0 }; a < 3; a++) {
+                batch.voxel[a][ray] = p.cell[a][lane];
+            }
+
+            batch.face[ray] = RAY_MISS;
+            batch.distance[ray] = 0.0f;
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * Lanes do not wait for the longest ray of a packet: a lane that finished
+     * takes the next ray of the batch right away, so the packet stays full
+     * until the batch runs dry.
+     */
+    template <typename V>
+    inline void runTraceRays(const RayBatch& batch)
+    {
+        constexpr size_t W { V::WIDTH };
+
+        Packet<V> p;
+        size_t ray[W];
+        size_t next { 0 };
+        size_t live { 0 };
+
+        auto refill = [&](size_t lane) {
+            while (next < batch.count) {
+                ray[lane] = next++;
+                if (startRay(batch, p, lane, ray[lane]) && probe(batch, p, lane, ray[lane])) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        for (size_t lane { 0 }; lane < W; lane++) {
+            // idle lanes walk a harmless ray along x, their results are never written
+            for (int a { 0 }; a < 3; a++) {
+                p.origin[a][lane] = 0.0f;
+                p.direction[a][lane] = a == 0 ? 1.0f : 0.0f;
+                p.inverse[a][lane] = a == 0 ? 1.0f : 0.0f;
+                p.tMax[a][lane] = a == 0 ? 1.0f : FAR;
+                p.tDelta[a][lane] = a == 0 ? 1.0f : FAR;
+                p.cell[a][lane] = 0;
+                p.step[a][lane] = a == 0 ? 1 : 0;
+                p.up[a][lane] = a == 0 ? -1 : 0;
+                p.moving[a][lane] = a == 0 ? -1 : 0;
+            }
+            p.t[lane] = 0.0f;
+            p.axis[lane] = -1;
+            setBlock(p, lane, 0);
+
+            p.active[lane] = refill(lane);
+            live += p.active[lane] ? 1 : 0;
+        }
+
+        while (live > 0) {
+            advance(p);
+
+            for (size_t lane { 0 }; lane < W; lane++) {
+                if (p.active[lane] && !probe(batch, p, lane, ray[lane]) && !refill(lane)) {
+                    p.active[lane] = false;
+                    live--;
+                }
+            }
+        }
+    }
+
+    void traceRaysSse4(const RayBatch& batch);
+    void traceRaysAvx2(const RayBatch& batch);
+
+}
+
+}
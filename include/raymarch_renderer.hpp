@@ -0,0 +1,78 @@
+#pragma once
+#include "brick_map.hpp"
+#include "config.hpp"
+#include "memory.hpp"
+#include "render_structs.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Draws the brick map by raymarching it in a compute shader, as an
+ * alternative to rasterizing chunk meshes.
+ *
+ * The grid cells and the brick slots live in two storage buffers. Every
+ * frame only the cells and bricks the last brick map update wrote are copied
+ * in through that frame's staging buffer, a missed update or a grown brick
+ * buffer uploads everything once. The shader writes an offscreen image per
+ * frame in flight, which is blitted onto the swapchain image, so the
+ * swapchain only needs to support transfer writes.
+ */
+class RaymarchRenderer {
+public:
+    // throws when the device cannot write rgba8 storage images or blit into the swapchain format
+    RaymarchRenderer(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Format swapchainFormat);
+    ~RaymarchRenderer();
+
+    RaymarchRenderer(const RaymarchRenderer&) = delete;
+    RaymarchRenderer& operator=(const RaymarchRenderer&) = delete;
+
+    // (re)creates the per frame images, the device must be idle
+    void setTargets(vk::Extent2D extent, uint32_t frameCount);
+
+    // records uploads, the dispatch and the blit, leaving the swapchain image ready to present
+    void record(vk::CommandBuffer commandBuffer, uint32_t frame, vk::Image swapchainImage, const BrickMap& brickMap, const vkUtil::RaymarchData& data);
+
+    // bytes copied to the gpu by the last record
+    size_t getUploadedBytes() const { return uploadedBytes; }
+
+private:
+    vk::Device device;
+    vk::PhysicalDevice physicalDevice;
+
+    vk::DescriptorSetLayout descriptorSetLayout;
+    vk::DescriptorPool descriptorPool { nullptr };
+    vk::PipelineLayout layout;
+    vk::Pipeline pipeline;
+
+    struct Frame {
+        vk::Image image;
+        vk::DeviceMemory imageMemory;
+        vk::ImageView imageView;
+        vk::DescriptorSet descriptorSet;
+
+        vkUtil::Buffer staging;
+        size_t stagingSize;
+    };
+
+    std::vector<Frame> frames;
+    vk::Extent2D extent;
+
+    vkUtil::Buffer cellBuffer {};
+    size_t cellBufferSize { 0 };
+    vkUtil::Buffer brickBuffer {};
+    size_t brickBufferSize { 0 };
+
+    // brick map revision the buffers hold, anything but the one before the map's current needs a full upload
+    bool synced { false };
+    uint64_t uploadedRevision { 0 };
+    size_t uploadedBytes { 0 };
+
+    void destroyTargets();
+    void updateDescriptorSets();
+    bool reserveBuffers(const BrickMap& brickMap);
+    void upload(vk::CommandBuffer commandBuffer, Frame& frame, const BrickMap& brickMap);
+};
+
+}
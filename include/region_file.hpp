@@ -0,0 +1,185 @@
+#pragma once
+#include "async_io.hpp"
+#include "chunk.hpp"
+#include "config.hpp"
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace VoKel {
+
+constexpr int REGION_SIZE_LOG2 { 3 };
+constexpr int REGION_SIZE { 1 << REGION_SIZE_LOG2 };
+constexpr int REGION_CHUNKS { REGION_SIZE * REGION_SIZE * REGION_SIZE };
+constexpr uint32_t REGION_SECTOR_SIZE { 512 };
+
+ChunkCoord chunkToRegion(const ChunkCoord& chunk);
+
+// slot of a chunk inside its region, x | z << 3 | y << 6 like the voxels of a chunk
+uint32_t regionSlot(const ChunkCoord& chunk);
+
+/*
+ * Chunk payload: palette, bits per index and solid count followed by the
+ * packed index words, run-length encoded a word at a time. Decoding writes
+ * straight into the chunk storage, there is no intermediate buffer.
+ */
+void encodeChunk(const Chunk& chunk, std::vector<uint8_t>& out);
+bool decodeChunk(const uint8_t* data, size_t size, Chunk& chunk);
+
+/*
+ * One file holding REGION_SIZE^3 chunks.
+ *
+ * The file starts with two copies of the offset table, each with a sequence
+ * number and a checksum. Payloads live in REGION_SECTOR_SIZE aligned slots
+ * after them and are never overwritten in place: a rewritten chunk goes to
+ * free sectors or the end of the file, the payloads are synced, and only
+ * then the older table copy is replaced by the new table. A crash at any
+ * point leaves at least one complete table pointing at intact payloads.
+ *
+ * Reads go through a read-only memory map of the whole file and may run on
+ * any number of threads, writes are serialized against them.
+ */
+class RegionFile {
+public:
+    struct Entry {
+        uint32_t sector;
+        uint32_t sectorCount;
+        uint32_t size;
+        uint32_t checksum;
+    };
+
+    // opens or creates the file, throws std::runtime_error when it cannot be used
+    explicit RegionFile(const std::filesystem::path& path);
+    ~RegionFile();
+
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    bool contains(uint32_t slot) const;
+
+    // nullptr when the slot is empty or its payload is damaged
+    std::unique_ptr<Chunk> read(uint32_t slot, size_t* payloadSize = nullptr);
+
+    // where a payload lives for reads that bypass the mapping, false when the slot is empty
+    bool locate(uint32_t slot, Entry& entry) const;
+
+    // checks and decodes a payload read elsewhere, nullptr when it does not match the entry
+    static std::unique_ptr<Chunk> decodePayload(const Entry& entry, const uint8_t* data, size_t size);
+
+    // read only handle on the file for the async service, opened on first use
+    uint32_t getIoFile(AsyncIo& io);
+
+    // relocates every chunk, then commits the table once for the whole batch, returns the payload bytes written
+    size_t write(const std::vector<std::pair<uint32_t, const Chunk*>>& chunks);
+
+    uint64_t getFileSize() const { return fileSize; }
+
+private:
+    std::filesystem::path path;
+
+#ifdef _WIN32
+    void* file { nullptr };
+    void* mapping { nullptr };
+#else
+    int file { -1 };
+#endif
+    const uint8_t* mapped { nullptr };
+    uint64_t mappedSize { 0 };
+    uint64_t fileSize { 0 };
+
+    std::array<Entry, REGION_CHUNKS> table {};
+    uint64_t sequence { 0 };
+    std::vector<bool> usedSectors;
+
+    mutable std::shared_mutex mutex;
+
+    AsyncIo* io { nullptr };
+    uint32_t ioFile { AsyncIo::INVALID_FILE };
+    std::mutex ioMutex;
+
+    void openFile();
+    void closeFile();
+    void remap();
+    bool loadTable(uint32_t copy);
+    void commitTable();
+    uint32_t allocateSectors(uint32_t count);
+    void markSectors(const Entry& entry, bool used);
+
+    void writeAt(uint64_t offset, const void* data, size_t size);
+    void sync();
+};
+
+/*
+ * Directory of region files, opened lazily and closed least recently used
+ * first. load is safe to call from the streaming jobs.
+ */
+class RegionStore {
+public:
+    struct Stats {
+        uint64_t chunksRead;
+        uint64_t bytesRead;
+        uint64_t readNanoseconds;
+        uint64_t chunksWritten;
+        uint64_t bytesWritten;
+
+        double chunksPerSecond() const { return readNanoseconds == 0 ? 0.0 : double(chunksRead) * 1e9 / double(readNanoseconds); }
+        double megabytesPerSecond() const { return readNanoseconds == 0 ? 0.0 : double(bytesRead) * 1e3 / double(readNanoseconds); }
+    };
+
+    explicit RegionStore(std::filesystem::path directory, size_t maxOpenRegions = 64);
+
+    std::unique_ptr<Chunk> load(const ChunkCoord& coord);
+
+    /*
+     * Streaming reads go through the async service instead of the mapping so
+     * a cold page never stalls a worker. Payloads land in staging slots
+     * registered with the service, larger ones in their own buffer.
+     */
+    void enableAsync(AsyncIo& io, uint32_t stagingSlots = 64, uint32_t stagingSlotSize = 64 << 10);
+
+    // false when the chunk was never saved, otherwise done runs once on the completion thread
+    bool loadAsync(const ChunkCoord& coord, std::function<void(std::unique_ptr<Chunk> chunk)> done);
+    void save(const std::vector<std::pair<ChunkCoord, const Chunk*>>& chunks);
+
+    // bytes taken by every region file in the directory
+    uint64_t getDiskUsage() const;
+
+    Stats getStats() const;
+    const std::filesystem::path& getDirectory() const { return directory; }
+
+private:
+    std::filesystem::path directory;
+    size_t maxOpenRegions;
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::pair<std::shared_ptr<RegionFile>, uint64_t>> regions;
+
+    // evicted files some reader or writer still holds, reopening one hands back the live object
+    std::unordered_map<uint64_t, std::weak_ptr<RegionFile>> evictedRegions;
+    std::unordered_set<uint64_t> missingRegions;
+    uint64_t useCounter { 0 };
+
+    std::atomic<uint64_t> chunksRead { 0 };
+    std::atomic<uint64_t> bytesRead { 0 };
+    std::atomic<uint64_t> readTime { 0 };
+    std::atomic<uint64_t> chunksWritten { 0 };
+    std::atomic<uint64_t> bytesWritten { 0 };
+
+    AsyncIo* io { nullptr };
+    std::vector<uint8_t> staging;
+    uint32_t stagingSlotSize { 0 };
+    std::vector<uint32_t> freeStagingSlots;
+    std::mutex stagingMutex;
+
+    std::filesystem::path regionPath(const ChunkCoord& region) const;
+    std::shared_ptr<RegionFile> openRegion(const ChunkCoord& region, bool create);
+};
+
+}
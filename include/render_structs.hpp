@@ -3,8 +3,57 @@
 
 namespace vkUtil {
 
-struct ObjectData {
-    glm::mat4 model;
+struct ChunkData {
+    glm::mat4 viewProjection;
+
+    // xyz world position of the chunk origin, w world units per fixed point vertex unit
+    glm::vec4 origin;
+};
+
+struct ChunkFaceTaskData {
+    glm::mat4 viewProjection;
+
+    // as ChunkData
+    glm::vec4 origin;
+
+    // xyz camera position, w unused
+    glm::vec4 eye;
+
+    // x first face of the chunk in the pool's vertex buffer, y its faces
+    glm::uvec4 faces;
+};
+
+struct RaymarchData {
+    glm::mat4 inverseViewProjection;
+
+    // xyz camera position, w distance at which rays give up
+    glm::vec4 camera;
+
+    // brick map window in bricks: first brick, size, and the cell the first brick wraps to
+    glm::ivec4 gridOrigin;
+    glm::ivec4 gridExtent;
+    glm::ivec4 gridWrap;
+};
+
+struct MeshletCullData {
+    // world space frustum planes, inside where dot(xyz, p) + w >= 0
+    glm::vec4 planes[6];
+
+    // xyz camera position, w unused
+    glm::vec4 eye;
+
+    // x meshlets to cull
+    glm::uvec4 counts;
+};
+
+struct MeshletTaskData {
+    glm::mat4 viewProjection;
+
+    // xyz camera position, w unused
+    glm::vec4 eye;
+
+    // x meshlets, y first meshlet of the draw, the task shader takes the frustum from the matrix
+    glm::uvec4 counts;
 };
 
 }
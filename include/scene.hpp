@@ -1,5 +1,19 @@
 #pragma once
+#include "async_io.hpp"
+#include "brick_map.hpp"
+#include "camera.hpp"
+#include "chunk_streamer.hpp"
+#include "chunk_visibility.hpp"
 #include "config.hpp"
+#include "dynamic_bvh.hpp"
+#include "entity_store.hpp"
+#include "job_system.hpp"
+#include "light_propagator.hpp"
+#include "lod.hpp"
+#include "raycast.hpp"
+#include "region_file.hpp"
+#include "terrain_generator.hpp"
+#include "world.hpp"
 
 #include <vector>
 
@@ -7,7 +21,38 @@ namespace VoKel {
 class Scene {
 public:
     Scene();
+    ~Scene();
 
-    std::vector<glm::vec3> trianglePositions;
+    void update();
+
+    // overlay triangles in clip space, mesh 0 is the triangle
+    EntityStore entities;
+
+    // bounds of the entity instances, data is the instance
+    DynamicBvh objects;
+
+    Camera camera;
+    JobSystem jobs;
+    TerrainGenerator terrain;
+    World world;
+    AsyncIo io;
+    RegionStore regions;
+    LightPropagator light;
+    VoxelRaycaster raycaster;
+    BrickMap brickMap;
+    ChunkVisibility visibility;
+    ChunkStreamer streamer;
+    ChunkLodManager lod;
+
+private:
+    // edited chunks that left the world this update, written as one batch per region
+    std::vector<std::pair<ChunkCoord, std::unique_ptr<Chunk>>> unsavedChunks;
+
+    // leaf of every instance in objects
+    std::vector<uint32_t> objectLeaves;
+    uint64_t objectRevision { 0 };
+
+    void saveUnloadedChunks();
+    void updateObjects();
 };
 }
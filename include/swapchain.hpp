@@ -14,6 +14,9 @@ struct SwapchainFrame {
     vk::Image image;
     vk::ImageView imageView;
     vk::Framebuffer framebuffer;
+    vk::Image depthBuffer;
+    vk::DeviceMemory depthBufferMemory;
+    vk::ImageView depthBufferView;
     vk::CommandBuffer commandBuffer;
     vk::Semaphore imageAvailable, renderFinished;
     vk::Fence inFlight;
@@ -32,6 +35,7 @@ vk::SurfaceFormatKHR chooseSwapchainSurfaceFormat(const std::vector<vk::SurfaceF
 
 vk::PresentModeKHR chooseSwapchainPresentMode(const std::vector<vk::PresentModeKHR>& presentModes);
 
-SwapchainBundle createSwapchain(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const uint32_t width, const uint32_t height);
+// at least minImageCount images where the surface allows that many, the driver may still return more
+SwapchainBundle createSwapchain(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const uint32_t width, const uint32_t height, const uint32_t minImageCount = 0);
 
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "isosurface_mesher.hpp"
+#include "job_system.hpp"
+#include "noise.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace VoKel {
+
+// terrain materials, each with a layer of the material atlas
+enum Material : Voxel {
+    MATERIAL_GRASS = 1,
+    MATERIAL_DIRT = 2,
+    MATERIAL_STONE = 3,
+    MATERIAL_SAND = 4,
+
+    // never generated, placed blocks that emit light
+    MATERIAL_LAMP = 5
+};
+
+struct TerrainSettings {
+    uint32_t seed { 1337 };
+
+    float baseHeight { 32.0f };
+    float heightScale { 96.0f };
+    float seaLevel { 8.0f };
+    FbmSettings height { 6, 1.0f / 512.0f, 2.0f, 0.5f, 64.0f, 1.0f / 384.0f };
+
+    // voxels whose cave density exceeds the threshold are carved out
+    FbmSettings caves { 3, 1.0f / 64.0f, 2.0f, 0.5f, 0.0f, 0.0f };
+    float caveThreshold { 0.3f };
+};
+
+/*
+ * Procedural terrain: a domain warped fBm heightmap for the surface and a
+ * 3D fBm density carving caves below it. Noise is evaluated in batches with
+ * the widest instruction set available, the output does not depend on the
+ * instruction set nor on the thread generating a chunk.
+ */
+class TerrainGenerator {
+public:
+    explicit TerrainGenerator(TerrainSettings settings = {}, SimdLevel simdLevel = VoKel::getSimdLevel());
+
+    // thread safe, matches World::Generator
+    void generate(Chunk& chunk, const ChunkCoord& coord, uint32_t lod) const;
+
+    /*
+     * Signed density on the voxel corners for the smooth mesher, the height
+     * above the surface cut by the caves. Both are roughly distances in
+     * voxels, and a point gets the same value at every level of detail, so
+     * coarse samples coincide with the fine ones below them.
+     */
+    void generateDensity(DensityField& field, const ChunkCoord& coord, uint32_t lod) const;
+
+    std::vector<std::unique_ptr<Chunk>> generateChunks(JobSystem& jobs, const std::vector<ChunkCoord>& coords, uint32_t lod) const;
+
+    struct Stats {
+        uint64_t chunks;
+
+        // summed over every generating thread
+        uint64_t nanoseconds;
+
+        double chunksPerSecondPerCore() const { return nanoseconds == 0 ? 0.0 : double(chunks) * 1e9 / double(nanoseconds); }
+    };
+
+    Stats getStats() const { return { generatedChunks.load(), generationTime.load() }; }
+    SimdLevel getSimdLevel() const { return simdLevel; }
+    const TerrainSettings& getSettings() const { return settings; }
+
+private:
+    TerrainSettings settings;
+    SimdLevel simdLevel;
+
+    mutable std::atomic<uint64_t> generatedChunks { 0 };
+    mutable std::atomic<uint64_t> generationTime { 0 };
+};
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Two level segregated fit allocator over a range of offsets, for memory the
+ * cpu never writes headers into, like the ranges of a gpu buffer.
+ *
+ * Free ranges are binned by size, a first level per power of two split into
+ * sixteen linear second level classes, with a bitmap over each level, so
+ * finding a free range that fits and freeing one with its neighbors merged
+ * are a few bit scans and list updates whatever the number of ranges. The
+ * request is rounded up to the next class first, any range of that class
+ * fits, which keeps the waste under one class width. Range records live in
+ * an array and their indices are the allocation handles.
+ */
+class TlsfAllocator {
+public:
+    static constexpr uint32_t NO_ALLOCATION { ~0u };
+
+    explicit TlsfAllocator(uint64_t capacity = 0);
+
+    // NO_ALLOCATION when no free range fits, grow and try again
+    uint32_t allocate(uint64_t size, uint64_t alignment = 1);
+    void free(uint32_t allocation);
+
+    // appends free space at the end, offsets of the allocations stay put
+    void grow(uint64_t capacity);
+
+    uint64_t getOffset(uint32_t allocation) const { return blocks[allocation].offset; }
+    uint64_t getSize(uint32_t allocation) const { return blocks[allocation].size; }
+
+    uint64_t getCapacity() const { return capacity; }
+    uint64_t getUsedSize() const { return used; }
+    uint64_t getLargestFreeSize() const;
+
+    // share of the free space outside the largest free range, 0 while it is all one range
+    float getFragmentation() const;
+
+    // allocation ending highest, moving these down first compacts the range
+    uint32_t getLastAllocation() const;
+
+private:
+    static constexpr int SECOND_LEVEL_BITS { 4 };
+    static constexpr int SECOND_LEVEL_COUNT { 1 << SECOND_LEVEL_BITS };
+    static constexpr int FIRST_LEVEL_COUNT { 64 - SECOND_LEVEL_BITS + 1 };
+
+    struct Block {
+        uint64_t offset;
+        uint64_t size;
+
+        // neighbors by offset
+        uint32_t previous;
+        uint32_t next;
+
+        // list of the size class while free, unused records chain through nextFree
+        uint32_t previousFree;
+        uint32_t nextFree;
+
+        bool free;
+    };
+
+    std::vector<Block> blocks;
+    uint32_t unusedBlocks { NO_ALLOCATION };
+    uint32_t lastBlock { NO_ALLOCATION };
+
+    uint64_t capacity { 0 };
+    uint64_t used { 0 };
+
+    uint64_t firstLevelBitmap { 0 };
+    std::array<uint32_t, FIRST_LEVEL_COUNT> secondLevelBitmaps {};
+    std::array<std::array<uint32_t, SECOND_LEVEL_COUNT>, FIRST_LEVEL_COUNT> freeLists;
+
+    static void mapping(uint64_t size, int& firstLevel, int& secondLevel);
+
+    uint32_t newBlock();
+    void recycleBlock(uint32_t block);
+
+    // splits the block after size units, returns the new block holding the rest
+    uint32_t split(uint32_t block, uint64_t size);
+
+    // absorbs the next block, which has to be free and out of its list
+    void merge(uint32_t block);
+
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    uint32_t findFree(uint64_t size) const;
+};
+
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "noise.hpp"
+
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Transform composition kernels, shared by the scalar and the SIMD code
+ * paths. Like noise.hpp this header stays free of config.hpp, it is compiled
+ * with -msse4.1 / -mavx2 as well.
+ */
+
+namespace VoKel {
+
+/*
+ * Positions, rotations and scales as separate arrays, one per component, so a
+ * group of entities loads with plain vector loads. Rotations are unit
+ * quaternions x, y, z, w. Every entity gets a column major 4x4 matrix of
+ * translation * rotation * scale, 16 floats at matrices + 16 * index.
+ */
+struct TransformBatch {
+    const float* position[3];
+    const float* rotation[4];
+    const float* scale[3];
+    size_t first;
+    size_t count;
+
+    float* matrices;
+};
+
+// safe to call from several threads on separate ranges
+void composeTransforms(const TransformBatch& batch, SimdLevel level);
+
+namespace transform {
+
+    /*
+     * Kernels written against a small vector interface V:
+     *
+     *   V::F          float lanes, V::WIDTH lanes each
+     *   load, store   float lanes from and to memory
+     *   set           every lane the same value
+     *   add, sub, mul lane wise arithmetic
+     *
+     * A group of entities is composed in registers, the twelve varying
+     * matrix entries are stored to a small buffer a lane per entity, and
+     * each entity's matrix is assembled from it and copied out whole.
+     */
+
+    // one entity, also the tail of the vector paths
+    inline void composeOne(const TransformBatch& batch, size_t i)
+    {
+        float x = batch.rotation[0][i];
+        float y = batch.rotation[1][i];
+        float z = batch.rotation[2][i];
+        float w = batch.rotation[3][i];
+        float sx = batch.scale[0][i];
+        float sy = batch.scale[1][i];
+        float sz = batch.scale[2][i];
+
+        float* m = batch.matrices + 16 * i;
+        m[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+        m[1] = 2.0f * (x * y + z * w) * sx;
+        m[2] = 2.0f * (x * z - y * w) * sx;
+        m[3] = 0.0f;
+        m[4] = 2.0f * (x * y - z * w) * sy;
+        m[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+        m[6] = 2.0f * (y * z + x * w) * sy;
+        m[7] = 0.0f;
+        m[8] = 2.0f * (x * z + y * w) * sz;
+        m[9] = 2.0f * (y * z - x * w) * sz;
+        m[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+        m[11] = 0.0f;
+        m[12] = batch.position[0][i];
+        m[13] = batch.position[1][i];
+        m[14] = batch.position[2][i];
+        m[15] = 1.0f;
+    }
+
+    template <typename V>
+    inline void runComposeTransforms(const TransformBatch& batch)
+    {
+        constexpr size_t W { V::WIDTH };
+
+        using F = typename V::F;
+
+        // matrix entries of the upper three rows, in column major order
+        constexpr int ENTRIES[12] { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14 };
+
+        const F one = V::set(1.0f);
+        const F two = V::set(2.0f);
+
+        size_t i { batch.first };
+        size_t end { batch.first + batch.count };
+
+        for (; i + W <= end; i += W) {
+            F x = V::load(batch.rotation[0] + i);
+            F y = V::load(batch.rotation[1] + i);
+            F z = V::load(batch.rotation[2] + i);
+            F w = V::load(batch.rotation[3] + i);
+            F sx = V::load(batch.scale[0] + i);
+            F sy = V::load(batch.scale[1] + i);
+            F sz = V::load(batch.scale[2] + i);
+
+            F xx = V::mul(x, x);
+            F yy = V::mul(y, y);
+            F zz = V::mul(z, z);
+            F xy = V::mul(x, y);
+            F xz = V::mul(x, z);
+            F yz = V::mul(y, z);
+            F xw = V::mul(x, w);
+            F yw = V::mul(y, w);
+            F zw = V::mul(z, w);
+
+            alignas(32) float lanes[12][W];
+            V::store(lanes[0], V::mul(V::sub(one, V::mul(two, V::add(yy, zz))), sx));
+            V::store(lanes[1], V::mul(V::mul(two, V::add(xy, zw)), sx));
+            V::store(lanes[2], V::mul(V::mul(two, V::sub(xz, yw)), sx));
+            V::store(lanes[3], V::mul(V::mul(two, V::sub(xy, zw)), sy));
+            V::store(lanes[4], V::mul(V::sub(one, V::mul(two, V::add(xx, zz))), sy));
+            V::store(lanes[5], V::mul(V::mul(two, V::add(yz, xw)), sy));
+            V::store(lanes[6], V::mul(V::mul(two, V::add(xz, yw)), sz));
+            V::store(lanes[7], V::mul(V::mul(two, V::sub(yz, xw)), sz));
+            V::store(lanes[8], V::mul(V::sub(one, V::mul(two, V::add(xx, yy))), sz));
+            V::store(lanes[9], V::load(batch.position[0] + i));
+            V::store(lanes[10], V::load(batch.position[1] + i));
+            V::store(lanes[11], V::load(batch.position[2] + i));
+
+            // whole matrices at once, the compiler turns the copy into vector stores
+            for (size_t lane { 0 }; lane < W; lane++) {
+                float m[16] { 0.0f };
+                for (int e { 0 }; e < 12; e++) {
+                    m[ENTRIES[e]] = lanes[e][lane];
+                }
+                m[15] = 1.0f;
+                std::memcpy(batch.matrices + 16 * (i + lane), m, sizeof(m));
+            }
+        }
+
+        for (; i < end; i++) {
+            composeOne(batch, i);
+        }
+    }
+
+    void composeTransformsSse4(const TransformBatch& batch);
+    void composeTransformsAvx2(const TransformBatch& batch);
+
+}
+
+}
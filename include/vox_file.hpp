@@ -0,0 +1,112 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * MagicaVoxel .vox file.
+ *
+ * Opening the file walks its chunk headers once. Model sizes, the palette,
+ * layers and the transform, group and shape nodes of the scene graph are
+ * parsed, the voxel payloads are only located. Voxels are read later a slice
+ * at a time, so the file never has to fit in memory.
+ *
+ * The scene graph is flattened into one instance per placed model, hidden
+ * nodes and layers are skipped and only the first animation frame is used.
+ * Files without a scene graph place every model at the origin.
+ */
+class VoxFile {
+public:
+    struct Model {
+        // MagicaVoxel axes, z up
+        glm::ivec3 size;
+        uint64_t voxelOffset;
+        uint32_t voxelCount;
+    };
+
+    struct Instance {
+        uint32_t model;
+
+        // rows of the rotation and the translation of the model center, MagicaVoxel axes
+        std::array<glm::ivec3, 3> rotation;
+        glm::ivec3 translation;
+    };
+
+    // throws std::runtime_error when the file cannot be read or is not a valid .vox file
+    explicit VoxFile(const std::filesystem::path& path);
+
+    const std::vector<Model>& getModels() const { return models; }
+    const std::vector<Instance>& getInstances() const { return instances; }
+
+    // rgba, r in the low byte, entry 0 is unused, files without one get a grey ramp
+    const std::array<uint32_t, 256>& getPalette() const { return palette; }
+
+    // raw voxels of a model, x | y << 8 | z << 16 | color index << 24
+    void readVoxels(const Model& model, uint32_t first, uint32_t count, std::vector<uint32_t>& out);
+
+    // world voxel of a model voxel, converted to y up
+    static glm::ivec3 place(const Model& model, const Instance& instance, const glm::ivec3& voxel);
+
+private:
+    std::ifstream file;
+    uint64_t fileSize;
+
+    std::vector<Model> models;
+    std::vector<Instance> instances;
+    std::array<uint32_t, 256> palette;
+};
+
+/*
+ * Streams .vox files into the world.
+ *
+ * Voxels are read in batches of a bounded size, placed, sorted by chunk and
+ * written into the chunks in parallel through World::editChunks, there is
+ * never a dense grid of the model. Chunks are loaded or generated first, so
+ * the import is merged into whatever is already there, and they are marked
+ * unsaved like any other edit.
+ */
+class VoxImporter {
+public:
+    struct Stats {
+        uint32_t models;
+        uint32_t instances;
+        uint64_t voxels;
+        uint64_t chunkEdits;
+        size_t batchBytes;
+        double parseSeconds;
+        double seconds;
+    };
+
+    VoxImporter(World& world, JobSystem& jobs);
+
+    // palette color index to material, defaults to the closest built-in material color
+    void setMaterials(const std::array<Voxel, 256>& materials) { this->materials = materials; customMaterials = true; }
+
+    // voxels read per batch, bounds the memory used by an import
+    void setBatchSize(size_t voxels) { batchSize = std::max<size_t>(voxels, 1); }
+
+    // places the file with its origin at the given voxel, throws std::runtime_error on unreadable files
+    Stats import(const std::filesystem::path& path, const glm::ivec3& position);
+
+    // closest of the built-in materials for every palette color, by the base color of their texture
+    static std::array<Voxel, 256> matchPalette(const std::array<uint32_t, 256>& palette);
+
+private:
+    World& world;
+    JobSystem& jobs;
+
+    std::array<Voxel, 256> materials {};
+    bool customMaterials { false };
+    size_t batchSize { 1 << 20 };
+};
+
+}
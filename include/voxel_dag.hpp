@@ -0,0 +1,88 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "raycast.hpp"
+#include "world.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace VoKel {
+
+// edge of the leaf nodes, a leaf holds 4x4x4 voxels
+constexpr int DAG_LEAF_SIZE_LOG2 { 2 };
+constexpr int DAG_LEAF_SIZE { 1 << DAG_LEAF_SIZE_LOG2 };
+
+/*
+ * Sparse voxel octree of a static block of chunks with identical subtrees
+ * merged, which turns it into a directed acyclic graph. Terrain, scans and
+ * imported models repeat the same solid, empty and surface patterns all over,
+ * so the graph is usually a small fraction of the palette chunks.
+ *
+ * Every node is a run of 32-bit words in one array, the root first:
+ *  - inner nodes: child mask in the low 8 bits, then one absolute word offset
+ *    per present child in octant order, octant = x | z << 1 | y << 2
+ *  - leaves, 4x4x4 voxels: a 64-bit occupancy mask in two words, then one
+ *    byte per solid voxel in mask order, four to a word, voxel x | z << 2 | y << 4
+ * The depth of a node tells it apart, leaves sit at the bottom level. Missing
+ * children are all air. Materials above 255 are clamped.
+ *
+ * Chunks are turned into subtrees in parallel, then merged level by level into
+ * the shared graph, hashing every node against the ones already stored. The
+ * same layout is walked by shaders/dag_trace.comp.
+ */
+class SparseVoxelDag {
+public:
+    // returns the chunk at the coordinate, the scratch chunk after filling it, or nullptr for air
+    using Source = std::function<const Chunk*(const ChunkCoord& coord, Chunk& scratch)>;
+
+    struct Stats {
+        // voxels of the built block and the solid ones among them
+        uint64_t voxels;
+        uint64_t solidVoxels;
+
+        // words the octree would take without merging, and the graph
+        uint64_t treeWords;
+        uint64_t words;
+        uint64_t nodes;
+        uint64_t leaves;
+
+        double buildSeconds;
+
+        size_t bytes() const { return size_t(words) * sizeof(uint32_t); }
+        double bitsPerVoxel() const { return voxels == 0 ? 0.0 : double(bytes()) * 8.0 / double(voxels); }
+        double bitsPerSolidVoxel() const { return solidVoxels == 0 ? 0.0 : double(bytes()) * 8.0 / double(solidVoxels); }
+    };
+
+    SparseVoxelDag() = default;
+
+    // builds the block of chunks starting at first, the graph covers the next power of two cube
+    void build(JobSystem& jobs, const ChunkCoord& first, const glm::ivec3& chunkCount, const Source& source);
+    void build(JobSystem& jobs, const World& world, const ChunkCoord& first, const glm::ivec3& chunkCount);
+
+    Voxel getVoxel(const glm::ivec3& voxel) const;
+
+    // first solid voxel along the ray, faces and distances like VoxelRaycaster
+    RayHit cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+    // first voxel covered by the graph and the edge of the covered cube
+    glm::ivec3 getOrigin() const { return origin; }
+    int getSize() const { return 1 << sizeLog2; }
+
+    // levels above the leaves
+    int getDepth() const { return sizeLog2 - DAG_LEAF_SIZE_LOG2; }
+
+    // empty when everything is air
+    const std::vector<uint32_t>& getNodes() const { return nodes; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    glm::ivec3 origin { 0 };
+    int sizeLog2 { DAG_LEAF_SIZE_LOG2 };
+
+    std::vector<uint32_t> nodes;
+    Stats stats {};
+};
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "chunk.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+#include "world.hpp"
+
+#include <vector>
+
+namespace VoKel {
+
+/*
+ * Turns triangle meshes into voxels of the world, for imports and for
+ * carving when the material is AIR.
+ *
+ * The surface is conservative: every voxel a triangle touches is set, found
+ * with the separating axis test of the triangle against the voxel box.
+ * Triangles are binned into the chunks their bounds overlap by per-thread
+ * lists, then every chunk is rasterized by one job into its own bitset, so
+ * no two threads ever write the same memory.
+ *
+ * The interior can be filled by parity, counting the crossings of a vertical
+ * ray through every voxel column, which needs a closed mesh but no extra
+ * memory beyond the chunks it fills, or by flood filling the outside of the
+ * surface in a bit grid over the mesh bounds, which tolerates overlapping
+ * and self intersecting shells as long as the surface has no holes.
+ */
+class MeshVoxelizer {
+public:
+    enum class Fill {
+        Surface,
+        Parity,
+        FloodFill
+    };
+
+    struct Stats {
+        uint32_t triangles;
+        uint64_t surfaceVoxels;
+        uint64_t interiorVoxels;
+        uint32_t chunks;
+
+        double surfaceSeconds;
+        double fillSeconds;
+        double writeSeconds;
+        double seconds;
+
+        double trianglesPerSecond() const { return surfaceSeconds > 0.0 ? triangles / surfaceSeconds : 0.0; }
+        double voxelsPerSecond() const { return seconds > 0.0 ? double(surfaceVoxels + interiorVoxels) / seconds : 0.0; }
+    };
+
+    MeshVoxelizer(World& world, JobSystem& jobs);
+
+    MeshVoxelizer(const MeshVoxelizer&) = delete;
+    MeshVoxelizer& operator=(const MeshVoxelizer&) = delete;
+
+    // indexed triangle list, transform maps the positions to voxel units in world space
+    Stats voxelize(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& transform, Voxel material, Fill fill);
+
+    // flood fills need a bit per voxel of the bounds, larger meshes throw std::runtime_error
+    void setFloodFillLimit(uint64_t voxels) { floodFillLimit = voxels; }
+
+private:
+    World& world;
+    JobSystem& jobs;
+
+    uint64_t floodFillLimit { uint64_t(1) << 33 };
+};
+
+}
@@ -52,6 +52,11 @@ public:
 
     void processInput();
 
+    bool isKeyDown(SDL_Scancode key)
+    {
+        return SDL_GetKeyboardState(nullptr)[key] != 0;
+    }
+
 private:
     SDL_Window* window;
     int width, height;
@@ -0,0 +1,123 @@
+#pragma once
+#include "chunk.hpp"
+#include "chunk_map.hpp"
+#include "config.hpp"
+#include "job_system.hpp"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace VoKel {
+
+constexpr uint32_t MAX_LOD_LEVELS { 8 };
+
+/*
+ * Downsample eight children of a chunk (ordered x | y << 1 | z << 2) into a
+ * single chunk at half resolution. A 2x2x2 block becomes solid when at least
+ * half of it is solid and takes its most common solid material.
+ * Missing children are treated as air.
+ */
+void downsampleChunk(const std::array<const Chunk*, 8>& children, Chunk& out);
+
+class World {
+public:
+    // fill a chunk covering CHUNK_SIZE << lod voxels per axis, sampled every 1 << lod voxels, must be thread safe
+    using Generator = std::function<void(Chunk& chunk, const ChunkCoord& coord, uint32_t lod)>;
+
+    // saved chunks, nullptr when the chunk was never stored
+    using Loader = std::function<std::unique_ptr<Chunk>(const ChunkCoord& coord)>;
+
+    // told about every resident chunk coming and going, chunk is nullptr when it left
+    using ChunkHandler = std::function<void(const ChunkCoord& coord, const Chunk* chunk)>;
+
+    // told about every voxel setVoxel changed, after the change
+    using EditHandler = std::function<void(const glm::ivec3& voxel, Voxel previous, Voxel value)>;
+
+    World() = default;
+
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    void setGenerator(Generator generator) { this->generator = std::move(generator); }
+    const Generator& getGenerator() const { return generator; }
+
+    void setLoader(Loader loader) { this->loader = std::move(loader); }
+    void setChunkHandler(ChunkHandler handler) { chunkHandler = std::move(handler); }
+    void setEditHandler(EditHandler handler) { editHandler = std::move(handler); }
+
+    Chunk* getChunk(const ChunkCoord& coord);
+    const Chunk* getChunk(const ChunkCoord& coord) const;
+
+    // resident chunks of the 3x3x3 block around coord in ChunkMap neighborhood order, nullptr where missing
+    std::array<const Chunk*, 27> getNeighborhood(const ChunkCoord& coord) const;
+
+    // returns the resident chunk, loads or generates it otherwise
+    Chunk& loadChunk(const ChunkCoord& coord);
+    Chunk& insertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk);
+    void removeChunk(const ChunkCoord& coord);
+
+    // takes a resident chunk out of the world, nullptr when it is not resident
+    std::unique_ptr<Chunk> releaseChunk(const ChunkCoord& coord);
+
+    Voxel getVoxel(const glm::ivec3& voxel) const;
+    void setVoxel(const glm::ivec3& voxel, Voxel value);
+
+    /*
+     * Bulk edits, for imports and other writes too large for setVoxel.
+     * Loads every chunk, runs the edit on each of them in parallel, then
+     * reports them to the chunk handler as if they were inserted again, the
+     * edit handler is not called. Coordinates must be distinct.
+     */
+    void editChunks(const std::vector<ChunkCoord>& coords, JobSystem& jobs, const std::function<void(uint32_t index, Chunk& chunk)>& edit);
+
+    /*
+     * Voxel data for a chunk at the given level of detail.
+     * Level 0 is the resident chunk itself, coarser levels are downsampled from
+     * their children when all of them are available and generated directly
+     * otherwise. Results are cached until an edit invalidates them.
+     */
+    const Chunk* getLodChunk(const ChunkCoord& coord, uint32_t lod);
+
+    // generate every requested chunk that getLodChunk would generate, in parallel
+    void prefetchLodChunks(const std::vector<std::pair<ChunkCoord, uint32_t>>& requests, JobSystem& jobs);
+
+    // drop cached coarse chunks the predicate rejects, keeps the cache bounded while the camera travels
+    void pruneLodCache(const std::function<bool(const ChunkCoord& coord, uint32_t lod)>& keep);
+
+    // chunks touched by setVoxel since the last call, used to schedule remeshing
+    std::vector<ChunkCoord> takeModifiedChunks();
+
+    // true once per edited chunk until it is saved, generated chunks never need saving
+    bool takeUnsaved(const ChunkCoord& coord) { return unsavedChunks.erase(packChunkCoord(coord)) > 0; }
+
+    size_t getChunkCount() const { return chunks.size(); }
+
+    template <typename Function>
+    void forEachChunk(Function&& function)
+    {
+        chunks.forEach([&function](uint64_t key, std::unique_ptr<Chunk>& chunk) {
+            function(unpackChunkCoord(key), *chunk);
+        });
+    }
+
+private:
+    Generator generator;
+    Loader loader;
+    ChunkHandler chunkHandler;
+    EditHandler editHandler;
+
+    ChunkMap<std::unique_ptr<Chunk>> chunks;
+    std::array<std::unordered_map<uint64_t, std::unique_ptr<Chunk>>, MAX_LOD_LEVELS> lodCache;
+    std::array<std::unordered_set<uint64_t>, MAX_LOD_LEVELS> editedLod;
+    std::vector<ChunkCoord> modifiedChunks;
+    std::unordered_set<uint64_t> unsavedChunks;
+
+    const Chunk* findLodChunk(const ChunkCoord& coord, uint32_t lod) const;
+    bool hasAllChildren(const ChunkCoord& coord, uint32_t lod) const;
+    void invalidateLod(const ChunkCoord& coord);
+};
+
+}
@@ -0,0 +1,44 @@
+#version 460 core
+
+// one layer per material index, see MaterialAtlas
+layout(set = 0, binding = 0) uniform sampler2DArray materials;
+
+layout(location = 0) in float fragLight;
+layout(location = 1) in vec3 fragPosition;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) flat in uint fragMaterial;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    // unknown materials show layer 0, the missing texture checker
+    uint layers = uint(textureSize(materials, 0).z);
+    float layer = float(fragMaterial < layers ? fragMaterial : 0u);
+
+    // a texture per world unit, projected along each axis and blended by the normal, blocky faces only ever take one
+    vec2 uvX = vec2(fragPosition.z, -fragPosition.y);
+    vec2 uvY = fragPosition.xz;
+    vec2 uvZ = vec2(fragPosition.x, -fragPosition.y);
+
+    vec3 weights = pow(abs(fragNormal), vec3(4.0));
+    weights /= weights.x + weights.y + weights.z;
+
+    // derivatives taken up front, the branches below are not uniform
+    vec4 gradX = vec4(dFdx(uvX), dFdy(uvX));
+    vec4 gradY = vec4(dFdx(uvY), dFdy(uvY));
+    vec4 gradZ = vec4(dFdx(uvZ), dFdy(uvZ));
+
+    vec3 albedo = vec3(0.0);
+    if (weights.x > 0.01) {
+        albedo += weights.x * textureGrad(materials, vec3(uvX, layer), gradX.xy, gradX.zw).rgb;
+    }
+    if (weights.y > 0.01) {
+        albedo += weights.y * textureGrad(materials, vec3(uvY, layer), gradY.xy, gradY.zw).rgb;
+    }
+    if (weights.z > 0.01) {
+        albedo += weights.z * textureGrad(materials, vec3(uvZ, layer), gradZ.xy, gradZ.zw).rgb;
+    }
+
+    outColor = vec4(albedo * fragLight, 1.0);
+}
@@ -0,0 +1,72 @@
+#version 460 core
+
+// the chunk mesh pool's vertex buffer, three words per ChunkVertex: x and y, z and the normal, the attributes
+layout(std430, set = 1, binding = 0) readonly buffer Vertices
+{
+    uint vertices[];
+};
+
+layout(push_constant) uniform constants
+{
+    mat4 viewProjection;
+    vec4 origin;
+}
+ChunkData;
+
+layout(location = 0) out float fragLight;
+layout(location = 1) out vec3 fragPosition;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) flat out uint fragMaterial;
+
+const vec3 faceNormals[6] = vec3[](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+// smooth meshes store an octahedral normal with the sign bit set
+vec3 decodeNormal(int packed)
+{
+    if (packed >= 0) {
+        return faceNormals[packed];
+    }
+
+    vec2 p = vec2(packed & 0x7f, (packed >> 7) & 0x7f) / 127.0 * 2.0 - 1.0;
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x < 0.0 ? -1.0 : 1.0, n.y < 0.0 ? -1.0 : 1.0);
+    }
+    return normalize(n);
+}
+
+// ambient occlusion level 0 is the darkest corner, 3 is fully open
+const float aoCurve[4] = float[](0.45, 0.65, 0.82, 1.0);
+
+void main()
+{
+    // the index buffer's indices plus the draw's vertex offset
+    uint word = uint(gl_VertexIndex) * 3;
+    uint xy = vertices[word];
+    uint zn = vertices[word + 1];
+    uint vertexAttributes = vertices[word + 2];
+
+    // 16 bit halves sign extended by the arithmetic shifts
+    ivec4 vertexPosition = ivec4(int(xy << 16) >> 16, int(xy) >> 16, int(zn << 16) >> 16, int(zn) >> 16);
+
+    uint material = vertexAttributes & 0xffffu;
+    uint ao = (vertexAttributes >> 16) & 0x3u;
+    float sky = float((vertexAttributes >> 18) & 0xfu) / 15.0;
+    float block = float((vertexAttributes >> 22) & 0xfu) / 15.0;
+    vec3 normal = decodeNormal(vertexPosition.w);
+
+    float sun = 0.55 + 0.45 * max(dot(normal, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+    float light = max(max(sky * sun, block), 0.04);
+
+    vec3 position = ChunkData.origin.xyz + vec3(vertexPosition.xyz) * ChunkData.origin.w;
+
+    fragLight = light * aoCurve[ao];
+    fragPosition = position;
+    fragNormal = normal;
+    fragMaterial = material;
+
+    gl_Position = ChunkData.viewProjection * vec4(position, 1.0);
+}
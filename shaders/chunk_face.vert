@@ -0,0 +1,95 @@
+#version 460 core
+
+// the chunk mesh pool's vertex buffer, three words per ChunkFace: the geometry, the attributes, the light
+layout(std430, set = 1, binding = 0) readonly buffer Faces
+{
+    uint faces[];
+};
+
+layout(push_constant) uniform constants
+{
+    mat4 viewProjection;
+    vec4 origin;
+}
+ChunkData;
+
+layout(location = 0) out float fragLight;
+layout(location = 1) out vec3 fragPosition;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) flat out uint fragMaterial;
+
+const vec3 faceNormals[6] = vec3[](
+    vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, -1.0));
+
+// quad corner order, (-u, -v), (+u, -v), (+u, +v), (-u, +v)
+const ivec2 cornerOffsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(1, 1), ivec2(0, 1));
+
+// the corners of the two triangles, negative faces wind the other way
+const uint positiveCorners[6] = uint[](0u, 1u, 2u, 0u, 2u, 3u);
+const uint negativeCorners[6] = uint[](0u, 2u, 1u, 0u, 3u, 2u);
+
+// faces are in whole voxels, the origin's scale is per fixed point unit of ChunkVertex
+const float CHUNK_VERTEX_SCALE = 256.0;
+
+// ambient occlusion level 0 is the darkest corner, 3 is fully open
+const float aoCurve[4] = float[](0.45, 0.65, 0.82, 1.0);
+
+uint cornerAo(uint attributes, uint corner)
+{
+    return (attributes >> (16 + 2 * corner)) & 0x3u;
+}
+
+void main()
+{
+    // six vertices per face starting at the draw's first vertex
+    uint face = uint(gl_VertexIndex) / 6;
+    uint vertex = uint(gl_VertexIndex) % 6;
+
+    uint geometry = faces[face * 3];
+    uint attributes = faces[face * 3 + 1];
+    uint faceLight = faces[face * 3 + 2];
+
+    int u0 = int(geometry & 0x1fu);
+    int v0 = int((geometry >> 5) & 0x1fu);
+    int slice = int((geometry >> 10) & 0x1fu);
+    int direction = int((geometry >> 15) & 0x7u);
+    int width = int((geometry >> 18) & 0x1fu) + 1;
+    int height = int((geometry >> 23) & 0x1fu) + 1;
+
+    int axis = direction / 2;
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    bool positive = (direction & 1) == 0;
+
+    // split along the brighter diagonal so a single dark corner does not bleed across the quad
+    bool flip = cornerAo(attributes, 0) + cornerAo(attributes, 2) < cornerAo(attributes, 1) + cornerAo(attributes, 3);
+    uint corner = positive ? positiveCorners[vertex] : negativeCorners[vertex];
+    if (flip) {
+        corner = (corner + 1) & 0x3u;
+    }
+
+    ivec3 local = ivec3(0);
+    local[axis] = slice + (positive ? 1 : 0);
+    local[u] = u0 + cornerOffsets[corner].x * width;
+    local[v] = v0 + cornerOffsets[corner].y * height;
+
+    uint material = attributes & 0xffffu;
+    uint ao = cornerAo(attributes, corner);
+    float sky = float((faceLight >> (4 * corner)) & 0xfu) / 15.0;
+    float block = float((faceLight >> (16 + 4 * corner)) & 0xfu) / 15.0;
+    vec3 normal = faceNormals[direction];
+
+    float sun = 0.55 + 0.45 * max(dot(normal, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+    float light = max(max(sky * sun, block), 0.04);
+
+    vec3 position = ChunkData.origin.xyz + vec3(local) * CHUNK_VERTEX_SCALE * ChunkData.origin.w;
+
+    fragLight = light * aoCurve[ao];
+    fragPosition = position;
+    fragNormal = normal;
+    fragMaterial = material;
+
+    gl_Position = ChunkData.viewProjection * vec4(position, 1.0);
+}
@@ -1,18 +1,24 @@
 #version 460 core
 
-layout(location = 0) in vec2 vertexPosition;
-layout(location = 1) in vec3 vertexColor;
+// five floats per vertex, the position and the color
+layout(std430, set = 0, binding = 0) readonly buffer Vertices
+{
+    float vertices[];
+};
 
-layout(push_constant) uniform constants
+// per instance, written by the entity store
+layout(std430, set = 0, binding = 1) readonly buffer Instances
 {
-    mat4 model;
-}
-ObjectData;
+    mat4 models[];
+};
 
 layout(location = 0) out vec3 fragColor;
 
 void main()
 {
-    fragColor = vertexColor;
-    gl_Position = ObjectData.model * vec4(vertexPosition, 0.0, 1.0);
-}
\ No newline at end of file
+    uint word = uint(gl_VertexIndex) * 5;
+    vec2 vertexPosition = vec2(vertices[word], vertices[word + 1]);
+
+    fragColor = vec3(vertices[word + 2], vertices[word + 3], vertices[word + 4]);
+    gl_Position = models[gl_InstanceIndex] * vec4(vertexPosition, 0.0, 1.0);
+}
@@ -0,0 +1,49 @@
+#version 460 core
+
+// octahedral normal in two snorm16
+struct Vertex {
+    vec3 position;
+    uint normal;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Vertices
+{
+    Vertex vertices[];
+};
+
+// per mesh instance, selected by the first instance of the meshlet's draw
+layout(std430, set = 0, binding = 1) readonly buffer Transforms
+{
+    mat4 models[];
+};
+
+layout(push_constant) uniform constants
+{
+    mat4 viewProjection;
+}
+MeshletData;
+
+layout(location = 0) out vec3 fragColor;
+
+vec3 decodeNormal(uint packed)
+{
+    vec2 p = unpackSnorm2x16(packed);
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x < 0.0 ? -1.0 : 1.0, n.y < 0.0 ? -1.0 : 1.0);
+    }
+    return normalize(n);
+}
+
+void main()
+{
+    // the index buffer holds the vertex of every meshlet corner
+    Vertex vertex = vertices[gl_VertexIndex];
+    mat4 model = models[gl_InstanceIndex];
+
+    vec3 normal = normalize(mat3(model) * decodeNormal(vertex.normal));
+    float sun = 0.35 + 0.65 * max(dot(normal, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+
+    fragColor = vec3(0.78, 0.74, 0.68) * sun;
+    gl_Position = MeshletData.viewProjection * model * vec4(vertex.position, 1.0);
+}
@@ -1,7 +1,17 @@
 #include "app.hpp"
+#include "asset_pack.hpp"
+#include "mesh_import.hpp"
+#include "meshlet_builder.hpp"
+#include "obj_file.hpp"
 #include "scene.hpp"
+#include "vox_file.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
 #include <sstream>
+#include <string>
 #include <stdint.h>
 
 App::App(int width, int height)
@@ -9,6 +19,102 @@ App::App(int width, int height)
     , graphicEngine { width, height, window }
     , scene {}
 {
+    // VOKEL_RENDERER=raymarch starts in the raymarcher, R switches between the two
+    const char* renderer = std::getenv("VOKEL_RENDERER");
+    if (renderer != nullptr && std::string(renderer) == "raymarch") {
+        setRenderMode(VoKel::Engine::RenderMode::Raymarch);
+    }
+
+    // VOKEL_GEOMETRY=mesh draws voxel faces and meshlets with task and mesh shaders where the device has them, M switches back and forth
+    const char* geometry = std::getenv("VOKEL_GEOMETRY");
+    if (geometry != nullptr && std::string(geometry) == "mesh" && !graphicEngine.setMeshShading(true)) {
+        std::cout << "Mesh shaders unavailable, drawing with vertex shaders\n";
+    }
+
+    // VOKEL_MESHER=gpu meshes voxel nodes in a compute shader, VOKEL_MESHER=verify also checks each mesh against the cpu mesher
+    const char* mesher = std::getenv("VOKEL_MESHER");
+    if (mesher != nullptr && (std::string(mesher) == "gpu" || std::string(mesher) == "verify")) {
+        scene.lod.setGpuMeshing(true);
+        graphicEngine.setGpuMeshVerification(std::string(mesher) == "verify");
+    }
+
+    // VOKEL_IMPORT=model.vox places a MagicaVoxel file in front of the camera
+    const char* import = std::getenv("VOKEL_IMPORT");
+    if (import != nullptr) {
+        glm::ivec3 position { glm::floor(scene.camera.position + scene.camera.forward() * 64.0f) };
+
+        try {
+            VoKel::VoxImporter importer { scene.world, scene.jobs };
+            VoKel::VoxImporter::Stats stats = importer.import(import, position);
+            std::cout << "Loaded " << import << ": " << stats.voxels << " voxels in " << stats.instances << " instances, "
+                      << stats.seconds * 1e3 << " ms\n";
+        } catch (const std::runtime_error& error) {
+            std::cout << "Failed to import " << import << ": " << error.what() << "\n";
+        }
+    }
+
+    // VOKEL_MESH=model.obj,other.obj draws triangle meshes in front of the camera, split into meshlets that are culled on the gpu,
+    // their index and vertex order is optimized on load and cached in assets.pack
+    const char* meshPaths = std::getenv("VOKEL_MESH");
+    if (meshPaths != nullptr) {
+        std::vector<std::filesystem::path> paths;
+        std::stringstream list { meshPaths };
+        for (std::string path; std::getline(list, path, ',');) {
+            if (!path.empty()) {
+                paths.push_back(path);
+            }
+        }
+
+        VoKel::AssetPack pack { "assets.pack" };
+        std::vector<VoKel::ImportedMesh> meshes = VoKel::importMeshes(paths, pack, scene.jobs);
+
+        try {
+            pack.save();
+        } catch (const std::runtime_error& error) {
+            std::cout << error.what() << "\n";
+        }
+
+        for (size_t i { 0 }; i < meshes.size(); i++) {
+            const VoKel::ImportedMesh& imported = meshes[i];
+            if (!imported.error.empty()) {
+                std::cout << "Failed to load " << imported.path.string() << ": " << imported.error << "\n";
+                continue;
+            }
+
+            const VoKel::ObjMesh& obj = imported.mesh;
+            const VoKel::MeshOptimization& optimization = imported.optimization;
+
+            auto start = std::chrono::steady_clock::now();
+            VoKel::MeshletMesh meshlets = VoKel::buildMeshlets(obj.positions, obj.indices, scene.jobs);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            // scaled to 64 voxels across, side by side
+            glm::vec3 min { std::numeric_limits<float>::max() };
+            glm::vec3 max { -std::numeric_limits<float>::max() };
+            for (const glm::vec3& position : obj.positions) {
+                min = glm::min(min, position);
+                max = glm::max(max, position);
+            }
+            float scale = 64.0f / std::max({ max.x - min.x, max.y - min.y, max.z - min.z, 1e-6f });
+            glm::vec3 center = scene.camera.position + scene.camera.forward() * 96.0f + scene.camera.right() * (80.0f * (float(i) - float(meshes.size() - 1) * 0.5f));
+            glm::mat4 transform = glm::scale(glm::translate(glm::mat4 { 1.0f }, center), glm::vec3 { scale }) * glm::translate(glm::mat4 { 1.0f }, -(min + max) * 0.5f);
+
+            if (!graphicEngine.addMeshletMesh(obj.positions, meshlets, transform)) {
+                std::cout << "Failed to load " << imported.path.string() << ": the device cannot draw meshlets\n";
+                continue;
+            }
+
+            std::cout << "Loaded " << imported.path.string() << ": " << obj.indices.size() / 3 << " triangles in " << meshlets.meshlets.size() << " meshlets, built in "
+                      << seconds * 1e3 << " ms\n";
+            std::cout << "\tacmr " << optimization.before.acmr << " -> " << optimization.after.acmr << ", atvr " << optimization.before.atvr << " -> "
+                      << optimization.after.atvr << ", overdraw " << optimization.before.overdraw << " -> " << optimization.after.overdraw;
+            if (imported.cached) {
+                std::cout << ", from the asset pack\n";
+            } else {
+                std::cout << ", optimized in " << optimization.seconds * 1e3 << " ms\n";
+            }
+        }
+    }
 }
 
 App::~App()
@@ -17,13 +123,79 @@ App::~App()
 
 void App::run()
 {
+    currentTime = window.getTime();
+
     while (!window.shouldClose()) {
         window.update();
+
+        float deltaTime = float(window.getElapsedTime(currentTime));
+        currentTime = window.getTime();
+
+        updateCamera(deltaTime);
+        updateRenderMode();
+        scene.update();
+
         graphicEngine.render(scene);
         calculateFrameRate();
     }
 }
 
+void App::updateCamera(float deltaTime)
+{
+    glm::vec3 direction { 0.0f };
+
+    if (window.isKeyDown(SDL_SCANCODE_W)) {
+        direction.z += 1.0f;
+    }
+    if (window.isKeyDown(SDL_SCANCODE_S)) {
+        direction.z -= 1.0f;
+    }
+    if (window.isKeyDown(SDL_SCANCODE_D)) {
+        direction.x += 1.0f;
+    }
+    if (window.isKeyDown(SDL_SCANCODE_A)) {
+        direction.x -= 1.0f;
+    }
+    if (window.isKeyDown(SDL_SCANCODE_SPACE)) {
+        direction.y += 1.0f;
+    }
+    if (window.isKeyDown(SDL_SCANCODE_LCTRL)) {
+        direction.y -= 1.0f;
+    }
+
+    float speed = window.isKeyDown(SDL_SCANCODE_LSHIFT) ? 400.0f : 40.0f;
+    scene.camera.move(direction, speed * deltaTime);
+
+    float turn { 1.5f * deltaTime };
+    float yaw = (window.isKeyDown(SDL_SCANCODE_LEFT) ? turn : 0.0f) - (window.isKeyDown(SDL_SCANCODE_RIGHT) ? turn : 0.0f);
+    float pitch = (window.isKeyDown(SDL_SCANCODE_UP) ? turn : 0.0f) - (window.isKeyDown(SDL_SCANCODE_DOWN) ? turn : 0.0f);
+    scene.camera.rotate(yaw, pitch);
+}
+
+void App::updateRenderMode()
+{
+    bool down = window.isKeyDown(SDL_SCANCODE_R);
+    if (down && !renderModeKeyDown) {
+        bool raster = graphicEngine.getRenderMode() == VoKel::Engine::RenderMode::Raster;
+        setRenderMode(raster ? VoKel::Engine::RenderMode::Raymarch : VoKel::Engine::RenderMode::Raster);
+    }
+    renderModeKeyDown = down;
+
+    down = window.isKeyDown(SDL_SCANCODE_M);
+    if (down && !meshShadingKeyDown) {
+        graphicEngine.setMeshShading(!graphicEngine.getMeshShading());
+    }
+    meshShadingKeyDown = down;
+}
+
+void App::setRenderMode(VoKel::Engine::RenderMode mode)
+{
+    // the brick map is only kept up to date while it is drawn
+    if (graphicEngine.setRenderMode(mode)) {
+        scene.brickMap.setEnabled(mode == VoKel::Engine::RenderMode::Raymarch);
+    }
+}
+
 void App::calculateFrameRate()
 {
     double delta = window.getElapsedTime(lastTime);
@@ -31,8 +203,39 @@ void App::calculateFrameRate()
     if (delta >= 1) {
         int framerate { std::max(1, int(numFrames / delta)) };
 
+        VoKel::TerrainGenerator::Stats terrainStats = scene.terrain.getStats();
+
         std::stringstream title;
         title << "Voxelize this! @ " << framerate << "fps";
+        title << " | terrain " << int(terrainStats.chunksPerSecondPerCore()) << " chunks/s/core ("
+              << VoKel::getSimdLevelName(scene.terrain.getSimdLevel()) << ", " << scene.jobs.getThreadCount() + 1 << " threads)";
+        title << " | " << scene.world.getChunkCount() << " chunks resident, " << scene.streamer.getStats().pending << " loading ("
+              << scene.io.getBackendName() << ")";
+        if (graphicEngine.getRenderMode() == VoKel::Engine::RenderMode::Raymarch) {
+            title << " | raymarching " << scene.brickMap.getBrickCount() << " bricks";
+        } else {
+            const VoKel::FrustumCuller::Stats& cullStats = graphicEngine.getChunkCullStats();
+            VoKel::ChunkMeshPool::Stats meshStats = graphicEngine.getChunkMeshStats();
+            title << " | " << graphicEngine.getDrawnChunkCount() << " chunk meshes drawn, " << cullStats.visible << " of " << cullStats.boxes << " in view";
+            title << " | " << (graphicEngine.getMeshShading() ? "mesh shaders " : "vertex shaders ") << graphicEngine.getGeometryMilliseconds() << " ms gpu";
+            title << " | mesh pool " << meshStats.usedVertices * 100 / std::max<uint64_t>(meshStats.vertexCapacity, 1) << "% of "
+                  << meshStats.vertexCapacity * sizeof(vkMesh::ChunkVertex) / (1 << 20) << " MiB vertices, fragmentation " << int(meshStats.vertexFragmentation * 100) << "%";
+
+            VoKel::MeshletRenderer::Stats meshletStats = graphicEngine.getMeshletStats();
+            if (meshletStats.meshlets > 0) {
+                title << " | " << meshletStats.drawnMeshlets << " of " << meshletStats.meshlets << " meshlets drawn, " << meshletStats.drawnTriangles * 100 / meshletStats.triangles
+                      << "% of triangles";
+            }
+
+            const VoKel::GpuChunkMesher::Stats& gpuMeshStats = graphicEngine.getGpuMeshStats();
+            if (gpuMeshStats.meshedChunks > 0) {
+                title << " | gpu meshing " << gpuMeshStats.gpuMillisecondsPerChunk << " ms/chunk";
+                if (gpuMeshStats.verifiedChunks > 0) {
+                    title << " vs cpu " << gpuMeshStats.cpuMillisecondsPerChunk << " ms/chunk, " << gpuMeshStats.mismatchedChunks << " of "
+                          << gpuMeshStats.verifiedChunks << " mismatched";
+                }
+            }
+        }
         window.setWindowTitle(title.str());
         lastTime = window.getTime();
         numFrames = -1;
@@ -0,0 +1,135 @@
+#include "asset_pack.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace VoKel {
+
+namespace {
+
+    // every field is stored in host byte order, all supported targets are little endian
+    constexpr char PACK_MAGIC[4] { 'V', 'O', 'K', 'A' };
+    constexpr uint32_t PACK_VERSION { 1 };
+
+    struct PackHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t entryCount;
+    };
+
+    // followed by size bytes of data
+    struct EntryHeader {
+        uint64_t key;
+        uint64_t size;
+        uint64_t checksum;
+    };
+
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash { seed };
+    for (size_t i { 0 }; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+AssetPack::AssetPack(const std::filesystem::path& path)
+    : path { path }
+{
+    std::ifstream file { path, std::ios::binary };
+    if (!file) {
+        return;
+    }
+
+    PackHeader header {};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0
+        || header.version != PACK_VERSION) {
+        return;
+    }
+
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+
+    for (uint64_t i { 0 }; i < header.entryCount; i++) {
+        EntryHeader entry {};
+        if (!file.read(reinterpret_cast<char*>(&entry), sizeof(entry))) {
+            return;
+        }
+
+        // a torn or corrupted size must not allocate more than the file holds
+        if (error || entry.size > fileSize) {
+            return;
+        }
+
+        std::vector<uint8_t> data(entry.size);
+        if (!file.read(reinterpret_cast<char*>(data.data()), std::streamsize(entry.size)) || hashBytes(data.data(), data.size()) != entry.checksum) {
+            return;
+        }
+        entries[entry.key] = std::move(data);
+    }
+}
+
+bool AssetPack::read(uint64_t key, std::vector<uint8_t>& data)
+{
+    std::lock_guard lock { mutex };
+
+    auto found = entries.find(key);
+    if (found == entries.end()) {
+        return false;
+    }
+
+    data = found->second;
+    return true;
+}
+
+void AssetPack::write(uint64_t key, std::vector<uint8_t> data)
+{
+    std::lock_guard lock { mutex };
+
+    entries[key] = std::move(data);
+    dirty = true;
+}
+
+void AssetPack::save()
+{
+    std::lock_guard lock { mutex };
+    if (!dirty) {
+        return;
+    }
+
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+
+    {
+        std::ofstream file { temporary, std::ios::binary | std::ios::trunc };
+
+        PackHeader header {};
+        std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+        header.version = PACK_VERSION;
+        header.entryCount = entries.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        for (const auto& [key, data] : entries) {
+            EntryHeader entry { key, data.size(), hashBytes(data.data(), data.size()) };
+            file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+        }
+
+        file.flush();
+        if (!file) {
+            throw std::runtime_error { "Failed to write the asset pack " + temporary.string() };
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        throw std::runtime_error { "Failed to replace the asset pack " + path.string() + ": " + error.message() };
+    }
+    dirty = false;
+}
+
+}
@@ -0,0 +1,647 @@
+#include "async_io.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define VOKEL_IO_URING 1
+#else
+#define VOKEL_IO_URING 0
+#endif
+
+namespace VoKel {
+
+constexpr intptr_t INVALID_HANDLE { -1 };
+
+class IoBackend {
+public:
+    struct Read {
+        ReadRequest request;
+        intptr_t handle;
+    };
+
+    explicit IoBackend(AsyncIo& owner)
+        : owner { owner }
+    {
+    }
+
+    virtual ~IoBackend() = default;
+
+    virtual const char* name() const = 0;
+    virtual void registerBuffers(const std::vector<std::pair<void*, size_t>>& buffers) = 0;
+    virtual void submit(std::vector<Read>& reads) = 0;
+
+protected:
+    void complete(Read& read, const ReadResult& result) { owner.complete(read.request, result); }
+
+private:
+    AsyncIo& owner;
+};
+
+namespace {
+
+    intptr_t openNative(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        // region files keep a writable handle open, reads have to share with it
+        HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        return handle == INVALID_HANDLE_VALUE ? INVALID_HANDLE : reinterpret_cast<intptr_t>(handle);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        return fd < 0 ? INVALID_HANDLE : intptr_t(fd);
+#endif
+    }
+
+    void closeNative(intptr_t handle)
+    {
+#ifdef _WIN32
+        CloseHandle(reinterpret_cast<HANDLE>(handle));
+#else
+        ::close(int(handle));
+#endif
+    }
+
+    // blocking positional read that retries short reads until the end of the file
+    ReadResult readBlocking(intptr_t handle, const ReadRequest& request)
+    {
+        ReadResult result { static_cast<uint8_t*>(request.destination), 0, 0 };
+
+        while (result.size < request.size) {
+            uint64_t offset = request.offset + result.size;
+            uint32_t remaining = request.size - result.size;
+
+#ifdef _WIN32
+            OVERLAPPED overlapped {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD read { 0 };
+            if (!ReadFile(reinterpret_cast<HANDLE>(handle), result.data + result.size, remaining, &read, &overlapped)) {
+                if (GetLastError() != ERROR_HANDLE_EOF) {
+                    result.error = EIO;
+                }
+                break;
+            }
+#else
+            ssize_t read = pread(int(handle), result.data + result.size, remaining, off_t(offset));
+            if (read < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                result.error = errno;
+                break;
+            }
+#endif
+            if (read == 0) {
+                break;
+            }
+
+            result.size += static_cast<uint32_t>(read);
+        }
+
+        return result;
+    }
+
+    /*
+     * Fallback: a few reader threads doing blocking reads. Registered buffers
+     * are plain memory here, the requests are served in submission order.
+     */
+    class ThreadPoolBackend : public IoBackend {
+    public:
+        ThreadPoolBackend(AsyncIo& owner, uint32_t threadCount)
+            : IoBackend { owner }
+        {
+            for (uint32_t i { 0 }; i < threadCount; i++) {
+                threads.emplace_back([this] { readerLoop(); });
+            }
+        }
+
+        ~ThreadPoolBackend() override
+        {
+            {
+                std::lock_guard lock { mutex };
+                stopping = true;
+            }
+
+            wake.notify_all();
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        const char* name() const override { return "thread pool"; }
+
+        void registerBuffers(const std::vector<std::pair<void*, size_t>>&) override { }
+
+        void submit(std::vector<Read>& reads) override
+        {
+            {
+                std::lock_guard lock { mutex };
+                for (Read& read : reads) {
+                    queue.push_back(std::move(read));
+                }
+            }
+
+            wake.notify_all();
+        }
+
+    private:
+        std::vector<std::thread> threads;
+        std::deque<Read> queue;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping { false };
+
+        void readerLoop()
+        {
+            while (true) {
+                Read read;
+
+                {
+                    std::unique_lock lock { mutex };
+                    wake.wait(lock, [this] { return stopping || !queue.empty(); });
+
+                    if (queue.empty()) {
+                        return;
+                    }
+
+                    read = std::move(queue.front());
+                    queue.pop_front();
+                }
+
+                complete(read, readBlocking(read.handle, read.request));
+            }
+        }
+    };
+
+#if VOKEL_IO_URING
+
+    int ioUringSetup(uint32_t entries, io_uring_params* params)
+    {
+        return int(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int ring, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+    {
+        return int(syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    int ioUringRegister(int ring, uint32_t opcode, const void* arguments, uint32_t count)
+    {
+        return int(syscall(__NR_io_uring_register, ring, opcode, arguments, count));
+    }
+
+    /*
+     * Raw io_uring without liburing. Submissions are serialized by a mutex,
+     * one thread blocks in io_uring_enter for completions and runs the
+     * callbacks. Requests beyond the ring size wait in a backlog and are
+     * submitted as completions free their slots.
+     */
+    class IoUringBackend : public IoBackend {
+    public:
+        IoUringBackend(AsyncIo& owner, uint32_t queueDepth)
+            : IoBackend { owner }
+        {
+            io_uring_params params {};
+            ring = ioUringSetup(queueDepth, &params);
+            if (ring < 0) {
+                throw std::runtime_error("io_uring_setup failed: " + std::string(std::strerror(errno)));
+            }
+
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+            // newer kernels map both rings with a single mmap
+            bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMap) {
+                sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+            }
+
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+            cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES));
+
+            if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+                unmapRings(params.sq_entries);
+                ::close(ring);
+                throw std::runtime_error("failed to map the io_uring rings");
+            }
+
+            sqEntries = params.sq_entries;
+            auto sqBytes = static_cast<uint8_t*>(sqRing);
+            sqTail = reinterpret_cast<uint32_t*>(sqBytes + params.sq_off.tail);
+            sqMask = *reinterpret_cast<uint32_t*>(sqBytes + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<uint32_t*>(sqBytes + params.sq_off.array);
+
+            auto cqBytes = static_cast<uint8_t*>(cqRing);
+            cqHead = reinterpret_cast<uint32_t*>(cqBytes + params.cq_off.head);
+            cqTail = reinterpret_cast<uint32_t*>(cqBytes + params.cq_off.tail);
+            cqMask = *reinterpret_cast<uint32_t*>(cqBytes + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cqBytes + params.cq_off.cqes);
+
+            // one slot per sqe, the completion queue is at least as large
+            slots.resize(sqEntries);
+            for (uint32_t i { sqEntries }; i > 0; i--) {
+                freeSlots.push_back(i - 1);
+            }
+
+            completionThread = std::thread { [this] { completionLoop(); } };
+        }
+
+        ~IoUringBackend() override
+        {
+            {
+                std::lock_guard lock { mutex };
+                stopping = true;
+
+                // a nop with the stop tag wakes the completion thread
+                io_uring_sqe* sqe = nextSqe(0);
+                sqe->opcode = IORING_OP_NOP;
+                sqe->user_data = STOP_TAG;
+                publish(1);
+            }
+
+            completionThread.join();
+
+            unmapRings(sqEntries);
+            ::close(ring);
+        }
+
+        const char* name() const override { return "io_uring"; }
+
+        void registerBuffers(const std::vector<std::pair<void*, size_t>>& buffers) override
+        {
+            std::lock_guard lock { mutex };
+
+            if (registered) {
+                ioUringRegister(ring, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+                registered = false;
+            }
+
+            if (buffers.empty()) {
+                return;
+            }
+
+            std::vector<iovec> vectors;
+            for (const auto& [data, size] : buffers) {
+                vectors.push_back(iovec { data, size });
+            }
+
+            // without registration, fixed reads fall back to ordinary ones
+            registered = ioUringRegister(ring, IORING_REGISTER_BUFFERS, vectors.data(), uint32_t(vectors.size())) == 0;
+        }
+
+        void submit(std::vector<Read>& reads) override
+        {
+            std::lock_guard lock { mutex };
+
+            for (Read& read : reads) {
+                backlog.push_back(std::move(read));
+            }
+
+            submitBacklog();
+        }
+
+    private:
+        static constexpr uint64_t STOP_TAG { ~0ull };
+
+        struct Slot {
+            Read read;
+            iovec vector;
+        };
+
+        int ring { -1 };
+        void* sqRing { nullptr };
+        void* cqRing { nullptr };
+        size_t sqRingSize { 0 };
+        size_t cqRingSize { 0 };
+
+        uint32_t sqEntries { 0 };
+        uint32_t* sqTail;
+        uint32_t sqMask;
+        uint32_t* sqArray;
+        io_uring_sqe* sqes { nullptr };
+
+        uint32_t* cqHead;
+        uint32_t* cqTail;
+        uint32_t cqMask;
+        io_uring_cqe* cqes;
+
+        std::mutex mutex;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+        std::deque<Read> backlog;
+        bool registered { false };
+        bool stopping { false };
+
+        std::thread completionThread;
+
+        void unmapRings(uint32_t entries)
+        {
+            if (sqes != nullptr && sqes != MAP_FAILED) {
+                munmap(sqes, entries * sizeof(io_uring_sqe));
+            }
+            if (cqRing != nullptr && cqRing != MAP_FAILED && cqRing != sqRing) {
+                munmap(cqRing, cqRingSize);
+            }
+            if (sqRing != nullptr && sqRing != MAP_FAILED) {
+                munmap(sqRing, sqRingSize);
+            }
+        }
+
+        // the submission queue is only touched with the mutex held, pending entries are published together
+        io_uring_sqe* nextSqe(uint32_t pending)
+        {
+            uint32_t index = (*sqTail + pending) & sqMask;
+            sqArray[index] = index;
+
+            io_uring_sqe* sqe = &sqes[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        void publish(uint32_t count)
+        {
+            __atomic_store_n(sqTail, *sqTail + count, __ATOMIC_RELEASE);
+
+            while (ioUringEnter(ring, count, 0, 0) < 0 && errno == EINTR) {
+            }
+        }
+
+        void submitBacklog()
+        {
+            uint32_t submitted { 0 };
+
+            while (!backlog.empty() && !freeSlots.empty()) {
+                uint32_t index = freeSlots.back();
+                freeSlots.pop_back();
+
+                Slot& slot = slots[index];
+                slot.read = std::move(backlog.front());
+                backlog.pop_front();
+
+                const ReadRequest& request = slot.read.request;
+
+                io_uring_sqe* sqe = nextSqe(submitted);
+
+                sqe->fd = int(slot.read.handle);
+                sqe->off = request.offset;
+                sqe->user_data = index;
+
+                if (request.buffer >= 0 && registered) {
+                    sqe->opcode = IORING_OP_READ_FIXED;
+                    sqe->addr = reinterpret_cast<uint64_t>(request.destination);
+                    sqe->len = request.size;
+                    sqe->buf_index = static_cast<uint16_t>(request.buffer);
+                } else {
+                    slot.vector = iovec { request.destination, request.size };
+                    sqe->opcode = IORING_OP_READV;
+                    sqe->addr = reinterpret_cast<uint64_t>(&slot.vector);
+                    sqe->len = 1;
+                }
+
+                submitted++;
+            }
+
+            if (submitted > 0) {
+                publish(submitted);
+            }
+        }
+
+        void completionLoop()
+        {
+            while (true) {
+                if (ioUringEnter(ring, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                    return;
+                }
+
+                uint32_t head = *cqHead;
+                uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                bool stop { false };
+
+                std::vector<std::pair<Read, ReadResult>> finished;
+
+                {
+                    std::lock_guard lock { mutex };
+
+                    for (; head != tail; head++) {
+                        const io_uring_cqe& cqe = cqes[head & cqMask];
+
+                        if (cqe.user_data == STOP_TAG) {
+                            stop = true;
+                            continue;
+                        }
+
+                        Slot& slot = slots[cqe.user_data];
+                        ReadResult result { static_cast<uint8_t*>(slot.read.request.destination), 0, 0 };
+                        if (cqe.res < 0) {
+                            result.error = -cqe.res;
+                        } else {
+                            result.size = static_cast<uint32_t>(cqe.res);
+                        }
+
+                        finished.emplace_back(std::move(slot.read), result);
+                        freeSlots.push_back(static_cast<uint32_t>(cqe.user_data));
+                    }
+
+                    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+                    if (!stopping) {
+                        submitBacklog();
+                    }
+                }
+
+                // short reads in the middle of a file finish with a blocking read
+                for (auto& [read, result] : finished) {
+                    if (result.error == 0 && result.size < read.request.size && result.size > 0) {
+                        ReadRequest rest = read.request;
+                        rest.offset += result.size;
+                        rest.size -= result.size;
+                        rest.destination = result.data + result.size;
+                        result.size += readBlocking(read.handle, rest).size;
+                    }
+
+                    complete(read, result);
+                }
+
+                if (stop) {
+                    return;
+                }
+            }
+        }
+    };
+
+#endif
+
+}
+
+AsyncIo::AsyncIo(uint32_t queueDepth)
+{
+    // VOKEL_IO=threads forces the fallback, handy when comparing the two
+    const char* forced = std::getenv("VOKEL_IO");
+    bool threadsOnly = forced != nullptr && std::string(forced) == "threads";
+
+#if VOKEL_IO_URING
+    if (!threadsOnly) {
+        try {
+            backend = std::make_unique<IoUringBackend>(*this, queueDepth);
+        } catch (const std::runtime_error&) {
+            backend = nullptr;
+        }
+    }
+#else
+    (void)threadsOnly;
+    (void)queueDepth;
+#endif
+
+    if (!backend) {
+        backend = std::make_unique<ThreadPoolBackend>(*this, 4);
+    }
+}
+
+AsyncIo::~AsyncIo()
+{
+    wait();
+    backend.reset();
+
+    for (const File& file : files) {
+        if (file.handle != INVALID_HANDLE) {
+            closeNative(file.handle);
+        }
+    }
+}
+
+const char* AsyncIo::getBackendName() const
+{
+    return backend->name();
+}
+
+uint32_t AsyncIo::openFile(const std::filesystem::path& path)
+{
+    intptr_t handle = openNative(path);
+    if (handle == INVALID_HANDLE) {
+        return INVALID_FILE;
+    }
+
+    std::lock_guard lock { mutex };
+
+    if (freeFiles.empty()) {
+        files.push_back(File { handle, 0, false });
+        return static_cast<uint32_t>(files.size() - 1);
+    }
+
+    uint32_t file = freeFiles.back();
+    freeFiles.pop_back();
+    files[file] = File { handle, 0, false };
+    return file;
+}
+
+void AsyncIo::closeFile(uint32_t file)
+{
+    std::lock_guard lock { mutex };
+
+    if (file >= files.size() || files[file].handle == INVALID_HANDLE) {
+        return;
+    }
+
+    files[file].closing = true;
+    if (files[file].pending == 0) {
+        closeNative(files[file].handle);
+        files[file].handle = INVALID_HANDLE;
+        freeFiles.push_back(file);
+    }
+}
+
+void AsyncIo::registerBuffers(const std::vector<std::pair<void*, size_t>>& buffers)
+{
+    wait();
+    backend->registerBuffers(buffers);
+}
+
+void AsyncIo::read(ReadRequest request)
+{
+    std::vector<ReadRequest> requests;
+    requests.push_back(std::move(request));
+    read(std::move(requests));
+}
+
+void AsyncIo::read(std::vector<ReadRequest> requests)
+{
+    std::vector<IoBackend::Read> reads;
+    reads.reserve(requests.size());
+
+    std::vector<ReadRequest> rejected;
+
+    {
+        std::lock_guard lock { mutex };
+
+        for (ReadRequest& request : requests) {
+            inFlight++;
+
+            if (request.file >= files.size() || files[request.file].handle == INVALID_HANDLE || files[request.file].closing) {
+                rejected.push_back(std::move(request));
+                continue;
+            }
+
+            files[request.file].pending++;
+            reads.push_back(IoBackend::Read { std::move(request), files[request.file].handle });
+        }
+    }
+
+    if (!reads.empty()) {
+        backend->submit(reads);
+    }
+
+    for (ReadRequest& request : rejected) {
+        request.file = INVALID_FILE;
+        complete(request, ReadResult { static_cast<uint8_t*>(request.destination), 0, EBADF });
+    }
+}
+
+void AsyncIo::complete(ReadRequest& request, const ReadResult& result)
+{
+    if (request.callback) {
+        request.callback(result);
+    }
+
+    std::lock_guard lock { mutex };
+
+    if (request.file < files.size()) {
+        File& file = files[request.file];
+        if (--file.pending == 0 && file.closing) {
+            closeNative(file.handle);
+            file.handle = INVALID_HANDLE;
+            freeFiles.push_back(request.file);
+        }
+    }
+
+    if (--inFlight == 0) {
+        idle.notify_all();
+    }
+}
+
+void AsyncIo::wait()
+{
+    std::unique_lock lock { mutex };
+    idle.wait(lock, [this] { return inFlight == 0; });
+}
+
+}
@@ -0,0 +1,281 @@
+#include "brick_map.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    // chunks rebuilt per parallel pass, bounds the memory held by built bricks
+    constexpr size_t REBUILD_BATCH { 256 };
+
+    struct BuiltBrick {
+        // cell value for empty and uniform bricks, BRICK_EMPTY with words filled otherwise
+        uint32_t cell;
+        bool mixed;
+        uint32_t words[BRICK_WORDS];
+    };
+
+    int floorMod(int value, int size)
+    {
+        int mod = value % size;
+        return mod < 0 ? mod + size : mod;
+    }
+
+    int floorDiv(int value, int size)
+    {
+        return (value - floorMod(value, size)) / size;
+    }
+
+    int brickIndex(const glm::ivec3& local)
+    {
+        return local.x | (local.z << 2) | (local.y << 4);
+    }
+
+    void buildBrick(const Voxel* voxels, int brick, BuiltBrick& out)
+    {
+        int bx = (brick & 3) * BRICK_SIZE;
+        int bz = ((brick >> 2) & 3) * BRICK_SIZE;
+        int by = (brick >> 4) * BRICK_SIZE;
+
+        Voxel first = voxels[Chunk::index(bx, by, bz)];
+        bool uniform { true };
+
+        for (int y { 0 }; y < BRICK_SIZE; y++) {
+            for (int z { 0 }; z < BRICK_SIZE; z++) {
+                const Voxel* row = voxels + Chunk::index(bx, by + y, bz + z);
+                uint32_t* words = out.words + ((z | (y << BRICK_SIZE_LOG2)) << (BRICK_SIZE_LOG2 - 2));
+
+                for (int x { 0 }; x < BRICK_SIZE; x += 4) {
+                    uint32_t word { 0 };
+                    for (int i { 0 }; i < 4; i++) {
+                        uniform &= row[x + i] == first;
+                        word |= uint32_t(std::min<Voxel>(row[x + i], 0xff)) << (i * 8);
+                    }
+                    words[x >> 2] = word;
+                }
+            }
+        }
+
+        out.mixed = !uniform;
+        out.cell = !uniform ? BRICK_EMPTY : (first == AIR ? BRICK_EMPTY : BRICK_UNIFORM | std::min<Voxel>(first, 0xff));
+    }
+
+}
+
+BrickMap::BrickMap(World& world, JobSystem& jobs, const glm::ivec3& extent)
+    : world { world }
+    , jobs { jobs }
+    , extent { extent }
+{
+}
+
+void BrickMap::setEnabled(bool enabled)
+{
+    if (this->enabled == enabled) {
+        return;
+    }
+
+    this->enabled = enabled;
+    placed = false;
+
+    cells.clear();
+    bricks.clear();
+    freeSlots.clear();
+    dirtyChunks.clear();
+    changedCells.clear();
+    changedBricks.clear();
+    revision++;
+}
+
+void BrickMap::chunkChanged(const ChunkCoord& coord)
+{
+    if (enabled) {
+        dirtyChunks[packChunkCoord(coord)] = ~0ull;
+    }
+}
+
+void BrickMap::voxelChanged(const glm::ivec3& voxel)
+{
+    if (enabled) {
+        glm::ivec3 local = worldToLocal(voxel) >> BRICK_SIZE_LOG2;
+        dirtyChunks[packChunkCoord(worldToChunk(voxel))] |= 1ull << brickIndex(local);
+    }
+}
+
+glm::ivec3 BrickMap::getWrap() const
+{
+    glm::ivec3 origin = getOrigin();
+    glm::ivec3 size = getExtent();
+    return { floorMod(origin.x, size.x), floorMod(origin.y, size.y), floorMod(origin.z, size.z) };
+}
+
+uint32_t BrickMap::cellIndex(const glm::ivec3& brick) const
+{
+    glm::ivec3 size = getExtent();
+    int x = floorMod(brick.x, size.x);
+    int y = floorMod(brick.y, size.y);
+    int z = floorMod(brick.z, size.z);
+    return uint32_t(x + size.x * (z + size.z * y));
+}
+
+bool BrickMap::inWindow(const ChunkCoord& coord) const
+{
+    glm::ivec3 local = coord - originChunk;
+    return local.x >= 0 && local.y >= 0 && local.z >= 0 && local.x < extent.x && local.y < extent.y && local.z < extent.z;
+}
+
+void BrickMap::update(const glm::vec3& center)
+{
+    if (!enabled) {
+        return;
+    }
+
+    changedCells.clear();
+    changedBricks.clear();
+
+    glm::ivec3 centerVoxel { glm::floor(center) };
+    glm::ivec3 centerChunk { floorDiv(centerVoxel.x, CHUNK_SIZE), floorDiv(centerVoxel.y, CHUNK_SIZE), floorDiv(centerVoxel.z, CHUNK_SIZE) };
+    glm::ivec3 origin = centerChunk - extent / 2;
+
+    if (!placed || origin != originChunk) {
+        glm::ivec3 previous = originChunk;
+        bool hadWindow = placed;
+
+        originChunk = origin;
+        placed = true;
+
+        if (cells.empty()) {
+            glm::ivec3 size = getExtent();
+            cells.assign(size_t(size.x) * size.y * size.z, BRICK_EMPTY);
+        }
+
+        // only chunks that entered the window are new, the ones that stayed keep their cells
+        for (int y { 0 }; y < extent.y; y++) {
+            for (int z { 0 }; z < extent.z; z++) {
+                for (int x { 0 }; x < extent.x; x++) {
+                    ChunkCoord coord = origin + glm::ivec3 { x, y, z };
+                    glm::ivec3 old = coord - previous;
+                    bool stayed = hadWindow && old.x >= 0 && old.y >= 0 && old.z >= 0 && old.x < extent.x && old.y < extent.y && old.z < extent.z;
+
+                    if (!stayed) {
+                        dirtyChunks[packChunkCoord(coord)] = ~0ull;
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<ChunkCoord, uint64_t>> work;
+    for (const auto& [key, mask] : dirtyChunks) {
+        ChunkCoord coord = unpackChunkCoord(key);
+        if (inWindow(coord)) {
+            work.emplace_back(coord, mask);
+        }
+    }
+    dirtyChunks.clear();
+
+    if (work.empty()) {
+        return;
+    }
+
+    rebuild(work);
+
+    if (!changedCells.empty() || !changedBricks.empty()) {
+        revision++;
+    }
+}
+
+void BrickMap::rebuild(std::vector<std::pair<ChunkCoord, uint64_t>>& work)
+{
+    std::vector<std::vector<BuiltBrick>> built(std::min(work.size(), REBUILD_BATCH));
+
+    for (size_t first { 0 }; first < work.size(); first += REBUILD_BATCH) {
+        uint32_t count = uint32_t(std::min(REBUILD_BATCH, work.size() - first));
+
+        jobs.parallelFor(count, [&](uint32_t i) {
+            const auto& [coord, mask] = work[first + i];
+            std::vector<BuiltBrick>& out = built[i];
+            out.resize(size_t(std::popcount(mask)));
+
+            const Chunk* chunk = static_cast<const World&>(world).getChunk(coord);
+            if (chunk == nullptr || chunk->isEmpty()) {
+                for (BuiltBrick& brick : out) {
+                    brick.cell = BRICK_EMPTY;
+                    brick.mixed = false;
+                }
+                return;
+            }
+
+            // uniform chunks never need decoding, their bricks all match
+            if (chunk->getPalette().size() == 1) {
+                for (BuiltBrick& brick : out) {
+                    brick.cell = BRICK_UNIFORM | std::min<Voxel>(chunk->getPalette()[0], 0xff);
+                    brick.mixed = false;
+                }
+                return;
+            }
+
+            thread_local std::vector<Voxel> voxels(CHUNK_VOLUME);
+            chunk->decode(voxels.data());
+
+            size_t next { 0 };
+            for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+                buildBrick(voxels.data(), std::countr_zero(bits), out[next++]);
+            }
+        });
+
+        for (uint32_t i { 0 }; i < count; i++) {
+            const auto& [coord, mask] = work[first + i];
+            size_t next { 0 };
+
+            for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+                int brick = std::countr_zero(bits);
+                glm::ivec3 local { brick & 3, brick >> 4, (brick >> 2) & 3 };
+                uint32_t index = cellIndex(coord * BRICKS_PER_CHUNK + local);
+
+                const BuiltBrick& result = built[i][next++];
+                uint32_t old = cells[index];
+                bool hadSlot = old != BRICK_EMPTY && (old & BRICK_UNIFORM) == 0;
+
+                if (!result.mixed) {
+                    if (hadSlot) {
+                        freeSlots.push_back(old - 1);
+                    }
+                    if (old != result.cell) {
+                        cells[index] = result.cell;
+                        changedCells.push_back(index);
+                    }
+                    continue;
+                }
+
+                uint32_t slot;
+                if (hadSlot) {
+                    slot = old - 1;
+                    // streamed back in unchanged, nothing to upload
+                    if (std::memcmp(bricks.data() + size_t(slot) * BRICK_WORDS, result.words, sizeof(result.words)) == 0) {
+                        continue;
+                    }
+                } else if (!freeSlots.empty()) {
+                    slot = freeSlots.back();
+                    freeSlots.pop_back();
+                } else {
+                    slot = uint32_t(bricks.size() / BRICK_WORDS);
+                    bricks.resize(bricks.size() + BRICK_WORDS);
+                }
+
+                std::memcpy(bricks.data() + size_t(slot) * BRICK_WORDS, result.words, sizeof(result.words));
+                changedBricks.push_back(slot);
+
+                if (old != slot + 1) {
+                    cells[index] = slot + 1;
+                    changedCells.push_back(index);
+                }
+            }
+        }
+    }
+}
+
+}
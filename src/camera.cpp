@@ -0,0 +1,58 @@
+#include "camera.hpp"
+
+#include <algorithm>
+
+namespace VoKel {
+
+Camera::Camera()
+    : position { 0.0f, 64.0f, 0.0f }
+    , yaw { 0.0f }
+    , pitch { -0.3f }
+    , fieldOfView { glm::radians(70.0f) }
+    , nearPlane { 0.25f }
+    , farPlane { 8192.0f }
+{
+}
+
+glm::vec3 Camera::forward() const
+{
+    return glm::vec3 {
+        -std::sin(yaw) * std::cos(pitch),
+        std::sin(pitch),
+        -std::cos(yaw) * std::cos(pitch)
+    };
+}
+
+glm::vec3 Camera::right() const
+{
+    return glm::vec3 { std::cos(yaw), 0.0f, -std::sin(yaw) };
+}
+
+glm::mat4 Camera::view() const
+{
+    return glm::lookAt(position, position + forward(), glm::vec3 { 0.0f, 1.0f, 0.0f });
+}
+
+glm::mat4 Camera::projection(float aspectRatio) const
+{
+    glm::mat4 projection = glm::perspective(fieldOfView, aspectRatio, nearPlane, farPlane);
+    projection[1][1] *= -1.0f;
+    return projection;
+}
+
+void Camera::move(const glm::vec3& localDirection, float distance)
+{
+    glm::vec3 direction = localDirection.x * right() + localDirection.y * glm::vec3 { 0.0f, 1.0f, 0.0f } + localDirection.z * forward();
+
+    if (glm::length(direction) > 0.0f) {
+        position += glm::normalize(direction) * distance;
+    }
+}
+
+void Camera::rotate(float deltaYaw, float deltaPitch)
+{
+    yaw += deltaYaw;
+    pitch = std::clamp(pitch + deltaPitch, -1.5f, 1.5f);
+}
+
+}
@@ -0,0 +1,213 @@
+#include "chunk.hpp"
+
+#include <algorithm>
+
+namespace VoKel {
+
+uint64_t packChunkCoord(const ChunkCoord& coord)
+{
+    constexpr uint64_t mask { (1ull << 21) - 1 };
+
+    return (static_cast<uint64_t>(coord.x) & mask)
+        | ((static_cast<uint64_t>(coord.y) & mask) << 21)
+        | ((static_cast<uint64_t>(coord.z) & mask) << 42);
+}
+
+ChunkCoord unpackChunkCoord(uint64_t key)
+{
+    // shift the 21 bit field to the top and back to sign extend it
+    auto unpack = [](uint64_t field) {
+        return static_cast<int>(static_cast<int64_t>(field << 43) >> 43);
+    };
+
+    return { unpack(key), unpack(key >> 21), unpack(key >> 42) };
+}
+
+ChunkCoord worldToChunk(const glm::ivec3& voxel)
+{
+    return { voxel.x >> CHUNK_SIZE_LOG2, voxel.y >> CHUNK_SIZE_LOG2, voxel.z >> CHUNK_SIZE_LOG2 };
+}
+
+glm::ivec3 worldToLocal(const glm::ivec3& voxel)
+{
+    return { voxel.x & (CHUNK_SIZE - 1), voxel.y & (CHUNK_SIZE - 1), voxel.z & (CHUNK_SIZE - 1) };
+}
+
+Chunk::Chunk()
+    : Chunk { AIR }
+{
+}
+
+Chunk::Chunk(Voxel fill)
+    : palette { fill }
+    , bitsPerIndex { 0 }
+    , solidCount { fill == AIR ? 0u : uint32_t(CHUNK_VOLUME) }
+{
+}
+
+uint32_t Chunk::readIndex(int i) const
+{
+    if (bitsPerIndex == 0) {
+        return 0;
+    }
+
+    uint32_t bit = static_cast<uint32_t>(i) * bitsPerIndex;
+    uint64_t mask = (1ull << bitsPerIndex) - 1;
+
+    return static_cast<uint32_t>((indices[bit >> 6] >> (bit & 63)) & mask);
+}
+
+void Chunk::writeIndex(int i, uint32_t paletteIndex)
+{
+    uint32_t bit = static_cast<uint32_t>(i) * bitsPerIndex;
+    uint64_t mask = (1ull << bitsPerIndex) - 1;
+    uint64_t& word = indices[bit >> 6];
+
+    word = (word & ~(mask << (bit & 63))) | (static_cast<uint64_t>(paletteIndex) << (bit & 63));
+}
+
+Voxel Chunk::getIndex(int i) const
+{
+    return palette[readIndex(i)];
+}
+
+void Chunk::resizeIndices(uint32_t newBits)
+{
+    std::vector<uint64_t> newIndices((static_cast<size_t>(CHUNK_VOLUME) * newBits + 63) / 64, 0);
+
+    if (bitsPerIndex != 0) {
+        for (int i { 0 }; i < CHUNK_VOLUME; i++) {
+            uint32_t bit = static_cast<uint32_t>(i) * newBits;
+            newIndices[bit >> 6] |= static_cast<uint64_t>(readIndex(i)) << (bit & 63);
+        }
+    }
+
+    indices = std::move(newIndices);
+    bitsPerIndex = newBits;
+}
+
+uint32_t Chunk::findOrAddPaletteEntry(Voxel voxel)
+{
+    for (uint32_t i { 0 }; i < palette.size(); i++) {
+        if (palette[i] == voxel) {
+            return i;
+        }
+    }
+
+    palette.push_back(voxel);
+
+    // bits stay a power of two so an index never straddles two words
+    uint32_t required { bitsPerIndex == 0 ? 1u : bitsPerIndex };
+    while ((1ull << required) < palette.size()) {
+        required *= 2;
+    }
+
+    if (required != bitsPerIndex) {
+        resizeIndices(required);
+    }
+
+    return static_cast<uint32_t>(palette.size() - 1);
+}
+
+void Chunk::setIndex(int i, Voxel voxel)
+{
+    uint32_t current = readIndex(i);
+    Voxel previous = palette[current];
+
+    if (previous == voxel) {
+        return;
+    }
+
+    solidCount += (voxel != AIR) - (previous != AIR);
+    writeIndex(i, findOrAddPaletteEntry(voxel));
+}
+
+void Chunk::fill(Voxel voxel)
+{
+    palette.assign(1, voxel);
+    indices.clear();
+    indices.shrink_to_fit();
+    bitsPerIndex = 0;
+    solidCount = voxel == AIR ? 0 : CHUNK_VOLUME;
+}
+
+void Chunk::decode(Voxel* out) const
+{
+    if (bitsPerIndex == 0) {
+        std::fill(out, out + CHUNK_VOLUME, palette[0]);
+        return;
+    }
+
+    uint32_t perWord = 64 / bitsPerIndex;
+    uint64_t mask = (1ull << bitsPerIndex) - 1;
+
+    int i { 0 };
+    for (uint64_t word : indices) {
+        for (uint32_t j { 0 }; j < perWord && i < CHUNK_VOLUME; j++, i++) {
+            out[i] = palette[(word >> (j * bitsPerIndex)) & mask];
+        }
+    }
+}
+
+void Chunk::compact()
+{
+    if (bitsPerIndex == 0) {
+        return;
+    }
+
+    std::vector<uint32_t> usage(palette.size(), 0);
+    for (int i { 0 }; i < CHUNK_VOLUME; i++) {
+        usage[readIndex(i)]++;
+    }
+
+    std::vector<Voxel> newPalette;
+    std::vector<uint32_t> remap(palette.size(), 0);
+    for (size_t i { 0 }; i < palette.size(); i++) {
+        if (usage[i] > 0) {
+            remap[i] = static_cast<uint32_t>(newPalette.size());
+            newPalette.push_back(palette[i]);
+        }
+    }
+
+    if (newPalette.size() == 1) {
+        fill(newPalette[0]);
+        return;
+    }
+
+    uint32_t newBits { 1 };
+    while ((1ull << newBits) < newPalette.size()) {
+        newBits *= 2;
+    }
+
+    std::vector<uint64_t> newIndices((static_cast<size_t>(CHUNK_VOLUME) * newBits + 63) / 64, 0);
+    for (int i { 0 }; i < CHUNK_VOLUME; i++) {
+        uint32_t bit = static_cast<uint32_t>(i) * newBits;
+        newIndices[bit >> 6] |= static_cast<uint64_t>(remap[readIndex(i)]) << (bit & 63);
+    }
+
+    palette = std::move(newPalette);
+    indices = std::move(newIndices);
+    bitsPerIndex = newBits;
+}
+
+uint64_t* Chunk::restore(const Voxel* newPalette, uint32_t paletteSize, uint32_t newBits, uint32_t newSolidCount)
+{
+    bool validBits = newBits == 0 || newBits == 1 || newBits == 2 || newBits == 4 || newBits == 8 || newBits == 16;
+    if (!validBits || paletteSize == 0 || paletteSize > (1ull << newBits) || newSolidCount > uint32_t(CHUNK_VOLUME)) {
+        throw std::runtime_error("invalid serialized chunk storage");
+    }
+
+    palette.assign(newPalette, newPalette + paletteSize);
+    indices.assign(static_cast<size_t>(CHUNK_VOLUME) * newBits / 64, 0);
+    bitsPerIndex = newBits;
+    solidCount = newSolidCount;
+
+    return indices.data();
+}
+
+size_t Chunk::memoryUsage() const
+{
+    return sizeof(Chunk) + palette.capacity() * sizeof(Voxel) + indices.capacity() * sizeof(uint64_t);
+}
+
+}
@@ -0,0 +1,356 @@
+#include "chunk_mesh_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    vkUtil::Buffer createBuffer(vk::Device device, vk::PhysicalDevice physicalDevice, size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags memoryProperties)
+    {
+        vkUtil::BufferInput input;
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.size = size;
+        input.usage = usage;
+        input.memoryProperties = memoryProperties;
+        return vkUtil::createBuffer(input);
+    }
+
+    void destroyBuffer(vk::Device device, vkUtil::Buffer& buffer)
+    {
+        if (buffer.buffer) {
+            device.destroyBuffer(buffer.buffer);
+            device.freeMemory(buffer.bufferMemory);
+        }
+        buffer = {};
+    }
+
+    constexpr vk::MemoryPropertyFlags HOST_MEMORY { vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent };
+
+}
+
+ChunkMeshPool::ChunkMeshPool(vk::Device device, vk::PhysicalDevice physicalDevice, int framesInFlight, const ChunkMeshPoolSettings& settings)
+    : device { device }
+    , physicalDevice { physicalDevice }
+    , framesInFlight { framesInFlight }
+    , settings { settings }
+{
+    vertices.elementSize = sizeof(vkMesh::ChunkVertex);
+    // the vertex shaders pull from it and the gpu mesher writes meshes in place
+    vertices.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+    vertices.allocator.grow(std::max<uint64_t>(settings.initialVertices, 1));
+
+    indices.elementSize = sizeof(uint32_t);
+    indices.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+    indices.allocator.grow(std::max<uint64_t>(settings.initialIndices, 1));
+
+    // created up front, so there are always buffers to bind
+    for (Arena* arena : { &vertices, &indices }) {
+        arena->bufferCapacity = arena->allocator.getCapacity();
+        arena->buffer = createBuffer(device, physicalDevice, arena->bufferCapacity * arena->elementSize,
+            arena->usage | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    }
+}
+
+ChunkMeshPool::~ChunkMeshPool()
+{
+    for (Frame& frame : frames) {
+        destroyBuffer(device, frame.staging);
+    }
+    for (RetiredBuffer& retired : retiredBuffers) {
+        destroyBuffer(device, retired.buffer);
+    }
+    destroyBuffer(device, vertices.buffer);
+    destroyBuffer(device, indices.buffer);
+}
+
+uint32_t ChunkMeshPool::allocate(Arena& arena, uint64_t count, uint32_t mesh)
+{
+    uint32_t allocation = arena.allocator.allocate(count);
+    if (allocation == TlsfAllocator::NO_ALLOCATION) {
+        // the buffer itself follows at the next record
+        uint64_t capacity = arena.allocator.getCapacity();
+        arena.allocator.grow(std::max(capacity * 2, capacity + count));
+        allocation = arena.allocator.allocate(count);
+    }
+
+    arena.owners[allocation] = mesh;
+    return allocation;
+}
+
+void ChunkMeshPool::retire(Arena& arena, uint32_t allocation)
+{
+    arena.owners.erase(allocation);
+    retiredRanges.push_back({ &arena, allocation, framesInFlight });
+}
+
+uint32_t ChunkMeshPool::add(const ChunkMeshData& data)
+{
+    if (data.empty()) {
+        return NO_MESH;
+    }
+
+    uint32_t mesh = data.faces.empty() ? reserve(data.vertices.size(), data.indices.size()) : reserve(data.faces.size(), 0);
+    if (mesh != NO_MESH) {
+        uploads.push_back({ mesh, data.vertices, data.indices, data.faces });
+    }
+    return mesh;
+}
+
+uint32_t ChunkMeshPool::reserve(uint64_t vertexCount, uint64_t indexCount)
+{
+    if (vertexCount == 0) {
+        return NO_MESH;
+    }
+
+    uint32_t mesh;
+    if (!freeMeshes.empty()) {
+        mesh = freeMeshes.back();
+        freeMeshes.pop_back();
+    } else {
+        mesh = static_cast<uint32_t>(meshes.size());
+        meshes.push_back({});
+    }
+
+    meshes[mesh].vertexAllocation = allocate(vertices, vertexCount, mesh);
+    meshes[mesh].indexAllocation = indexCount > 0 ? allocate(indices, indexCount, mesh) : TlsfAllocator::NO_ALLOCATION;
+    meshes[mesh].vertexCount = static_cast<uint32_t>(vertexCount);
+    meshes[mesh].indexCount = static_cast<uint32_t>(indexCount);
+
+    return mesh;
+}
+
+void ChunkMeshPool::remove(uint32_t mesh)
+{
+    if (mesh == NO_MESH) {
+        return;
+    }
+
+    // never uploaded when it goes before the next record
+    std::erase_if(uploads, [mesh](const Upload& upload) { return upload.mesh == mesh; });
+
+    retire(vertices, meshes[mesh].vertexAllocation);
+    if (meshes[mesh].indexAllocation != TlsfAllocator::NO_ALLOCATION) {
+        retire(indices, meshes[mesh].indexAllocation);
+    }
+    freeMeshes.push_back(mesh);
+}
+
+ChunkMeshPool::DrawRange ChunkMeshPool::getDrawRange(uint32_t mesh) const
+{
+    const Mesh& entry = meshes[mesh];
+    bool indexed = entry.indexAllocation != TlsfAllocator::NO_ALLOCATION;
+    return {
+        entry.indexCount,
+        indexed ? static_cast<uint32_t>(indices.allocator.getOffset(entry.indexAllocation)) : 0,
+        static_cast<int32_t>(vertices.allocator.getOffset(entry.vertexAllocation)),
+        indexed ? 0 : entry.vertexCount
+    };
+}
+
+bool ChunkMeshPool::growBuffer(vk::CommandBuffer commandBuffer, Arena& arena)
+{
+    uint64_t capacity = arena.allocator.getCapacity();
+    if (capacity <= arena.bufferCapacity) {
+        return false;
+    }
+
+    vkUtil::Buffer grown = createBuffer(device, physicalDevice, capacity * arena.elementSize,
+        arena.usage | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    // offsets stay the same, frames in flight keep drawing from the old buffer until they are done
+    commandBuffer.copyBuffer(arena.buffer.buffer, grown.buffer, vk::BufferCopy { 0, 0, arena.bufferCapacity * arena.elementSize });
+    retiredBuffers.push_back({ arena.buffer, framesInFlight });
+
+    arena.buffer = grown;
+    arena.bufferCapacity = capacity;
+    return true;
+}
+
+void ChunkMeshPool::compact(Arena& arena, std::vector<vk::BufferCopy>& moves)
+{
+    TlsfAllocator& allocator = arena.allocator;
+    if (allocator.getFragmentation() <= settings.compactionThreshold) {
+        return;
+    }
+
+    size_t moved { 0 };
+    while (moved < settings.compactionBytesPerFrame) {
+        uint32_t last = allocator.getLastAllocation();
+
+        // a retired range on top frees itself once its frames are done
+        auto owner = arena.owners.find(last);
+        if (owner == arena.owners.end()) {
+            break;
+        }
+
+        uint64_t size = allocator.getSize(last);
+        uint32_t target = allocator.allocate(size);
+        if (target == TlsfAllocator::NO_ALLOCATION) {
+            break;
+        }
+        if (allocator.getOffset(target) > allocator.getOffset(last)) {
+            allocator.free(target);
+            break;
+        }
+
+        // both ranges are allocated, so they never overlap
+        moves.push_back({ allocator.getOffset(last) * arena.elementSize, allocator.getOffset(target) * arena.elementSize, size * arena.elementSize });
+        moved += size * arena.elementSize;
+
+        uint32_t mesh = owner->second;
+        Mesh& entry = meshes[mesh];
+        (&arena == &vertices ? entry.vertexAllocation : entry.indexAllocation) = target;
+
+        retire(arena, last);
+        arena.owners[target] = mesh;
+    }
+
+    movedBytes += moved;
+}
+
+void ChunkMeshPool::record(vk::CommandBuffer commandBuffer, uint32_t frameIndex)
+{
+    uploadedBytes = 0;
+    movedBytes = 0;
+
+    if (frameIndex >= frames.size()) {
+        frames.resize(frameIndex + 1, Frame { {}, 0 });
+    }
+    Frame& frame = frames[frameIndex];
+
+    // waited on for as many frames as there are in flight, nothing reads these anymore
+    std::erase_if(retiredRanges, [](RetiredRange& retired) {
+        if (--retired.framesLeft < 0) {
+            retired.arena->allocator.free(retired.allocation);
+            return true;
+        }
+        return false;
+    });
+    std::erase_if(retiredBuffers, [this](RetiredBuffer& retired) {
+        if (--retired.framesLeft < 0) {
+            destroyBuffer(device, retired.buffer);
+            return true;
+        }
+        return false;
+    });
+
+    // uploads first, the moves below carry meshes copied in this frame along
+    std::vector<vk::BufferCopy> vertexCopies;
+    std::vector<vk::BufferCopy> indexCopies;
+    size_t total { 0 };
+    for (const Upload& upload : uploads) {
+        const Mesh& mesh = meshes[upload.mesh];
+
+        // faces take the vertex slots of voxel meshes
+        size_t vertexBytes = upload.faces.empty() ? upload.vertices.size() * sizeof(vkMesh::ChunkVertex) : upload.faces.size() * sizeof(vkMesh::ChunkFace);
+        vertexCopies.push_back({ total, vertices.allocator.getOffset(mesh.vertexAllocation) * vertices.elementSize, vertexBytes });
+        total += vertexBytes;
+
+        if (mesh.indexAllocation != TlsfAllocator::NO_ALLOCATION) {
+            size_t indexBytes = upload.indices.size() * sizeof(uint32_t);
+            indexCopies.push_back({ total, indices.allocator.getOffset(mesh.indexAllocation) * indices.elementSize, indexBytes });
+            total += indexBytes;
+        }
+    }
+
+    std::vector<vk::BufferCopy> vertexMoves;
+    std::vector<vk::BufferCopy> indexMoves;
+    compact(vertices, vertexMoves);
+    compact(indices, indexMoves);
+
+    bool grows = vertices.allocator.getCapacity() > vertices.bufferCapacity || indices.allocator.getCapacity() > indices.bufferCapacity;
+    if (!grows && total == 0 && vertexMoves.empty() && indexMoves.empty()) {
+        return;
+    }
+
+    if (total > 0) {
+        // the frame's fence was waited on, its previous copies are done with the staging buffer
+        if (total > frame.stagingSize) {
+            destroyBuffer(device, frame.staging);
+            frame.stagingSize = std::max(total, frame.stagingSize * 2);
+            frame.staging = createBuffer(device, physicalDevice, frame.stagingSize, vk::BufferUsageFlagBits::eTransferSrc, HOST_MEMORY);
+        }
+
+        char* mapped = static_cast<char*>(device.mapMemory(frame.staging.bufferMemory, 0, total));
+        size_t indexCopy { 0 };
+        for (size_t i { 0 }; i < uploads.size(); i++) {
+            const Upload& upload = uploads[i];
+            if (upload.faces.empty()) {
+                std::memcpy(mapped + vertexCopies[i].srcOffset, upload.vertices.data(), vertexCopies[i].size);
+                std::memcpy(mapped + indexCopies[indexCopy].srcOffset, upload.indices.data(), indexCopies[indexCopy].size);
+                indexCopy++;
+            } else {
+                std::memcpy(mapped + vertexCopies[i].srcOffset, upload.faces.data(), vertexCopies[i].size);
+            }
+        }
+        device.unmapMemory(frame.staging.bufferMemory);
+    }
+    uploads.clear();
+
+    // earlier frames may still be reading the buffers, and the copies of the last record wrote ranges that
+    // growing and compacting read back
+    vk::MemoryBarrier before { vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eTransferWrite,
+        vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), before, nullptr, nullptr);
+
+    // each step writes ranges the next one reads or overwrites
+    vk::MemoryBarrier transfer { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite };
+
+    bool grown = growBuffer(commandBuffer, vertices);
+    grown = growBuffer(commandBuffer, indices) || grown;
+    if (grown) {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(), transfer, nullptr, nullptr);
+    }
+
+    if (total > 0) {
+        commandBuffer.copyBuffer(frame.staging.buffer, vertices.buffer.buffer, vertexCopies);
+        if (!indexCopies.empty()) {
+            commandBuffer.copyBuffer(frame.staging.buffer, indices.buffer.buffer, indexCopies);
+        }
+    }
+
+    if (!vertexMoves.empty() || !indexMoves.empty()) {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(), transfer, nullptr, nullptr);
+
+        if (!vertexMoves.empty()) {
+            commandBuffer.copyBuffer(vertices.buffer.buffer, vertices.buffer.buffer, vertexMoves);
+        }
+        if (!indexMoves.empty()) {
+            commandBuffer.copyBuffer(indices.buffer.buffer, indices.buffer.buffer, indexMoves);
+        }
+    }
+
+    vk::MemoryBarrier after { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eIndexRead };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader,
+        vk::DependencyFlags(), after, nullptr, nullptr);
+
+    uploadedBytes = total;
+}
+
+void ChunkMeshPool::bind(vk::CommandBuffer commandBuffer) const
+{
+    commandBuffer.bindIndexBuffer(indices.buffer.buffer, 0, vk::IndexType::eUint32);
+}
+
+ChunkMeshPool::Stats ChunkMeshPool::getStats() const
+{
+    Stats stats {};
+    stats.meshes = static_cast<uint32_t>(meshes.size() - freeMeshes.size());
+    stats.usedVertices = vertices.allocator.getUsedSize();
+    stats.vertexCapacity = vertices.allocator.getCapacity();
+    stats.usedIndices = indices.allocator.getUsedSize();
+    stats.indexCapacity = indices.allocator.getCapacity();
+    stats.vertexFragmentation = vertices.allocator.getFragmentation();
+    stats.indexFragmentation = indices.allocator.getFragmentation();
+    stats.uploadedBytes = uploadedBytes;
+    stats.movedBytes = movedBytes;
+    return stats;
+}
+
+}
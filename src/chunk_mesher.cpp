@@ -0,0 +1,334 @@
+#include "chunk_mesher.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr int PADDED_SIZE { ChunkMeshVolume::SIZE };
+
+    constexpr uint8_t FULL_SKY_LIGHT { 0xf0 };
+    constexpr uint64_t LANE_MASK { (1ull << CHUNK_SIZE) - 1 };
+
+    constexpr int paddedIndex(int x, int y, int z)
+    {
+        return ChunkMeshVolume::index(x, y, z);
+    }
+
+    // chunk plus a one voxel border taken from the face neighbors
+    void fillPaddedVolume(const ChunkMeshInput& input, std::vector<Voxel>& padded, std::vector<Voxel>& dense)
+    {
+        std::fill(padded.begin(), padded.end(), AIR);
+
+        input.chunk->decode(dense.data());
+        for (int y { 0 }; y < CHUNK_SIZE; y++) {
+            for (int z { 0 }; z < CHUNK_SIZE; z++) {
+                std::copy_n(&dense[Chunk::index(0, y, z)], CHUNK_SIZE, &padded[paddedIndex(0, y, z)]);
+            }
+        }
+
+        for (int face { 0 }; face < 6; face++) {
+            const Chunk* neighbor = input.neighbors[face];
+            if (neighbor == nullptr || neighbor->isEmpty() || (input.skirtMask & (1 << face))) {
+                continue;
+            }
+
+            glm::ivec3 direction = FACE_DIRECTIONS[face];
+            int axis = face / 2;
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+
+            for (int j { 0 }; j < CHUNK_SIZE; j++) {
+                for (int i { 0 }; i < CHUNK_SIZE; i++) {
+                    glm::ivec3 source {};
+                    source[axis] = direction[axis] > 0 ? 0 : CHUNK_SIZE - 1;
+                    source[u] = i;
+                    source[v] = j;
+
+                    glm::ivec3 target = source;
+                    target[axis] = direction[axis] > 0 ? CHUNK_SIZE : -1;
+
+                    padded[paddedIndex(target.x, target.y, target.z)] = neighbor->get(source.x, source.y, source.z);
+                }
+            }
+        }
+    }
+
+    // same layout for light, border cells without a neighbor repeat the chunk's own border
+    void fillPaddedLight(const ChunkMeshInput& input, std::vector<uint8_t>& light)
+    {
+        for (int y { -1 }; y <= CHUNK_SIZE; y++) {
+            for (int z { -1 }; z <= CHUNK_SIZE; z++) {
+                for (int x { -1 }; x <= CHUNK_SIZE; x++) {
+                    glm::ivec3 p { x, y, z };
+                    glm::ivec3 inside = glm::clamp(p, 0, CHUNK_SIZE - 1);
+                    const uint8_t* source = input.light;
+
+                    // border cells on a face read the neighbor, edge and corner cells stay clamped
+                    glm::ivec3 outside = glm::ivec3(glm::notEqual(p, inside));
+                    if (outside.x + outside.y + outside.z == 1) {
+                        int axis = outside.x ? 0 : (outside.y ? 1 : 2);
+                        int face = axis * 2 + (p[axis] < 0 ? 1 : 0);
+
+                        if (input.neighborLight[face] != nullptr && (input.skirtMask & (1 << face)) == 0) {
+                            source = input.neighborLight[face];
+                            inside[axis] = p[axis] < 0 ? CHUNK_SIZE - 1 : 0;
+                        }
+                    }
+
+                    light[paddedIndex(x, y, z)] = source[Chunk::index(inside.x, inside.y, inside.z)];
+                }
+            }
+        }
+    }
+
+    /*
+     * Solid bits of every padded layer perpendicular to each axis. Row v + 1
+     * of layer w + 1 holds the voxel at u in bit u + 1, with u and v the two
+     * other axes in the order the quads use.
+     */
+    using LayerBits = std::array<std::array<std::array<uint64_t, PADDED_SIZE>, PADDED_SIZE>, 3>;
+
+    void fillLayerBits(const std::vector<Voxel>& padded, LayerBits& layers)
+    {
+        for (auto& axisLayers : layers) {
+            for (auto& rows : axisLayers) {
+                rows.fill(0);
+            }
+        }
+
+        for (int y { -1 }; y <= CHUNK_SIZE; y++) {
+            for (int z { -1 }; z <= CHUNK_SIZE; z++) {
+                for (int x { -1 }; x <= CHUNK_SIZE; x++) {
+                    if (padded[paddedIndex(x, y, z)] == AIR) {
+                        continue;
+                    }
+
+                    // axis 0: u = y, v = z; axis 1: u = z, v = x; axis 2: u = x, v = y
+                    layers[0][x + 1][z + 1] |= 1ull << (y + 1);
+                    layers[1][y + 1][x + 1] |= 1ull << (z + 1);
+                    layers[2][z + 1][y + 1] |= 1ull << (x + 1);
+                }
+            }
+        }
+    }
+
+    /*
+     * Ambient occlusion of one corner for a whole row of 32 faces at once.
+     * Each bit is a lane, the two returned masks are the low and high bit of
+     * ao = 3 - (side1 + side2 + corner), forced to 0 when both sides are solid.
+     */
+    struct AoLanes {
+        uint64_t low;
+        uint64_t high;
+    };
+
+    AoLanes cornerOcclusion(uint64_t side1, uint64_t side2, uint64_t corner)
+    {
+        uint64_t sumLow = side1 ^ side2 ^ corner;
+        uint64_t sumHigh = (side1 & side2) | (corner & (side1 ^ side2));
+        uint64_t blocked = side1 & side2;
+
+        return { ~sumLow & ~blocked & LANE_MASK, ~sumHigh & ~blocked & LANE_MASK };
+    }
+
+    // face key: material, then 2 bit ao, 4 bit sky and 4 bit block light for each of the four corners
+    constexpr int KEY_AO_SHIFT { 16 };
+    constexpr int KEY_SKY_SHIFT { 24 };
+    constexpr int KEY_BLOCK_SHIFT { 40 };
+
+    // corners in quad order, (-u, -v), (+u, -v), (+u, +v), (-u, +v)
+    constexpr std::array<glm::ivec2, 4> CORNER_SIGNS {
+        glm::ivec2 { -1, -1 }, glm::ivec2 { 1, -1 }, glm::ivec2 { 1, 1 }, glm::ivec2 { -1, 1 }
+    };
+
+    void emitFace(ChunkMeshData& mesh, int face, int slice, int u0, int v0, int width, int height, uint64_t key)
+    {
+        // the key's low bits are the face's attributes word, the light nibbles above line up with its light word
+        vkMesh::ChunkFace chunkFace {};
+        chunkFace.geometry = vkMesh::packChunkFaceGeometry(face, slice, u0, v0, width, height);
+        chunkFace.attributes = static_cast<uint32_t>(key & 0xffffff);
+        chunkFace.light = static_cast<uint32_t>(key >> KEY_SKY_SHIFT);
+        mesh.faces.push_back(chunkFace);
+    }
+
+}
+
+bool fillChunkMeshVolume(const ChunkMeshInput& input, ChunkMeshVolume& volume)
+{
+    if (input.chunk == nullptr || input.chunk->isEmpty()) {
+        return false;
+    }
+
+    thread_local std::vector<Voxel> dense(CHUNK_VOLUME);
+    fillPaddedVolume(input, volume.voxels, dense);
+
+    volume.lit = input.light != nullptr;
+    if (volume.lit) {
+        fillPaddedLight(input, volume.light);
+    }
+
+    return true;
+}
+
+ChunkMeshData meshChunk(const ChunkMeshInput& input)
+{
+    thread_local ChunkMeshVolume volume;
+    if (!fillChunkMeshVolume(input, volume)) {
+        return {};
+    }
+
+    return meshChunkVolume(volume);
+}
+
+ChunkMeshData meshChunkVolume(const ChunkMeshVolume& volume)
+{
+    ChunkMeshData mesh;
+
+    const std::vector<Voxel>& padded = volume.voxels;
+    const std::vector<uint8_t>& paddedLight = volume.light;
+
+    thread_local LayerBits layers;
+    fillLayerBits(padded, layers);
+
+    std::array<uint64_t, CHUNK_AREA> mask;
+
+    for (int face { 0 }; face < 6; face++) {
+        glm::ivec3 direction = FACE_DIRECTIONS[face];
+        int axis = face / 2;
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+
+        for (int slice { 0 }; slice < CHUNK_SIZE; slice++) {
+            const auto& current = layers[axis][slice + 1];
+            const auto& front = layers[axis][slice + 1 + direction[axis]];
+            bool any { false };
+
+            for (int j { 0 }; j < CHUNK_SIZE; j++) {
+                uint64_t visible = (current[j + 1] >> 1) & ~(front[j + 1] >> 1) & LANE_MASK;
+
+                std::fill_n(&mask[j * CHUNK_SIZE], CHUNK_SIZE, 0);
+                if (visible == 0) {
+                    continue;
+                }
+
+                any = true;
+
+                // lane i is the face at u = i, shifting by 0 or 2 reads the cell at u - 1 or u + 1
+                uint64_t previous = front[j];
+                uint64_t row = front[j + 1];
+                uint64_t next = front[j + 2];
+
+                const std::array<AoLanes, 4> ao {
+                    cornerOcclusion(row, previous >> 1, previous),
+                    cornerOcclusion(row >> 2, previous >> 1, previous >> 2),
+                    cornerOcclusion(row >> 2, next >> 1, next >> 2),
+                    cornerOcclusion(row, next >> 1, next)
+                };
+
+                for (uint64_t bits { visible }; bits != 0; bits &= bits - 1) {
+                    int i = std::countr_zero(bits);
+
+                    glm::ivec3 p {};
+                    p[axis] = slice;
+                    p[u] = i;
+                    p[v] = j;
+
+                    uint64_t key = padded[paddedIndex(p.x, p.y, p.z)];
+
+                    for (int c { 0 }; c < 4; c++) {
+                        uint64_t occlusion = ((ao[c].low >> i) & 1) | (((ao[c].high >> i) & 1) << 1);
+                        key |= occlusion << (KEY_AO_SHIFT + 2 * c);
+                    }
+
+                    if (!volume.lit) {
+                        for (int c { 0 }; c < 4; c++) {
+                            key |= uint64_t(FULL_SKY_LIGHT >> 4) << (KEY_SKY_SHIFT + 4 * c);
+                        }
+                    } else {
+                        // smooth light: average of the open cells touching the corner in front of the face
+                        glm::ivec3 cell = p + direction;
+
+                        for (int c { 0 }; c < 4; c++) {
+                            glm::ivec3 side1 = cell;
+                            glm::ivec3 side2 = cell;
+                            side1[u] += CORNER_SIGNS[c].x;
+                            side2[v] += CORNER_SIGNS[c].y;
+                            glm::ivec3 diagonal = side1;
+                            diagonal[v] += CORNER_SIGNS[c].y;
+
+                            bool open1 = padded[paddedIndex(side1.x, side1.y, side1.z)] == AIR;
+                            bool open2 = padded[paddedIndex(side2.x, side2.y, side2.z)] == AIR;
+                            bool openDiagonal = (open1 || open2) && padded[paddedIndex(diagonal.x, diagonal.y, diagonal.z)] == AIR;
+
+                            uint32_t sky { 0 }, block { 0 }, count { 0 };
+                            auto add = [&](const glm::ivec3& q) {
+                                uint8_t level = paddedLight[paddedIndex(q.x, q.y, q.z)];
+                                sky += level >> 4;
+                                block += level & 0xf;
+                                count++;
+                            };
+
+                            add(cell);
+                            if (open1) {
+                                add(side1);
+                            }
+                            if (open2) {
+                                add(side2);
+                            }
+                            if (openDiagonal) {
+                                add(diagonal);
+                            }
+
+                            key |= uint64_t((sky + count / 2) / count) << (KEY_SKY_SHIFT + 4 * c);
+                            key |= uint64_t((block + count / 2) / count) << (KEY_BLOCK_SHIFT + 4 * c);
+                        }
+                    }
+
+                    mask[j * CHUNK_SIZE + i] = key;
+                }
+            }
+
+            if (!any) {
+                continue;
+            }
+
+            // greedy merge of equal keys, first along u then along v
+            for (int j { 0 }; j < CHUNK_SIZE; j++) {
+                for (int i { 0 }; i < CHUNK_SIZE;) {
+                    uint64_t key = mask[j * CHUNK_SIZE + i];
+                    if (key == 0) {
+                        i++;
+                        continue;
+                    }
+
+                    int width { 1 };
+                    while (i + width < CHUNK_SIZE && mask[j * CHUNK_SIZE + i + width] == key) {
+                        width++;
+                    }
+
+                    int height { 1 };
+                    for (; j + height < CHUNK_SIZE; height++) {
+                        const uint64_t* row = &mask[(j + height) * CHUNK_SIZE + i];
+                        if (!std::all_of(row, row + width, [key](uint64_t m) { return m == key; })) {
+                            break;
+                        }
+                    }
+
+                    for (int h { 0 }; h < height; h++) {
+                        std::fill_n(&mask[(j + h) * CHUNK_SIZE + i], width, 0);
+                    }
+
+                    emitFace(mesh, face, slice, i, j, width, height, key);
+                    i += width;
+                }
+            }
+        }
+    }
+
+    return mesh;
+}
+
+}
@@ -0,0 +1,271 @@
+#include "chunk_streamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VoKel {
+
+namespace {
+
+    // the queues are rebuilt when the view turns by more than about 18 degrees
+    constexpr float REQUEUE_ANGLE_COS { 0.95f };
+
+    glm::vec3 chunkCenter(const ChunkCoord& coord)
+    {
+        return (glm::vec3(coord) + 0.5f) * float(CHUNK_SIZE);
+    }
+
+}
+
+ChunkStreamer::ChunkStreamer(World& world, JobSystem& jobs, StreamingSettings settings)
+    : world { world }
+    , jobs { jobs }
+    , settings { settings }
+{
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+    // queued jobs still hold this pointer, they return early once stopping is set
+    std::unique_lock lock { mutex };
+    stopping = true;
+    drained.wait(lock, [this] { return running == 0; });
+}
+
+void ChunkStreamer::update(const glm::vec3& position, const glm::vec3& direction)
+{
+    ChunkCoord current { glm::floor(position / float(CHUNK_SIZE)) };
+
+    if (!queueValid || current != cameraChunk || glm::dot(direction, viewDirection) < REQUEUE_ANGLE_COS) {
+        cameraChunk = current;
+        cameraPosition = position;
+        viewDirection = direction;
+        rebuildQueues();
+        queueValid = true;
+    }
+
+    insertResults();
+    dispatchLoads();
+    unloadChunks();
+}
+
+float ChunkStreamer::priority(const ChunkCoord& coord) const
+{
+    glm::vec3 offset = chunkCenter(coord) - cameraPosition;
+    float distance = glm::length(offset) / float(CHUNK_SIZE);
+
+    if (distance < 1.0f) {
+        return distance;
+    }
+
+    float facing = glm::dot(offset, viewDirection) / (distance * float(CHUNK_SIZE));
+    return distance * (1.0f + settings.directionWeight * 0.5f * (1.0f - facing));
+}
+
+bool ChunkStreamer::isWanted(const ChunkCoord& coord) const
+{
+    float radius = (settings.loadRadius + settings.hysteresis) * float(CHUNK_SIZE);
+    glm::vec3 offset = chunkCenter(coord) - cameraPosition;
+    return glm::dot(offset, offset) <= radius * radius;
+}
+
+void ChunkStreamer::rebuildQueues()
+{
+    loadQueue.clear();
+
+    int extent = static_cast<int>(std::ceil(settings.loadRadius));
+    float radius = settings.loadRadius * float(CHUNK_SIZE);
+
+    for (int y { -extent }; y <= extent; y++) {
+        for (int z { -extent }; z <= extent; z++) {
+            for (int x { -extent }; x <= extent; x++) {
+                ChunkCoord coord = cameraChunk + ChunkCoord { x, y, z };
+
+                glm::vec3 offset = chunkCenter(coord) - cameraPosition;
+                if (glm::dot(offset, offset) > radius * radius) {
+                    continue;
+                }
+
+                if (world.getChunk(coord) == nullptr && !pendingLoads.contains(packChunkCoord(coord))) {
+                    loadQueue.push_back(coord);
+                }
+            }
+        }
+    }
+
+    // highest priority at the back so dispatching pops from the end
+    std::vector<std::pair<float, ChunkCoord>> sorted;
+    sorted.reserve(loadQueue.size());
+    for (const ChunkCoord& coord : loadQueue) {
+        sorted.emplace_back(priority(coord), coord);
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+
+    for (size_t i { 0 }; i < sorted.size(); i++) {
+        loadQueue[i] = sorted[i].second;
+    }
+
+    unloadQueue.clear();
+    world.forEachChunk([this](const ChunkCoord& coord, Chunk&) {
+        if (!isWanted(coord)) {
+            unloadQueue.push_back(coord);
+        }
+    });
+}
+
+void ChunkStreamer::dispatchLoads()
+{
+    while (pendingLoads.size() < settings.maxPendingLoads && !loadQueue.empty()) {
+        ChunkCoord coord = loadQueue.back();
+        loadQueue.pop_back();
+
+        // setVoxel may have made the chunk resident in the meantime
+        if (world.getChunk(coord) != nullptr || !pendingLoads.insert(packChunkCoord(coord)).second) {
+            continue;
+        }
+
+        {
+            std::lock_guard lock { mutex };
+            running++;
+        }
+
+        jobs.submit([this, coord] { startLoad(coord); });
+    }
+}
+
+void ChunkStreamer::startLoad(const ChunkCoord& coord)
+{
+    bool cancelled;
+    {
+        std::lock_guard lock { mutex };
+        cancelled = stopping;
+    }
+
+    if (cancelled) {
+        finishLoad(coord, nullptr);
+        return;
+    }
+
+    bool reading = asyncLoader && asyncLoader(coord, [this, coord](std::unique_ptr<Chunk> chunk) {
+        // damaged payloads are generated again instead
+        if (chunk != nullptr) {
+            finishLoad(coord, std::move(chunk));
+        } else {
+            jobs.submit([this, coord] { generateChunk(coord); });
+        }
+    });
+
+    if (!reading) {
+        generateChunk(coord);
+    }
+}
+
+void ChunkStreamer::generateChunk(const ChunkCoord& coord)
+{
+    if (loader) {
+        if (std::unique_ptr<Chunk> stored = loader(coord)) {
+            finishLoad(coord, std::move(stored));
+            return;
+        }
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+    if (const World::Generator& generator = world.getGenerator()) {
+        generator(*chunk, coord, 0);
+    }
+
+    chunk->compact();
+    finishLoad(coord, std::move(chunk));
+}
+
+void ChunkStreamer::finishLoad(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+{
+    std::lock_guard lock { mutex };
+    results.push_back(Result { coord, std::move(chunk) });
+    if (--running == 0) {
+        drained.notify_all();
+    }
+}
+
+void ChunkStreamer::insertResults()
+{
+    std::vector<Result> ready;
+
+    {
+        std::lock_guard lock { mutex };
+        size_t count = std::min<size_t>(results.size(), settings.loadsPerUpdate);
+        ready.reserve(count);
+        std::move(results.begin(), results.begin() + count, std::back_inserter(ready));
+        results.erase(results.begin(), results.begin() + count);
+    }
+
+    for (Result& result : ready) {
+        pendingLoads.erase(packChunkCoord(result.coord));
+
+        // the camera may have moved on while the chunk was loading
+        if (result.chunk == nullptr || !isWanted(result.coord) || world.getChunk(result.coord) != nullptr) {
+            continue;
+        }
+
+        world.insertChunk(result.coord, std::move(result.chunk));
+        loadedCount++;
+    }
+}
+
+void ChunkStreamer::unloadChunks()
+{
+    for (uint32_t unloads { 0 }; unloads < settings.unloadsPerUpdate && !unloadQueue.empty();) {
+        ChunkCoord coord = unloadQueue.back();
+        unloadQueue.pop_back();
+
+        if (isWanted(coord)) {
+            continue;
+        }
+
+        std::unique_ptr<Chunk> chunk = world.releaseChunk(coord);
+        if (chunk == nullptr) {
+            continue;
+        }
+
+        if (unloadHandler) {
+            unloadHandler(coord, std::move(chunk));
+        }
+
+        unloadedCount++;
+        unloads++;
+    }
+}
+
+void ChunkStreamer::unloadAll()
+{
+    std::vector<ChunkCoord> resident;
+    world.forEachChunk([&resident](const ChunkCoord& coord, Chunk&) {
+        resident.push_back(coord);
+    });
+
+    for (const ChunkCoord& coord : resident) {
+        std::unique_ptr<Chunk> chunk = world.releaseChunk(coord);
+        if (unloadHandler) {
+            unloadHandler(coord, std::move(chunk));
+        }
+        unloadedCount++;
+    }
+
+    unloadQueue.clear();
+    queueValid = false;
+}
+
+ChunkStreamer::Stats ChunkStreamer::getStats() const
+{
+    Stats stats {};
+    stats.loaded = loadedCount;
+    stats.unloaded = unloadedCount;
+    stats.pending = static_cast<uint32_t>(pendingLoads.size());
+    stats.queued = static_cast<uint32_t>(loadQueue.size());
+    return stats;
+}
+
+}
@@ -0,0 +1,433 @@
+#include "chunk_visibility.hpp"
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr uint16_t ALL_CONNECTED { (1u << 15) - 1 };
+
+    // cached for a reached cell whose chunk is not resident
+    constexpr uint16_t NOT_RESIDENT { 1u << 15 };
+
+    // a cell whose chunk has not been looked up since the cube moved onto it
+    constexpr uint16_t UNKNOWN { 0xffff };
+
+    // entries of a cell the current search found outside the frustum, it is not tested again
+    constexpr uint8_t OUTSIDE { 1u << 7 };
+
+    // a step off the cube in faceSteps
+    constexpr int32_t LEAVES_CUBE { INT32_MIN };
+
+    // frustum planes per cell coordinate, the six planes padded to a width the compiler tests at once
+    constexpr int PLANE_LANES { 8 };
+
+    constexpr std::array<std::array<uint8_t, 6>, 6> PAIR_BITS = [] {
+        std::array<std::array<uint8_t, 6>, 6> bits {};
+        uint8_t next { 0 };
+        for (int a { 0 }; a < 6; a++) {
+            for (int b { a + 1 }; b < 6; b++) {
+                bits[a][b] = next;
+                bits[b][a] = next;
+                next++;
+            }
+        }
+        return bits;
+    }();
+
+    // faces a chunk may be left by for every connectivity, one byte per entry face
+    const std::vector<uint64_t> EXIT_FACES = [] {
+        std::vector<uint64_t> exits(ALL_CONNECTED + 1);
+        for (uint32_t connected { 0 }; connected <= ALL_CONNECTED; connected++) {
+            for (int entry { 0 }; entry < 6; entry++) {
+                uint64_t faces { 0 };
+                for (int face { 0 }; face < 6; face++) {
+                    faces |= face != entry && ((connected >> PAIR_BITS[entry][face]) & 1u) ? 1u << face : 0u;
+                }
+                exits[connected] |= faces << (entry * 8);
+            }
+        }
+        return exits;
+    }();
+
+    // the bytes of EXIT_FACES for a set of entry faces
+    constexpr std::array<uint64_t, 64> ENTRY_BYTES = [] {
+        std::array<uint64_t, 64> bytes {};
+        for (uint32_t entries { 0 }; entries < 64; entries++) {
+            for (int entry { 0 }; entry < 6; entry++) {
+                bytes[entries] |= (entries >> entry) & 1u ? 0xffull << (entry * 8) : 0;
+            }
+        }
+        return bytes;
+    }();
+
+    // faces in Face order, as one bit each
+    uint8_t rowFaces(uint32_t run, int y, int z)
+    {
+        constexpr int LAST { CHUNK_SIZE - 1 };
+
+        uint8_t faces { 0 };
+        faces |= (run >> LAST) & 1u ? 1u << int(Face::PositiveX) : 0u;
+        faces |= run & 1u ? 1u << int(Face::NegativeX) : 0u;
+        faces |= y == LAST ? 1u << int(Face::PositiveY) : 0u;
+        faces |= y == 0 ? 1u << int(Face::NegativeY) : 0u;
+        faces |= z == LAST ? 1u << int(Face::PositiveZ) : 0u;
+        faces |= z == 0 ? 1u << int(Face::NegativeZ) : 0u;
+        return faces;
+    }
+
+    uint32_t reverseBits(uint32_t v)
+    {
+        v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+        v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+        v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+        v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+        return (v >> 16) | (v << 16);
+    }
+
+    // from every seed up to the end of its run, the carry of the addition runs through the open bits
+    uint32_t fillUp(uint32_t seed, uint32_t open)
+    {
+        return (open & ~(open + seed)) | seed;
+    }
+
+    // whole runs of open bits holding a seed
+    uint32_t fillRuns(uint32_t seed, uint32_t open)
+    {
+        seed &= open;
+        return fillUp(seed, open) | reverseBits(fillUp(reverseBits(seed), reverseBits(open)));
+    }
+
+}
+
+uint16_t facePairBit(int a, int b)
+{
+    return uint16_t(1u << PAIR_BITS[a][b]);
+}
+
+uint16_t faceConnectivity(const Chunk& chunk)
+{
+    if (chunk.isEmpty()) {
+        return ALL_CONNECTED;
+    }
+    if (chunk.isFull()) {
+        return 0;
+    }
+
+    // open voxels as rows along x, indexed z | y << 5 like the voxels of a chunk
+    constexpr int ROWS { CHUNK_AREA };
+    uint32_t open[ROWS];
+    uint32_t visited[ROWS] {};
+
+    // straight from the packed palette indices, a chunk with air and solid voxels has at least one bit each
+    const std::vector<Voxel>& palette = chunk.getPalette();
+    std::vector<uint32_t> air(palette.size());
+    for (size_t p { 0 }; p < palette.size(); p++) {
+        air[p] = palette[p] == AIR ? 1u : 0u;
+    }
+
+    uint32_t bits = chunk.getBitsPerIndex();
+    uint32_t perWord = 64 / bits;
+    uint64_t mask = (1ull << bits) - 1;
+
+    std::fill(std::begin(open), std::end(open), 0u);
+    int voxel { 0 };
+    for (uint64_t word : chunk.getIndices()) {
+        for (uint32_t j { 0 }; j < perWord && voxel < CHUNK_VOLUME; j++, voxel++) {
+            open[voxel >> CHUNK_SIZE_LOG2] |= air[(word >> (j * bits)) & mask] << (voxel & (CHUNK_SIZE - 1));
+        }
+    }
+
+    uint16_t connected { 0 };
+    std::vector<std::pair<int, uint32_t>> stack;
+
+    for (int start { 0 }; start < ROWS; start++) {
+        while (uint32_t unvisited = open[start] & ~visited[start]) {
+            // one region of connected open voxels, seeded at its lowest unvisited voxel
+            uint8_t faces { 0 };
+            stack.emplace_back(start, unvisited & (~unvisited + 1));
+
+            while (!stack.empty()) {
+                auto [row, seed] = stack.back();
+                stack.pop_back();
+
+                uint32_t run = fillRuns(seed, open[row] & ~visited[row]);
+                if (run == 0) {
+                    continue;
+                }
+                visited[row] |= run;
+
+                int z = row & (CHUNK_SIZE - 1);
+                int y = row >> CHUNK_SIZE_LOG2;
+                faces |= rowFaces(run, y, z);
+
+                const int neighbors[4] {
+                    z > 0 ? row - 1 : -1,
+                    z < CHUNK_SIZE - 1 ? row + 1 : -1,
+                    y > 0 ? row - CHUNK_SIZE : -1,
+                    y < CHUNK_SIZE - 1 ? row + CHUNK_SIZE : -1,
+                };
+                for (int next : neighbors) {
+                    if (next >= 0 && (run & open[next] & ~visited[next]) != 0) {
+                        stack.emplace_back(next, run & open[next] & ~visited[next]);
+                    }
+                }
+            }
+
+            for (int a { 0 }; a < 6; a++) {
+                for (int b { a + 1 }; b < 6; b++) {
+                    if ((faces >> a) & (faces >> b) & 1u) {
+                        connected |= facePairBit(a, b);
+                    }
+                }
+            }
+        }
+    }
+
+    return connected;
+}
+
+ChunkVisibility::ChunkVisibility(World& world, JobSystem& jobs, int radius)
+    : world { world }
+    , jobs { jobs }
+    , radius { radius }
+    , extent { 2 * radius + 1 }
+    , cube(size_t(extent) * extent * extent, Cell { 0, UNKNOWN, 0 })
+{
+}
+
+size_t ChunkVisibility::cellIndex(const ChunkCoord& coord) const
+{
+    glm::ivec3 wrapped = ((coord % extent) + extent) % extent;
+    return (size_t(wrapped.y) * extent + wrapped.z) * extent + wrapped.x;
+}
+
+void ChunkVisibility::chunkChanged(const ChunkCoord& coord)
+{
+    dirtyChunks.insert(packChunkCoord(coord));
+}
+
+void ChunkVisibility::voxelChanged(const glm::ivec3& voxel)
+{
+    dirtyChunks.insert(packChunkCoord(worldToChunk(voxel)));
+}
+
+void ChunkVisibility::update()
+{
+    if (dirtyChunks.empty()) {
+        return;
+    }
+
+    std::vector<uint64_t> keys { dirtyChunks.begin(), dirtyChunks.end() };
+    std::vector<int32_t> computed(keys.size());
+    dirtyChunks.clear();
+
+    // -1 for chunks that left the world
+    jobs.parallelFor(static_cast<uint32_t>(keys.size()), [&](uint32_t i) {
+        const Chunk* chunk = static_cast<const World&>(world).getChunk(unpackChunkCoord(keys[i]));
+        computed[i] = chunk == nullptr ? -1 : faceConnectivity(*chunk);
+    });
+
+    for (size_t i { 0 }; i < keys.size(); i++) {
+        if (computed[i] < 0) {
+            connectivity.erase(keys[i]);
+        } else {
+            connectivity[keys[i]] = uint16_t(computed[i]);
+        }
+
+        // chunks outside the cube get their cell once it moves onto them
+        ChunkCoord coord = unpackChunkCoord(keys[i]);
+        glm::ivec3 offset = glm::abs(coord - center);
+        if (offset.x <= radius && offset.y <= radius && offset.z <= radius) {
+            cube[cellIndex(coord)].connected = computed[i] < 0 ? NOT_RESIDENT : uint16_t(computed[i]);
+        }
+    }
+
+    stats.connectivityUpdates += static_cast<uint32_t>(keys.size());
+}
+
+void ChunkVisibility::moveCube(const ChunkCoord& camera)
+{
+    glm::ivec3 moved = camera - center;
+    center = camera;
+    if (glm::any(glm::greaterThanEqual(glm::abs(moved), glm::ivec3 { extent }))) {
+        for (Cell& cell : cube) {
+            cell.connected = UNKNOWN;
+        }
+        return;
+    }
+
+    // per axis the layers of cells that now hold chunks on the far side of the cube
+    for (int axis { 0 }; axis < 3; axis++) {
+        int first = moved[axis] > 0 ? center[axis] + radius - moved[axis] + 1 : center[axis] - radius;
+        for (int layer { 0 }; layer < std::abs(moved[axis]); layer++) {
+            int wrapped = (((first + layer) % extent) + extent) % extent;
+            for (int a { 0 }; a < extent; a++) {
+                for (int b { 0 }; b < extent; b++) {
+                    glm::ivec3 cell;
+                    cell[axis] = wrapped;
+                    cell[(axis + 1) % 3] = a;
+                    cell[(axis + 2) % 3] = b;
+                    cube[(size_t(cell.y) * extent + cell.z) * extent + cell.x].connected = UNKNOWN;
+                }
+            }
+        }
+    }
+}
+
+void ChunkVisibility::traverse(const glm::vec3& cameraPosition, const Frustum& frustum)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // the stamps wrap every 65536 searches, clearing them keeps old ones from matching
+    if (++search == 0) {
+        for (Cell& cell : cube) {
+            cell.search = 0;
+        }
+        search = 1;
+    }
+
+    moveCube(worldToChunk(glm::ivec3 { glm::floor(cameraPosition) }));
+    const glm::ivec3 corner = center - radius;
+
+    // the distance of a cell's corner furthest along a plane's normal splits into one term per axis,
+    // the padding planes are always in front
+    planeDistances.assign(size_t(3) * extent * PLANE_LANES, 1.0f);
+    for (int p { 0 }; p < int(frustum.planes.size()); p++) {
+        const glm::vec4& plane = frustum.planes[p];
+        for (int axis { 0 }; axis < 3; axis++) {
+            float offset = plane[axis] >= 0.0f ? float(CHUNK_SIZE) : 0.0f;
+            for (int i { 0 }; i < extent; i++) {
+                planeDistances[(size_t(axis) * extent + i) * PLANE_LANES + p]
+                    = plane[axis] * (float((corner[axis] + i) * CHUNK_SIZE) + offset) + (axis == 0 ? plane.w : 0.0f);
+            }
+        }
+    }
+
+    // the entry bytes written below may alias any member, the loop keeps what it reads in locals
+    const int size { extent };
+    const uint16_t current { search };
+    Cell* cells = cube.data();
+    const float* distances = planeDistances.data();
+
+    auto inFrustum = [size, distances](int x, int y, int z) {
+        const float* xs = distances + size_t(x) * PLANE_LANES;
+        const float* ys = distances + (size_t(size) + y) * PLANE_LANES;
+        const float* zs = distances + (size_t(2) * size + z) * PLANE_LANES;
+        bool inside { true };
+        for (int p { 0 }; p < PLANE_LANES; p++) {
+            inside &= xs[p] + ys[p] + zs[p] >= 0.0f;
+        }
+        return inside;
+    };
+
+    // cells wrap around the cube, per face and coordinate along its axis how far the index moves with a
+    // step, or that the step leaves the cube
+    const glm::ivec3 wrappedCorner = ((corner % extent) + extent) % extent;
+    faceSteps.resize(size_t(6) * extent);
+    for (int face { 0 }; face < 6; face++) {
+        int axis = face >> 1;
+        int64_t stride = axis == 0 ? 1 : axis == 1 ? int64_t(extent) * extent : extent;
+        for (int i { 0 }; i < extent; i++) {
+            int from = (wrappedCorner[axis] + i) % extent;
+            int to = face & 1 ? (from == 0 ? extent - 1 : from - 1) : (from == extent - 1 ? 0 : from + 1);
+            bool leaves = face & 1 ? i == 0 : i == extent - 1;
+            faceSteps[size_t(face) * extent + i] = leaves ? LEAVES_CUBE : int32_t((to - from) * stride);
+        }
+    }
+    const int32_t* steps = faceSteps.data();
+
+    // the map is only looked up for chunks the cube moved onto
+    auto reach = [this, corner](Cell& cell, const glm::ivec3& local) {
+        if (cell.connected == UNKNOWN) {
+            const uint16_t* connected = connectivity.find(packChunkCoord(corner + local));
+            cell.connected = connected == nullptr ? NOT_RESIDENT : *connected;
+        }
+    };
+
+    // the queue keeps the length of the longest search
+    glm::ivec3 origin { radius };
+    queue.resize(std::max(queue.size(), size_t(64)));
+    queue[0] = { origin, uint32_t(cellIndex(center)), 0 };
+    size_t tail { 1 };
+    reach(cells[queue[0].index], origin);
+    cells[queue[0].index].search = current;
+    cells[queue[0].index].entries = 0;
+
+    for (size_t head { 0 }; head < tail; head++) {
+        if (tail + 6 > queue.size()) {
+            queue.resize(queue.size() * 2);
+        }
+
+        Step step = queue[head];
+        const Cell& cell = cells[step.index];
+
+        // the camera chunk is left by every face, chunks that are not resident end the search
+        uint32_t exits { 0x3f };
+        if (head != 0) {
+            if (cell.connected == NOT_RESIDENT) {
+                continue;
+            }
+            uint64_t bytes = EXIT_FACES[cell.connected] & ENTRY_BYTES[cell.entries];
+            bytes |= bytes >> 32;
+            bytes |= bytes >> 16;
+            bytes |= bytes >> 8;
+            exits = uint32_t(bytes) & 0x3f;
+        }
+
+        // never back towards the camera
+        uint32_t backwards = ((step.directions & 0x15u) << 1) | ((step.directions >> 1) & 0x15u);
+        exits &= ~backwards;
+
+        for (; exits != 0; exits &= exits - 1) {
+            int face = std::countr_zero(exits);
+            int32_t move = steps[face * size + step.local[face >> 1]];
+            if (move == LEAVES_CUBE) {
+                continue;
+            }
+
+            // only cells reached for the first time are tested against the frustum and queued, one entered
+            // again through another face is still waiting in the next layer and just gains the face
+            uint32_t index = uint32_t(int64_t(step.index) + move);
+            glm::ivec3 next = step.local + FACE_DIRECTIONS[face];
+            Cell& neighbor = cells[index];
+            if (neighbor.search != current) {
+                neighbor.search = current;
+                if (!inFrustum(next.x, next.y, next.z)) {
+                    neighbor.entries = OUTSIDE;
+                    continue;
+                }
+
+                reach(neighbor, next);
+                neighbor.entries = 0;
+                queue[tail++] = { next, index, uint8_t(step.directions | (1u << face)) };
+            } else if (neighbor.entries == OUTSIDE) {
+                continue;
+            }
+            neighbor.entries |= uint8_t(1u << (face ^ 1));
+        }
+    }
+
+    stats.steps = static_cast<uint32_t>(tail);
+    stats.searchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool ChunkVisibility::isVisible(const ChunkCoord& coord) const
+{
+    if (search == 0) {
+        return true;
+    }
+
+    glm::ivec3 offset = glm::abs(coord - center);
+    if (offset.x > radius || offset.y > radius || offset.z > radius) {
+        return true;
+    }
+
+    const Cell& cell = cube[cellIndex(coord)];
+    return cell.search == search && cell.entries != OUTSIDE;
+}
+
+}
@@ -145,6 +145,37 @@ QueueFamilyIndices findQueueFamilies(
     return indices;
 }
 
+namespace {
+
+    const std::vector<const char*> meshShaderExtensions {
+        VK_EXT_MESH_SHADER_EXTENSION_NAME,
+        VK_KHR_SPIRV_1_4_EXTENSION_NAME,
+        VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME
+    };
+
+}
+
+bool supportsMeshShaders(const vk::PhysicalDevice& physicalDevice)
+{
+    uint32_t version = VK_MAKE_API_VERSION(0, 1, 1, 0);
+    if (vk::enumerateInstanceVersion() < version || physicalDevice.getProperties().apiVersion < version) {
+        return false;
+    }
+
+    if (!checkDeviceExtensionSupport(physicalDevice, meshShaderExtensions)) {
+        return false;
+    }
+
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    const auto& meshFeatures = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+    return meshFeatures.taskShader && meshFeatures.meshShader;
+}
+
+PFN_vkCmdDrawMeshTasksEXT loadDrawMeshTasks(const vk::Device& device)
+{
+    return reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(device.getProcAddr("vkCmdDrawMeshTasksEXT"));
+}
+
 vk::Device createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface)
 {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
@@ -175,6 +206,20 @@ vk::Device createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const v
     vk::PhysicalDeviceFeatures enabledFeatures {};
     enabledFeatures.setGeometryShader(true);
 
+    // optional, meshlet drawing needs the first and takes several draws per indirect call with the second
+    vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
+    enabledFeatures.setDrawIndirectFirstInstance(supportedFeatures.drawIndirectFirstInstance);
+    enabledFeatures.setMultiDrawIndirect(supportedFeatures.multiDrawIndirect);
+
+    // optional, chunk faces and meshlets are drawn by task and mesh shaders where the device has them
+    vk::PhysicalDeviceMeshShaderFeaturesEXT meshFeatures {};
+    bool meshShading = supportsMeshShaders(physicalDevice);
+    if (meshShading) {
+        deviceExtensions.insert(deviceExtensions.end(), meshShaderExtensions.begin(), meshShaderExtensions.end());
+        meshFeatures.setTaskShader(true);
+        meshFeatures.setMeshShader(true);
+    }
+
     std::vector<const char*> enabledLayers;
     if (DEBUG_MODE) {
         enabledLayers.push_back("VK_LAYER_KHRONOS_validation");
@@ -191,6 +236,10 @@ vk::Device createLogicalDevice(const vk::PhysicalDevice& physicalDevice, const v
         &enabledFeatures
     };
 
+    if (meshShading) {
+        createInfo.pNext = &meshFeatures;
+    }
+
     try {
         vk::Device device = physicalDevice.createDevice(createInfo);
 
@@ -0,0 +1,673 @@
+#include "dynamic_bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace VoKel {
+
+namespace {
+
+    // internal nodes whose refit area grows past this factor of their build area are rebuilt
+    constexpr float DEGRADE_RATIO { 2.0f };
+
+    // fat boxes are stretched this many moves ahead along the displacement
+    constexpr float DISPLACEMENT_AHEAD { 2.0f };
+
+    constexpr int BINS { 12 };
+
+    // queries handed to a job at once
+    constexpr uint32_t QUERIES_PER_JOB { 64 };
+
+    float area(const glm::vec3& min, const glm::vec3& max)
+    {
+        glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    bool overlaps(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+    {
+        return glm::all(glm::lessThanEqual(minA, maxB)) && glm::all(glm::lessThanEqual(minB, maxA));
+    }
+
+    bool contains(const glm::vec3& outerMin, const glm::vec3& outerMax, const glm::vec3& min, const glm::vec3& max)
+    {
+        return glm::all(glm::lessThanEqual(outerMin, min)) && glm::all(glm::lessThanEqual(max, outerMax));
+    }
+
+    // entry distance of the ray into the box, or a negative value when it misses within maxDistance
+    float rayEntry(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverse, float maxDistance)
+    {
+        glm::vec3 t0 = (min - origin) * inverse;
+        glm::vec3 t1 = (max - origin) * inverse;
+        glm::vec3 near = glm::min(t0, t1);
+        glm::vec3 far = glm::max(t0, t1);
+
+        float entry = std::max({ near.x, near.y, near.z, 0.0f });
+        float exit = std::min({ far.x, far.y, far.z, maxDistance });
+        return entry <= exit ? entry : -1.0f;
+    }
+
+}
+
+DynamicBvh::DynamicBvh(float margin)
+    : margin { margin }
+{
+}
+
+uint32_t DynamicBvh::insert(const glm::vec3& min, const glm::vec3& max, uint32_t data)
+{
+    uint32_t leaf = allocateNode();
+
+    glm::vec3 pad = (max - min) * margin;
+    Node& node = nodes[leaf];
+    node.min = min - pad;
+    node.max = max + pad;
+    node.data = data;
+    node.moved = true;
+
+    tightMin[leaf] = min;
+    tightMax[leaf] = max;
+    movedLeaves.push_back(leaf);
+
+    insertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void DynamicBvh::remove(uint32_t leaf)
+{
+    removeLeaf(leaf);
+    freeNode(leaf);
+    leafCount--;
+}
+
+bool DynamicBvh::move(uint32_t leaf, const glm::vec3& min, const glm::vec3& max, const glm::vec3& displacement)
+{
+    tightMin[leaf] = min;
+    tightMax[leaf] = max;
+
+    Node& node = nodes[leaf];
+    if (contains(node.min, node.max, min, max)) {
+        return false;
+    }
+
+    glm::vec3 pad = (max - min) * margin;
+    glm::vec3 ahead = displacement * DISPLACEMENT_AHEAD;
+    glm::vec3 fatMin = min - pad + glm::min(ahead, glm::vec3 { 0.0f });
+    glm::vec3 fatMax = max + pad + glm::max(ahead, glm::vec3 { 0.0f });
+
+    // a short move patches the bounds up the tree, a jump finds the leaf a new place
+    if (overlaps(node.min, node.max, fatMin, fatMax)) {
+        node.min = fatMin;
+        node.max = fatMax;
+        refit(node.parent, true);
+        refits++;
+    } else {
+        removeLeaf(leaf);
+        nodes[leaf].min = fatMin;
+        nodes[leaf].max = fatMax;
+        insertLeaf(leaf);
+        reinserts++;
+    }
+
+    if (!nodes[leaf].moved) {
+        nodes[leaf].moved = true;
+        movedLeaves.push_back(leaf);
+    }
+    return true;
+}
+
+void DynamicBvh::optimize()
+{
+    std::vector<uint32_t> candidates;
+    candidates.swap(degradedNodes);
+
+    for (uint32_t candidate : candidates) {
+        if (!nodes[candidate].degraded) {
+            continue;
+        }
+
+        // the highest degraded ancestor takes the whole subtree with it
+        uint32_t top = candidate;
+        for (uint32_t node = nodes[candidate].parent; node != NULL_NODE; node = nodes[node].parent) {
+            if (nodes[node].degraded) {
+                top = node;
+            }
+        }
+
+        rebuild(top);
+    }
+}
+
+void DynamicBvh::clear()
+{
+    nodes.clear();
+    tightMin.clear();
+    tightMax.clear();
+    degradedNodes.clear();
+    movedLeaves.clear();
+    freeList = NULL_NODE;
+    root = NULL_NODE;
+    leafCount = 0;
+}
+
+template <typename Visit>
+void DynamicBvh::forEachOverlap(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& stack, Visit&& visit) const
+{
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    stack.clear();
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[index];
+        if (!overlaps(node.min, node.max, min, max)) {
+            continue;
+        }
+
+        if (!node.isLeaf()) {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        } else if (overlaps(tightMin[index], tightMax[index], min, max)) {
+            visit(index);
+        }
+    }
+}
+
+void DynamicBvh::query(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& hits) const
+{
+    std::vector<uint32_t> stack;
+    forEachOverlap(min, max, stack, [&](uint32_t leaf) {
+        hits.push_back(nodes[leaf].data);
+    });
+}
+
+void DynamicBvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    // planes a node still straddles, a node inside a plane passes it on to its children
+    std::vector<std::pair<uint32_t, uint8_t>> stack;
+    stack.emplace_back(root, uint8_t(0x3f));
+
+    while (!stack.empty()) {
+        auto [index, planes] = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[index];
+        const glm::vec3& min = node.isLeaf() ? tightMin[index] : node.min;
+        const glm::vec3& max = node.isLeaf() ? tightMax[index] : node.max;
+
+        bool outside { false };
+        for (int p { 0 }; p < 6 && !outside; p++) {
+            if (((planes >> p) & 1u) == 0) {
+                continue;
+            }
+
+            const glm::vec4& plane = frustum.planes[p];
+            glm::vec3 positive { plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z };
+            glm::vec3 negative { plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y, plane.z >= 0.0f ? min.z : max.z };
+
+            outside = glm::dot(glm::vec3 { plane }, positive) + plane.w < 0.0f;
+            if (glm::dot(glm::vec3 { plane }, negative) + plane.w >= 0.0f) {
+                planes &= uint8_t(~(1u << p));
+            }
+        }
+
+        if (outside) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            visible.push_back(node.data);
+        } else {
+            stack.emplace_back(node.left, planes);
+            stack.emplace_back(node.right, planes);
+        }
+    }
+}
+
+uint32_t DynamicBvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const
+{
+    uint32_t hit { NULL_NODE };
+    distance = maxDistance;
+
+    if (root == NULL_NODE) {
+        return hit;
+    }
+
+    glm::vec3 inverse = 1.0f / direction;
+
+    // nearer child on top, nodes entered past the closest hit are skipped
+    std::vector<std::pair<uint32_t, float>> stack;
+    float rootEntry = rayEntry(nodes[root].min, nodes[root].max, origin, inverse, distance);
+    if (rootEntry >= 0.0f) {
+        stack.emplace_back(root, rootEntry);
+    }
+
+    while (!stack.empty()) {
+        auto [index, entry] = stack.back();
+        stack.pop_back();
+
+        if (entry > distance) {
+            continue;
+        }
+
+        const Node& node = nodes[index];
+        if (node.isLeaf()) {
+            float t = rayEntry(tightMin[index], tightMax[index], origin, inverse, distance);
+            if (t >= 0.0f && (hit == NULL_NODE || t < distance)) {
+                hit = node.data;
+                distance = t;
+            }
+            continue;
+        }
+
+        float left = rayEntry(nodes[node.left].min, nodes[node.left].max, origin, inverse, distance);
+        float right = rayEntry(nodes[node.right].min, nodes[node.right].max, origin, inverse, distance);
+
+        std::pair<uint32_t, float> near { node.left, left };
+        std::pair<uint32_t, float> far { node.right, right };
+        if (right >= 0.0f && (left < 0.0f || right < left)) {
+            std::swap(near, far);
+        }
+
+        if (far.second >= 0.0f) {
+            stack.push_back(far);
+        }
+        if (near.second >= 0.0f) {
+            stack.push_back(near);
+        }
+    }
+
+    return hit;
+}
+
+void DynamicBvh::queryBatch(JobSystem& jobs, const std::vector<BoxQuery>& queries, std::vector<std::vector<uint32_t>>& hits) const
+{
+    hits.resize(queries.size());
+
+    uint32_t groups = static_cast<uint32_t>((queries.size() + QUERIES_PER_JOB - 1) / QUERIES_PER_JOB);
+    jobs.parallelFor(groups, [&](uint32_t group) {
+        std::vector<uint32_t> stack;
+        size_t end = std::min(queries.size(), size_t(group + 1) * QUERIES_PER_JOB);
+
+        for (size_t i { size_t(group) * QUERIES_PER_JOB }; i < end; i++) {
+            hits[i].clear();
+            forEachOverlap(queries[i].min, queries[i].max, stack, [&](uint32_t leaf) {
+                hits[i].push_back(nodes[leaf].data);
+            });
+        }
+    });
+}
+
+void DynamicBvh::collectPairs(JobSystem& jobs, std::vector<std::pair<uint32_t, uint32_t>>& pairs)
+{
+    pairs.clear();
+
+    // leaves removed since they moved may have been reused, only those still flagged count
+    std::sort(movedLeaves.begin(), movedLeaves.end());
+    movedLeaves.erase(std::unique(movedLeaves.begin(), movedLeaves.end()), movedLeaves.end());
+
+    std::vector<uint32_t> moved;
+    for (uint32_t leaf : movedLeaves) {
+        if (nodes[leaf].moved && nodes[leaf].isLeaf()) {
+            moved.push_back(leaf);
+        }
+    }
+    movedLeaves.clear();
+
+    uint32_t groups = static_cast<uint32_t>((moved.size() + QUERIES_PER_JOB - 1) / QUERIES_PER_JOB);
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found(groups);
+
+    jobs.parallelFor(groups, [&](uint32_t group) {
+        std::vector<uint32_t> stack;
+        size_t end = std::min(moved.size(), size_t(group + 1) * QUERIES_PER_JOB);
+
+        for (size_t i { size_t(group) * QUERIES_PER_JOB }; i < end; i++) {
+            uint32_t leaf = moved[i];
+            forEachOverlap(tightMin[leaf], tightMax[leaf], stack, [&](uint32_t other) {
+                // two moved leaves find each other, the lower index reports the pair
+                if (other == leaf || (nodes[other].moved && other < leaf)) {
+                    return;
+                }
+
+                uint32_t a = nodes[leaf].data;
+                uint32_t b = nodes[other].data;
+                found[group].emplace_back(std::min(a, b), std::max(a, b));
+            });
+        }
+    });
+
+    for (uint32_t leaf : moved) {
+        nodes[leaf].moved = false;
+    }
+
+    for (const auto& group : found) {
+        pairs.insert(pairs.end(), group.begin(), group.end());
+    }
+}
+
+DynamicBvh::Stats DynamicBvh::getStats() const
+{
+    Stats stats {};
+    stats.leaves = leafCount;
+    stats.refits = refits;
+    stats.reinserts = reinserts;
+    stats.rebuiltNodes = rebuiltNodes;
+
+    if (root == NULL_NODE) {
+        return stats;
+    }
+
+    stats.height = nodes[root].height;
+
+    float internal { 0.0f };
+    std::vector<uint32_t> stack { root };
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+
+        if (!node.isLeaf()) {
+            internal += area(node.min, node.max);
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    float rootArea = area(nodes[root].min, nodes[root].max);
+    stats.cost = rootArea > 0.0f ? internal / rootArea : 0.0f;
+    return stats;
+}
+
+uint32_t DynamicBvh::allocateNode()
+{
+    uint32_t index;
+    if (freeList != NULL_NODE) {
+        index = freeList;
+        freeList = nodes[index].parent;
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        tightMin.emplace_back(0.0f);
+        tightMax.emplace_back(0.0f);
+    }
+
+    nodes[index] = Node { glm::vec3 { 0.0f }, NULL_NODE, glm::vec3 { 0.0f }, NULL_NODE, NULL_NODE, NULL_NODE, 0.0f, 0, false, false };
+    return index;
+}
+
+void DynamicBvh::freeNode(uint32_t node)
+{
+    nodes[node].parent = freeList;
+    nodes[node].left = NULL_NODE;
+    nodes[node].degraded = false;
+    nodes[node].moved = false;
+    freeList = node;
+}
+
+void DynamicBvh::insertLeaf(uint32_t leaf)
+{
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    uint32_t sibling = findSibling(nodes[leaf].min, nodes[leaf].max);
+    uint32_t oldParent = nodes[sibling].parent;
+
+    // may grow the array, no references are held across it
+    uint32_t parent = allocateNode();
+    nodes[parent].parent = oldParent;
+    nodes[parent].left = sibling;
+    nodes[parent].right = leaf;
+
+    if (oldParent == NULL_NODE) {
+        root = parent;
+    } else if (nodes[oldParent].left == sibling) {
+        nodes[oldParent].left = parent;
+    } else {
+        nodes[oldParent].right = parent;
+    }
+
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+
+    refit(parent, false);
+}
+
+void DynamicBvh::removeLeaf(uint32_t leaf)
+{
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    uint32_t parent = nodes[leaf].parent;
+    uint32_t grandParent = nodes[parent].parent;
+    uint32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    nodes[sibling].parent = grandParent;
+    if (grandParent == NULL_NODE) {
+        root = sibling;
+    } else {
+        if (nodes[grandParent].left == parent) {
+            nodes[grandParent].left = sibling;
+        } else {
+            nodes[grandParent].right = sibling;
+        }
+        refit(grandParent, true);
+    }
+
+    freeNode(parent);
+}
+
+uint32_t DynamicBvh::findSibling(const glm::vec3& min, const glm::vec3& max) const
+{
+    // branch and bound over the cost of pairing with a node plus the growth of its ancestors
+    float leafArea = area(min, max);
+
+    uint32_t best { root };
+    float bestCost = area(glm::min(min, nodes[root].min), glm::max(max, nodes[root].max));
+
+    std::vector<std::pair<uint32_t, float>> stack;
+    stack.emplace_back(root, 0.0f);
+
+    while (!stack.empty()) {
+        auto [index, inherited] = stack.back();
+        stack.pop_back();
+
+        const Node& node = nodes[index];
+        float direct = area(glm::min(min, node.min), glm::max(max, node.max));
+        float cost = direct + inherited;
+        if (cost < bestCost) {
+            best = index;
+            bestCost = cost;
+        }
+
+        if (node.isLeaf()) {
+            continue;
+        }
+
+        float childInherited = inherited + direct - area(node.min, node.max);
+        if (leafArea + childInherited < bestCost) {
+            stack.emplace_back(node.left, childInherited);
+            stack.emplace_back(node.right, childInherited);
+        }
+    }
+
+    return best;
+}
+
+void DynamicBvh::refit(uint32_t index, bool patch)
+{
+    // patching stops where nothing changes and flags the nodes that grew too much,
+    // inserting makes the ancestors fit their new subtree as if just built
+    while (index != NULL_NODE) {
+        Node& node = nodes[index];
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+
+        glm::vec3 min = glm::min(left.min, right.min);
+        glm::vec3 max = glm::max(left.max, right.max);
+        uint16_t height = uint16_t(1 + std::max(left.height, right.height));
+
+        if (patch && min == node.min && max == node.max && height == node.height) {
+            return;
+        }
+
+        node.min = min;
+        node.max = max;
+        node.height = height;
+
+        if (!patch) {
+            node.buildArea = area(min, max);
+        } else if (!node.degraded && area(min, max) > DEGRADE_RATIO * node.buildArea) {
+            node.degraded = true;
+            degradedNodes.push_back(index);
+        }
+
+        index = node.parent;
+    }
+}
+
+uint32_t DynamicBvh::build(std::vector<uint32_t>& leaves, size_t begin, size_t end)
+{
+    if (end - begin == 1) {
+        return leaves[begin];
+    }
+
+    glm::vec3 centerMin { std::numeric_limits<float>::max() };
+    glm::vec3 centerMax { -std::numeric_limits<float>::max() };
+    for (size_t i { begin }; i < end; i++) {
+        glm::vec3 center = (nodes[leaves[i]].min + nodes[leaves[i]].max) * 0.5f;
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+
+    glm::vec3 extent = centerMax - centerMin;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+    size_t middle = begin + (end - begin) / 2;
+    if (extent[axis] > 0.0f) {
+        // surface area heuristic over centroid bins along the widest axis
+        struct Bin {
+            glm::vec3 min { std::numeric_limits<float>::max() };
+            glm::vec3 max { -std::numeric_limits<float>::max() };
+            uint32_t count { 0 };
+        };
+        Bin bins[BINS];
+
+        float scale = BINS / extent[axis];
+        auto binOf = [&](uint32_t leaf) {
+            float center = (nodes[leaf].min[axis] + nodes[leaf].max[axis]) * 0.5f;
+            return std::min(BINS - 1, int((center - centerMin[axis]) * scale));
+        };
+
+        for (size_t i { begin }; i < end; i++) {
+            Bin& bin = bins[binOf(leaves[i])];
+            bin.min = glm::min(bin.min, nodes[leaves[i]].min);
+            bin.max = glm::max(bin.max, nodes[leaves[i]].max);
+            bin.count++;
+        }
+
+        // areas and counts of everything right of each split, swept from the far end
+        float rightCost[BINS];
+        Bin sweep;
+        for (int b { BINS - 1 }; b > 0; b--) {
+            sweep.min = glm::min(sweep.min, bins[b].min);
+            sweep.max = glm::max(sweep.max, bins[b].max);
+            sweep.count += bins[b].count;
+            rightCost[b] = sweep.count > 0 ? area(sweep.min, sweep.max) * sweep.count : 0.0f;
+        }
+
+        int bestSplit { 0 };
+        float bestCost { std::numeric_limits<float>::max() };
+        sweep = Bin {};
+        for (int b { 0 }; b < BINS - 1; b++) {
+            sweep.min = glm::min(sweep.min, bins[b].min);
+            sweep.max = glm::max(sweep.max, bins[b].max);
+            sweep.count += bins[b].count;
+
+            float cost = (sweep.count > 0 ? area(sweep.min, sweep.max) * sweep.count : 0.0f) + rightCost[b + 1];
+            if (sweep.count > 0 && sweep.count < end - begin && cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b + 1;
+            }
+        }
+
+        if (bestSplit > 0) {
+            auto split = std::partition(leaves.begin() + begin, leaves.begin() + end, [&](uint32_t leaf) {
+                return binOf(leaf) < bestSplit;
+            });
+            middle = size_t(split - leaves.begin());
+        }
+    }
+
+    if (middle == begin || middle == end) {
+        middle = begin + (end - begin) / 2;
+    }
+
+    uint32_t left = build(leaves, begin, middle);
+    uint32_t right = build(leaves, middle, end);
+
+    uint32_t index = allocateNode();
+    Node& node = nodes[index];
+    node.left = left;
+    node.right = right;
+    node.min = glm::min(nodes[left].min, nodes[right].min);
+    node.max = glm::max(nodes[left].max, nodes[right].max);
+    node.height = uint16_t(1 + std::max(nodes[left].height, nodes[right].height));
+    node.buildArea = area(node.min, node.max);
+
+    nodes[left].parent = index;
+    nodes[right].parent = index;
+    return index;
+}
+
+void DynamicBvh::rebuild(uint32_t index)
+{
+    uint32_t parent = nodes[index].parent;
+    bool wasLeft = parent != NULL_NODE && nodes[parent].left == index;
+
+    // the internal nodes are freed first, the build takes them back from the free list
+    std::vector<uint32_t> leaves;
+    std::vector<uint32_t> stack { index };
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+
+        if (nodes[node].isLeaf()) {
+            leaves.push_back(node);
+        } else {
+            stack.push_back(nodes[node].left);
+            stack.push_back(nodes[node].right);
+            freeNode(node);
+            rebuiltNodes++;
+        }
+    }
+
+    uint32_t subtree = build(leaves, 0, leaves.size());
+    nodes[subtree].parent = parent;
+
+    if (parent == NULL_NODE) {
+        root = subtree;
+    } else {
+        if (wasLeft) {
+            nodes[parent].left = subtree;
+        } else {
+            nodes[parent].right = subtree;
+        }
+        refit(parent, true);
+    }
+}
+
+}
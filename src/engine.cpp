@@ -3,8 +3,10 @@
 #include "config.hpp"
 #include "device.hpp"
 #include "framebuffer.hpp"
+#include "image.hpp"
 #include "instance.hpp"
 #include "logging.hpp"
+#include "mesh.hpp"
 #include "pipeline.hpp"
 #include "render_structs.hpp"
 #include "scene.hpp"
@@ -43,10 +45,39 @@ Engine::~Engine()
     device.destroyRenderPass(renderpass);
     device.destroyPipelineLayout(layout);
     device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(chunkLayout);
+    device.destroyPipeline(chunkPipeline);
+    device.destroyPipelineLayout(chunkFaceLayout);
+    device.destroyPipeline(chunkFacePipeline);
+    if (meshletPipeline) {
+        device.destroyPipelineLayout(meshletLayout);
+        device.destroyPipeline(meshletPipeline);
+    }
+    if (chunkFaceMeshPipeline) {
+        device.destroyPipelineLayout(chunkFaceMeshLayout);
+        device.destroyPipeline(chunkFaceMeshPipeline);
+    }
+    if (meshletMeshPipeline) {
+        device.destroyPipelineLayout(meshletMeshLayout);
+        device.destroyPipeline(meshletMeshPipeline);
+    }
+    if (geometryQueries) {
+        device.destroyQueryPool(geometryQueries);
+    }
+
+    device.destroyDescriptorPool(geometryDescriptorPool);
+    device.destroyDescriptorSetLayout(overlayGeometryLayout);
+    device.destroyDescriptorSetLayout(chunkGeometryLayout);
 
     cleanupSwapchain();
 
     delete triangleMesh;
+    delete instanceBuffer;
+    delete raymarcher;
+    delete meshletRenderer;
+    delete chunkMesher;
+    delete chunkMeshPool;
+    delete materialAtlas;
 
     device.destroy();
 
@@ -67,6 +98,9 @@ void Engine::cleanupSwapchain()
         device.destroySemaphore(frame.renderFinished);
         device.destroyImageView(frame.imageView);
         device.destroyFramebuffer(frame.framebuffer);
+        device.destroyImageView(frame.depthBufferView);
+        device.destroyImage(frame.depthBuffer);
+        device.freeMemory(frame.depthBufferMemory);
     }
 
     device.destroySwapchainKHR(swapchain);
@@ -103,18 +137,39 @@ void Engine::createDevice()
     device = vkInit::createLogicalDevice(physicalDevice, surface);
     std::tie(graphicsQueue, presentQueue) = vkInit::getQueue(physicalDevice, device, surface);
 
+    // the logical device enabled them under the same check
+    meshShading = vkInit::supportsMeshShaders(physicalDevice);
+    if (meshShading) {
+        drawMeshTasks = vkInit::loadDrawMeshTasks(device);
+    }
+
+    depthFormat = vkImage::findSupportedFormat(
+        physicalDevice,
+        { vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint },
+        vk::ImageTiling::eOptimal,
+        vk::FormatFeatureFlagBits::eDepthStencilAttachment);
+
     createSwapchain();
     frameNumber = 0;
 }
 
 void Engine::createSwapchain()
 {
-    vkInit::SwapchainBundle bundle = vkInit::createSwapchain(device, physicalDevice, surface, width, height);
+    // the per-frame resources are sized once for the first swapchain's images, a recreated swapchain is asked
+    // for at least as many so frameNumber stays within all of them, any images beyond are simply not used for frames
+    bool first = maxFrameInFlight == 0;
+
+    vkInit::SwapchainBundle bundle = vkInit::createSwapchain(device, physicalDevice, surface, width, height, static_cast<uint32_t>(maxFrameInFlight));
     swapchain = bundle.swapchain;
     swapchainFormat = bundle.format;
     swapchainFrames = bundle.frames;
     swapchainExtent = bundle.extent;
-    maxFrameInFlight = static_cast<int>(swapchainFrames.size());
+
+    if (first) {
+        maxFrameInFlight = static_cast<int>(swapchainFrames.size());
+    } else if (swapchainFrames.size() < size_t(maxFrameInFlight)) {
+        throw std::runtime_error { "The recreated swapchain has fewer images than frames in flight" };
+    }
 }
 
 void Engine::recreateSwapchain()
@@ -127,26 +182,149 @@ void Engine::recreateSwapchain()
 
     cleanupSwapchain();
     createSwapchain();
+    createDepthBuffers();
     createFramebuffers();
     createFrameSyncObj();
 
     vkInit::commandBufferInputChunk commandBufferInput { device, commandPool, swapchainFrames };
     vkInit::createFrameCommandBuffer(commandBufferInput);
+
+    if (raymarcher != nullptr) {
+        raymarcher->setTargets(swapchainExtent, static_cast<uint32_t>(swapchainFrames.size()));
+    }
 }
 
 void Engine::createPipeline()
 {
+    // the chunk pipeline layout takes the material set
+    if (materialAtlas == nullptr) {
+        materialAtlas = new MaterialAtlas(device, physicalDevice);
+    }
+
+    // no fixed vertex input, the overlay reads its triangle and instances and the chunks the pool's vertex buffer
+    // the task and mesh shaders read the chunk faces too where there are any
+    vk::ShaderStageFlags chunkGeometryStages = vk::ShaderStageFlagBits::eVertex;
+    if (meshShading) {
+        chunkGeometryStages |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+    }
+
+    overlayGeometryLayout = vkInit::createStorageBufferSetLayout(device, 2);
+    chunkGeometryLayout = vkInit::createStorageBufferSetLayout(device, 1, chunkGeometryStages);
+
     vkInit::GraphicsPipelineInBundle specification {};
     specification.device = device;
     specification.vertFilePath = "../../shaders/bin/main.vert.spv";
     specification.fragFilePath = "../../shaders/bin/main.frag.spv";
     specification.swapchainExtent = swapchainExtent;
     specification.format = swapchainFormat;
+    specification.depthFormat = depthFormat;
+    specification.pushConstantSize = 0;
+    specification.descriptorSetLayouts = { overlayGeometryLayout };
+    specification.depthTest = false;
 
     vkInit::GraphicsPipelineOutBundle output = vkInit::createGraphicsPipeline(specification, pipeline);
     layout = output.layout;
     renderpass = output.renderpass;
     pipeline = output.pipeline;
+
+    // chunk meshes share the render pass, they are depth tested and wound counter clockwise
+    specification.vertFilePath = "../../shaders/bin/chunk.vert.spv";
+    specification.fragFilePath = "../../shaders/bin/chunk.frag.spv";
+    specification.pushConstantSize = sizeof(vkUtil::ChunkData);
+    specification.descriptorSetLayouts = { materialAtlas->getDescriptorSetLayout(), chunkGeometryLayout };
+    specification.frontFace = vk::FrontFace::eCounterClockwise;
+    specification.depthTest = true;
+    specification.renderpass = renderpass;
+
+    output = vkInit::createGraphicsPipeline(specification, chunkPipeline);
+    chunkLayout = output.layout;
+    chunkPipeline = output.pipeline;
+
+    // voxel faces expand into their two triangles in the vertex shader, the layouts match so the sets stay bound
+    specification.vertFilePath = "../../shaders/bin/chunk_face.vert.spv";
+
+    output = vkInit::createGraphicsPipeline(specification, chunkFacePipeline);
+    chunkFaceLayout = output.layout;
+    chunkFacePipeline = output.pipeline;
+
+    // the same faces from the task and mesh shaders, the push constants differ so the sets are bound again
+    if (meshShading) {
+        specification.taskFilePath = "../../shaders/bin/chunk_face.task.spv";
+        specification.meshFilePath = "../../shaders/bin/chunk_face.mesh.spv";
+        specification.pushConstantSize = sizeof(vkUtil::ChunkFaceTaskData);
+
+        output = vkInit::createGraphicsPipeline(specification, chunkFaceMeshPipeline);
+        chunkFaceMeshLayout = output.layout;
+        chunkFaceMeshPipeline = output.pipeline;
+
+        specification.taskFilePath.clear();
+        specification.meshFilePath.clear();
+    }
+
+    // optional, without it meshes cannot be loaded as meshlets
+    if (meshletRenderer == nullptr) {
+        try {
+            meshletRenderer = new MeshletRenderer(device, physicalDevice, static_cast<uint32_t>(maxFrameInFlight), meshShading);
+        } catch (const std::runtime_error& error) {
+            if (DEBUG_MODE) {
+                std::cout << "Meshlet drawing unavailable: " << error.what() << "\n";
+            }
+        }
+    }
+
+    // meshlets pull their vertices and world matrices and are lit like the overlay is colored
+    if (meshletRenderer != nullptr) {
+        specification.vertFilePath = "../../shaders/bin/meshlet.vert.spv";
+        specification.fragFilePath = "../../shaders/bin/main.frag.spv";
+        specification.pushConstantSize = sizeof(glm::mat4);
+        specification.descriptorSetLayouts = { meshletRenderer->getGeometryLayout() };
+
+        output = vkInit::createGraphicsPipeline(specification, meshletPipeline);
+        meshletLayout = output.layout;
+        meshletPipeline = output.pipeline;
+
+        // the task shader culls in place of the compute pass, the mesh shader outputs what meshlet.vert does
+        if (meshShading) {
+            specification.taskFilePath = "../../shaders/bin/meshlet.task.spv";
+            specification.meshFilePath = "../../shaders/bin/meshlet.mesh.spv";
+            specification.pushConstantSize = sizeof(vkUtil::MeshletTaskData);
+            specification.descriptorSetLayouts = { meshletRenderer->getGeometryLayout(), meshletRenderer->getTaskLayout() };
+
+            output = vkInit::createGraphicsPipeline(specification, meshletMeshPipeline);
+            meshletMeshLayout = output.layout;
+            meshletMeshPipeline = output.pipeline;
+        }
+    }
+
+    // timing of the geometry draws, to compare the vertex path and the mesh shaders
+    vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+    if (properties.limits.timestampComputeAndGraphics && !geometryQueries) {
+        vk::QueryPoolCreateInfo queryInfo {};
+        queryInfo.queryType = vk::QueryType::eTimestamp;
+        queryInfo.queryCount = 2 * static_cast<uint32_t>(maxFrameInFlight);
+        geometryQueries = device.createQueryPool(queryInfo);
+        timestampPeriod = properties.limits.timestampPeriod;
+        geometryTimed.assign(maxFrameInFlight, false);
+    }
+}
+
+void Engine::createDepthBuffers()
+{
+    vkImage::ImageInput imageInput {};
+    imageInput.device = device;
+    imageInput.physicalDevice = physicalDevice;
+    imageInput.width = swapchainExtent.width;
+    imageInput.height = swapchainExtent.height;
+    imageInput.tiling = vk::ImageTiling::eOptimal;
+    imageInput.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment;
+    imageInput.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    imageInput.format = depthFormat;
+
+    for (auto& frame : swapchainFrames) {
+        frame.depthBuffer = vkImage::createImage(imageInput);
+        frame.depthBufferMemory = vkImage::createImageMemory(imageInput, frame.depthBuffer);
+        frame.depthBufferView = vkImage::createImageView(device, frame.depthBuffer, depthFormat, vk::ImageAspectFlagBits::eDepth);
+    }
 }
 
 void Engine::createFramebuffers()
@@ -170,6 +348,7 @@ void Engine::createFrameSyncObj()
 
 void Engine::finalizeSetup()
 {
+    createDepthBuffers();
     createFramebuffers();
     commandPool = vkInit::createCommandPool(device, physicalDevice, surface);
 
@@ -183,16 +362,205 @@ void Engine::finalizeSetup()
 void Engine::createAssets()
 {
     triangleMesh = new TriangleMesh(device, physicalDevice);
+    instanceBuffer = new InstanceBuffer(device, physicalDevice);
+    chunkMeshPool = new ChunkMeshPool(device, physicalDevice, maxFrameInFlight);
+    chunkMesher = new GpuChunkMesher(device, physicalDevice, maxFrameInFlight);
+
+    uint32_t frameCount = static_cast<uint32_t>(maxFrameInFlight);
+
+    vk::DescriptorPoolSize poolSize { vk::DescriptorType::eStorageBuffer, 3 * frameCount };
+    vk::DescriptorPoolCreateInfo poolInfo {};
+    poolInfo.flags = vk::DescriptorPoolCreateFlags();
+    poolInfo.maxSets = 2 * frameCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    geometryDescriptorPool = device.createDescriptorPool(poolInfo);
+
+    // the overlay's sets first, then the chunks'
+    std::vector<vk::DescriptorSetLayout> layouts(frameCount, overlayGeometryLayout);
+    layouts.resize(2 * frameCount, chunkGeometryLayout);
+
+    vk::DescriptorSetAllocateInfo allocInfo {};
+    allocInfo.descriptorPool = geometryDescriptorPool;
+    allocInfo.descriptorSetCount = 2 * frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+    std::vector<vk::DescriptorSet> sets = device.allocateDescriptorSets(allocInfo);
+
+    overlayGeometrySets.assign(sets.begin(), sets.begin() + frameCount);
+    chunkGeometrySets.assign(sets.begin() + frameCount, sets.end());
+
+    // optional, the raster path keeps working on devices that cannot blit into the swapchain
+    vk::SurfaceCapabilitiesKHR capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
+    if (capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) {
+        try {
+            raymarcher = new RaymarchRenderer(device, physicalDevice, swapchainFormat);
+            raymarcher->setTargets(swapchainExtent, static_cast<uint32_t>(swapchainFrames.size()));
+        } catch (const std::runtime_error& error) {
+            if (DEBUG_MODE) {
+                std::cout << "Raymarching unavailable: " << error.what() << "\n";
+            }
+            delete raymarcher;
+            raymarcher = nullptr;
+        }
+    }
+}
+
+bool Engine::addMeshletMesh(const std::vector<glm::vec3>& positions, const MeshletMesh& mesh, const glm::mat4& transform)
+{
+    if (meshletRenderer == nullptr) {
+        return false;
+    }
+
+    meshletRenderer->addMesh(positions, mesh, transform);
+    return true;
+}
+
+bool Engine::setMeshShading(bool enabled)
+{
+    if (enabled && !meshShading) {
+        return false;
+    }
+
+    useMeshShading = enabled;
+    return true;
+}
+
+bool Engine::setRenderMode(RenderMode mode)
+{
+    if (mode == RenderMode::Raymarch && raymarcher == nullptr) {
+        return false;
+    }
+
+    renderMode = mode;
+    return true;
 }
 
 void Engine::prepareScene(vk::CommandBuffer commandBuffer)
 {
-    vk::Buffer vertexBuffer[] = { triangleMesh->buffer.buffer };
-    vk::DeviceSize offsets[] = { 0 };
-    commandBuffer.bindVertexBuffers(0, 1, vertexBuffer, offsets);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, overlayGeometrySets[frameNumber], nullptr);
 }
 
-void Engine::recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t imageIndex, const Scene& scene)
+void Engine::writeGeometrySets(uint32_t frame)
+{
+    // the frame's fence was waited on, nothing in flight reads its sets
+    vk::DescriptorBufferInfo triangleInfo { triangleMesh->buffer.buffer, 0, VK_WHOLE_SIZE };
+    vk::DescriptorBufferInfo instanceInfo { instanceBuffer->getBuffer(), 0, VK_WHOLE_SIZE };
+    vk::DescriptorBufferInfo chunkVertexInfo { chunkMeshPool->getVertexBuffer(), 0, VK_WHOLE_SIZE };
+
+    std::array<vk::WriteDescriptorSet, 3> descriptorWrites {};
+    descriptorWrites[0] = { overlayGeometrySets[frame], 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &triangleInfo };
+    descriptorWrites[1] = { overlayGeometrySets[frame], 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &instanceInfo };
+    descriptorWrites[2] = { chunkGeometrySets[frame], 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &chunkVertexInfo };
+    device.updateDescriptorSets(descriptorWrites, nullptr);
+}
+
+void Engine::syncChunkMeshes(Scene& scene)
+{
+    const auto& nodes = scene.lod.getActiveNodes();
+
+    // meshes the gpu counted, they are written by this frame's record before anything draws them,
+    // outdated ones are dropped by the mesher so the record never writes to a freed range
+    auto current = [&](uint64_t key, uint64_t revision) {
+        auto node = nodes.find(key);
+        return node != nodes.end() && node->second.revision == revision;
+    };
+
+    for (const GpuChunkMesher::Result& result : chunkMesher->collect(frameNumber, *chunkMeshPool, current)) {
+        auto pending = pendingChunkMeshes.find(result.key);
+        if (pending != pendingChunkMeshes.end() && pending->second == result.revision) {
+            pendingChunkMeshes.erase(pending);
+        }
+
+        setChunkMesh(result.key, nodes.at(result.key), result.mesh);
+    }
+
+    size_t uploadedBytes { 0 };
+    std::vector<uint64_t> submitted;
+    for (const auto& [key, node] : nodes) {
+        auto it = chunkSlots.find(key);
+        if (it != chunkSlots.end() && chunkMeshes[it->second].revision == node.revision) {
+            continue;
+        }
+
+        // the node keeps its previous mesh until the gpu one arrives
+        auto pending = pendingChunkMeshes.find(key);
+        if (pending != pendingChunkMeshes.end() && pending->second == node.revision) {
+            continue;
+        }
+
+        if (node.volume) {
+            if (chunkMesher->submit(key, node.revision, node.volume)) {
+                pendingChunkMeshes[key] = node.revision;
+                submitted.push_back(key);
+            }
+            continue;
+        }
+
+        // bounded per frame, the remaining nodes keep their previous mesh until the next frame
+        if (uploadedBytes > 0 && uploadedBytes + node.mesh.byteSize() > chunkUploadBytesPerFrame) {
+            break;
+        }
+
+        setChunkMesh(key, node, chunkMeshPool->add(node.mesh));
+        uploadedBytes += node.mesh.byteSize();
+    }
+
+    // the mesher holds the volumes now
+    for (uint64_t key : submitted) {
+        scene.lod.releaseVolume(key);
+    }
+
+    std::erase_if(pendingChunkMeshes, [&](const auto& pending) { return !nodes.contains(pending.first); });
+
+    for (uint32_t slot { 0 }; slot < chunkMeshes.size();) {
+        if (!nodes.contains(chunkMeshes[slot].key)) {
+            removeChunkMesh(slot);
+        } else {
+            slot++;
+        }
+    }
+}
+
+void Engine::setChunkMesh(uint64_t key, const LodNode& node, uint32_t mesh)
+{
+    GpuChunk chunk {};
+    chunk.key = key;
+    chunk.coord = node.coord;
+    chunk.lod = node.lod;
+    chunk.revision = node.revision;
+    chunk.origin = glm::vec4 { node.origin(), node.voxelSize() / vkMesh::CHUNK_VERTEX_SCALE };
+    chunk.mesh = mesh;
+
+    glm::vec3 boundsMin = node.origin();
+    glm::vec3 boundsMax = node.origin() + float(CHUNK_SIZE) * node.voxelSize();
+
+    auto it = chunkSlots.find(key);
+    if (it != chunkSlots.end()) {
+        chunkMeshPool->remove(chunkMeshes[it->second].mesh);
+        chunkMeshes[it->second] = chunk;
+        chunkBounds.set(it->second, boundsMin, boundsMax);
+    } else {
+        chunkSlots.emplace(key, static_cast<uint32_t>(chunkMeshes.size()));
+        chunkMeshes.push_back(chunk);
+        chunkBounds.add(boundsMin, boundsMax);
+    }
+}
+
+void Engine::removeChunkMesh(uint32_t slot)
+{
+    chunkMeshPool->remove(chunkMeshes[slot].mesh);
+    chunkSlots.erase(chunkMeshes[slot].key);
+
+    if (slot + 1 < chunkMeshes.size()) {
+        chunkMeshes[slot] = chunkMeshes.back();
+        chunkSlots[chunkMeshes[slot].key] = slot;
+    }
+
+    chunkMeshes.pop_back();
+    chunkBounds.removeSwap(slot);
+}
+
+void Engine::recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t imageIndex, Scene& scene)
 {
     vk::CommandBufferBeginInfo beginInfo {};
     try {
@@ -203,6 +571,57 @@ void Engine::recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t
         }
     }
 
+    float aspectRatio = float(swapchainExtent.width) / float(swapchainExtent.height);
+    glm::mat4 viewProjection = scene.camera.projection(aspectRatio) * scene.camera.view();
+
+    if (renderMode == RenderMode::Raymarch) {
+        vkUtil::RaymarchData raymarchData {};
+        raymarchData.inverseViewProjection = glm::inverse(viewProjection);
+        raymarchData.camera = glm::vec4 { scene.camera.position, raymarchDistance };
+        raymarchData.gridOrigin = glm::ivec4 { scene.brickMap.getOrigin(), 0 };
+        raymarchData.gridExtent = glm::ivec4 { scene.brickMap.getExtent(), 0 };
+        raymarchData.gridWrap = glm::ivec4 { scene.brickMap.getWrap(), 0 };
+
+        raymarcher->record(commandBuffer, frameNumber, swapchainFrames[imageIndex].image, scene.brickMap, raymarchData);
+
+        try {
+            commandBuffer.end();
+        } catch (const vk::SystemError& err) {
+            if (DEBUG_MODE) {
+                std::cout << "Failed to finish recording command buffer\n";
+            }
+        }
+        return;
+    }
+
+    // copies are not allowed inside the render pass
+    instanceBuffer->record(commandBuffer, frameNumber, scene.entities);
+    chunkMeshPool->record(commandBuffer, frameNumber);
+    chunkMesher->record(commandBuffer, frameNumber, *chunkMeshPool);
+    materialAtlas->record(commandBuffer);
+    if (meshletRenderer != nullptr) {
+        meshletRenderer->record(commandBuffer, frameNumber, viewProjection, scene.camera.position, useMeshShading);
+    }
+
+    // the fence of the frame's last timing was waited on
+    if (geometryQueries) {
+        if (geometryTimed[frameNumber]) {
+            std::array<uint64_t, 2> timestamps {};
+            vk::Result result = device.getQueryPoolResults(geometryQueries, frameNumber * 2, 2,
+                sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+            if (result == vk::Result::eSuccess) {
+                geometryMilliseconds = double(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6;
+            }
+        }
+
+        commandBuffer.resetQueryPool(geometryQueries, frameNumber * 2, 2);
+        geometryTimed[frameNumber] = true;
+    }
+
+    // after the records, which may have grown the buffers
+    writeGeometrySets(frameNumber);
+
     vk::RenderPassBeginInfo renderPassInfo {};
     renderPassInfo.renderPass = renderpass;
     renderPassInfo.framebuffer = swapchainFrames[imageIndex].framebuffer;
@@ -210,14 +629,14 @@ void Engine::recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t
     renderPassInfo.renderArea.offset.y = 0;
     renderPassInfo.renderArea.extent = swapchainExtent;
 
-    vk::ClearValue clearColor { std::array<float, 4> { 0.1f, 0.1f, 0.1f, 1.0f } };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    std::array<vk::ClearValue, 2> clearValues {};
+    clearValues[0].color = vk::ClearColorValue { std::array<float, 4> { 0.55f, 0.7f, 0.9f, 1.0f } };
+    clearValues[1].depthStencil = vk::ClearDepthStencilValue { 1.0f, 0 };
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
 
     commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
 
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
-
     vk::Viewport viewport {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -232,14 +651,104 @@ void Engine::recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t
     scissor.extent = swapchainExtent;
     commandBuffer.setScissor(0, scissor);
 
+    if (geometryQueries) {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, geometryQueries, frameNumber * 2);
+    }
+
+    // voxel terrain
+    std::array<vk::DescriptorSet, 2> chunkSets { materialAtlas->getDescriptorSet(), chunkGeometrySets[frameNumber] };
+    chunkMeshPool->bind(commandBuffer);
+
+    vkUtil::ChunkData chunkData {};
+    chunkData.viewProjection = viewProjection;
+
+    vkUtil::ChunkFaceTaskData taskData {};
+    taskData.viewProjection = viewProjection;
+    taskData.eye = glm::vec4 { scene.camera.position, 0.0f };
+
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    scene.visibility.traverse(scene.camera.position, frustum);
+    chunkDraws.clear();
+
+    for (uint32_t slot : chunkCuller.cull(scene.jobs, frustum, chunkBounds)) {
+        const GpuChunk& chunk = chunkMeshes[slot];
+        if (chunk.mesh == ChunkMeshPool::NO_MESH) {
+            continue;
+        }
+
+        // occlusion is only known for full resolution chunks, coarser nodes are always drawn
+        if (chunk.lod == 0 && !scene.visibility.isVisible(chunk.coord)) {
+            continue;
+        }
+
+        chunkDraws.push_back(slot);
+    }
+    drawnChunks = static_cast<uint32_t>(chunkDraws.size());
+
+    // voxel faces first, six vertices each from their first slot or groups of 32 for the task shader,
+    // then the indexed smooth meshes
+    for (bool faces : { true, false }) {
+        bool faceTasks = faces && useMeshShading;
+        vk::PipelineLayout drawLayout = faceTasks ? chunkFaceMeshLayout : chunkLayout;
+        bool bound { false };
+        for (uint32_t slot : chunkDraws) {
+            const GpuChunk& chunk = chunkMeshes[slot];
+            ChunkMeshPool::DrawRange range = chunkMeshPool->getDrawRange(chunk.mesh);
+            if ((range.faceCount > 0) != faces) {
+                continue;
+            }
+
+            if (!bound) {
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, faceTasks ? chunkFaceMeshPipeline : faces ? chunkFacePipeline : chunkPipeline);
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, drawLayout, 0, chunkSets, nullptr);
+                bound = true;
+            }
+
+            if (faceTasks) {
+                taskData.origin = chunk.origin;
+                taskData.faces = glm::uvec4 { static_cast<uint32_t>(range.vertexOffset), range.faceCount, 0, 0 };
+                commandBuffer.pushConstants(drawLayout, vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT, 0, sizeof(taskData), &taskData);
+                drawMeshTasks(static_cast<VkCommandBuffer>(commandBuffer), (range.faceCount + 31) / 32, 1, 1);
+                continue;
+            }
+
+            chunkData.origin = chunk.origin;
+            commandBuffer.pushConstants(chunkLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(chunkData), &chunkData);
+
+            if (faces) {
+                commandBuffer.draw(range.faceCount * 6, 1, static_cast<uint32_t>(range.vertexOffset) * 6, 0);
+            } else {
+                commandBuffer.drawIndexed(range.indexCount, 1, range.firstIndex, range.vertexOffset, 0);
+            }
+        }
+    }
+
+    // meshes, whichever meshlets the cull above kept, or culled by the task shader as they are drawn
+    if (meshletRenderer != nullptr && !meshletRenderer->empty()) {
+        if (useMeshShading) {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, meshletMeshPipeline);
+            meshletRenderer->drawMeshTasks(commandBuffer, frameNumber, meshletMeshLayout, viewProjection, scene.camera.position);
+        } else {
+            commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, meshletPipeline);
+            commandBuffer.pushConstants(meshletLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(viewProjection), &viewProjection);
+            meshletRenderer->draw(commandBuffer, frameNumber, meshletLayout);
+        }
+    }
+
+    if (geometryQueries) {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, geometryQueries, frameNumber * 2 + 1);
+    }
+
+    // overlay triangles
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+
     prepareScene(commandBuffer);
 
-    for (auto& position : scene.trianglePositions) {
-        glm::mat4 model = glm::translate(glm::mat4 { 1.0f }, position);
-        vkUtil::ObjectData objectData;
-        objectData.model = model;
-        commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(objectData), &objectData);
-        commandBuffer.draw(3, 1, 0, 0);
+    // the world matrix of each instance is read from the instance buffer by its instance index
+    overlayVisible.clear();
+    scene.objects.cull(Frustum::fromMatrix(glm::mat4 { 1.0f }), overlayVisible);
+    for (uint32_t instance : overlayVisible) {
+        commandBuffer.draw(3, 1, 0, instance);
     }
 
     commandBuffer.endRenderPass();
@@ -253,7 +762,7 @@ void Engine::recordDrawCommands(const vk::CommandBuffer& commandBuffer, uint32_t
     }
 }
 
-void Engine::render(const Scene& scene)
+void Engine::render(Scene& scene)
 {
     if (device.waitForFences(1, &swapchainFrames[frameNumber].inFlight, VK_TRUE, UINT64_MAX) != vk::Result::eSuccess) {
         if (DEBUG_MODE) {
@@ -280,13 +789,18 @@ void Engine::render(const Scene& scene)
 
     vk::CommandBuffer commandBuffer = swapchainFrames[frameNumber].commandBuffer;
 
+    if (renderMode == RenderMode::Raster) {
+        syncChunkMeshes(scene);
+    }
+
     commandBuffer.reset();
 
     recordDrawCommands(commandBuffer, imageIndex, scene);
 
     vk::SubmitInfo submitInfo {};
     vk::Semaphore waitSemaphores[] = { swapchainFrames[frameNumber].imageAvailable };
-    vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+    // the raymarcher first touches the swapchain image with its blit
+    vk::PipelineStageFlags waitStages[] = { renderMode == RenderMode::Raymarch ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eColorAttachmentOutput };
     submitInfo.waitSemaphoreCount = 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
@@ -0,0 +1,489 @@
+#include "entity_store.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace VoKel {
+
+namespace {
+
+    struct ScalarOps {
+        using F = float;
+        static constexpr size_t WIDTH { 1 };
+
+        static F load(const float* p) { return *p; }
+        static void store(float* p, F a) { *p = a; }
+        static F set(float v) { return v; }
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+    };
+
+    // dirty rows below which a block is composed row by row
+    constexpr int SPARSE_ROWS { 16 };
+
+    constexpr uint32_t BLOCKS_PER_JOB { 16 };
+
+    uint32_t slotOf(EntityId entity)
+    {
+        return static_cast<uint32_t>(entity);
+    }
+
+    EntityId makeEntity(uint32_t slot, uint32_t generation)
+    {
+        return EntityId(slot) | (EntityId(generation) << 32);
+    }
+
+}
+
+void composeTransforms(const TransformBatch& batch, SimdLevel level)
+{
+#if VOKEL_X86
+    if (level == SimdLevel::AVX2) {
+        transform::composeTransformsAvx2(batch);
+        return;
+    }
+
+    if (level == SimdLevel::SSE4) {
+        transform::composeTransformsSse4(batch);
+        return;
+    }
+#endif
+
+    (void)level;
+    transform::runComposeTransforms<ScalarOps>(batch);
+}
+
+EntityStore::EntityStore(SimdLevel level)
+    : level { level }
+{
+}
+
+EntityId EntityStore::create(uint32_t components, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = static_cast<uint32_t>(records.size());
+        records.push_back({ 0, 0, 0, false });
+    }
+
+    EntityId entity = makeEntity(slot, records[slot].generation);
+    uint32_t archetype = findArchetype(components);
+
+    records[slot].archetype = archetype;
+    records[slot].row = addRow(archetype, entity);
+    records[slot].alive = true;
+    entityCount++;
+
+    setPosition(entity, position);
+    setRotation(entity, rotation);
+    setScale(entity, scale);
+    return entity;
+}
+
+void EntityStore::destroy(EntityId entity)
+{
+    const Record& record = getRecord(entity);
+    removeRow(record.archetype, record.row);
+
+    uint32_t slot = slotOf(entity);
+    records[slot].alive = false;
+    records[slot].generation++;
+    freeSlots.push_back(slot);
+    entityCount--;
+}
+
+bool EntityStore::isAlive(EntityId entity) const
+{
+    uint32_t slot = slotOf(entity);
+    return slot < records.size() && records[slot].alive && records[slot].generation == uint32_t(entity >> 32);
+}
+
+void EntityStore::setComponents(EntityId entity, uint32_t components)
+{
+    Record record = getRecord(entity);
+    if (archetypes[record.archetype].components == components) {
+        return;
+    }
+
+    // may add an archetype, references into the list are taken after it
+    uint32_t target = findArchetype(components);
+    uint32_t row = addRow(target, entity);
+
+    Archetype& from = archetypes[record.archetype];
+    Archetype& to = archetypes[target];
+    uint32_t shared = from.components & to.components;
+
+    for (int a { 0 }; a < 3; a++) {
+        to.position[a][row] = from.position[a][record.row];
+        to.scale[a][row] = from.scale[a][record.row];
+    }
+    for (int c { 0 }; c < 4; c++) {
+        to.rotation[c][row] = from.rotation[c][record.row];
+    }
+    if (shared & COMPONENT_BOUNDS) {
+        for (int a { 0 }; a < 3; a++) {
+            to.boundsMin[a][row] = from.boundsMin[a][record.row];
+            to.boundsMax[a][row] = from.boundsMax[a][record.row];
+        }
+    }
+    if (shared & COMPONENT_MESH) {
+        to.mesh[row] = from.mesh[record.row];
+        instanceMeshes[to.instance[row]] = to.mesh[row];
+    }
+
+    // the new instance may be the one that moves into the old slot, the record has to point at it first
+    records[slotOf(entity)].archetype = target;
+    records[slotOf(entity)].row = row;
+
+    removeRow(record.archetype, record.row);
+}
+
+uint32_t EntityStore::getComponents(EntityId entity) const
+{
+    return archetypes[getRecord(entity).archetype].components;
+}
+
+void EntityStore::setPosition(EntityId entity, const glm::vec3& position)
+{
+    const Record& record = getRecord(entity);
+    Archetype& archetype = archetypes[record.archetype];
+    for (int a { 0 }; a < 3; a++) {
+        archetype.position[a][record.row] = position[a];
+    }
+    markDirty(archetype, record.row);
+}
+
+void EntityStore::setRotation(EntityId entity, const glm::quat& rotation)
+{
+    const Record& record = getRecord(entity);
+    Archetype& archetype = archetypes[record.archetype];
+    archetype.rotation[0][record.row] = rotation.x;
+    archetype.rotation[1][record.row] = rotation.y;
+    archetype.rotation[2][record.row] = rotation.z;
+    archetype.rotation[3][record.row] = rotation.w;
+    markDirty(archetype, record.row);
+}
+
+void EntityStore::setScale(EntityId entity, const glm::vec3& scale)
+{
+    const Record& record = getRecord(entity);
+    Archetype& archetype = archetypes[record.archetype];
+    for (int a { 0 }; a < 3; a++) {
+        archetype.scale[a][record.row] = scale[a];
+    }
+    markDirty(archetype, record.row);
+}
+
+void EntityStore::setBounds(EntityId entity, const glm::vec3& min, const glm::vec3& max)
+{
+    const Record& record = getRecord(entity);
+    Archetype& archetype = archetypes[record.archetype];
+    if ((archetype.components & COMPONENT_BOUNDS) == 0) {
+        return;
+    }
+
+    for (int a { 0 }; a < 3; a++) {
+        archetype.boundsMin[a][record.row] = min[a];
+        archetype.boundsMax[a][record.row] = max[a];
+    }
+    markDirty(archetype, record.row);
+}
+
+void EntityStore::setMesh(EntityId entity, uint32_t mesh)
+{
+    const Record& record = getRecord(entity);
+    Archetype& archetype = archetypes[record.archetype];
+    if ((archetype.components & COMPONENT_MESH) == 0) {
+        return;
+    }
+
+    archetype.mesh[record.row] = mesh;
+    instanceMeshes[archetype.instance[record.row]] = mesh;
+}
+
+glm::vec3 EntityStore::getPosition(EntityId entity) const
+{
+    const Record& record = getRecord(entity);
+    const Archetype& archetype = archetypes[record.archetype];
+    return { archetype.position[0][record.row], archetype.position[1][record.row], archetype.position[2][record.row] };
+}
+
+glm::quat EntityStore::getRotation(EntityId entity) const
+{
+    const Record& record = getRecord(entity);
+    const Archetype& archetype = archetypes[record.archetype];
+    return glm::quat { archetype.rotation[3][record.row], archetype.rotation[0][record.row], archetype.rotation[1][record.row], archetype.rotation[2][record.row] };
+}
+
+glm::vec3 EntityStore::getScale(EntityId entity) const
+{
+    const Record& record = getRecord(entity);
+    const Archetype& archetype = archetypes[record.archetype];
+    return { archetype.scale[0][record.row], archetype.scale[1][record.row], archetype.scale[2][record.row] };
+}
+
+const glm::mat4& EntityStore::getWorldMatrix(EntityId entity) const
+{
+    const Record& record = getRecord(entity);
+    return archetypes[record.archetype].world[record.row];
+}
+
+void EntityStore::update(JobSystem& jobs)
+{
+    // the dirty rows of each listed block, clearing the words lets the blocks be listed again
+    struct Work {
+        uint32_t archetype;
+        uint32_t block;
+        uint64_t rows;
+    };
+
+    std::vector<Work> work;
+    for (uint32_t a { 0 }; a < archetypes.size(); a++) {
+        Archetype& archetype = archetypes[a];
+        for (uint32_t block : archetype.dirtyBlocks) {
+            uint32_t first = block * BLOCK_SIZE;
+            uint32_t rows = std::min(BLOCK_SIZE, archetype.size() - std::min(first, archetype.size()));
+            uint64_t valid = rows == BLOCK_SIZE ? ~0ull : (1ull << rows) - 1;
+
+            if ((archetype.dirty[block] & valid) != 0) {
+                work.push_back({ a, block, archetype.dirty[block] & valid });
+            }
+            archetype.dirty[block] = 0;
+        }
+        archetype.dirtyBlocks.clear();
+    }
+
+    updatedRows = 0;
+    if (work.empty()) {
+        return;
+    }
+
+    auto composeBlock = [&](uint32_t i) {
+        const Work& item = work[i];
+        Archetype& archetype = archetypes[item.archetype];
+
+        // dense blocks in one vector pass, the clean rows come out the same as before
+        size_t first = size_t(item.block) * BLOCK_SIZE;
+        TransformBatch batch {
+            { archetype.position[0].data(), archetype.position[1].data(), archetype.position[2].data() },
+            { archetype.rotation[0].data(), archetype.rotation[1].data(), archetype.rotation[2].data(), archetype.rotation[3].data() },
+            { archetype.scale[0].data(), archetype.scale[1].data(), archetype.scale[2].data() },
+            first,
+            std::min<size_t>(BLOCK_SIZE, archetype.size() - first),
+            &archetype.world[0][0][0],
+        };
+        if (std::popcount(item.rows) >= SPARSE_ROWS) {
+            composeTransforms(batch, level);
+        } else {
+            for (uint64_t rows = item.rows; rows != 0; rows &= rows - 1) {
+                transform::composeOne(batch, first + std::countr_zero(rows));
+            }
+        }
+
+        if ((archetype.components & COMPONENT_MESH) == 0) {
+            return;
+        }
+
+        bool bounded = archetype.components & COMPONENT_BOUNDS;
+        for (uint64_t rows = item.rows; rows != 0; rows &= rows - 1) {
+            uint32_t row = static_cast<uint32_t>(first) + std::countr_zero(rows);
+            const glm::mat4& world = archetype.world[row];
+
+            // the box of the rotated model box, a point at the origin without bounds
+            glm::vec3 center { world[3] };
+            glm::vec3 extent { 0.0f };
+            if (bounded) {
+                glm::vec3 min { archetype.boundsMin[0][row], archetype.boundsMin[1][row], archetype.boundsMin[2][row] };
+                glm::vec3 max { archetype.boundsMax[0][row], archetype.boundsMax[1][row], archetype.boundsMax[2][row] };
+                glm::vec3 half = (max - min) * 0.5f;
+
+                center = glm::vec3 { world * glm::vec4 { (min + max) * 0.5f, 1.0f } };
+                for (int a { 0 }; a < 3; a++) {
+                    extent += glm::abs(glm::vec3 { world[a] }) * half[a];
+                }
+            }
+
+            uint32_t instance = archetype.instance[row];
+            instanceMatrices[instance] = world;
+            instanceBounds.set(instance, center - extent, center + extent);
+        }
+    };
+
+    // scattered edits leave many blocks with a row or two, they are handed out in groups
+    uint32_t groups = static_cast<uint32_t>((work.size() + BLOCKS_PER_JOB - 1) / BLOCKS_PER_JOB);
+    auto composeGroup = [&](uint32_t group) {
+        uint32_t end = std::min(static_cast<uint32_t>(work.size()), (group + 1) * BLOCKS_PER_JOB);
+        for (uint32_t i { group * BLOCKS_PER_JOB }; i < end; i++) {
+            composeBlock(i);
+        }
+    };
+
+    if (groups > 1) {
+        jobs.parallelFor(groups, composeGroup);
+    } else {
+        composeGroup(0);
+    }
+
+    std::vector<uint32_t> changed;
+    for (const Work& item : work) {
+        const Archetype& archetype = archetypes[item.archetype];
+        updatedRows += static_cast<uint32_t>(std::popcount(item.rows));
+
+        if (archetype.components & COMPONENT_MESH) {
+            for (uint64_t rows = item.rows; rows != 0; rows &= rows - 1) {
+                changed.push_back(archetype.instance[item.block * BLOCK_SIZE + std::countr_zero(rows)]);
+            }
+        }
+    }
+
+    if (!changed.empty()) {
+        changedInstances = std::move(changed);
+        revision++;
+    }
+}
+
+const EntityStore::Record& EntityStore::getRecord(EntityId entity) const
+{
+    if (!isAlive(entity)) {
+        throw std::runtime_error("Entity " + std::to_string(slotOf(entity)) + " does not exist");
+    }
+    return records[slotOf(entity)];
+}
+
+uint32_t EntityStore::findArchetype(uint32_t components)
+{
+    for (uint32_t a { 0 }; a < archetypes.size(); a++) {
+        if (archetypes[a].components == components) {
+            return a;
+        }
+    }
+
+    archetypes.emplace_back();
+    archetypes.back().components = components;
+    return static_cast<uint32_t>(archetypes.size() - 1);
+}
+
+uint32_t EntityStore::addRow(uint32_t index, EntityId entity)
+{
+    Archetype& archetype = archetypes[index];
+    uint32_t row = archetype.size();
+
+    archetype.entities.push_back(entity);
+    for (int a { 0 }; a < 3; a++) {
+        archetype.position[a].push_back(0.0f);
+        archetype.scale[a].push_back(1.0f);
+    }
+    for (int c { 0 }; c < 4; c++) {
+        archetype.rotation[c].push_back(c == 3 ? 1.0f : 0.0f);
+    }
+
+    if (archetype.components & COMPONENT_BOUNDS) {
+        for (int a { 0 }; a < 3; a++) {
+            archetype.boundsMin[a].push_back(0.0f);
+            archetype.boundsMax[a].push_back(0.0f);
+        }
+    }
+
+    if (archetype.components & COMPONENT_MESH) {
+        archetype.mesh.push_back(0);
+        archetype.instance.push_back(addInstance(entity, 0));
+    }
+
+    archetype.world.push_back(glm::mat4 { 1.0f });
+
+    // the words are never shrunk, bits past the end are masked off by update
+    if (archetype.dirty.size() * BLOCK_SIZE < archetype.size()) {
+        archetype.dirty.push_back(0);
+    }
+
+    markDirty(archetype, row);
+    return row;
+}
+
+void EntityStore::removeRow(uint32_t index, uint32_t row)
+{
+    Archetype& archetype = archetypes[index];
+
+    if (archetype.components & COMPONENT_MESH) {
+        removeInstance(archetype.instance[row]);
+    }
+
+    // the last row moves into the hole and keeps its dirty bit, its stale bit past the end stays set
+    uint32_t last = archetype.size() - 1;
+    auto move = [row, last](auto& column) {
+        column[row] = column[last];
+        column.pop_back();
+    };
+
+    move(archetype.entities);
+    for (int a { 0 }; a < 3; a++) {
+        move(archetype.position[a]);
+        move(archetype.scale[a]);
+    }
+    for (int c { 0 }; c < 4; c++) {
+        move(archetype.rotation[c]);
+    }
+    if (archetype.components & COMPONENT_BOUNDS) {
+        for (int a { 0 }; a < 3; a++) {
+            move(archetype.boundsMin[a]);
+            move(archetype.boundsMax[a]);
+        }
+    }
+    if (archetype.components & COMPONENT_MESH) {
+        move(archetype.mesh);
+        move(archetype.instance);
+    }
+    move(archetype.world);
+
+    if (row != last) {
+        records[slotOf(archetype.entities[row])].row = row;
+        if ((archetype.dirty[last / BLOCK_SIZE] >> (last % BLOCK_SIZE)) & 1u) {
+            markDirty(archetype, row);
+        }
+    }
+}
+
+void EntityStore::markDirty(Archetype& archetype, uint32_t row)
+{
+    uint64_t& word = archetype.dirty[row / BLOCK_SIZE];
+    if (word == 0) {
+        archetype.dirtyBlocks.push_back(row / BLOCK_SIZE);
+    }
+    word |= 1ull << (row % BLOCK_SIZE);
+}
+
+uint32_t EntityStore::addInstance(EntityId entity, uint32_t mesh)
+{
+    instanceMatrices.push_back(glm::mat4 { 1.0f });
+    instanceMeshes.push_back(mesh);
+    instanceEntities.push_back(entity);
+    return instanceBounds.add(glm::vec3 { 0.0f }, glm::vec3 { 0.0f });
+}
+
+void EntityStore::removeInstance(uint32_t instance)
+{
+    // the last instance moves into the slot, its row is recomposed so the slot counts as changed
+    uint32_t last = getInstanceCount() - 1;
+    if (instance != last) {
+        EntityId moved = instanceEntities[last];
+        instanceMatrices[instance] = instanceMatrices[last];
+        instanceMeshes[instance] = instanceMeshes[last];
+        instanceEntities[instance] = moved;
+
+        const Record& record = records[slotOf(moved)];
+        Archetype& archetype = archetypes[record.archetype];
+        archetype.instance[record.row] = instance;
+        markDirty(archetype, record.row);
+    }
+
+    instanceMatrices.pop_back();
+    instanceMeshes.pop_back();
+    instanceEntities.pop_back();
+    instanceBounds.removeSwap(instance);
+}
+
+}
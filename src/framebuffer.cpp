@@ -7,7 +7,8 @@ void createFramebuffer(framebufferInput inputChunk, std::vector<vkInit::Swapchai
 {
     for (size_t i { 0 }; i < frames.size(); i++) {
         std::vector<vk::ImageView> attachments {
-            frames[i].imageView
+            frames[i].imageView,
+            frames[i].depthBufferView
         };
 
         vk::FramebufferCreateInfo framebufferInfo {};
@@ -0,0 +1,162 @@
+#include "frustum_cull.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace VoKel {
+
+namespace {
+
+    struct ScalarOps {
+        using F = float;
+        using M = bool;
+        static constexpr size_t WIDTH { 1 };
+
+        static F load(const float* p) { return *p; }
+        static F set(float v) { return v; }
+        static F add(F a, F b) { return a + b; }
+        static F mul(F a, F b) { return a * b; }
+
+        static M greaterEqual(F a, F b) { return a >= b; }
+        static M all() { return true; }
+        static M andm(M a, M b) { return a && b; }
+        static uint32_t bits(M a) { return a ? 1u : 0u; }
+    };
+
+    // boxes per job, small enough to spread a few thousand chunks over the threads
+    constexpr uint32_t CULL_BLOCK { 2048 };
+
+}
+
+size_t cullBoxes(const CullBatch& batch, SimdLevel level)
+{
+#if VOKEL_X86
+    if (level == SimdLevel::AVX2) {
+        return cull::cullBoxesAvx2(batch);
+    }
+
+    if (level == SimdLevel::SSE4) {
+        return cull::cullBoxesSse4(batch);
+    }
+#endif
+
+    (void)level;
+    return cull::runCullBoxes<ScalarOps>(batch);
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+{
+    // rows of the matrix, glm stores columns
+    glm::vec4 row[4];
+    for (int i { 0 }; i < 4; i++) {
+        row[i] = glm::vec4 { viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i] };
+    }
+
+    Frustum frustum;
+    frustum.planes = {
+        row[3] + row[0],
+        row[3] - row[0],
+        row[3] + row[1],
+        row[3] - row[1],
+        row[2],
+        row[3] - row[2],
+    };
+
+    for (glm::vec4& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3 { plane });
+    }
+
+    return frustum;
+}
+
+uint32_t BoundsList::add(const glm::vec3& min, const glm::vec3& max)
+{
+    for (int a { 0 }; a < 3; a++) {
+        this->min[a].push_back(min[a]);
+        this->max[a].push_back(max[a]);
+    }
+    return size() - 1;
+}
+
+void BoundsList::set(uint32_t index, const glm::vec3& min, const glm::vec3& max)
+{
+    for (int a { 0 }; a < 3; a++) {
+        this->min[a][index] = min[a];
+        this->max[a][index] = max[a];
+    }
+}
+
+void BoundsList::removeSwap(uint32_t index)
+{
+    for (int a { 0 }; a < 3; a++) {
+        min[a][index] = min[a].back();
+        max[a][index] = max[a].back();
+        min[a].pop_back();
+        max[a].pop_back();
+    }
+}
+
+void BoundsList::clear()
+{
+    for (int a { 0 }; a < 3; a++) {
+        min[a].clear();
+        max[a].clear();
+    }
+}
+
+FrustumCuller::FrustumCuller(SimdLevel level)
+    : level { level }
+{
+}
+
+const std::vector<uint32_t>& FrustumCuller::cull(JobSystem& jobs, const Frustum& frustum, const BoundsList& bounds)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    float planes[6][4];
+    for (int p { 0 }; p < 6; p++) {
+        for (int c { 0 }; c < 4; c++) {
+            planes[p][c] = frustum.planes[p][c];
+        }
+    }
+
+    uint32_t count = bounds.size();
+    uint32_t blocks = (count + CULL_BLOCK - 1) / CULL_BLOCK;
+    visible.resize(count);
+    blockCounts.resize(blocks);
+
+    auto cullBlock = [&](uint32_t block) {
+        CullBatch batch {
+            { bounds.getMin(0), bounds.getMin(1), bounds.getMin(2) },
+            { bounds.getMax(0), bounds.getMax(1), bounds.getMax(2) },
+            size_t(block) * CULL_BLOCK,
+            std::min<size_t>(CULL_BLOCK, count - size_t(block) * CULL_BLOCK),
+            planes,
+            6,
+            visible.data() + size_t(block) * CULL_BLOCK,
+        };
+        blockCounts[block] = static_cast<uint32_t>(cullBoxes(batch, level));
+    };
+
+    if (blocks > 1) {
+        jobs.parallelFor(blocks, cullBlock);
+    } else if (blocks == 1) {
+        cullBlock(0);
+    }
+
+    // pack the ranges, every block moves to or before its own start
+    uint32_t written { 0 };
+    for (uint32_t block { 0 }; block < blocks; block++) {
+        auto first = visible.begin() + size_t(block) * CULL_BLOCK;
+        std::copy(first, first + blockCounts[block], visible.begin() + written);
+        written += blockCounts[block];
+    }
+    visible.resize(written);
+
+    stats.boxes = count;
+    stats.visible = written;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return visible;
+}
+
+}
@@ -0,0 +1,41 @@
+// built with -mavx2, only reached when the cpu reports AVX2 (see CMakeLists.txt)
+#include "frustum_cull_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <immintrin.h>
+
+namespace VoKel {
+
+namespace cull {
+
+    namespace {
+
+        struct Avx2Ops {
+            using F = __m256;
+            using M = __m256;
+            static constexpr size_t WIDTH { 8 };
+
+            static F load(const float* p) { return _mm256_loadu_ps(p); }
+            static F set(float v) { return _mm256_set1_ps(v); }
+            static F add(F a, F b) { return _mm256_add_ps(a, b); }
+            static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+
+            static M greaterEqual(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+            static M all() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+            static M andm(M a, M b) { return _mm256_and_ps(a, b); }
+            static uint32_t bits(M a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+        };
+
+    }
+
+    size_t cullBoxesAvx2(const CullBatch& batch)
+    {
+        return runCullBoxes<Avx2Ops>(batch);
+    }
+
+}
+
+}
+
+#endif
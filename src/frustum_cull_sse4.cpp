@@ -0,0 +1,41 @@
+// built with -msse4.1, only reached when the cpu reports SSE4.1 (see CMakeLists.txt)
+#include "frustum_cull_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <smmintrin.h>
+
+namespace VoKel {
+
+namespace cull {
+
+    namespace {
+
+        struct Sse4Ops {
+            using F = __m128;
+            using M = __m128;
+            static constexpr size_t WIDTH { 4 };
+
+            static F load(const float* p) { return _mm_loadu_ps(p); }
+            static F set(float v) { return _mm_set1_ps(v); }
+            static F add(F a, F b) { return _mm_add_ps(a, b); }
+            static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+
+            static M greaterEqual(F a, F b) { return _mm_cmpge_ps(a, b); }
+            static M all() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+            static M andm(M a, M b) { return _mm_and_ps(a, b); }
+            static uint32_t bits(M a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+        };
+
+    }
+
+    size_t cullBoxesSse4(const CullBatch& batch)
+    {
+        return runCullBoxes<Sse4Ops>(batch);
+    }
+
+}
+
+}
+
+#endif
@@ -0,0 +1,385 @@
+#include "gpu_chunk_mesher.hpp"
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    // slot layouts shared with chunk_mesh.comp
+    constexpr uint32_t SLICES { 6 * CHUNK_SIZE };
+    constexpr uint32_t VOXEL_WORDS { ChunkMeshVolume::VOLUME / 2 };
+    constexpr uint32_t VOLUME_WORDS { 1 + VOXEL_WORDS + ChunkMeshVolume::VOLUME / 4 };
+
+    // quads and first quad of every face slice, the draw arguments, the face count and the write target
+    constexpr uint32_t MESH_DRAW { 2 * SLICES };
+    constexpr uint32_t MESH_WORDS { MESH_DRAW + 8 };
+    constexpr uint32_t MESH_FACE_COUNT { MESH_DRAW + 4 };
+    constexpr uint32_t MESH_FACE_BASE { MESH_DRAW + 5 };
+
+    constexpr uint32_t PASS_COUNT { 0 };
+    constexpr uint32_t PASS_SCAN { 1 };
+    constexpr uint32_t PASS_EMIT { 2 };
+
+    constexpr uint32_t QUERIES_PER_FRAME { 4 };
+
+    struct MeshPass {
+        uint32_t pass;
+        uint32_t firstSlot;
+    };
+
+    constexpr vk::MemoryPropertyFlags HOST_MEMORY { vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent };
+
+    vkUtil::Buffer createBuffer(vk::Device device, vk::PhysicalDevice physicalDevice, size_t size, vk::BufferUsageFlags usage)
+    {
+        vkUtil::BufferInput input;
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.size = size;
+        input.usage = usage;
+        input.memoryProperties = HOST_MEMORY;
+        return vkUtil::createBuffer(input);
+    }
+
+    void destroyBuffer(vk::Device device, vkUtil::Buffer& buffer)
+    {
+        if (buffer.buffer) {
+            device.destroyBuffer(buffer.buffer);
+            device.freeMemory(buffer.bufferMemory);
+        }
+        buffer = {};
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+}
+
+GpuChunkMesher::GpuChunkMesher(vk::Device device, vk::PhysicalDevice physicalDevice, int framesInFlight, const GpuChunkMesherSettings& settings)
+    : device { device }
+    , physicalDevice { physicalDevice }
+    , settings { settings }
+{
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings {};
+    for (uint32_t binding { 0 }; binding < bindings.size(); binding++) {
+        bindings[binding] = { binding, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute };
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.flags = vk::DescriptorSetLayoutCreateFlags();
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    descriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+    vkInit::ComputePipelineInBundle specification {};
+    specification.device = device;
+    specification.compFilePath = "../../shaders/bin/chunk_mesh.comp.spv";
+    specification.descriptorSetLayout = descriptorSetLayout;
+    specification.pushConstantSize = sizeof(MeshPass);
+
+    vkInit::ComputePipelineOutBundle output = vkInit::createComputePipeline(specification);
+    layout = output.layout;
+    pipeline = output.pipeline;
+
+    uint32_t frameCount = static_cast<uint32_t>(framesInFlight);
+
+    vk::DescriptorPoolSize poolSize { vk::DescriptorType::eStorageBuffer, 3 * frameCount };
+    vk::DescriptorPoolCreateInfo poolInfo {};
+    poolInfo.flags = vk::DescriptorPoolCreateFlags();
+    poolInfo.maxSets = frameCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    descriptorPool = device.createDescriptorPool(poolInfo);
+
+    std::vector<vk::DescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo {};
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+    std::vector<vk::DescriptorSet> sets = device.allocateDescriptorSets(allocInfo);
+
+    frames.resize(frameCount);
+    for (uint32_t i { 0 }; i < frameCount; i++) {
+        frames[i] = Frame { {}, {}, 0, sets[i], {}, {}, {}, 0, false, 0 };
+    }
+
+    // timing is optional, meshing works the same without it
+    vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+    if (properties.limits.timestampComputeAndGraphics) {
+        vk::QueryPoolCreateInfo queryInfo {};
+        queryInfo.queryType = vk::QueryType::eTimestamp;
+        queryInfo.queryCount = QUERIES_PER_FRAME * frameCount;
+        queryPool = device.createQueryPool(queryInfo);
+        timestampPeriod = properties.limits.timestampPeriod;
+    }
+}
+
+GpuChunkMesher::~GpuChunkMesher()
+{
+    for (Frame& frame : frames) {
+        destroyBuffer(device, frame.volumes);
+        destroyBuffer(device, frame.meshes);
+        destroyBuffer(device, frame.readback);
+    }
+
+    if (queryPool) {
+        device.destroyQueryPool(queryPool);
+    }
+
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(layout);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+}
+
+bool GpuChunkMesher::submit(uint64_t key, uint64_t revision, std::shared_ptr<const ChunkMeshVolume> volume)
+{
+    if (queued.size() >= settings.chunksPerBatch) {
+        return false;
+    }
+
+    queued.push_back({ key, revision, std::move(volume), ChunkMeshPool::NO_MESH, 0, 0 });
+    return true;
+}
+
+std::vector<GpuChunkMesher::Result> GpuChunkMesher::collect(uint32_t frameIndex, ChunkMeshPool& pool, const std::function<bool(uint64_t key, uint64_t revision)>& keep)
+{
+    Frame& frame = frames[frameIndex];
+    std::vector<Result> results;
+
+    if (frame.timed) {
+        std::array<uint64_t, QUERIES_PER_FRAME> timestamps {};
+        vk::Result result = device.getQueryPoolResults(queryPool, frameIndex * QUERIES_PER_FRAME, QUERIES_PER_FRAME,
+            sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+        if (result == vk::Result::eSuccess) {
+            gpuMilliseconds += double((timestamps[1] - timestamps[0]) + (timestamps[3] - timestamps[2])) * timestampPeriod * 1e-6;
+            timedChunks += frame.timedChunks;
+            stats.gpuMillisecondsPerChunk = gpuMilliseconds / double(std::max<uint64_t>(timedChunks, 1));
+        }
+        frame.timed = false;
+    }
+
+    if (!frame.emitted.empty()) {
+        verify(frame);
+    }
+
+    if (frame.counted.empty()) {
+        return results;
+    }
+
+    const uint32_t* mapped = static_cast<const uint32_t*>(device.mapMemory(frame.meshes.bufferMemory, 0, VK_WHOLE_SIZE));
+    for (uint32_t i { 0 }; i < frame.counted.size(); i++) {
+        Job& job = frame.counted[i];
+
+        // the job keeps its slot in the bank, record skips it like a chunk without faces
+        if (!keep(job.key, job.revision)) {
+            job.mesh = ChunkMeshPool::NO_MESH;
+            job.volume.reset();
+            continue;
+        }
+
+        const uint32_t* mesh = mapped + (frame.bank * settings.chunksPerBatch + i) * MESH_WORDS;
+
+        job.faceCount = mesh[MESH_FACE_COUNT];
+        job.mesh = pool.reserve(job.faceCount, 0);
+
+        results.push_back({ job.key, job.revision, job.mesh });
+    }
+    device.unmapMemory(frame.meshes.bufferMemory);
+
+    stats.meshedChunks += results.size();
+    return results;
+}
+
+void GpuChunkMesher::verify(Frame& frame)
+{
+    const char* mapped = static_cast<const char*>(device.mapMemory(frame.readback.bufferMemory, 0, VK_WHOLE_SIZE));
+
+    for (const Job& job : frame.emitted) {
+        auto start = Clock::now();
+        ChunkMeshData reference = meshChunkVolume(*job.volume);
+        cpuMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        bool match = reference.faces.size() == job.faceCount
+            && std::memcmp(mapped + job.readbackOffset, reference.faces.data(), size_t(job.faceCount) * sizeof(vkMesh::ChunkFace)) == 0;
+
+        stats.verifiedChunks++;
+        stats.mismatchedChunks += match ? 0 : 1;
+    }
+
+    device.unmapMemory(frame.readback.bufferMemory);
+    stats.cpuMillisecondsPerChunk = cpuMilliseconds / double(std::max<uint64_t>(stats.verifiedChunks, 1));
+    frame.emitted.clear();
+}
+
+void GpuChunkMesher::dispatch(vk::CommandBuffer commandBuffer, const Frame& frame, uint32_t pass, uint32_t bank, uint32_t groups, uint32_t chunks)
+{
+    MeshPass constants { pass, bank * settings.chunksPerBatch };
+    commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+    commandBuffer.dispatch(groups, chunks, 1);
+}
+
+void GpuChunkMesher::record(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const ChunkMeshPool& pool)
+{
+    Frame& frame = frames[frameIndex];
+
+    std::vector<Job> writes = std::move(frame.counted);
+    frame.counted.clear();
+
+    if (writes.empty() && queued.empty()) {
+        return;
+    }
+
+    // created with the first batch, the frame's fence was waited on so nothing reads them anymore
+    if (!frame.volumes.buffer) {
+        uint32_t slots = 2 * settings.chunksPerBatch;
+        frame.volumes = createBuffer(device, physicalDevice, size_t(slots) * VOLUME_WORDS * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer);
+        frame.meshes = createBuffer(device, physicalDevice, size_t(slots) * MESH_WORDS * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer);
+    }
+
+    // the pool's buffers change when it grows
+    vk::DescriptorBufferInfo volumeInfo { frame.volumes.buffer, 0, VK_WHOLE_SIZE };
+    vk::DescriptorBufferInfo meshInfo { frame.meshes.buffer, 0, VK_WHOLE_SIZE };
+    vk::DescriptorBufferInfo vertexInfo { pool.getVertexBuffer(), 0, VK_WHOLE_SIZE };
+
+    std::array<vk::WriteDescriptorSet, 3> descriptorWrites {};
+    descriptorWrites[0] = { frame.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &volumeInfo };
+    descriptorWrites[1] = { frame.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshInfo };
+    descriptorWrites[2] = { frame.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &vertexInfo };
+    device.updateDescriptorSets(descriptorWrites, nullptr);
+
+    uint32_t firstQuery = frameIndex * QUERIES_PER_FRAME;
+    if (queryPool) {
+        commandBuffer.resetQueryPool(queryPool, firstQuery, QUERIES_PER_FRAME);
+    }
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, frame.descriptorSet, nullptr);
+
+    // the collected meshes, in place at their pool ranges as of the pool's record
+    if (queryPool) {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, firstQuery);
+    }
+
+    if (!writes.empty()) {
+        uint32_t* mapped = static_cast<uint32_t*>(device.mapMemory(frame.meshes.bufferMemory, 0, VK_WHOLE_SIZE));
+        for (uint32_t i { 0 }; i < writes.size(); i++) {
+            uint32_t* mesh = mapped + (frame.bank * settings.chunksPerBatch + i) * MESH_WORDS;
+
+            // dropped meshes have no range to write to, without quads in any slice every workgroup returns early
+            if (writes[i].mesh == ChunkMeshPool::NO_MESH) {
+                std::fill(mesh, mesh + SLICES, 0u);
+                continue;
+            }
+
+            ChunkMeshPool::DrawRange range = pool.getDrawRange(writes[i].mesh);
+            mesh[MESH_FACE_BASE] = static_cast<uint32_t>(range.vertexOffset);
+        }
+        device.unmapMemory(frame.meshes.bufferMemory);
+
+        // the pool's copies of this record land before the shader writes next to or over them
+        vk::MemoryBarrier before { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderWrite };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), before, nullptr, nullptr);
+
+        dispatch(commandBuffer, frame, PASS_EMIT, frame.bank, SLICES, static_cast<uint32_t>(writes.size()));
+
+        // drawn this frame, copied by later compaction, growth or verification
+        vk::MemoryBarrier after { vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eTransfer,
+            vk::DependencyFlags(), after, nullptr, nullptr);
+
+        if (settings.verify) {
+            std::vector<vk::BufferCopy> faceCopies;
+            size_t total { 0 };
+
+            for (Job& job : writes) {
+                // volumes uploaded before verification was turned on are gone
+                if (job.mesh == ChunkMeshPool::NO_MESH || !job.volume) {
+                    continue;
+                }
+
+                ChunkMeshPool::DrawRange range = pool.getDrawRange(job.mesh);
+                size_t faceBytes = size_t(job.faceCount) * sizeof(vkMesh::ChunkFace);
+
+                job.readbackOffset = total;
+                faceCopies.push_back({ uint64_t(range.vertexOffset) * sizeof(vkMesh::ChunkFace), total, faceBytes });
+                total += faceBytes;
+
+                frame.emitted.push_back(std::move(job));
+            }
+
+            if (total > 0) {
+                if (total > frame.readbackSize) {
+                    destroyBuffer(device, frame.readback);
+                    frame.readbackSize = std::max(total, frame.readbackSize * 2);
+                    frame.readback = createBuffer(device, physicalDevice, frame.readbackSize, vk::BufferUsageFlagBits::eTransferDst);
+                }
+
+                commandBuffer.copyBuffer(pool.getVertexBuffer(), frame.readback.buffer, faceCopies);
+
+                vk::MemoryBarrier readback { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead };
+                commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                    vk::DependencyFlags(), readback, nullptr, nullptr);
+            }
+        }
+    }
+
+    if (queryPool) {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, queryPool, firstQuery + 1);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queryPool, firstQuery + 2);
+    }
+
+    // the next batch goes into the other bank, the writes above still read this one
+    if (!queued.empty()) {
+        frame.bank ^= 1;
+
+        char* mapped = static_cast<char*>(device.mapMemory(frame.volumes.bufferMemory, 0, VK_WHOLE_SIZE));
+        for (uint32_t i { 0 }; i < queued.size(); i++) {
+            const ChunkMeshVolume& volume = *queued[i].volume;
+            uint32_t* slot = reinterpret_cast<uint32_t*>(mapped) + size_t(frame.bank * settings.chunksPerBatch + i) * VOLUME_WORDS;
+
+            slot[0] = volume.lit ? 1 : 0;
+            std::memcpy(slot + 1, volume.voxels.data(), volume.voxels.size() * sizeof(Voxel));
+            if (volume.lit) {
+                std::memcpy(slot + 1 + VOXEL_WORDS, volume.light.data(), volume.light.size());
+            }
+
+            // only verification meshes it again on the cpu
+            if (!settings.verify) {
+                queued[i].volume.reset();
+            }
+        }
+        device.unmapMemory(frame.volumes.bufferMemory);
+
+        uint32_t chunks = static_cast<uint32_t>(queued.size());
+        dispatch(commandBuffer, frame, PASS_COUNT, frame.bank, SLICES, chunks);
+
+        vk::MemoryBarrier counted { vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), counted, nullptr, nullptr);
+
+        dispatch(commandBuffer, frame, PASS_SCAN, frame.bank, 1, chunks);
+
+        // collect reads the draw arguments once the frame's fence was waited on
+        vk::MemoryBarrier scanned { vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eHostRead };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost,
+            vk::DependencyFlags(), scanned, nullptr, nullptr);
+
+        frame.counted = std::move(queued);
+        queued.clear();
+    }
+
+    if (queryPool) {
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, queryPool, firstQuery + 3);
+        frame.timed = true;
+        frame.timedChunks = static_cast<uint32_t>(frame.counted.size());
+    }
+}
+
+}
@@ -0,0 +1,86 @@
+#include "image.hpp"
+#include "memory.hpp"
+
+namespace vkImage {
+
+vk::Image createImage(const ImageInput& input)
+{
+    vk::ImageCreateInfo imageInfo {};
+    imageInfo.flags = vk::ImageCreateFlags();
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.extent = vk::Extent3D { input.width, input.height, 1 };
+    imageInfo.mipLevels = input.mipLevels;
+    imageInfo.arrayLayers = input.arrayLayers;
+    imageInfo.format = input.format;
+    imageInfo.tiling = input.tiling;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+    imageInfo.usage = input.usage;
+    imageInfo.sharingMode = vk::SharingMode::eExclusive;
+    imageInfo.samples = vk::SampleCountFlagBits::e1;
+
+    try {
+        return input.device.createImage(imageInfo);
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error { std::string { "Failed to create image: " } + err.what() };
+    }
+
+    return nullptr;
+}
+
+vk::DeviceMemory createImageMemory(const ImageInput& input, const vk::Image& image)
+{
+    vk::MemoryRequirements requirements = input.device.getImageMemoryRequirements(image);
+
+    vk::MemoryAllocateInfo allocInfo {};
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = vkUtil::findMemoryTypeIndex(input.physicalDevice, requirements.memoryTypeBits, input.memoryProperties);
+
+    try {
+        vk::DeviceMemory memory = input.device.allocateMemory(allocInfo);
+        input.device.bindImageMemory(image, memory, 0);
+        return memory;
+    } catch (const vk::SystemError& err) {
+        throw std::runtime_error { std::string { "Failed to allocate image memory: " } + err.what() };
+    }
+
+    return nullptr;
+}
+
+vk::ImageView createImageView(const vk::Device& device, const vk::Image& image, vk::Format format, vk::ImageAspectFlags aspect,
+    vk::ImageViewType viewType, uint32_t mipLevels, uint32_t arrayLayers)
+{
+    vk::ImageViewCreateInfo createInfo {};
+    createInfo.image = image;
+    createInfo.viewType = viewType;
+    createInfo.format = format;
+    createInfo.components.r = vk::ComponentSwizzle::eIdentity;
+    createInfo.components.g = vk::ComponentSwizzle::eIdentity;
+    createInfo.components.b = vk::ComponentSwizzle::eIdentity;
+    createInfo.components.a = vk::ComponentSwizzle::eIdentity;
+    createInfo.subresourceRange.aspectMask = aspect;
+    createInfo.subresourceRange.baseMipLevel = 0;
+    createInfo.subresourceRange.levelCount = mipLevels;
+    createInfo.subresourceRange.baseArrayLayer = 0;
+    createInfo.subresourceRange.layerCount = arrayLayers;
+
+    return device.createImageView(createInfo);
+}
+
+vk::Format findSupportedFormat(const vk::PhysicalDevice& physicalDevice, const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features)
+{
+    for (vk::Format format : candidates) {
+        vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+
+        if (tiling == vk::ImageTiling::eLinear && (properties.linearTilingFeatures & features) == features) {
+            return format;
+        }
+
+        if (tiling == vk::ImageTiling::eOptimal && (properties.optimalTilingFeatures & features) == features) {
+            return format;
+        }
+    }
+
+    throw std::runtime_error { "Unable to find a suitable image format" };
+}
+
+}
@@ -88,8 +88,9 @@ vk::Instance createInstance(
     /*
      * or drop down to an earlier version to ensure compatibility with more
      * devices VK_MAKE_API_VERSION(variant, major, minor, patch)
+     * 1.1 where the loader has it, mesh shaders need its feature queries
      */
-    version = VK_MAKE_API_VERSION(0, 1, 0, 0);
+    version = version >= VK_MAKE_API_VERSION(0, 1, 1, 0) ? VK_MAKE_API_VERSION(0, 1, 1, 0) : VK_MAKE_API_VERSION(0, 1, 0, 0);
 
     // typedef struct VkApplicationInfo {
     //     VkStructureType    sType;
@@ -0,0 +1,139 @@
+#include "instance_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    vkUtil::Buffer createBuffer(vk::Device device, vk::PhysicalDevice physicalDevice, size_t size, vk::BufferUsageFlags usage)
+    {
+        vkUtil::BufferInput input;
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.size = size;
+        input.usage = usage;
+        return vkUtil::createBuffer(input);
+    }
+
+    void destroyBuffer(vk::Device device, vkUtil::Buffer& buffer)
+    {
+        if (buffer.buffer) {
+            device.destroyBuffer(buffer.buffer);
+            device.freeMemory(buffer.bufferMemory);
+        }
+        buffer = {};
+    }
+
+}
+
+InstanceBuffer::InstanceBuffer(vk::Device device, vk::PhysicalDevice physicalDevice)
+    : device { device }
+    , physicalDevice { physicalDevice }
+{
+    // room for a few instances, so there is always a buffer to bind
+    bufferSize = 64 * sizeof(glm::mat4);
+    buffer = createBuffer(device, physicalDevice, bufferSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    for (Frame& frame : frames) {
+        destroyBuffer(device, frame.staging);
+    }
+    destroyBuffer(device, buffer);
+}
+
+void InstanceBuffer::record(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const EntityStore& entities)
+{
+    uploadedBytes = 0;
+
+    if (frameIndex >= frames.size()) {
+        frames.resize(frameIndex + 1, Frame { {}, 0 });
+    }
+    Frame& frame = frames[frameIndex];
+
+    const std::vector<glm::mat4>& matrices = entities.getInstanceMatrices();
+    size_t bytes = matrices.size() * sizeof(glm::mat4);
+
+    // frames in flight still read the old buffer, growing is rare enough to simply wait for them
+    bool resized { false };
+    if (bytes > bufferSize) {
+        device.waitIdle();
+        destroyBuffer(device, buffer);
+        bufferSize = std::max(bytes, bufferSize * 2);
+        buffer = createBuffer(device, physicalDevice, bufferSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+        resized = true;
+    }
+
+    bool missed = !synced || entities.getRevision() != uploadedRevision + 1;
+    if (!resized && synced && entities.getRevision() == uploadedRevision) {
+        return;
+    }
+
+    // runs of consecutive instances, instances removed since the update are past the end
+    std::vector<vk::BufferCopy> copies;
+    if (resized || missed) {
+        if (bytes > 0) {
+            copies.push_back({ 0, 0, bytes });
+        }
+    } else {
+        std::vector<uint32_t> changed = entities.getChangedInstances();
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+        size_t offset { 0 };
+        for (size_t i { 0 }; i < changed.size() && changed[i] < matrices.size();) {
+            size_t end = i + 1;
+            while (end < changed.size() && changed[end] == changed[end - 1] + 1 && changed[end] < matrices.size()) {
+                end++;
+            }
+
+            vk::DeviceSize size = (end - i) * sizeof(glm::mat4);
+            copies.push_back({ offset, changed[i] * sizeof(glm::mat4), size });
+            offset += size;
+            i = end;
+        }
+    }
+
+    synced = true;
+    uploadedRevision = entities.getRevision();
+
+    size_t total { 0 };
+    for (const vk::BufferCopy& copy : copies) {
+        total += copy.size;
+    }
+
+    if (total == 0) {
+        return;
+    }
+
+    // the frame's fence was waited on, its previous copies are done with the staging buffer
+    if (total > frame.stagingSize) {
+        destroyBuffer(device, frame.staging);
+        frame.stagingSize = std::max(total, frame.stagingSize * 2);
+        frame.staging = createBuffer(device, physicalDevice, frame.stagingSize, vk::BufferUsageFlagBits::eTransferSrc);
+    }
+
+    char* mapped = static_cast<char*>(device.mapMemory(frame.staging.bufferMemory, 0, total));
+    for (const vk::BufferCopy& copy : copies) {
+        std::memcpy(mapped + copy.srcOffset, reinterpret_cast<const char*>(matrices.data()) + copy.dstOffset, copy.size);
+    }
+    device.unmapMemory(frame.staging.bufferMemory);
+
+    // earlier frames may still be reading the buffer
+    vk::MemoryBarrier before { vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader, vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(), before, nullptr, nullptr);
+
+    commandBuffer.copyBuffer(frame.staging.buffer, buffer.buffer, copies);
+
+    vk::MemoryBarrier after { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eVertexShader,
+        vk::DependencyFlags(), after, nullptr, nullptr);
+
+    uploadedBytes = total;
+}
+
+}
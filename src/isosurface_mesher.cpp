@@ -0,0 +1,658 @@
+#include "isosurface_mesher.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr uint32_t NO_VERTEX { ~0u };
+    constexpr int SCALE { int(vkMesh::CHUNK_VERTEX_SCALE) };
+
+    // corners per axis of the chunk's own cells
+    constexpr int CORNERS { CHUNK_SIZE + 1 };
+
+    /*
+     * Signs of the corners -1 to CHUNK_SIZE on every axis, row [y + 1][z + 1]
+     * holds the corner at x in bit x + 1. Lane i of a cell row is the cell at
+     * x = i - 1, its corners are bits i and i + 1 of the corner rows.
+     */
+    constexpr int SIGN_ROWS { CHUNK_SIZE + 2 };
+    using SignRows = std::array<std::array<uint64_t, SIGN_ROWS>, SIGN_ROWS>;
+
+    // cells -1 to CHUNK_SIZE - 1, dual contouring shares the first layer with the neighbors
+    constexpr uint64_t CELL_LANES { (1ull << (CHUNK_SIZE + 1)) - 1 };
+    constexpr uint64_t CHUNK_LANES { CELL_LANES & ~1ull };
+
+    // cube corner c sits at (c & 1, c >> 1 & 1, c >> 2 & 1)
+    glm::ivec3 cornerOffset(int corner)
+    {
+        return { corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 };
+    }
+
+    // edge 4 * axis + k runs along axis from the corner with the other two bits taken from k
+    struct Edge {
+        uint8_t from;
+        uint8_t axis;
+    };
+
+    constexpr std::array<Edge, 12> EDGES = [] {
+        std::array<Edge, 12> edges {};
+        for (int axis { 0 }; axis < 3; axis++) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+            for (int k { 0 }; k < 4; k++) {
+                edges[axis * 4 + k] = { uint8_t(((k & 1) << u) | ((k >> 1) << v)), uint8_t(axis) };
+            }
+        }
+        return edges;
+    }();
+
+    int edgeBetween(int a, int b)
+    {
+        int axis = std::countr_zero(unsigned(a ^ b));
+        int lower = std::min(a, b);
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        return axis * 4 + ((lower >> u) & 1) + (((lower >> v) & 1) << 1);
+    }
+
+    // corners of a square in (u, v), counter clockwise seen from the +axis side
+    constexpr std::array<glm::ivec2, 4> SQUARE {
+        glm::ivec2 { 0, 0 }, glm::ivec2 { 1, 0 }, glm::ivec2 { 1, 1 }, glm::ivec2 { 0, 1 }
+    };
+
+    struct MarchingCubesCase {
+        uint8_t triangleCount;
+        std::array<uint8_t, 30> edges;
+    };
+
+    /*
+     * The triangle table is derived instead of typed in. Walking the corners
+     * of each cube face counter clockwise from outside, every run of solid
+     * corners gives a segment from the edge entering it to the edge leaving
+     * it. Diagonal solid corners on a face are always kept apart, a rule that
+     * only looks at the face, so two cells sharing it agree and the surface
+     * stays closed. Every crossed edge starts one segment and ends another,
+     * the segments chain into loops that are fanned into triangles, facing
+     * away from the solid side.
+     */
+    std::array<MarchingCubesCase, 256> buildMarchingCubesTable()
+    {
+        std::array<MarchingCubesCase, 256> table {};
+
+        for (int solid { 0 }; solid < 256; solid++) {
+            std::array<int, 12> next;
+            next.fill(-1);
+
+            for (int face { 0 }; face < 6; face++) {
+                int axis = face / 2;
+                int u = (axis + 1) % 3;
+                int v = (axis + 2) % 3;
+                bool positive = (face & 1) == 0;
+
+                std::array<int, 4> corners;
+                for (int i { 0 }; i < 4; i++) {
+                    corners[i] = (int(positive) << axis) | (SQUARE[i].x << u) | (SQUARE[i].y << v);
+                }
+                if (!positive) {
+                    std::reverse(corners.begin(), corners.end());
+                }
+
+                auto inside = [&](int i) { return (solid >> corners[i & 3]) & 1; };
+
+                for (int i { 0 }; i < 4; i++) {
+                    if (inside(i) || !inside(i + 1)) {
+                        continue;
+                    }
+
+                    int j = i + 1;
+                    while (inside(j)) {
+                        j++;
+                    }
+
+                    next[edgeBetween(corners[i], corners[(i + 1) & 3])] = edgeBetween(corners[(j - 1) & 3], corners[j & 3]);
+                }
+            }
+
+            MarchingCubesCase& entry = table[solid];
+            std::array<bool, 12> visited {};
+
+            for (int start { 0 }; start < 12; start++) {
+                if (next[start] < 0 || visited[start]) {
+                    continue;
+                }
+
+                std::array<int, 12> loop;
+                int size { 0 };
+                for (int edge { start }; !visited[edge]; edge = next[edge]) {
+                    visited[edge] = true;
+                    loop[size++] = edge;
+                }
+
+                for (int i { 1 }; i + 1 < size; i++) {
+                    uint8_t* triangle = &entry.edges[3 * entry.triangleCount++];
+                    triangle[0] = uint8_t(loop[0]);
+                    triangle[1] = uint8_t(loop[i]);
+                    triangle[2] = uint8_t(loop[i + 1]);
+                }
+            }
+        }
+
+        return table;
+    }
+
+    const std::array<MarchingCubesCase, 256>& marchingCubesTable()
+    {
+        static const std::array<MarchingCubesCase, 256> table = buildMarchingCubesTable();
+        return table;
+    }
+
+    // true when the field has both solid and open corners
+    bool classifyCorners(const DensityField& field, SignRows& signs, bool& anySolid)
+    {
+        uint64_t solidRows { 0 };
+        uint64_t openRows { 0 };
+        constexpr uint64_t rowMask { (1ull << SIGN_ROWS) - 1 };
+
+        for (int y { -1 }; y <= CHUNK_SIZE; y++) {
+            for (int z { -1 }; z <= CHUNK_SIZE; z++) {
+                const float* row = &field.density[DensityField::index(-1, y, z)];
+
+                uint64_t bits { 0 };
+                for (int i { 0 }; i < SIGN_ROWS; i++) {
+                    bits |= uint64_t(row[i] > 0.0f) << i;
+                }
+
+                signs[y + 1][z + 1] = bits;
+                solidRows |= bits;
+                openRows |= ~bits & rowMask;
+            }
+        }
+
+        anySolid = solidRows != 0;
+        return anySolid && openRows != 0;
+    }
+
+    // solid bits of the cell in lane i, given the corner rows by dy | dz << 1
+    int cellCase(const std::array<uint64_t, 4>& rows, int lane)
+    {
+        int solid { 0 };
+        for (int corner { 0 }; corner < 8; corner++) {
+            solid |= int((rows[corner >> 1] >> (lane + (corner & 1))) & 1) << corner;
+        }
+        return solid;
+    }
+
+    // lanes whose cells have both solid and open corners
+    uint64_t mixedCells(const std::array<uint64_t, 4>& rows)
+    {
+        uint64_t any { 0 };
+        uint64_t all { ~0ull };
+        for (uint64_t row : rows) {
+            any |= row | (row >> 1);
+            all &= row & (row >> 1);
+        }
+        return any & ~all;
+    }
+
+    std::array<uint64_t, 4> cellRows(const SignRows& signs, int y, int z)
+    {
+        return { signs[y + 1][z + 1], signs[y + 2][z + 1], signs[y + 1][z + 2], signs[y + 2][z + 2] };
+    }
+
+    glm::vec3 gradient(const DensityField& field, const glm::ivec3& p)
+    {
+        return glm::vec3 {
+            field.at(p.x + 1, p.y, p.z) - field.at(p.x - 1, p.y, p.z),
+            field.at(p.x, p.y + 1, p.z) - field.at(p.x, p.y - 1, p.z),
+            field.at(p.x, p.y, p.z + 1) - field.at(p.x, p.y, p.z - 1)
+        } * 0.5f;
+    }
+
+    // where the density crosses zero along the edge from corner to corner + axis
+    float crossing(const DensityField& field, const glm::ivec3& corner, int axis)
+    {
+        glm::ivec3 end = corner;
+        end[axis]++;
+
+        float d0 = field.at(corner.x, corner.y, corner.z);
+        float d1 = field.at(end.x, end.y, end.z);
+        return d0 / (d0 - d1);
+    }
+
+    Voxel solidMaterial(const DensityField& field, const glm::ivec3& corner, int axis)
+    {
+        glm::ivec3 end = corner;
+        end[axis]++;
+
+        int i = DensityField::index(corner.x, corner.y, corner.z);
+        return field.material[field.density[i] > 0.0f ? i : DensityField::index(end.x, end.y, end.z)];
+    }
+
+    // whole voxels and the fraction are converted apart, so chunks sharing a face round alike
+    vkMesh::ChunkVertex makeVertex(const glm::ivec3& base, const glm::vec3& offset, uint16_t normal, Voxel material)
+    {
+        glm::ivec3 fixed = base * SCALE + glm::ivec3(glm::round(offset * float(SCALE)));
+
+        vkMesh::ChunkVertex vertex {};
+        vertex.x = static_cast<int16_t>(fixed.x);
+        vertex.y = static_cast<int16_t>(fixed.y);
+        vertex.z = static_cast<int16_t>(fixed.z);
+        vertex.normal = normal;
+        vertex.attributes = vkMesh::packChunkAttributes(material, 3, 15, 0);
+        return vertex;
+    }
+
+    void marchCubes(const DensityField& field, const SignRows& signs, ChunkMeshData& mesh)
+    {
+        const auto& table = marchingCubesTable();
+
+        // vertices on the edges leaving each corner of two corner slices, by y & 1
+        thread_local std::array<std::array<std::array<uint32_t, 3>, CORNERS * CORNERS>, 2> edgeVertices;
+
+        auto edgeVertex = [&](const glm::ivec3& corner, int axis) {
+            uint32_t& id = edgeVertices[corner.y & 1][corner.z * CORNERS + corner.x][axis];
+
+            if (id == NO_VERTEX) {
+                glm::ivec3 end = corner;
+                end[axis]++;
+
+                float t = crossing(field, corner, axis);
+                glm::vec3 offset { 0.0f };
+                offset[axis] = t;
+
+                // density grows into the solid, the normal points out of it
+                glm::vec3 normal = -glm::mix(gradient(field, corner), gradient(field, end), t);
+
+                id = static_cast<uint32_t>(mesh.vertices.size());
+                mesh.vertices.push_back(makeVertex(corner, offset, vkMesh::packSmoothNormal(normal), solidMaterial(field, corner, axis)));
+            }
+
+            return id;
+        };
+
+        for (auto& slot : edgeVertices[0]) {
+            slot.fill(NO_VERTEX);
+        }
+
+        for (int y { 0 }; y < CHUNK_SIZE; y++) {
+            for (auto& slot : edgeVertices[(y + 1) & 1]) {
+                slot.fill(NO_VERTEX);
+            }
+
+            for (int z { 0 }; z < CHUNK_SIZE; z++) {
+                std::array<uint64_t, 4> rows = cellRows(signs, y, z);
+
+                for (uint64_t bits { mixedCells(rows) & CHUNK_LANES }; bits != 0; bits &= bits - 1) {
+                    int lane = std::countr_zero(bits);
+                    glm::ivec3 cell { lane - 1, y, z };
+                    const MarchingCubesCase& entry = table[cellCase(rows, lane)];
+
+                    for (int i { 0 }; i < 3 * entry.triangleCount; i++) {
+                        const Edge& edge = EDGES[entry.edges[i]];
+                        mesh.indices.push_back(edgeVertex(cell + cornerOffset(edge.from), edge.axis));
+                    }
+                }
+            }
+        }
+    }
+
+    // eigen decomposition of a symmetric 3x3 matrix by Jacobi rotations, vectors in the columns
+    void symmetricEigen(float a[3][3], float vectors[3][3], float values[3])
+    {
+        for (int i { 0 }; i < 3; i++) {
+            for (int j { 0 }; j < 3; j++) {
+                vectors[i][j] = i == j ? 1.0f : 0.0f;
+            }
+        }
+
+        constexpr int PAIRS[3][2] { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+        for (int sweep { 0 }; sweep < 6; sweep++) {
+            for (const auto& pair : PAIRS) {
+                int p = pair[0];
+                int q = pair[1];
+                if (std::abs(a[p][q]) < 1e-9f) {
+                    continue;
+                }
+
+                float theta = (a[q][q] - a[p][p]) / (2.0f * a[p][q]);
+                float t = (theta < 0.0f ? -1.0f : 1.0f) / (std::abs(theta) + std::sqrt(theta * theta + 1.0f));
+                float c = 1.0f / std::sqrt(t * t + 1.0f);
+                float s = t * c;
+
+                auto rotate = [c, s](float& x, float& y) {
+                    float rx = c * x - s * y;
+                    y = s * x + c * y;
+                    x = rx;
+                };
+
+                for (int k { 0 }; k < 3; k++) {
+                    rotate(a[k][p], a[k][q]);
+                }
+                for (int k { 0 }; k < 3; k++) {
+                    rotate(a[p][k], a[q][k]);
+                }
+                for (int k { 0 }; k < 3; k++) {
+                    rotate(vectors[k][p], vectors[k][q]);
+                }
+            }
+        }
+
+        for (int i { 0 }; i < 3; i++) {
+            values[i] = a[i][i];
+        }
+    }
+
+    // directions whose eigenvalue is below this fraction of the largest are left at the mass point
+    constexpr float EIGEN_CUTOFF { 0.1f };
+
+    /*
+     * Point closest to the tangent planes of the crossings in least squares,
+     * solved with a truncated pseudo inverse around the mass point. Two
+     * planes leave the point free along their common edge, where it stays
+     * near the mass point, three pin it to their corner.
+     */
+    glm::vec3 solveQef(const std::array<glm::vec3, 12>& points, const std::array<glm::vec3, 12>& normals, int count)
+    {
+        glm::vec3 mass { 0.0f };
+        for (int i { 0 }; i < count; i++) {
+            mass += points[i];
+        }
+        mass /= float(count);
+
+        float ata[3][3] {};
+        glm::vec3 atb { 0.0f };
+        for (int i { 0 }; i < count; i++) {
+            const glm::vec3& n = normals[i];
+            float b = glm::dot(n, points[i] - mass);
+            for (int r { 0 }; r < 3; r++) {
+                for (int c { 0 }; c < 3; c++) {
+                    ata[r][c] += n[r] * n[c];
+                }
+                atb[r] += n[r] * b;
+            }
+        }
+
+        float vectors[3][3];
+        float values[3];
+        symmetricEigen(ata, vectors, values);
+
+        float largest = std::max({ values[0], values[1], values[2] });
+        glm::vec3 position = mass;
+        for (int i { 0 }; i < 3; i++) {
+            if (values[i] <= EIGEN_CUTOFF * largest) {
+                continue;
+            }
+
+            glm::vec3 direction { vectors[0][i], vectors[1][i], vectors[2][i] };
+            position += direction * (glm::dot(direction, atb) / values[i]);
+        }
+
+        return glm::clamp(position, glm::vec3 { 0.0f }, glm::vec3 { 1.0f });
+    }
+
+    void contourCells(const DensityField& field, const SignRows& signs, ChunkMeshData& mesh)
+    {
+        // vertex of every mixed cell from -1 to CHUNK_SIZE - 1, only read back for mixed cells
+        constexpr int CELLS { CHUNK_SIZE + 1 };
+        thread_local std::vector<uint32_t> cellVertices(CELLS * CELLS * CELLS);
+
+        auto cellSlot = [](const glm::ivec3& cell) {
+            return (cell.x + 1) + (cell.z + 1) * CELLS + (cell.y + 1) * CELLS * CELLS;
+        };
+
+        for (int y { -1 }; y < CHUNK_SIZE; y++) {
+            for (int z { -1 }; z < CHUNK_SIZE; z++) {
+                std::array<uint64_t, 4> rows = cellRows(signs, y, z);
+
+                for (uint64_t bits { mixedCells(rows) & CELL_LANES }; bits != 0; bits &= bits - 1) {
+                    int lane = std::countr_zero(bits);
+                    glm::ivec3 cell { lane - 1, y, z };
+                    int solid = cellCase(rows, lane);
+
+                    std::array<glm::vec3, 12> points;
+                    std::array<glm::vec3, 12> normals;
+                    glm::vec3 normalSum { 0.0f };
+                    int count { 0 };
+
+                    for (const Edge& edge : EDGES) {
+                        int to = edge.from | (1 << edge.axis);
+                        if (((solid >> edge.from) & 1) == ((solid >> to) & 1)) {
+                            continue;
+                        }
+
+                        glm::ivec3 corner = cell + cornerOffset(edge.from);
+                        float t = crossing(field, corner, edge.axis);
+
+                        points[count] = glm::vec3(cornerOffset(edge.from));
+                        points[count][edge.axis] = t;
+
+                        glm::vec3 g = glm::mix(gradient(field, corner), gradient(field, cell + cornerOffset(to)), t);
+                        float length = glm::length(g);
+                        normals[count] = length > 0.0f ? -g / length : glm::vec3 { 0.0f };
+                        normalSum += normals[count];
+                        count++;
+                    }
+
+                    glm::vec3 position = solveQef(points, normals, count);
+
+                    // material of the solid corner nearest the vertex
+                    int nearest { -1 };
+                    float nearestDistance { 4.0f };
+                    for (int corner { 0 }; corner < 8; corner++) {
+                        float distance = glm::dot(position - glm::vec3(cornerOffset(corner)), position - glm::vec3(cornerOffset(corner)));
+                        if (((solid >> corner) & 1) && distance < nearestDistance) {
+                            nearest = corner;
+                            nearestDistance = distance;
+                        }
+                    }
+
+                    glm::ivec3 corner = cell + cornerOffset(nearest);
+                    Voxel material = field.material[DensityField::index(corner.x, corner.y, corner.z)];
+
+                    cellVertices[cellSlot(cell)] = static_cast<uint32_t>(mesh.vertices.size());
+                    mesh.vertices.push_back(makeVertex(cell, position, vkMesh::packSmoothNormal(normalSum), material));
+                }
+            }
+        }
+
+        // a quad around every crossed edge the chunk owns, those starting at corners 0 to CHUNK_SIZE - 1
+        auto emitQuad = [&](const glm::ivec3& corner, int axis, bool solidBelow) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+
+            // the four cells around the edge, counter clockwise seen from the +axis side
+            std::array<uint32_t, 4> quad;
+            for (int i { 0 }; i < 4; i++) {
+                glm::ivec3 cell = corner;
+                cell[u] -= 1 - SQUARE[i].x;
+                cell[v] -= 1 - SQUARE[i].y;
+                quad[i] = cellVertices[cellSlot(cell)];
+            }
+
+            // the surface faces +axis when the solid is below it
+            if (!solidBelow) {
+                std::swap(quad[1], quad[3]);
+            }
+
+            // split along the shorter diagonal
+            auto length = [&](uint32_t a, uint32_t b) {
+                const vkMesh::ChunkVertex& p = mesh.vertices[a];
+                const vkMesh::ChunkVertex& q = mesh.vertices[b];
+                glm::ivec3 d { p.x - q.x, p.y - q.y, p.z - q.z };
+                return d.x * d.x + d.y * d.y + d.z * d.z;
+            };
+
+            if (length(quad[0], quad[2]) <= length(quad[1], quad[3])) {
+                mesh.indices.insert(mesh.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+            } else {
+                mesh.indices.insert(mesh.indices.end(), { quad[0], quad[1], quad[3], quad[1], quad[2], quad[3] });
+            }
+        };
+
+        for (int y { 0 }; y < CHUNK_SIZE; y++) {
+            for (int z { 0 }; z < CHUNK_SIZE; z++) {
+                uint64_t row = signs[y + 1][z + 1];
+
+                std::array<uint64_t, 3> crossed {
+                    row ^ (row >> 1),
+                    row ^ signs[y + 2][z + 1],
+                    row ^ signs[y + 1][z + 2]
+                };
+
+                for (int axis { 0 }; axis < 3; axis++) {
+                    for (uint64_t bits { crossed[axis] & CHUNK_LANES }; bits != 0; bits &= bits - 1) {
+                        int lane = std::countr_zero(bits);
+                        emitQuad({ lane - 1, y, z }, axis, (row >> lane) & 1);
+                    }
+                }
+            }
+        }
+    }
+
+    struct CapPoint {
+        glm::ivec3 base;
+        glm::vec3 offset;
+        Voxel material;
+    };
+
+    /*
+     * Solid cross section of the field on a chunk face, facing out of the
+     * chunk. Crossings use the same edges as the surface meshes so the cap
+     * meets the surface exactly, fully solid cells are merged into strips.
+     */
+    void capFace(const DensityField& field, int face, ChunkMeshData& mesh)
+    {
+        int axis = face / 2;
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        bool positive = (face & 1) == 0;
+
+        auto corner = [&](int i, int j) {
+            glm::ivec3 p {};
+            p[axis] = positive ? CHUNK_SIZE : 0;
+            p[u] = i;
+            p[v] = j;
+            return p;
+        };
+
+        auto solid = [&](const glm::ivec3& p) {
+            return field.at(p.x, p.y, p.z) > 0.0f;
+        };
+
+        auto material = [&](const glm::ivec3& p) {
+            return field.material[DensityField::index(p.x, p.y, p.z)];
+        };
+
+        // points counter clockwise seen from the +axis side
+        auto emitPolygon = [&](const CapPoint* points, int count) {
+            uint32_t base = static_cast<uint32_t>(mesh.vertices.size());
+            for (int i { 0 }; i < count; i++) {
+                mesh.vertices.push_back(makeVertex(points[i].base, points[i].offset, uint16_t(face), points[i].material));
+            }
+
+            for (int i { 1 }; i + 1 < count; i++) {
+                if (positive) {
+                    mesh.indices.insert(mesh.indices.end(), { base, base + i, base + i + 1 });
+                } else {
+                    mesh.indices.insert(mesh.indices.end(), { base, base + i + 1, base + i });
+                }
+            }
+        };
+
+        auto cornerPoint = [&](const glm::ivec3& p) {
+            return CapPoint { p, glm::vec3 { 0.0f }, material(p) };
+        };
+
+        auto crossingPoint = [&](const glm::ivec3& a, const glm::ivec3& b) {
+            int edgeAxis = a[u] != b[u] ? u : v;
+            glm::ivec3 lower = glm::min(a, b);
+            glm::vec3 offset { 0.0f };
+            offset[edgeAxis] = crossing(field, lower, edgeAxis);
+            return CapPoint { lower, offset, solidMaterial(field, lower, edgeAxis) };
+        };
+
+        for (int j { 0 }; j < CHUNK_SIZE; j++) {
+            for (int i { 0 }; i < CHUNK_SIZE;) {
+                std::array<glm::ivec3, 4> square;
+                int solidCorners { 0 };
+                for (int c { 0 }; c < 4; c++) {
+                    square[c] = corner(i + SQUARE[c].x, j + SQUARE[c].y);
+                    solidCorners |= int(solid(square[c])) << c;
+                }
+
+                if (solidCorners == 0xf) {
+                    int end = i + 1;
+                    while (end < CHUNK_SIZE && solid(corner(end + 1, j)) && solid(corner(end + 1, j + 1))) {
+                        end++;
+                    }
+
+                    const CapPoint strip[4] { cornerPoint(corner(i, j)), cornerPoint(corner(end, j)), cornerPoint(corner(end, j + 1)), cornerPoint(corner(i, j + 1)) };
+                    emitPolygon(strip, 4);
+                    i = end;
+                    continue;
+                }
+
+                // every run of solid corners is cut off on its own, like the cube faces of the surface
+                auto inside = [&](int c) { return (solidCorners >> (c & 3)) & 1; };
+                for (int c { 0 }; c < 4; c++) {
+                    if (inside(c) || !inside(c + 1)) {
+                        continue;
+                    }
+
+                    CapPoint polygon[6];
+                    int count { 0 };
+                    polygon[count++] = crossingPoint(square[c & 3], square[(c + 1) & 3]);
+
+                    int k = c + 1;
+                    for (; inside(k); k++) {
+                        polygon[count++] = cornerPoint(square[k & 3]);
+                    }
+
+                    polygon[count++] = crossingPoint(square[(k - 1) & 3], square[k & 3]);
+                    emitPolygon(polygon, count);
+                }
+
+                i++;
+            }
+        }
+    }
+
+}
+
+ChunkMeshData meshIsosurface(const IsosurfaceInput& input)
+{
+    ChunkMeshData mesh;
+
+    if (input.field == nullptr) {
+        return mesh;
+    }
+
+    thread_local SignRows signs;
+
+    bool anySolid;
+    if (classifyCorners(*input.field, signs, anySolid)) {
+        if (input.mode == IsosurfaceMode::MarchingCubes) {
+            marchCubes(*input.field, signs, mesh);
+        } else {
+            contourCells(*input.field, signs, mesh);
+        }
+    }
+
+    if (anySolid) {
+        for (int face { 0 }; face < 6; face++) {
+            if (input.skirtMask & (1 << face)) {
+                capFace(*input.field, face, mesh);
+            }
+        }
+    }
+
+    return mesh;
+}
+
+}
@@ -0,0 +1,134 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace VoKel {
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    workers.reserve(threadCount);
+    for (uint32_t i { 0 }; i < threadCount; i++) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock { mutex };
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+    enqueue(std::move(job), false);
+}
+
+void JobSystem::enqueue(std::function<void()> job, bool urgent)
+{
+    {
+        std::lock_guard lock { mutex };
+        if (urgent) {
+            jobs.push_front(std::move(job));
+        } else {
+            jobs.push_back(std::move(job));
+        }
+    }
+
+    wake.notify_one();
+}
+
+void JobSystem::workerLoop()
+{
+    while (true) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock lock { mutex };
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            if (stopping && jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            running++;
+        }
+
+        job();
+
+        {
+            std::lock_guard lock { mutex };
+            running--;
+
+            if (running == 0 && jobs.empty()) {
+                idle.notify_all();
+            }
+        }
+    }
+}
+
+void JobSystem::wait()
+{
+    std::unique_lock lock { mutex };
+    idle.wait(lock, [this] { return running == 0 && jobs.empty(); });
+}
+
+void JobSystem::parallelFor(uint32_t count, const std::function<void(uint32_t)>& function)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // shared so helpers that start after the range is done only touch live state
+    struct Range {
+        std::atomic<uint32_t> next { 0 };
+        std::atomic<uint32_t> done { 0 };
+        uint32_t count;
+        const std::function<void(uint32_t)>* function;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto range = std::make_shared<Range>();
+    range->count = count;
+    range->function = &function;
+
+    auto work = [](Range& range) {
+        uint32_t index;
+        while ((index = range.next.fetch_add(1)) < range.count) {
+            (*range.function)(index);
+
+            if (range.done.fetch_add(1) + 1 == range.count) {
+                std::lock_guard lock { range.mutex };
+                range.finished.notify_all();
+            }
+        }
+    };
+
+    uint32_t helpers = std::min(count - 1, getThreadCount());
+    for (uint32_t i { 0 }; i < helpers; i++) {
+        enqueue([range, work] { work(*range); }, true);
+    }
+
+    work(*range);
+
+    std::unique_lock lock { range->mutex };
+    range->finished.wait(lock, [&] { return range->done.load() == count; });
+}
+
+}
@@ -0,0 +1,582 @@
+#include "light_propagator.hpp"
+#include "chunk_mesher.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr uint8_t SKY { 0 };
+    constexpr uint8_t BLOCK { 1 };
+
+    constexpr int DOWN_FACE { int(Face::NegativeY) };
+
+    uint8_t channelLevel(uint8_t light, uint8_t channel)
+    {
+        return channel == SKY ? skyLight(light) : blockLight(light);
+    }
+
+    uint8_t withLevel(uint8_t light, uint8_t channel, uint8_t level)
+    {
+        return channel == SKY ? packLight(level, blockLight(light)) : packLight(skyLight(light), level);
+    }
+
+    /*
+     * The 3x3x3 chunks a job may touch. A node is only processed while all
+     * six of its neighbors are inside, everything else is spilled.
+     */
+    struct Region {
+        glm::ivec3 origin;
+        std::array<const Chunk*, 27> chunks {};
+        std::array<ChunkLight*, 27> lights {};
+
+        // false when the voxel is outside or its chunk is not resident
+        bool locate(const glm::ivec3& voxel, int& slot, int& index) const
+        {
+            glm::ivec3 local = voxel - origin;
+            if (glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(local, glm::ivec3(3 * CHUNK_SIZE)))) {
+                return false;
+            }
+
+            glm::ivec3 chunk = local >> CHUNK_SIZE_LOG2;
+            slot = chunk.x + chunk.y * 3 + chunk.z * 9;
+            if (lights[slot] == nullptr) {
+                return false;
+            }
+
+            local &= CHUNK_SIZE - 1;
+            index = Chunk::index(local.x, local.y, local.z);
+            return true;
+        }
+
+        bool interior(const glm::ivec3& voxel) const
+        {
+            glm::ivec3 local = voxel - origin;
+            return glm::all(glm::greaterThanEqual(local, glm::ivec3(1))) && glm::all(glm::lessThan(local, glm::ivec3(3 * CHUNK_SIZE - 1)));
+        }
+    };
+
+    struct RegionOutput {
+        std::vector<LightPropagator::Node> spilled;
+        std::vector<LightPropagator::Node> relight;
+        uint64_t updates { 0 };
+    };
+
+}
+
+bool ChunkLight::set(int i, uint8_t light)
+{
+    if (levels.empty()) {
+        if (light == uniform) {
+            return false;
+        }
+        levels.assign(CHUNK_VOLUME, uniform);
+    } else if (levels[i] == light) {
+        return false;
+    }
+
+    levels[i] = light;
+    changed = true;
+    return true;
+}
+
+void ChunkLight::fill(uint8_t light)
+{
+    if (!levels.empty() || uniform != light) {
+        changed = true;
+    }
+
+    levels.clear();
+    levels.shrink_to_fit();
+    uniform = light;
+}
+
+void ChunkLight::assign(const uint8_t* light)
+{
+    if (std::all_of(light, light + CHUNK_VOLUME, [first = light[0]](uint8_t level) { return level == first; })) {
+        fill(light[0]);
+        return;
+    }
+
+    levels.assign(light, light + CHUNK_VOLUME);
+    changed = true;
+}
+
+void ChunkLight::compact()
+{
+    if (levels.empty()) {
+        return;
+    }
+
+    uint8_t first = levels[0];
+    if (std::all_of(levels.begin(), levels.end(), [first](uint8_t light) { return light == first; })) {
+        levels.clear();
+        levels.shrink_to_fit();
+        uniform = first;
+    }
+}
+
+LightPropagator::LightPropagator(World& world, JobSystem& jobs)
+    : world { world }
+    , jobs { jobs }
+{
+}
+
+void LightPropagator::setEmission(Voxel material, uint8_t level)
+{
+    if (material >= emission.size()) {
+        emission.resize(size_t(material) + 1, 0);
+    }
+
+    emission[material] = std::min(level, MAX_LIGHT_LEVEL);
+}
+
+void LightPropagator::chunkInserted(const ChunkCoord& coord)
+{
+    uint64_t key = packChunkCoord(coord);
+
+    auto& light = lights[key];
+    if (light == nullptr) {
+        light = std::make_unique<ChunkLight>();
+    }
+
+    insertedChunks.insert(key);
+}
+
+void LightPropagator::chunkRemoved(const ChunkCoord& coord)
+{
+    // light that flowed into the neighbors stays until the chunk returns
+    uint64_t key = packChunkCoord(coord);
+    lights.erase(key);
+    insertedChunks.erase(key);
+}
+
+void LightPropagator::voxelChanged(const glm::ivec3& voxel, Voxel previous, Voxel)
+{
+    edits.emplace_back(voxel, previous);
+}
+
+ChunkLight* LightPropagator::findLight(const ChunkCoord& coord)
+{
+    std::unique_ptr<ChunkLight>* light = lights.find(packChunkCoord(coord));
+    return light == nullptr ? nullptr : light->get();
+}
+
+uint8_t LightPropagator::getLight(const glm::ivec3& voxel) const
+{
+    const std::unique_ptr<ChunkLight>* light = lights.find(packChunkCoord(worldToChunk(voxel)));
+    if (light == nullptr) {
+        return 0;
+    }
+
+    glm::ivec3 local = worldToLocal(voxel);
+    return (*light)->get(Chunk::index(local.x, local.y, local.z));
+}
+
+const uint8_t* LightPropagator::getLevels(const ChunkCoord& coord)
+{
+    const ChunkLight* light = findLight(coord);
+    if (light == nullptr) {
+        return nullptr;
+    }
+
+    if (const uint8_t* levels = light->data()) {
+        return levels;
+    }
+
+    // uniform chunks share one expanded copy per value
+    std::vector<uint8_t>& levels = uniformLevels[light->getUniform()];
+    if (levels.empty()) {
+        levels.assign(CHUNK_VOLUME, light->getUniform());
+    }
+
+    return levels.data();
+}
+
+std::vector<ChunkCoord> LightPropagator::takeChangedChunks()
+{
+    std::vector<ChunkCoord> changed;
+    changed.swap(changedChunks);
+    return changed;
+}
+
+void LightPropagator::seedChunk(const ChunkCoord& coord, std::vector<Node>& removals, std::vector<Node>& additions)
+{
+    const Chunk* chunk = world.getChunk(coord);
+    ChunkLight* light = findLight(coord);
+    if (chunk == nullptr || light == nullptr) {
+        return;
+    }
+
+    glm::ivec3 origin = coord * CHUNK_SIZE;
+
+    std::array<const Chunk*, 6> neighborChunks {};
+    std::array<ChunkLight*, 6> neighborLights {};
+    for (int face { 0 }; face < 6; face++) {
+        neighborChunks[face] = world.getChunk(coord + FACE_DIRECTIONS[face]);
+        neighborLights[face] = neighborChunks[face] == nullptr ? nullptr : findLight(coord + FACE_DIRECTIONS[face]);
+    }
+
+    const ChunkLight* above = neighborLights[int(Face::PositiveY)];
+
+    // sky light falls straight down, an air chunk under open sky needs no array at all
+    if (chunk->isEmpty() && (above == nullptr || (above->data() == nullptr && skyLight(above->getUniform()) == MAX_LIGHT_LEVEL))) {
+        light->fill(packLight(MAX_LIGHT_LEVEL, 0));
+    } else {
+        thread_local std::vector<Voxel> voxels(CHUNK_VOLUME);
+        thread_local std::vector<uint8_t> levels(CHUNK_VOLUME);
+
+        chunk->decode(voxels.data());
+        std::fill(levels.begin(), levels.end(), 0);
+
+        for (int z { 0 }; z < CHUNK_SIZE; z++) {
+            for (int x { 0 }; x < CHUNK_SIZE; x++) {
+                if (above != nullptr && skyLight(above->get(Chunk::index(x, 0, z))) != MAX_LIGHT_LEVEL) {
+                    continue;
+                }
+
+                for (int y { CHUNK_SIZE - 1 }; y >= 0 && voxels[Chunk::index(x, y, z)] == AIR; y--) {
+                    levels[Chunk::index(x, y, z)] = packLight(MAX_LIGHT_LEVEL, 0);
+                }
+            }
+        }
+
+        // lit columns spread sideways wherever that brightens air, below a lit voxel is lit too or opaque
+        for (int i { 0 }; i < CHUNK_VOLUME; i++) {
+            if (skyLight(levels[i]) != MAX_LIGHT_LEVEL) {
+                continue;
+            }
+
+            int x = i & (CHUNK_SIZE - 1);
+            int z = (i >> CHUNK_SIZE_LOG2) & (CHUNK_SIZE - 1);
+
+            auto darker = [&](int next) {
+                return voxels[next] == AIR && skyLight(levels[next]) < MAX_LIGHT_LEVEL - 1;
+            };
+
+            if ((x > 0 && darker(i - 1)) || (x < CHUNK_SIZE - 1 && darker(i + 1))
+                || (z > 0 && darker(i - CHUNK_SIZE)) || (z < CHUNK_SIZE - 1 && darker(i + CHUNK_SIZE))) {
+                additions.push_back(Node { origin + glm::ivec3 { x, i >> (2 * CHUNK_SIZE_LOG2), z }, 0, SKY });
+            }
+        }
+
+        // block light sources, skipped unless the palette holds an emitting material
+        const std::vector<Voxel>& palette = chunk->getPalette();
+        if (std::any_of(palette.begin(), palette.end(), [this](Voxel voxel) { return getEmission(voxel) > 0; })) {
+            for (int i { 0 }; i < CHUNK_VOLUME; i++) {
+                if (uint8_t level = getEmission(voxels[i])) {
+                    levels[i] = withLevel(levels[i], BLOCK, level);
+
+                    glm::ivec3 local { i & (CHUNK_SIZE - 1), i >> (2 * CHUNK_SIZE_LOG2), (i >> CHUNK_SIZE_LOG2) & (CHUNK_SIZE - 1) };
+                    additions.push_back(Node { origin + local, 0, BLOCK });
+                }
+            }
+        }
+
+        light->assign(levels.data());
+    }
+
+    // light crossing the faces, out of lit columns into darker neighbors and from brighter neighbors in
+    for (int face { 0 }; face < 6 && !chunk->isFull(); face++) {
+        const Chunk* neighbor = neighborChunks[face];
+        const ChunkLight* neighborLight = neighborLights[face];
+        if (neighborLight == nullptr) {
+            continue;
+        }
+
+        int axis = face / 2;
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        bool positive = FACE_DIRECTIONS[face][axis] > 0;
+
+        // full sky light passes down without loss
+        uint8_t outwardTarget = face == DOWN_FACE ? MAX_LIGHT_LEVEL : MAX_LIGHT_LEVEL - 1;
+        bool inwardColumn = face == int(Face::PositiveY);
+
+        for (int j { 0 }; j < CHUNK_SIZE; j++) {
+            for (int i { 0 }; i < CHUNK_SIZE; i++) {
+                glm::ivec3 inside {};
+                inside[axis] = positive ? CHUNK_SIZE - 1 : 0;
+                inside[u] = i;
+                inside[v] = j;
+
+                glm::ivec3 across = inside;
+                across[axis] = positive ? 0 : CHUNK_SIZE - 1;
+
+                int insideIndex = Chunk::index(inside.x, inside.y, inside.z);
+                int acrossIndex = Chunk::index(across.x, across.y, across.z);
+                uint8_t own = light->get(insideIndex);
+                uint8_t other = neighborLight->get(acrossIndex);
+
+                bool ownOpen = chunk->getIndex(insideIndex) == AIR;
+                bool otherOpen = neighbor->getIndex(acrossIndex) == AIR;
+
+                if (!inwardColumn && skyLight(own) == MAX_LIGHT_LEVEL && otherOpen && skyLight(other) < outwardTarget) {
+                    additions.push_back(Node { origin + inside, 0, SKY });
+                }
+
+                if (!ownOpen) {
+                    continue;
+                }
+
+                uint8_t sky = skyLight(other);
+                uint8_t skyTarget = inwardColumn && sky == MAX_LIGHT_LEVEL ? sky : sky - 1;
+                if (sky > 1 && skyLight(own) < skyTarget) {
+                    additions.push_back(Node { origin + inside + FACE_DIRECTIONS[face], 0, SKY });
+                }
+                if (blockLight(other) > 1 && blockLight(own) < blockLight(other) - 1) {
+                    additions.push_back(Node { origin + inside + FACE_DIRECTIONS[face], 0, BLOCK });
+                }
+            }
+        }
+    }
+
+    // the chunk below assumed open sky until now, columns this chunk blocks go dark
+    if (ChunkLight* below = neighborLights[DOWN_FACE]) {
+        for (int z { 0 }; z < CHUNK_SIZE; z++) {
+            for (int x { 0 }; x < CHUNK_SIZE; x++) {
+                int top = Chunk::index(x, CHUNK_SIZE - 1, z);
+                uint8_t level = below->get(top);
+
+                if (skyLight(level) == MAX_LIGHT_LEVEL && skyLight(light->get(Chunk::index(x, 0, z))) != MAX_LIGHT_LEVEL) {
+                    below->set(top, withLevel(level, SKY, 0));
+                    removals.push_back(Node { origin + glm::ivec3 { x, -1, z }, MAX_LIGHT_LEVEL, SKY });
+                }
+            }
+        }
+    }
+}
+
+void LightPropagator::seedEdit(const glm::ivec3& voxel, Voxel previous, std::vector<Node>& removals, std::vector<Node>& additions)
+{
+    ChunkLight* light = findLight(worldToChunk(voxel));
+    if (light == nullptr) {
+        return;
+    }
+
+    glm::ivec3 local = worldToLocal(voxel);
+    int index = Chunk::index(local.x, local.y, local.z);
+    Voxel value = world.getVoxel(voxel);
+
+    if (value != AIR || getEmission(previous) > 0) {
+        // an opaque block swallows whatever passed through, an old source takes its light along
+        for (uint8_t channel : { SKY, BLOCK }) {
+            uint8_t level = channelLevel(light->get(index), channel);
+            if (level == 0 || (value == AIR && channel == SKY)) {
+                continue;
+            }
+
+            light->set(index, withLevel(light->get(index), channel, 0));
+            removals.push_back(Node { voxel, level, channel });
+        }
+    }
+
+    if (uint8_t level = getEmission(value)) {
+        light->set(index, withLevel(light->get(index), BLOCK, level));
+        additions.push_back(Node { voxel, 0, BLOCK });
+    }
+
+    // an opened voxel is lit again from its neighbors
+    if (value == AIR) {
+        for (const glm::ivec3& direction : FACE_DIRECTIONS) {
+            additions.push_back(Node { voxel + direction, 0, SKY });
+            additions.push_back(Node { voxel + direction, 0, BLOCK });
+        }
+    }
+}
+
+void LightPropagator::update()
+{
+    if (insertedChunks.empty() && edits.empty()) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Node> removals;
+    std::vector<Node> additions;
+
+    // inserted chunks first, edits may have touched them before they were seeded,
+    // top down so a column of new chunks passes sky light straight through
+    std::vector<ChunkCoord> inserted;
+    for (uint64_t key : insertedChunks) {
+        inserted.push_back(unpackChunkCoord(key));
+    }
+    insertedChunks.clear();
+
+    // a chunk reads its face neighbors and writes the one below, a checkerboard per layer keeps the jobs apart
+    auto phase = [](const ChunkCoord& coord) {
+        return std::make_pair(-coord.y, (coord.x + coord.z) & 1);
+    };
+
+    std::sort(inserted.begin(), inserted.end(), [&](const ChunkCoord& a, const ChunkCoord& b) {
+        return phase(a) < phase(b);
+    });
+
+    for (size_t first { 0 }; first < inserted.size();) {
+        size_t last { first + 1 };
+        while (last < inserted.size() && phase(inserted[last]) == phase(inserted[first])) {
+            last++;
+        }
+
+        std::vector<std::pair<std::vector<Node>, std::vector<Node>>> seeds(last - first);
+        jobs.parallelFor(static_cast<uint32_t>(last - first), [&](uint32_t i) {
+            seedChunk(inserted[first + i], seeds[i].first, seeds[i].second);
+        });
+
+        for (const auto& [chunkRemovals, chunkAdditions] : seeds) {
+            removals.insert(removals.end(), chunkRemovals.begin(), chunkRemovals.end());
+            additions.insert(additions.end(), chunkAdditions.begin(), chunkAdditions.end());
+        }
+
+        first = last;
+    }
+
+    for (const auto& [voxel, previous] : edits) {
+        seedEdit(voxel, previous, removals, additions);
+    }
+    edits.clear();
+
+    // everything a removed source lit is cleared before any light refills it
+    std::vector<Node> relight;
+    propagate(std::move(removals), true, relight);
+
+    additions.insert(additions.end(), relight.begin(), relight.end());
+    relight.clear();
+    propagate(std::move(additions), false, relight);
+
+    lights.forEach([this](uint64_t key, std::unique_ptr<ChunkLight>& light) {
+        if (light->changed) {
+            light->changed = false;
+            light->compact();
+            changedChunks.push_back(unpackChunkCoord(key));
+        }
+    });
+
+    updateTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightPropagator::propagate(std::vector<Node> nodes, bool removal, std::vector<Node>& relight)
+{
+    while (!nodes.empty()) {
+        roundCount++;
+
+        // group the queue by chunk, nodes in chunks that are not resident go nowhere
+        std::unordered_map<uint64_t, std::vector<Node>> buckets;
+        for (const Node& node : nodes) {
+            uint64_t key = packChunkCoord(worldToChunk(node.voxel));
+            if (lights.contains(key)) {
+                buckets[key].push_back(node);
+            }
+        }
+        nodes.clear();
+
+        // chunks three apart never share a neighbor, each phase runs its jobs fully in parallel
+        std::array<std::vector<std::pair<ChunkCoord, std::vector<Node>*>>, 27> phases;
+        for (auto& [key, bucket] : buckets) {
+            ChunkCoord coord = unpackChunkCoord(key);
+            glm::ivec3 phase = ((coord % 3) + 3) % 3;
+            phases[phase.x + phase.y * 3 + phase.z * 9].emplace_back(coord, &bucket);
+        }
+
+        for (const auto& phase : phases) {
+            if (phase.empty()) {
+                continue;
+            }
+
+            std::vector<RegionOutput> outputs(phase.size());
+            jobs.parallelFor(static_cast<uint32_t>(phase.size()), [&](uint32_t job) {
+                const ChunkCoord& center = phase[job].first;
+                std::vector<Node>& queue = *phase[job].second;
+                RegionOutput& output = outputs[job];
+
+                Region region;
+                region.origin = (center - 1) * CHUNK_SIZE;
+                region.chunks = static_cast<const World&>(world).getNeighborhood(center);
+
+                std::array<std::unique_ptr<ChunkLight>*, 27> found;
+                lights.gatherNeighborhood(center, found);
+                for (int i { 0 }; i < 27; i++) {
+                    region.lights[i] = region.chunks[i] == nullptr || found[i] == nullptr ? nullptr : found[i]->get();
+                }
+
+                // the queue grows while it is processed, a plain index keeps it a fifo
+                for (size_t head { 0 }; head < queue.size(); head++) {
+                    Node node = queue[head];
+
+                    if (!region.interior(node.voxel)) {
+                        output.spilled.push_back(node);
+                        continue;
+                    }
+
+                    int slot, index;
+
+                    if (removal) {
+                        for (int face { 0 }; face < 6; face++) {
+                            glm::ivec3 next = node.voxel + FACE_DIRECTIONS[face];
+                            if (!region.locate(next, slot, index)) {
+                                continue;
+                            }
+
+                            ChunkLight& light = *region.lights[slot];
+                            uint8_t packed = light.get(index);
+                            uint8_t level = channelLevel(packed, node.channel);
+                            if (level == 0) {
+                                continue;
+                            }
+
+                            bool column = node.channel == SKY && face == DOWN_FACE && node.level == MAX_LIGHT_LEVEL && level == MAX_LIGHT_LEVEL;
+                            bool emitting = node.channel == BLOCK && getEmission(region.chunks[slot]->getIndex(index)) > 0;
+
+                            if ((level < node.level || column) && !emitting) {
+                                light.set(index, withLevel(packed, node.channel, 0));
+                                queue.push_back(Node { next, level, node.channel });
+                                output.updates++;
+                            } else {
+                                // lit by something else, it refills the cleared area afterwards
+                                output.relight.push_back(Node { next, 0, node.channel });
+                            }
+                        }
+                    } else {
+                        if (!region.locate(node.voxel, slot, index)) {
+                            continue;
+                        }
+
+                        uint8_t level = channelLevel(region.lights[slot]->get(index), node.channel);
+                        if (level <= 1) {
+                            continue;
+                        }
+
+                        for (int face { 0 }; face < 6; face++) {
+                            glm::ivec3 next = node.voxel + FACE_DIRECTIONS[face];
+                            if (!region.locate(next, slot, index) || region.chunks[slot]->getIndex(index) != AIR) {
+                                continue;
+                            }
+
+                            bool column = node.channel == SKY && face == DOWN_FACE && level == MAX_LIGHT_LEVEL;
+                            uint8_t target = column ? level : level - 1;
+
+                            ChunkLight& light = *region.lights[slot];
+                            uint8_t packed = light.get(index);
+                            if (channelLevel(packed, node.channel) < target) {
+                                light.set(index, withLevel(packed, node.channel, target));
+                                queue.push_back(Node { next, 0, node.channel });
+                                output.updates++;
+                            }
+                        }
+                    }
+                }
+            });
+
+            for (RegionOutput& output : outputs) {
+                nodes.insert(nodes.end(), output.spilled.begin(), output.spilled.end());
+                relight.insert(relight.end(), output.relight.begin(), output.relight.end());
+                updateCount += output.updates;
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,355 @@
+#include "lod.hpp"
+
+#include <algorithm>
+
+namespace VoKel {
+
+uint64_t packLodKey(const ChunkCoord& coord, uint32_t lod)
+{
+    constexpr uint64_t mask { (1ull << 20) - 1 };
+
+    return (static_cast<uint64_t>(coord.x) & mask)
+        | ((static_cast<uint64_t>(coord.y) & mask) << 20)
+        | ((static_cast<uint64_t>(coord.z) & mask) << 40)
+        | (static_cast<uint64_t>(lod) << 60);
+}
+
+namespace {
+
+    float distanceToBounds(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+    {
+        glm::vec3 closest = glm::clamp(point, min, max);
+        return glm::length(point - closest);
+    }
+
+}
+
+ChunkLodManager::ChunkLodManager(World& world, JobSystem& jobs, LodSettings settings)
+    : world { world }
+    , jobs { jobs }
+    , settings { settings }
+{
+    this->settings.levels = std::clamp(settings.levels, 1u, MAX_LOD_LEVELS);
+}
+
+void ChunkLodManager::update(const glm::vec3& cameraPosition)
+{
+    ChunkCoord current { glm::floor(cameraPosition / float(CHUNK_SIZE)) };
+
+    if (!selectionValid || current != cameraChunk) {
+        cameraChunk = current;
+        selectNodes(cameraPosition);
+        queueBuilds(cameraPosition);
+        selectionValid = true;
+    }
+
+    invalidateChunks(world.takeModifiedChunks());
+
+    std::vector<DesiredNode> batch;
+
+    // nodes still waiting for streamed chunks go first, they were queued earlier
+    std::erase_if(waitingNodes, [&](uint64_t key) {
+        auto it = desiredNodes.find(key);
+        if (it == desiredNodes.end()) {
+            return true;
+        }
+
+        if (batch.size() < settings.rebuildsPerUpdate && isResident(it->second)) {
+            batch.push_back(it->second);
+            return true;
+        }
+
+        return false;
+    });
+
+    while (batch.size() < settings.rebuildsPerUpdate && !buildQueue.empty()) {
+        uint64_t key = buildQueue.back();
+        buildQueue.pop_back();
+
+        auto it = desiredNodes.find(key);
+        if (it == desiredNodes.end()) {
+            continue;
+        }
+
+        if (isResident(it->second)) {
+            batch.push_back(it->second);
+        } else {
+            waitingNodes.insert(key);
+        }
+    }
+
+    buildNodes(batch);
+    retireStaleNodes();
+}
+
+void ChunkLodManager::selectNodes(const glm::vec3& cameraPosition)
+{
+    desiredNodes.clear();
+
+    uint32_t top = topLevel();
+    ChunkCoord center { glm::floor(cameraPosition / float(CHUNK_SIZE << top)) };
+    topCenter = center;
+
+    for (int y { -settings.verticalRadius }; y <= settings.verticalRadius; y++) {
+        for (int z { -settings.horizontalRadius }; z <= settings.horizontalRadius; z++) {
+            for (int x { -settings.horizontalRadius }; x <= settings.horizontalRadius; x++) {
+                refine(center + ChunkCoord { x, y, z }, top, cameraPosition);
+            }
+        }
+    }
+
+    computeSkirts();
+
+    // coarse chunks outside the tiled area, plus a margin for neighbor lookups, are not needed anymore
+    world.pruneLodCache([&](const ChunkCoord& coord, uint32_t lod) {
+        if (lod > top) {
+            return false;
+        }
+
+        glm::ivec3 offset = glm::abs((coord >> int(top - lod)) - center);
+        return offset.x <= settings.horizontalRadius + 1 && offset.z <= settings.horizontalRadius + 1
+            && offset.y <= settings.verticalRadius + 1;
+    });
+}
+
+void ChunkLodManager::refine(const ChunkCoord& coord, uint32_t lod, const glm::vec3& cameraPosition)
+{
+    float size = float(CHUNK_SIZE << lod);
+    glm::vec3 min = glm::vec3(coord) * size;
+
+    if (lod > 0 && distanceToBounds(cameraPosition, min, min + size) < settings.splitDistance * size) {
+        for (int i { 0 }; i < 8; i++) {
+            refine(coord * 2 + ChunkCoord { i & 1, (i >> 1) & 1, (i >> 2) & 1 }, lod - 1, cameraPosition);
+        }
+        return;
+    }
+
+    desiredNodes[packLodKey(coord, lod)] = DesiredNode { coord, lod, 0 };
+}
+
+void ChunkLodManager::computeSkirts()
+{
+    for (auto& [key, node] : desiredNodes) {
+        node.skirtMask = 0;
+
+        for (int face { 0 }; face < 6; face++) {
+            if (!desiredNodes.contains(packLodKey(node.coord + FACE_DIRECTIONS[face], node.lod))) {
+                node.skirtMask |= uint8_t(1 << face);
+            }
+        }
+    }
+}
+
+void ChunkLodManager::queueBuilds(const glm::vec3& cameraPosition)
+{
+    buildQueue.clear();
+    waitingNodes.clear();
+
+    for (const auto& [key, node] : desiredNodes) {
+        auto active = activeNodes.find(key);
+        if (active != activeNodes.end() && active->second.skirtMask == node.skirtMask && !dirtyNodes.contains(key)) {
+            continue;
+        }
+
+        buildQueue.push_back(key);
+    }
+
+    // nearest nodes are built first, they sit at the back of the queue
+    auto distance = [&](uint64_t key) {
+        const DesiredNode& node = desiredNodes.at(key);
+        float size = float(CHUNK_SIZE << node.lod);
+        glm::vec3 min = glm::vec3(node.coord) * size;
+        return distanceToBounds(cameraPosition, min, min + size);
+    };
+
+    std::sort(buildQueue.begin(), buildQueue.end(), [&](uint64_t a, uint64_t b) {
+        return distance(a) > distance(b);
+    });
+}
+
+void ChunkLodManager::invalidateChunks(const std::vector<ChunkCoord>& chunks, uint32_t levels)
+{
+    levels = std::min(levels, settings.levels);
+
+    for (const ChunkCoord& chunk : chunks) {
+        for (uint32_t lod { 0 }; lod < levels; lod++) {
+            ChunkCoord coord = chunk >> int(lod);
+
+            // border voxels also change the faces of the neighbors
+            for (int face { -1 }; face < 6; face++) {
+                ChunkCoord target = face < 0 ? coord : coord + FACE_DIRECTIONS[face];
+                uint64_t key = packLodKey(target, lod);
+
+                // nodes that were never built are still queued anyway and dirty ones already are,
+                // stale nodes still on screen are marked too as the next selection may want them back
+                if (!activeNodes.contains(key) || !dirtyNodes.insert(key).second) {
+                    continue;
+                }
+                if (desiredNodes.contains(key)) {
+                    buildQueue.push_back(key);
+                }
+            }
+        }
+    }
+}
+
+bool ChunkLodManager::isResident(const DesiredNode& node) const
+{
+    if (node.lod > 0 || !settings.waitForResidentChunks || isSmooth()) {
+        return true;
+    }
+
+    if (world.getChunk(node.coord) == nullptr) {
+        return false;
+    }
+
+    for (int face { 0 }; face < 6; face++) {
+        if ((node.skirtMask & (1 << face)) == 0 && world.getChunk(node.coord + FACE_DIRECTIONS[face]) == nullptr) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ChunkLodManager::buildNodes(const std::vector<DesiredNode>& nodes)
+{
+    if (nodes.empty()) {
+        return;
+    }
+
+    bool gpu = settings.gpuMeshing && !isSmooth();
+
+    std::vector<ChunkMeshData> meshes;
+    std::vector<std::shared_ptr<const ChunkMeshVolume>> volumes;
+    if (gpu) {
+        volumes = fillVoxelVolumes(nodes);
+    } else {
+        meshes = isSmooth() ? meshSmoothNodes(nodes) : meshVoxelNodes(nodes);
+    }
+
+    for (size_t i { 0 }; i < nodes.size(); i++) {
+        uint64_t key = packLodKey(nodes[i].coord, nodes[i].lod);
+        dirtyNodes.erase(key);
+
+        LodNode& active = activeNodes[key];
+        active.coord = nodes[i].coord;
+        active.lod = nodes[i].lod;
+        active.skirtMask = nodes[i].skirtMask;
+        active.revision = nextRevision++;
+        active.mesh = gpu ? ChunkMeshData {} : std::move(meshes[i]);
+        active.volume = gpu ? std::move(volumes[i]) : nullptr;
+    }
+}
+
+void ChunkLodManager::releaseVolume(uint64_t key)
+{
+    auto it = activeNodes.find(key);
+    if (it != activeNodes.end()) {
+        it->second.volume.reset();
+    }
+}
+
+std::vector<ChunkMeshInput> ChunkLodManager::gatherVoxelInputs(const std::vector<DesiredNode>& nodes)
+{
+    // voxel data is generated in parallel first, the world is only touched from this thread
+    std::vector<std::pair<ChunkCoord, uint32_t>> requests;
+    for (const DesiredNode& node : nodes) {
+        requests.emplace_back(node.coord, node.lod);
+
+        for (int face { 0 }; face < 6; face++) {
+            if ((node.skirtMask & (1 << face)) == 0) {
+                requests.emplace_back(node.coord + FACE_DIRECTIONS[face], node.lod);
+            }
+        }
+    }
+
+    world.prefetchLodChunks(requests, jobs);
+
+    std::vector<ChunkMeshInput> inputs(nodes.size());
+    for (size_t i { 0 }; i < nodes.size(); i++) {
+        inputs[i].chunk = world.getLodChunk(nodes[i].coord, nodes[i].lod);
+        inputs[i].skirtMask = nodes[i].skirtMask;
+
+        bool lit = nodes[i].lod == 0 && lightLookup;
+        if (lit) {
+            inputs[i].light = lightLookup(nodes[i].coord);
+        }
+
+        for (int face { 0 }; face < 6; face++) {
+            if ((nodes[i].skirtMask & (1 << face)) == 0) {
+                inputs[i].neighbors[face] = world.getLodChunk(nodes[i].coord + FACE_DIRECTIONS[face], nodes[i].lod);
+
+                if (lit) {
+                    inputs[i].neighborLight[face] = lightLookup(nodes[i].coord + FACE_DIRECTIONS[face]);
+                }
+            }
+        }
+    }
+
+    return inputs;
+}
+
+std::vector<ChunkMeshData> ChunkLodManager::meshVoxelNodes(const std::vector<DesiredNode>& nodes)
+{
+    std::vector<ChunkMeshInput> inputs = gatherVoxelInputs(nodes);
+
+    std::vector<ChunkMeshData> meshes(nodes.size());
+    jobs.parallelFor(static_cast<uint32_t>(nodes.size()), [&](uint32_t i) {
+        meshes[i] = meshChunk(inputs[i]);
+    });
+
+    return meshes;
+}
+
+std::vector<std::shared_ptr<const ChunkMeshVolume>> ChunkLodManager::fillVoxelVolumes(const std::vector<DesiredNode>& nodes)
+{
+    std::vector<ChunkMeshInput> inputs = gatherVoxelInputs(nodes);
+
+    // only the copy into the padded layout stays on the cpu, empty chunks get no volume
+    std::vector<std::shared_ptr<const ChunkMeshVolume>> volumes(nodes.size());
+    jobs.parallelFor(static_cast<uint32_t>(nodes.size()), [&](uint32_t i) {
+        auto volume = std::make_shared<ChunkMeshVolume>();
+        if (fillChunkMeshVolume(inputs[i], *volume)) {
+            volumes[i] = std::move(volume);
+        }
+    });
+
+    return volumes;
+}
+
+std::vector<ChunkMeshData> ChunkLodManager::meshSmoothNodes(const std::vector<DesiredNode>& nodes)
+{
+    std::vector<ChunkMeshData> meshes(nodes.size());
+
+    // the density is sampled and meshed on the same thread, one field per worker
+    jobs.parallelFor(static_cast<uint32_t>(nodes.size()), [&](uint32_t i) {
+        thread_local DensityField field;
+        densitySource(field, nodes[i].coord, nodes[i].lod);
+        meshes[i] = meshIsosurface({ &field, settings.isosurfaceMode, nodes[i].skirtMask });
+    });
+
+    return meshes;
+}
+
+void ChunkLodManager::retireStaleNodes()
+{
+    bool complete = buildQueue.empty() && waitingNodes.empty();
+
+    // nodes that left the tiled area cannot overlap a missing replacement, they go right away
+    std::erase_if(activeNodes, [&](const auto& entry) {
+        if (desiredNodes.contains(entry.first)) {
+            return false;
+        }
+
+        glm::ivec3 offset = glm::abs((entry.second.coord >> int(topLevel() - entry.second.lod)) - topCenter);
+        bool outside = offset.x > settings.horizontalRadius || offset.z > settings.horizontalRadius || offset.y > settings.verticalRadius;
+        if (complete || outside) {
+            dirtyNodes.erase(entry.first);
+            return true;
+        }
+        return false;
+    });
+}
+
+}
@@ -0,0 +1,317 @@
+#include "material_atlas.hpp"
+#include "image.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    uint32_t packColor(const glm::vec3& color)
+    {
+        glm::uvec3 bytes { glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f };
+        return bytes.r | bytes.g << 8 | bytes.b << 16 | 0xffu << 24;
+    }
+
+    // noise over one block that wraps around, four copies shifted by a block blended by the distance to the edges
+    std::vector<float> wrappingNoise(uint32_t size, float frequency, uint32_t octaves, uint32_t seed)
+    {
+        FbmSettings settings { octaves, frequency, 2.0f, 0.5f, 0.0f, 0.0f };
+        uint32_t count = size * size;
+
+        std::vector<float> x(count);
+        std::vector<float> y(count);
+        std::vector<float> noise(count);
+        std::vector<float> out(count, 0.0f);
+
+        for (int corner { 0 }; corner < 4; corner++) {
+            for (uint32_t i { 0 }; i < count; i++) {
+                x[i] = float(i % size) / float(size) - float(corner & 1);
+                y[i] = float(i / size) / float(size) - float(corner >> 1);
+            }
+            fbm2D(x.data(), y.data(), noise.data(), count, settings, seed, getSimdLevel());
+
+            for (uint32_t i { 0 }; i < count; i++) {
+                float u = float(i % size) / float(size);
+                float v = float(i / size) / float(size);
+                out[i] += noise[i] * (corner & 1 ? u : 1.0f - u) * (corner >> 1 ? v : 1.0f - v);
+            }
+        }
+
+        return out;
+    }
+
+    // box filter of each 2x2 block of texels, size is the side of the input
+    std::vector<uint32_t> downsample(const std::vector<uint32_t>& texels, uint32_t size)
+    {
+        uint32_t half = std::max(size / 2, 1u);
+        std::vector<uint32_t> out(half * half);
+
+        for (uint32_t y { 0 }; y < half; y++) {
+            for (uint32_t x { 0 }; x < half; x++) {
+                uint32_t x1 = std::min(x * 2 + 1, size - 1);
+                uint32_t y1 = std::min(y * 2 + 1, size - 1);
+                std::array<uint32_t, 4> samples { texels[y * 2 * size + x * 2], texels[y * 2 * size + x1], texels[y1 * size + x * 2], texels[y1 * size + x1] };
+
+                uint32_t texel { 0 };
+                for (int channel { 0 }; channel < 4; channel++) {
+                    uint32_t sum { 2 };
+                    for (uint32_t sample : samples) {
+                        sum += (sample >> (channel * 8)) & 0xff;
+                    }
+                    texel |= (sum / 4) << (channel * 8);
+                }
+                out[y * half + x] = texel;
+            }
+        }
+
+        return out;
+    }
+
+    void imageBarrier(vk::CommandBuffer commandBuffer, vk::Image image, uint32_t baseLevel, uint32_t levelCount, uint32_t layerCount,
+        vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess,
+        vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage)
+    {
+        vk::ImageMemoryBarrier barrier {};
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, baseLevel, levelCount, 0, layerCount };
+
+        commandBuffer.pipelineBarrier(srcStage, dstStage, vk::DependencyFlags(), nullptr, nullptr, barrier);
+    }
+
+}
+
+std::vector<uint32_t> generateMaterialTexture(Voxel material, uint32_t size)
+{
+    std::vector<uint32_t> texels(size * size);
+
+    // the same colors the chunk shader used before it sampled textures
+    glm::vec3 color;
+    float frequency, variation;
+    switch (material) {
+    case MATERIAL_GRASS:
+        color = { 0.36f, 0.62f, 0.25f };
+        frequency = 8.0f;
+        variation = 0.18f;
+        break;
+    case MATERIAL_DIRT:
+        color = { 0.47f, 0.33f, 0.22f };
+        frequency = 6.0f;
+        variation = 0.2f;
+        break;
+    case MATERIAL_STONE:
+        color = { 0.5f, 0.5f, 0.52f };
+        frequency = 3.0f;
+        variation = 0.15f;
+        break;
+    case MATERIAL_SAND:
+        color = { 0.86f, 0.8f, 0.58f };
+        frequency = 16.0f;
+        variation = 0.08f;
+        break;
+    case MATERIAL_LAMP:
+        color = { 1.0f, 0.85f, 0.55f };
+        frequency = 4.0f;
+        variation = 0.08f;
+        break;
+    default:
+        for (uint32_t i { 0 }; i < size * size; i++) {
+            bool odd = ((i % size) * 2 / size + (i / size) * 2 / size) & 1;
+            texels[i] = packColor(odd ? glm::vec3 { 1.0f, 0.0f, 1.0f } : glm::vec3 { 0.0f });
+        }
+        return texels;
+    }
+
+    std::vector<float> base = wrappingNoise(size, frequency, 3, material);
+    std::vector<float> detail = wrappingNoise(size, frequency * 2.0f, 1, material + 101);
+
+    for (uint32_t i { 0 }; i < size * size; i++) {
+        float shade = 1.0f + base[i] * variation;
+
+        // dirt gets pebbles, stone cracks along the noise's zero crossings
+        if (material == MATERIAL_DIRT && detail[i] > 0.35f) {
+            shade *= 0.7f;
+        } else if (material == MATERIAL_STONE && std::abs(detail[i]) < 0.04f) {
+            shade *= 0.65f;
+        }
+
+        // lamps get a darker frame a sixteenth of the block wide
+        uint32_t x = i % size;
+        uint32_t y = i / size;
+        uint32_t border = std::max(size / 16, 1u);
+        if (material == MATERIAL_LAMP && (x < border || y < border || x >= size - border || y >= size - border)) {
+            shade *= 0.5f;
+        }
+
+        texels[i] = packColor(color * shade);
+    }
+
+    return texels;
+}
+
+MaterialAtlas::MaterialAtlas(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t textureSize)
+    : device { device }
+    , textureSize { textureSize }
+    , mipLevels { static_cast<uint32_t>(std::bit_width(textureSize)) }
+{
+    vk::FormatFeatureFlags features = physicalDevice.getFormatProperties(FORMAT).optimalTilingFeatures;
+    if (!(features & vk::FormatFeatureFlagBits::eSampledImage)) {
+        throw std::runtime_error { "Material textures need sampled rgba8 images" };
+    }
+
+    vk::FormatFeatureFlags blitFeatures = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+    gpuMips = (features & blitFeatures) == blitFeatures;
+
+    // levels the cpu fills, layer after layer within each level so one copy covers all layers
+    std::vector<std::vector<uint32_t>> layers(MATERIAL_LAYER_COUNT);
+    for (uint32_t layer { 0 }; layer < MATERIAL_LAYER_COUNT; layer++) {
+        layers[layer] = generateMaterialTexture(static_cast<Voxel>(layer), textureSize);
+    }
+
+    std::vector<uint32_t> texels;
+    uint32_t size = textureSize;
+    for (uint32_t level { 0 }; level < (gpuMips ? 1 : mipLevels); level++) {
+        vk::BufferImageCopy copy {};
+        copy.bufferOffset = texels.size() * sizeof(uint32_t);
+        copy.imageSubresource = vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, level, 0, MATERIAL_LAYER_COUNT };
+        copy.imageExtent = vk::Extent3D { size, size, 1 };
+        copies.push_back(copy);
+
+        for (std::vector<uint32_t>& layer : layers) {
+            texels.insert(texels.end(), layer.begin(), layer.end());
+            layer = downsample(layer, size);
+        }
+        size = std::max(size / 2, 1u);
+    }
+
+    vkUtil::BufferInput bufferInput;
+    bufferInput.device = device;
+    bufferInput.physicalDevice = physicalDevice;
+    bufferInput.size = texels.size() * sizeof(uint32_t);
+    bufferInput.usage = vk::BufferUsageFlagBits::eTransferSrc;
+    staging = vkUtil::createBuffer(bufferInput);
+
+    void* mapped = device.mapMemory(staging.bufferMemory, 0, bufferInput.size);
+    std::memcpy(mapped, texels.data(), bufferInput.size);
+    device.unmapMemory(staging.bufferMemory);
+
+    vkImage::ImageInput imageInput {};
+    imageInput.device = device;
+    imageInput.physicalDevice = physicalDevice;
+    imageInput.width = textureSize;
+    imageInput.height = textureSize;
+    imageInput.tiling = vk::ImageTiling::eOptimal;
+    imageInput.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+    imageInput.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    imageInput.format = FORMAT;
+    imageInput.mipLevels = mipLevels;
+    imageInput.arrayLayers = MATERIAL_LAYER_COUNT;
+
+    image = vkImage::createImage(imageInput);
+    imageMemory = vkImage::createImageMemory(imageInput, image);
+    imageView = vkImage::createImageView(device, image, FORMAT, vk::ImageAspectFlagBits::eColor, vk::ImageViewType::e2DArray, mipLevels, MATERIAL_LAYER_COUNT);
+
+    // texels stay crisp up close, distant blocks blend between the mips
+    vk::SamplerCreateInfo samplerInfo {};
+    samplerInfo.flags = vk::SamplerCreateFlags();
+    samplerInfo.magFilter = vk::Filter::eNearest;
+    samplerInfo.minFilter = vk::Filter::eLinear;
+    samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
+    samplerInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
+    samplerInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
+    samplerInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = float(mipLevels);
+    sampler = device.createSampler(samplerInfo);
+
+    vk::DescriptorSetLayoutBinding binding { 0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eFragment };
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.flags = vk::DescriptorSetLayoutCreateFlags();
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    descriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+    vk::DescriptorPoolSize poolSize { vk::DescriptorType::eCombinedImageSampler, 1 };
+
+    vk::DescriptorPoolCreateInfo poolInfo {};
+    poolInfo.flags = vk::DescriptorPoolCreateFlags();
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    descriptorPool = device.createDescriptorPool(poolInfo);
+
+    vk::DescriptorSetAllocateInfo allocInfo {};
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+    descriptorSet = device.allocateDescriptorSets(allocInfo)[0];
+
+    // the first record leaves the image in this layout before anything samples it
+    vk::DescriptorImageInfo imageInfo { sampler, imageView, vk::ImageLayout::eShaderReadOnlyOptimal };
+    vk::WriteDescriptorSet write { descriptorSet, 0, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfo };
+    device.updateDescriptorSets(write, nullptr);
+}
+
+MaterialAtlas::~MaterialAtlas()
+{
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+    device.destroySampler(sampler);
+    device.destroyImageView(imageView);
+    device.destroyImage(image);
+    device.freeMemory(imageMemory);
+    device.destroyBuffer(staging.buffer);
+    device.freeMemory(staging.bufferMemory);
+}
+
+void MaterialAtlas::record(vk::CommandBuffer commandBuffer)
+{
+    if (uploaded) {
+        return;
+    }
+    uploaded = true;
+
+    imageBarrier(commandBuffer, image, 0, mipLevels, MATERIAL_LAYER_COUNT, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+        vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer);
+
+    commandBuffer.copyBufferToImage(staging.buffer, image, vk::ImageLayout::eTransferDstOptimal, copies);
+
+    // without blits the cpu filled every level and the loop records nothing
+    uint32_t blitted = gpuMips ? mipLevels : 1;
+    int32_t size = int32_t(textureSize);
+    for (uint32_t level { 1 }; level < blitted; level++) {
+        // the level above was just written, it turns into the source
+        imageBarrier(commandBuffer, image, level - 1, 1, MATERIAL_LAYER_COUNT, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal,
+            vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer);
+
+        int32_t half = std::max(size / 2, 1);
+
+        vk::ImageBlit blit {};
+        blit.srcSubresource = vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, level - 1, 0, MATERIAL_LAYER_COUNT };
+        blit.srcOffsets[1] = vk::Offset3D { size, size, 1 };
+        blit.dstSubresource = vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, level, 0, MATERIAL_LAYER_COUNT };
+        blit.dstOffsets[1] = vk::Offset3D { half, half, 1 };
+        commandBuffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+        imageBarrier(commandBuffer, image, level - 1, 1, MATERIAL_LAYER_COUNT, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader);
+
+        size = half;
+    }
+
+    // the last blitted level, or every level the cpu filled
+    uint32_t remaining = blitted - 1;
+    imageBarrier(commandBuffer, image, remaining, mipLevels - remaining, MATERIAL_LAYER_COUNT, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader);
+}
+
+}
@@ -26,7 +26,7 @@ void allocateBufferMemory(Buffer& buffer, const BufferInput& input)
     allocInfo.memoryTypeIndex = findMemoryTypeIndex(
         input.physicalDevice,
         memoryRequirements.memoryTypeBits,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+        input.memoryProperties);
 
     buffer.bufferMemory = input.device.allocateMemory(allocInfo);
     input.device.bindBufferMemory(buffer.buffer, buffer.bufferMemory, 0);
@@ -0,0 +1,98 @@
+#include "mesh_import.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace VoKel {
+
+namespace {
+
+    // part of every key, bumped whenever the optimization or the encoding below changes
+    constexpr uint32_t MESH_IMPORT_VERSION { 1 };
+
+    struct MeshHeader {
+        uint64_t positionCount;
+        uint64_t indexCount;
+        MeshOptimization optimization;
+    };
+
+    std::vector<uint8_t> encodeMesh(const ObjMesh& mesh, const MeshOptimization& optimization)
+    {
+        MeshHeader header { mesh.positions.size(), mesh.indices.size(), optimization };
+        size_t positionBytes = mesh.positions.size() * sizeof(glm::vec3);
+        size_t indexBytes = mesh.indices.size() * sizeof(uint32_t);
+
+        std::vector<uint8_t> data(sizeof(header) + positionBytes + indexBytes);
+        std::memcpy(data.data(), &header, sizeof(header));
+        std::memcpy(data.data() + sizeof(header), mesh.positions.data(), positionBytes);
+        std::memcpy(data.data() + sizeof(header) + positionBytes, mesh.indices.data(), indexBytes);
+        return data;
+    }
+
+    bool decodeMesh(const std::vector<uint8_t>& data, ObjMesh& mesh, MeshOptimization& optimization)
+    {
+        MeshHeader header {};
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        size_t positionBytes = header.positionCount * sizeof(glm::vec3);
+        size_t indexBytes = header.indexCount * sizeof(uint32_t);
+        if (data.size() != sizeof(header) + positionBytes + indexBytes) {
+            return false;
+        }
+
+        mesh.positions.resize(header.positionCount);
+        mesh.indices.resize(header.indexCount);
+        std::memcpy(mesh.positions.data(), data.data() + sizeof(header), positionBytes);
+        std::memcpy(mesh.indices.data(), data.data() + sizeof(header) + positionBytes, indexBytes);
+        optimization = header.optimization;
+        return true;
+    }
+
+    uint64_t sourceKey(const std::filesystem::path& path)
+    {
+        std::ifstream file { path, std::ios::binary };
+        if (!file) {
+            throw std::runtime_error { "Failed to open " + path.string() };
+        }
+        std::vector<char> bytes { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+        return hashBytes(bytes.data(), bytes.size(), hashBytes(&MESH_IMPORT_VERSION, sizeof(MESH_IMPORT_VERSION)));
+    }
+
+}
+
+std::vector<ImportedMesh> importMeshes(const std::vector<std::filesystem::path>& paths, AssetPack& pack, JobSystem& jobs)
+{
+    std::vector<ImportedMesh> meshes(paths.size());
+
+    jobs.parallelFor(static_cast<uint32_t>(paths.size()), [&](uint32_t i) {
+        ImportedMesh& imported = meshes[i];
+        imported.path = paths[i];
+
+        // the job system does not carry exceptions across threads
+        try {
+            uint64_t key = sourceKey(imported.path);
+
+            std::vector<uint8_t> data;
+            if (pack.read(key, data) && decodeMesh(data, imported.mesh, imported.optimization)) {
+                imported.cached = true;
+                return;
+            }
+
+            imported.mesh = loadObj(imported.path);
+            imported.optimization = optimizeMesh(imported.mesh);
+            pack.write(key, encodeMesh(imported.mesh, imported.optimization));
+        } catch (const std::runtime_error& error) {
+            imported.mesh = {};
+            imported.error = error.what();
+        }
+    });
+
+    return meshes;
+}
+
+}
@@ -0,0 +1,446 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr uint32_t NONE { ~0u };
+
+    // a vertex is cached while fewer than ANALYSIS_CACHE_SIZE misses happened since its own
+    class FifoCache {
+    public:
+        explicit FifoCache(size_t vertexCount)
+            : stamps(vertexCount, 0)
+        {
+        }
+
+        // true on a miss
+        bool access(uint32_t vertex)
+        {
+            if (time - stamps[vertex] > ANALYSIS_CACHE_SIZE) {
+                stamps[vertex] = time++;
+                return true;
+            }
+            return false;
+        }
+
+        uint32_t accessTriangle(const uint32_t* triangle)
+        {
+            return uint32_t(access(triangle[0])) + uint32_t(access(triangle[1])) + uint32_t(access(triangle[2]));
+        }
+
+        void flush() { time += ANALYSIS_CACHE_SIZE + 1; }
+
+    private:
+        std::vector<uint32_t> stamps;
+        uint32_t time { ANALYSIS_CACHE_SIZE + 1 };
+    };
+
+    // pixels along the longest side of the mesh bounds in the overdraw views
+    constexpr int OVERDRAW_RESOLUTION { 256 };
+
+    float edge(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p)
+    {
+        return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    }
+
+    // orthographic views along +x, -x, +y, -y, +z and -z, back faces culled and every depth test passed counted as a shaded pixel
+    float analyzeOverdraw(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+    {
+        glm::vec3 min { std::numeric_limits<float>::max() };
+        glm::vec3 max { -std::numeric_limits<float>::max() };
+        for (uint32_t index : indices) {
+            min = glm::min(min, positions[index]);
+            max = glm::max(max, positions[index]);
+        }
+        float extent = std::max({ max.x - min.x, max.y - min.y, max.z - min.z });
+        if (indices.empty() || extent <= 0.0f) {
+            return 0.0f;
+        }
+        float scale = float(OVERDRAW_RESOLUTION) / extent;
+
+        uint64_t shaded { 0 };
+        uint64_t covered { 0 };
+        std::vector<float> depths(OVERDRAW_RESOLUTION * OVERDRAW_RESOLUTION);
+
+        for (int axis { 0 }; axis < 3; axis++) {
+            int u = (axis + 1) % 3;
+            int v = (axis + 2) % 3;
+
+            for (float sign : { 1.0f, -1.0f }) {
+                std::fill(depths.begin(), depths.end(), std::numeric_limits<float>::max());
+
+                for (size_t t { 0 }; t < indices.size(); t += 3) {
+                    glm::vec3 a = (positions[indices[t]] - min) * scale;
+                    glm::vec3 b = (positions[indices[t + 1]] - min) * scale;
+                    glm::vec3 c = (positions[indices[t + 2]] - min) * scale;
+
+                    // the camera looks along sign * axis
+                    if (glm::cross(b - a, c - a)[axis] * sign >= 0.0f) {
+                        continue;
+                    }
+
+                    glm::vec2 a2 { a[u], a[v] };
+                    glm::vec2 b2 { b[u], b[v] };
+                    glm::vec2 c2 { c[u], c[v] };
+                    float za = a[axis] * sign;
+                    float zb = b[axis] * sign;
+                    float zc = c[axis] * sign;
+
+                    float area = edge(a2, b2, c2);
+                    if (area == 0.0f) {
+                        continue;
+                    }
+                    if (area < 0.0f) {
+                        std::swap(b2, c2);
+                        std::swap(zb, zc);
+                        area = -area;
+                    }
+
+                    int x0 = std::max(int(std::floor(std::min({ a2.x, b2.x, c2.x }))), 0);
+                    int y0 = std::max(int(std::floor(std::min({ a2.y, b2.y, c2.y }))), 0);
+                    int x1 = std::min(int(std::ceil(std::max({ a2.x, b2.x, c2.x }))), OVERDRAW_RESOLUTION - 1);
+                    int y1 = std::min(int(std::ceil(std::max({ a2.y, b2.y, c2.y }))), OVERDRAW_RESOLUTION - 1);
+
+                    // pixel centers strictly inside, so edges shared by two triangles are not shaded twice
+                    for (int y { y0 }; y <= y1; y++) {
+                        for (int x { x0 }; x <= x1; x++) {
+                            glm::vec2 p { float(x) + 0.5f, float(y) + 0.5f };
+                            float wa = edge(b2, c2, p);
+                            float wb = edge(c2, a2, p);
+                            float wc = edge(a2, b2, p);
+                            if (wa <= 0.0f || wb <= 0.0f || wc <= 0.0f) {
+                                continue;
+                            }
+
+                            float depth = (wa * za + wb * zb + wc * zc) / area;
+                            float& stored = depths[y * OVERDRAW_RESOLUTION + x];
+                            if (depth < stored) {
+                                stored = depth;
+                                shaded++;
+                            }
+                        }
+                    }
+                }
+
+                covered += std::count_if(depths.begin(), depths.end(), [](float depth) { return depth != std::numeric_limits<float>::max(); });
+            }
+        }
+
+        return covered > 0 ? float(double(shaded) / double(covered)) : 0.0f;
+    }
+
+    // Forsyth's scoring, the cache is an LRU of FORSYTH_CACHE_SIZE vertices
+    constexpr uint32_t FORSYTH_CACHE_SIZE { 32 };
+    constexpr uint32_t FORSYTH_MAX_VALENCE { 32 };
+
+    struct ForsythScores {
+        float cache[FORSYTH_CACHE_SIZE];
+        float valence[FORSYTH_MAX_VALENCE + 1];
+
+        ForsythScores()
+        {
+            // the last triangle's vertices score alike whatever order they were added in
+            for (uint32_t i { 0 }; i < FORSYTH_CACHE_SIZE; i++) {
+                cache[i] = i < 3 ? 0.75f : std::pow(1.0f - float(i - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+            }
+
+            // vertices with few triangles left are finished first
+            valence[0] = 0.0f;
+            for (uint32_t i { 1 }; i <= FORSYTH_MAX_VALENCE; i++) {
+                valence[i] = 2.0f / std::sqrt(float(i));
+            }
+        }
+
+        float score(uint32_t position, uint32_t remaining) const
+        {
+            if (remaining == 0) {
+                return -1.0f;
+            }
+            return (position == NONE ? 0.0f : cache[position]) + valence[std::min(remaining, FORSYTH_MAX_VALENCE)];
+        }
+    };
+
+}
+
+MeshDrawStats analyzeMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+    MeshDrawStats stats {};
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return stats;
+    }
+
+    FifoCache cache { positions.size() };
+    std::vector<bool> referenced(positions.size(), false);
+    size_t misses { 0 };
+    size_t vertices { 0 };
+    for (size_t t { 0 }; t < triangleCount; t++) {
+        misses += cache.accessTriangle(&indices[t * 3]);
+        for (int k { 0 }; k < 3; k++) {
+            vertices += referenced[indices[t * 3 + k]] ? 0 : 1;
+            referenced[indices[t * 3 + k]] = true;
+        }
+    }
+
+    stats.acmr = float(misses) / float(triangleCount);
+    stats.atvr = float(misses) / float(vertices);
+    stats.overdraw = analyzeOverdraw(positions, indices);
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+    static const ForsythScores scores;
+
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // triangles of every vertex, the live ones first, remaining counts them
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t index : indices) {
+        offsets[index + 1]++;
+    }
+    for (size_t v { 0 }; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    std::vector<uint32_t> adjacency(indices.size());
+    for (uint32_t t { 0 }; t < triangleCount; t++) {
+        for (int k { 0 }; k < 3; k++) {
+            uint32_t vertex = indices[t * 3 + k];
+            adjacency[offsets[vertex] + remaining[vertex]++] = t;
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v { 0 }; v < vertexCount; v++) {
+        vertexScores[v] = scores.score(NONE, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    uint32_t best { 0 };
+    for (uint32_t t { 0 }; t < triangleCount; t++) {
+        const uint32_t* triangle = &indices[t * 3];
+        triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+        best = triangleScores[t] > triangleScores[best] ? t : best;
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    uint32_t cursor { 0 };
+
+    for (uint32_t count { 0 }; count < triangleCount; count++) {
+        // nothing cached has triangles left, go on with the next one in input order
+        if (best == NONE) {
+            while (emitted[cursor]) {
+                cursor++;
+            }
+            best = cursor;
+        }
+
+        const uint32_t* triangle = &indices[best * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        nextCache.clear();
+        for (int k { 0 }; k < 3; k++) {
+            uint32_t vertex = triangle[k];
+            uint32_t* list = &adjacency[offsets[vertex]];
+            uint32_t* found = std::find(list, list + remaining[vertex], best);
+            std::swap(*found, list[--remaining[vertex]]);
+
+            if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end()) {
+                nextCache.push_back(vertex);
+            }
+        }
+        size_t added = nextCache.size();
+        for (uint32_t vertex : cache) {
+            if (std::find(nextCache.begin(), nextCache.begin() + added, vertex) == nextCache.begin() + added) {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        // the vertices pushed out of the cache lose their position, their triangles' scores follow every vertex's change
+        for (size_t i { 0 }; i < nextCache.size(); i++) {
+            uint32_t vertex = nextCache[i];
+            uint32_t position = i < FORSYTH_CACHE_SIZE ? static_cast<uint32_t>(i) : NONE;
+
+            float score = scores.score(position, remaining[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+
+            const uint32_t* list = &adjacency[offsets[vertex]];
+            for (uint32_t j { 0 }; j < remaining[vertex]; j++) {
+                triangleScores[list[j]] += delta;
+            }
+        }
+
+        nextCache.resize(std::min<size_t>(nextCache.size(), FORSYTH_CACHE_SIZE));
+        std::swap(cache, nextCache);
+
+        // the best triangle touches a cached vertex, the scores of all others did not change
+        best = NONE;
+        float bestScore { -std::numeric_limits<float>::max() };
+        for (uint32_t vertex : cache) {
+            const uint32_t* list = &adjacency[offsets[vertex]];
+            for (uint32_t j { 0 }; j < remaining[vertex]; j++) {
+                if (triangleScores[list[j]] > bestScore || (triangleScores[list[j]] == bestScore && list[j] < best)) {
+                    best = list[j];
+                    bestScore = triangleScores[list[j]];
+                }
+            }
+        }
+    }
+
+    indices = std::move(output);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, float threshold)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // runs start where all three vertices miss, the order before them does not matter to the cache
+    FifoCache cache { positions.size() };
+    std::vector<uint32_t> runs;
+    for (uint32_t t { 0 }; t < triangleCount; t++) {
+        if (cache.accessTriangle(&indices[t * 3]) == 3) {
+            runs.push_back(t);
+        }
+    }
+    if (runs.empty() || runs[0] != 0) {
+        runs.insert(runs.begin(), 0);
+    }
+    runs.push_back(triangleCount);
+
+    // a cluster ends once its own miss ratio comes within threshold of its run's, the cache is flushed for the next one
+    std::vector<uint32_t> clusters;
+    for (size_t r { 0 }; r + 1 < runs.size(); r++) {
+        uint32_t begin = runs[r];
+        uint32_t end = runs[r + 1];
+
+        cache.flush();
+        uint32_t misses { 0 };
+        for (uint32_t t { begin }; t < end; t++) {
+            misses += cache.accessTriangle(&indices[t * 3]);
+        }
+        float runRatio = float(misses) / float(end - begin);
+
+        cache.flush();
+        clusters.push_back(begin);
+        uint32_t start { begin };
+        misses = 0;
+        for (uint32_t t { begin }; t < end; t++) {
+            misses += cache.accessTriangle(&indices[t * 3]);
+
+            if (t + 1 < end && float(misses) / float(t + 1 - start) <= runRatio * threshold) {
+                cache.flush();
+                clusters.push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // area weighted centroids and normals, the cross products are twice the areas
+    size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::vec3> centroids(clusterCount, glm::vec3 { 0.0f });
+    std::vector<glm::vec3> normals(clusterCount, glm::vec3 { 0.0f });
+    glm::vec3 meshCentroid { 0.0f };
+    float meshArea { 0.0f };
+
+    for (size_t c { 0 }; c < clusterCount; c++) {
+        float area { 0.0f };
+        for (uint32_t t { clusters[c] }; t < clusters[c + 1]; t++) {
+            glm::vec3 a = positions[indices[t * 3]];
+            glm::vec3 b = positions[indices[t * 3 + 1]];
+            glm::vec3 d = positions[indices[t * 3 + 2]];
+
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(normal);
+            centroids[c] += (a + b + d) * (triangleArea / 3.0f);
+            normals[c] += normal;
+            area += triangleArea;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroids[c] / area : positions[indices[clusters[c] * 3]];
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : centroids[0];
+
+    // the further out a cluster faces, the more of the mesh it can hide
+    std::vector<float> keys(clusterCount, 0.0f);
+    for (size_t c { 0 }; c < clusterCount; c++) {
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    for (uint32_t c { 0 }; c < clusterCount; c++) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (uint32_t c : order) {
+        output.insert(output.end(), indices.begin() + size_t(clusters[c]) * 3, indices.begin() + size_t(clusters[c + 1]) * 3);
+    }
+    indices = std::move(output);
+}
+
+void optimizeVertexFetch(std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(positions.size(), NONE);
+    uint32_t next { 0 };
+    for (uint32_t& index : indices) {
+        if (remap[index] == NONE) {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+
+    std::vector<glm::vec3> reordered(next);
+    for (size_t v { 0 }; v < positions.size(); v++) {
+        if (remap[v] != NONE) {
+            reordered[remap[v]] = positions[v];
+        }
+    }
+    positions = std::move(reordered);
+}
+
+MeshOptimization optimizeMesh(ObjMesh& mesh)
+{
+    MeshOptimization optimization {};
+    optimization.before = analyzeMesh(mesh.positions, mesh.indices);
+
+    auto start = std::chrono::steady_clock::now();
+    optimizeVertexCache(mesh.indices, mesh.positions.size());
+    optimizeOverdraw(mesh.indices, mesh.positions);
+    optimizeVertexFetch(mesh.positions, mesh.indices);
+    optimization.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    optimization.after = analyzeMesh(mesh.positions, mesh.indices);
+    return optimization;
+}
+
+}
@@ -0,0 +1,345 @@
+#include "meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace VoKel {
+
+namespace {
+
+    // triangles per parallel range, large enough that few meshlets get cut at a range border
+    constexpr uint32_t RANGE_TRIANGLES { 1 << 15 };
+
+    constexpr uint32_t NONE { ~0u };
+
+    // 10 bits per axis of the position in the mesh bounds, interleaved
+    uint32_t mortonCode(const glm::vec3& position, const glm::vec3& min, const glm::vec3& scale)
+    {
+        glm::uvec3 cell = glm::uvec3(glm::clamp((position - min) * scale, glm::vec3 { 0.0f }, glm::vec3 { 1023.0f }));
+
+        uint32_t code { 0 };
+        for (uint32_t bit { 0 }; bit < 10; bit++) {
+            code |= ((cell.x >> bit) & 1) << (bit * 3);
+            code |= ((cell.y >> bit) & 1) << (bit * 3 + 1);
+            code |= ((cell.z >> bit) & 1) << (bit * 3 + 2);
+        }
+        return code;
+    }
+
+    // normals within about 84 degrees of the axis, wider cones are left uncullable
+    constexpr float MIN_CONE_DOT { 0.1f };
+
+    void computeBounds(const std::vector<glm::vec3>& positions, const MeshletMesh& mesh, Meshlet& meshlet)
+    {
+        glm::vec3 min { std::numeric_limits<float>::max() };
+        glm::vec3 max { -std::numeric_limits<float>::max() };
+        for (uint32_t i { 0 }; i < meshlet.vertexCount; i++) {
+            const glm::vec3& position = positions[mesh.vertices[meshlet.vertexOffset + i]];
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+
+        meshlet.center = (min + max) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (uint32_t i { 0 }; i < meshlet.vertexCount; i++) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(positions[mesh.vertices[meshlet.vertexOffset + i]] - meshlet.center));
+        }
+
+        // degenerate triangles have no side to face
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.triangleCount);
+        glm::vec3 sum { 0.0f };
+        for (uint32_t t { 0 }; t < meshlet.triangleCount; t++) {
+            const uint8_t* triangle = &mesh.triangles[(meshlet.triangleOffset + t) * 3];
+            glm::vec3 a = positions[mesh.vertices[meshlet.vertexOffset + triangle[0]]];
+            glm::vec3 b = positions[mesh.vertices[meshlet.vertexOffset + triangle[1]]];
+            glm::vec3 c = positions[mesh.vertices[meshlet.vertexOffset + triangle[2]]];
+
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if (length > 0.0f) {
+                normals.push_back(normal / length);
+                sum += normals.back();
+            }
+        }
+
+        meshlet.coneAxis = glm::vec3 { 0.0f };
+        meshlet.coneCutoff = 1.0f;
+
+        float sumLength = glm::length(sum);
+        if (normals.empty() || sumLength == 0.0f) {
+            return;
+        }
+
+        glm::vec3 axis = sum / sumLength;
+        float minDot { 1.0f };
+        for (const glm::vec3& normal : normals) {
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        }
+
+        if (minDot > MIN_CONE_DOT) {
+            meshlet.coneAxis = axis;
+            meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+
+    void buildRange(const std::vector<glm::vec3>& positions, const uint32_t* rangeIndices, uint32_t triangleCount, MeshletMesh& mesh)
+    {
+        uint32_t indexCount = triangleCount * 3;
+
+        // range local vertices in ascending order of the mesh's vertices, from the indices sorted by vertex
+        std::vector<uint64_t> sortedIndices(indexCount);
+        for (uint32_t i { 0 }; i < indexCount; i++) {
+            sortedIndices[i] = uint64_t(rangeIndices[i]) << 32 | i;
+        }
+        std::sort(sortedIndices.begin(), sortedIndices.end());
+
+        std::vector<uint32_t> rangeVertices;
+        std::vector<uint32_t> localIndices(indexCount);
+        for (uint64_t sorted : sortedIndices) {
+            uint32_t vertex = static_cast<uint32_t>(sorted >> 32);
+            if (rangeVertices.empty() || rangeVertices.back() != vertex) {
+                rangeVertices.push_back(vertex);
+            }
+            localIndices[static_cast<uint32_t>(sorted)] = static_cast<uint32_t>(rangeVertices.size() - 1);
+        }
+        uint32_t vertexCount = static_cast<uint32_t>(rangeVertices.size());
+
+        // triangles of every vertex, in triangle order
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (uint32_t vertex : localIndices) {
+            adjacencyOffsets[vertex + 1]++;
+        }
+        for (uint32_t v { 0 }; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        std::vector<uint32_t> adjacency(indexCount);
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i { 0 }; i < indexCount; i++) {
+            adjacency[fill[localIndices[i]]++] = i / 3;
+        }
+
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (uint32_t t { 0 }; t < triangleCount; t++) {
+            centroids[t] = (positions[rangeIndices[t * 3]] + positions[rangeIndices[t * 3 + 1]] + positions[rangeIndices[t * 3 + 2]]) / 3.0f;
+        }
+
+        // stamped with the meshlet that last saw them, so nothing is cleared between meshlets
+        std::vector<uint32_t> vertexMeshlet(vertexCount, NONE);
+        std::vector<uint8_t> vertexSlot(vertexCount, 0);
+        std::vector<uint32_t> candidateMeshlet(triangleCount, NONE);
+        std::vector<uint32_t> candidateSlot(triangleCount, 0);
+        std::vector<bool> used(triangleCount, false);
+
+        // unused triangles of every vertex, a vertex down to its last one leaves that triangle stranded if passed over
+        std::vector<uint32_t> liveTriangles(vertexCount);
+        for (uint32_t v { 0 }; v < vertexCount; v++) {
+            liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+        }
+
+        // border triangles with the vertices they would still add, kept up to date as vertices join
+        struct Candidate {
+            uint32_t triangle;
+            uint32_t added;
+            glm::vec3 centroid;
+        };
+        std::vector<Candidate> candidates;
+        uint32_t nextUnused { 0 };
+        uint32_t remaining { triangleCount };
+        uint32_t seed { NONE };
+
+        while (remaining > 0) {
+            if (seed == NONE) {
+                while (used[nextUnused]) {
+                    nextUnused++;
+                }
+                seed = nextUnused;
+            }
+
+            uint32_t id = static_cast<uint32_t>(mesh.meshlets.size());
+            Meshlet meshlet {};
+            meshlet.vertexOffset = static_cast<uint32_t>(mesh.vertices.size());
+            meshlet.triangleOffset = static_cast<uint32_t>(mesh.triangleCount());
+
+            glm::vec3 centroidSum { 0.0f };
+            candidates.clear();
+
+            auto add = [&](uint32_t triangle) {
+                used[triangle] = true;
+                remaining--;
+                centroidSum += centroids[triangle];
+
+                for (uint32_t k { 0 }; k < 3; k++) {
+                    uint32_t vertex = localIndices[triangle * 3 + k];
+                    liveTriangles[vertex]--;
+                    if (vertexMeshlet[vertex] != id) {
+                        vertexMeshlet[vertex] = id;
+                        vertexSlot[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+                        mesh.vertices.push_back(rangeVertices[vertex]);
+
+                        for (uint32_t a { adjacencyOffsets[vertex] }; a < adjacencyOffsets[vertex + 1]; a++) {
+                            uint32_t neighbor = adjacency[a];
+                            if (used[neighbor]) {
+                                continue;
+                            }
+                            if (candidateMeshlet[neighbor] == id) {
+                                candidates[candidateSlot[neighbor]].added--;
+                                continue;
+                            }
+
+                            uint32_t added { 0 };
+                            for (uint32_t n { 0 }; n < 3; n++) {
+                                added += vertexMeshlet[localIndices[neighbor * 3 + n]] != id ? 1 : 0;
+                            }
+                            candidateMeshlet[neighbor] = id;
+                            candidateSlot[neighbor] = static_cast<uint32_t>(candidates.size());
+                            candidates.push_back({ neighbor, added, centroids[neighbor] });
+                        }
+                    }
+                    mesh.triangles.push_back(vertexSlot[vertex]);
+                }
+                meshlet.triangleCount++;
+            };
+
+            add(seed);
+
+            while (meshlet.triangleCount < MESHLET_MAX_TRIANGLES) {
+                glm::vec3 centroid = centroidSum / float(meshlet.triangleCount);
+                uint32_t best { NONE };
+                uint32_t bestPriority { NONE };
+                float bestDistance { std::numeric_limits<float>::max() };
+
+                // used candidates drop out, the ones that do not fit stay for seeding the next meshlet
+                uint32_t kept { 0 };
+                for (const Candidate& candidate : candidates) {
+                    if (used[candidate.triangle]) {
+                        continue;
+                    }
+                    candidateSlot[candidate.triangle] = kept;
+                    candidates[kept++] = candidate;
+
+                    if (meshlet.vertexCount + candidate.added > MESHLET_MAX_VERTICES) {
+                        continue;
+                    }
+
+                    // triangles adding no vertex come first, then those that are the last of one of their vertices,
+                    // then by how many vertices they add
+                    uint32_t priority { 0 };
+                    if (candidate.added > 0) {
+                        const uint32_t* triangle = &localIndices[candidate.triangle * 3];
+                        bool dangling = liveTriangles[triangle[0]] == 1 || liveTriangles[triangle[1]] == 1 || liveTriangles[triangle[2]] == 1;
+                        priority = dangling ? 1 : 1 + candidate.added;
+                    }
+                    if (priority > bestPriority) {
+                        continue;
+                    }
+
+                    glm::vec3 offset = candidate.centroid - centroid;
+                    float distance = glm::dot(offset, offset);
+                    if (priority < bestPriority || distance < bestDistance || (distance == bestDistance && candidate.triangle < best)) {
+                        best = candidate.triangle;
+                        bestPriority = priority;
+                        bestDistance = distance;
+                    }
+                }
+                candidates.resize(kept);
+
+                if (best == NONE) {
+                    break;
+                }
+                add(best);
+            }
+
+            // the most enclosed border triangle seeds the next meshlet, so the unused area shrinks from its corners
+            // instead of leaving pockets, then the closest one, the lowest unused one when the border is empty
+            glm::vec3 centroid = centroidSum / float(meshlet.triangleCount);
+            uint32_t seedLive { NONE };
+            float seedDistance { std::numeric_limits<float>::max() };
+            seed = NONE;
+            for (const Candidate& candidate : candidates) {
+                if (used[candidate.triangle]) {
+                    continue;
+                }
+                const uint32_t* triangle = &localIndices[candidate.triangle * 3];
+                uint32_t live = liveTriangles[triangle[0]] + liveTriangles[triangle[1]] + liveTriangles[triangle[2]];
+                if (live > seedLive) {
+                    continue;
+                }
+
+                glm::vec3 offset = candidate.centroid - centroid;
+                float distance = glm::dot(offset, offset);
+                if (live < seedLive || distance < seedDistance || (distance == seedDistance && candidate.triangle < seed)) {
+                    seed = candidate.triangle;
+                    seedLive = live;
+                    seedDistance = distance;
+                }
+            }
+
+            computeBounds(positions, mesh, meshlet);
+            mesh.meshlets.push_back(meshlet);
+        }
+    }
+
+}
+
+bool isMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& eye)
+{
+    glm::vec3 direction = meshlet.center - eye;
+    return glm::dot(direction, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(direction) + meshlet.radius;
+}
+
+MeshletMesh buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, JobSystem& jobs)
+{
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    uint32_t rangeCount = (triangleCount + RANGE_TRIANGLES - 1) / RANGE_TRIANGLES;
+
+    // exporters leave the triangles in any order, along a morton curve of their centroids every range is one region of the mesh
+    glm::vec3 min { std::numeric_limits<float>::max() };
+    glm::vec3 max { -std::numeric_limits<float>::max() };
+    for (uint32_t index : indices) {
+        min = glm::min(min, positions[index]);
+        max = glm::max(max, positions[index]);
+    }
+    glm::vec3 scale = 1023.0f / glm::max(max - min, glm::vec3 { std::numeric_limits<float>::min() });
+
+    std::vector<uint64_t> keys(triangleCount);
+    jobs.parallelFor(rangeCount, [&](uint32_t range) {
+        uint32_t end = std::min((range + 1) * RANGE_TRIANGLES, triangleCount);
+        for (uint32_t t { range * RANGE_TRIANGLES }; t < end; t++) {
+            glm::vec3 centroid = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3.0f;
+            keys[t] = uint64_t(mortonCode(centroid, min, scale)) << 32 | t;
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint32_t> sorted(indices.size());
+    std::vector<MeshletMesh> ranges(rangeCount);
+    jobs.parallelFor(rangeCount, [&](uint32_t range) {
+        uint32_t first = range * RANGE_TRIANGLES;
+        uint32_t count = std::min(RANGE_TRIANGLES, triangleCount - first);
+        for (uint32_t t { first }; t < first + count; t++) {
+            uint32_t source = static_cast<uint32_t>(keys[t]);
+            std::copy_n(&indices[size_t(source) * 3], 3, &sorted[size_t(t) * 3]);
+        }
+        buildRange(positions, &sorted[size_t(first) * 3], count, ranges[range]);
+    });
+
+    MeshletMesh mesh;
+    for (const MeshletMesh& range : ranges) {
+        uint32_t vertexBase = static_cast<uint32_t>(mesh.vertices.size());
+        uint32_t triangleBase = static_cast<uint32_t>(mesh.triangleCount());
+
+        for (Meshlet meshlet : range.meshlets) {
+            meshlet.vertexOffset += vertexBase;
+            meshlet.triangleOffset += triangleBase;
+            mesh.meshlets.push_back(meshlet);
+        }
+        mesh.vertices.insert(mesh.vertices.end(), range.vertices.begin(), range.vertices.end());
+        mesh.triangles.insert(mesh.triangles.end(), range.triangles.begin(), range.triangles.end());
+    }
+
+    return mesh;
+}
+
+}
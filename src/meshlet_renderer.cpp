@@ -0,0 +1,380 @@
+#include "meshlet_renderer.hpp"
+#include "device.hpp"
+#include "frustum_cull.hpp"
+#include "pipeline.hpp"
+#include "render_structs.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr uint32_t GROUP_SIZE { 64 };
+
+    // meshlets per task workgroup, and workgroups per draw within the least maxTaskWorkGroupCount
+    constexpr uint32_t TASK_GROUP_SIZE { 32 };
+    constexpr uint32_t MAX_TASK_GROUPS { 65535 };
+
+    // drawn meshlets and their triangles, added up by the cull
+    constexpr size_t COUNTER_BYTES { 2 * sizeof(uint32_t) };
+
+    vkUtil::Buffer createBuffer(vk::Device device, vk::PhysicalDevice physicalDevice, size_t size, vk::BufferUsageFlags usage,
+        vk::MemoryPropertyFlags memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+    {
+        vkUtil::BufferInput input;
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.size = size;
+        input.usage = usage;
+        input.memoryProperties = memoryProperties;
+        return vkUtil::createBuffer(input);
+    }
+
+    void destroyBuffer(vk::Device device, vkUtil::Buffer& buffer)
+    {
+        if (buffer.buffer) {
+            device.destroyBuffer(buffer.buffer);
+            device.freeMemory(buffer.bufferMemory);
+        }
+        buffer = {};
+    }
+
+    template <typename T>
+    vkUtil::Buffer createFilledBuffer(vk::Device device, vk::PhysicalDevice physicalDevice, const std::vector<T>& data, vk::BufferUsageFlags usage)
+    {
+        size_t size = data.size() * sizeof(T);
+        vkUtil::Buffer buffer = createBuffer(device, physicalDevice, size, usage);
+
+        void* mapped = device.mapMemory(buffer.bufferMemory, 0, size);
+        std::memcpy(mapped, data.data(), size);
+        device.unmapMemory(buffer.bufferMemory);
+        return buffer;
+    }
+
+    // octahedral mapping onto the z = 1 - |x| - |y| diamond, the lower half folded over its edges
+    uint32_t packNormal(glm::vec3 normal)
+    {
+        float length = glm::length(normal);
+        if (length == 0.0f) {
+            return glm::packSnorm2x16(glm::vec2 { 0.0f });
+        }
+
+        normal /= std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        glm::vec2 p { normal.x, normal.y };
+        if (normal.z < 0.0f) {
+            p = (1.0f - glm::abs(glm::vec2 { normal.y, normal.x })) * glm::vec2 { normal.x < 0.0f ? -1.0f : 1.0f, normal.y < 0.0f ? -1.0f : 1.0f };
+        }
+        return glm::packSnorm2x16(p);
+    }
+
+}
+
+MeshletRenderer::MeshletRenderer(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t framesInFlight, bool meshShading)
+    : device { device }
+    , physicalDevice { physicalDevice }
+{
+    // the instance index of every meshlet draw selects its world matrix
+    vk::PhysicalDeviceFeatures features = physicalDevice.getFeatures();
+    if (!features.drawIndirectFirstInstance) {
+        throw std::runtime_error { "Meshlet drawing needs indirect draws with a first instance" };
+    }
+
+    // several draws per call where the device takes them, one call per meshlet otherwise
+    drawsPerCall = features.multiDrawIndirect ? std::max(physicalDevice.getProperties().limits.maxDrawIndirectCount, 1u) : 1;
+
+    vk::ShaderStageFlags geometryStages = vk::ShaderStageFlagBits::eVertex;
+    if (meshShading) {
+        geometryStages |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+        taskLayout = vkInit::createStorageBufferSetLayout(device, 4, vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT);
+        drawMeshTasksCommand = vkInit::loadDrawMeshTasks(device);
+    }
+
+    geometryLayout = vkInit::createStorageBufferSetLayout(device, 2, geometryStages);
+    cullLayout = vkInit::createStorageBufferSetLayout(device, 4, vk::ShaderStageFlagBits::eCompute);
+
+    uint32_t setsPerFrame = meshShading ? 2 : 1;
+    vk::DescriptorPoolSize poolSize { vk::DescriptorType::eStorageBuffer, 2 + 4 * setsPerFrame * framesInFlight };
+    vk::DescriptorPoolCreateInfo poolInfo {};
+    poolInfo.flags = vk::DescriptorPoolCreateFlags();
+    poolInfo.maxSets = 1 + setsPerFrame * framesInFlight;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    descriptorPool = device.createDescriptorPool(poolInfo);
+
+    // the cull sets, the task sets where there are any, then the geometry
+    std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, cullLayout);
+    if (meshShading) {
+        layouts.resize(2 * framesInFlight, taskLayout);
+    }
+    layouts.push_back(geometryLayout);
+
+    vk::DescriptorSetAllocateInfo allocInfo {};
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+    allocInfo.pSetLayouts = layouts.data();
+    std::vector<vk::DescriptorSet> sets = device.allocateDescriptorSets(allocInfo);
+
+    frames.resize(framesInFlight);
+    for (uint32_t i { 0 }; i < framesInFlight; i++) {
+        frames[i] = {};
+        frames[i].cullSet = sets[i];
+        if (meshShading) {
+            frames[i].taskSet = sets[framesInFlight + i];
+        }
+    }
+    geometrySet = sets.back();
+
+    vkInit::ComputePipelineInBundle specification {};
+    specification.device = device;
+    specification.compFilePath = "../../shaders/bin/meshlet_cull.comp.spv";
+    specification.descriptorSetLayout = cullLayout;
+    specification.pushConstantSize = sizeof(vkUtil::MeshletCullData);
+
+    vkInit::ComputePipelineOutBundle output = vkInit::createComputePipeline(specification);
+    cullPipelineLayout = output.layout;
+    cullPipeline = output.pipeline;
+}
+
+MeshletRenderer::~MeshletRenderer()
+{
+    destroyBuffers();
+
+    device.destroyPipeline(cullPipeline);
+    device.destroyPipelineLayout(cullPipelineLayout);
+    device.destroyDescriptorPool(descriptorPool);
+    device.destroyDescriptorSetLayout(cullLayout);
+    device.destroyDescriptorSetLayout(geometryLayout);
+    if (taskLayout) {
+        device.destroyDescriptorSetLayout(taskLayout);
+    }
+}
+
+void MeshletRenderer::destroyBuffers()
+{
+    destroyBuffer(device, vertexBuffer);
+    destroyBuffer(device, indexBuffer);
+    destroyBuffer(device, meshletBuffer);
+    destroyBuffer(device, transformBuffer);
+    destroyBuffer(device, meshletVertexBuffer);
+    destroyBuffer(device, meshletTriangleBuffer);
+
+    for (Frame& frame : frames) {
+        destroyBuffer(device, frame.draws);
+        destroyBuffer(device, frame.counters);
+        frame.recorded = false;
+    }
+}
+
+void MeshletRenderer::createBuffers()
+{
+    vk::BufferUsageFlags storage = vk::BufferUsageFlagBits::eStorageBuffer;
+    vertexBuffer = createFilledBuffer(device, physicalDevice, vertices, storage);
+    indexBuffer = createFilledBuffer(device, physicalDevice, indices, vk::BufferUsageFlagBits::eIndexBuffer);
+    meshletBuffer = createFilledBuffer(device, physicalDevice, meshlets, storage);
+    transformBuffer = createFilledBuffer(device, physicalDevice, transforms, storage);
+
+    vk::DescriptorBufferInfo vertexInfo { vertexBuffer.buffer, 0, VK_WHOLE_SIZE };
+    vk::DescriptorBufferInfo meshletInfo { meshletBuffer.buffer, 0, VK_WHOLE_SIZE };
+    vk::DescriptorBufferInfo transformInfo { transformBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+    std::vector<vk::WriteDescriptorSet> writes {
+        { geometrySet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &vertexInfo },
+        { geometrySet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &transformInfo },
+    };
+
+    // the draws are only written and read by the gpu, the counters are read back
+    std::vector<std::array<vk::DescriptorBufferInfo, 2>> frameInfos(frames.size());
+    for (size_t i { 0 }; i < frames.size(); i++) {
+        Frame& frame = frames[i];
+        frame.draws = createBuffer(device, physicalDevice, meshlets.size() * sizeof(vk::DrawIndexedIndirectCommand),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        frame.counters = createBuffer(device, physicalDevice, COUNTER_BYTES, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+
+        frameInfos[i][0] = { frame.draws.buffer, 0, VK_WHOLE_SIZE };
+        frameInfos[i][1] = { frame.counters.buffer, 0, VK_WHOLE_SIZE };
+
+        writes.push_back({ frame.cullSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshletInfo });
+        writes.push_back({ frame.cullSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &transformInfo });
+        writes.push_back({ frame.cullSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &frameInfos[i][0] });
+        writes.push_back({ frame.cullSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &frameInfos[i][1] });
+    }
+
+    // the mesh shaders read the meshlets' own vertex lists and local triangles, the task shader adds to the same counters
+    vk::DescriptorBufferInfo meshletVertexInfo {};
+    vk::DescriptorBufferInfo meshletTriangleInfo {};
+    if (taskLayout) {
+        meshletVertexBuffer = createFilledBuffer(device, physicalDevice, meshletVertices, storage);
+        meshletTriangleBuffer = createFilledBuffer(device, physicalDevice, meshletTriangles, storage);
+        meshletVertexInfo = { meshletVertexBuffer.buffer, 0, VK_WHOLE_SIZE };
+        meshletTriangleInfo = { meshletTriangleBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+        for (size_t i { 0 }; i < frames.size(); i++) {
+            vk::DescriptorSet taskSet = frames[i].taskSet;
+            writes.push_back({ taskSet, 0, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshletInfo });
+            writes.push_back({ taskSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshletVertexInfo });
+            writes.push_back({ taskSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &meshletTriangleInfo });
+            writes.push_back({ taskSet, 3, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &frameInfos[i][1] });
+        }
+    }
+
+    device.updateDescriptorSets(writes, nullptr);
+}
+
+void MeshletRenderer::addMesh(const std::vector<glm::vec3>& positions, const MeshletMesh& mesh, const glm::mat4& transform)
+{
+    if (mesh.meshlets.empty()) {
+        return;
+    }
+
+    // area weighted, the cross products are twice the triangle areas
+    std::vector<glm::vec3> normals(positions.size(), glm::vec3 { 0.0f });
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        for (uint32_t t { 0 }; t < meshlet.triangleCount; t++) {
+            const uint8_t* triangle = &mesh.triangles[size_t(meshlet.triangleOffset + t) * 3];
+            uint32_t a = mesh.vertices[meshlet.vertexOffset + triangle[0]];
+            uint32_t b = mesh.vertices[meshlet.vertexOffset + triangle[1]];
+            uint32_t c = mesh.vertices[meshlet.vertexOffset + triangle[2]];
+
+            glm::vec3 normal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+            normals[a] += normal;
+            normals[b] += normal;
+            normals[c] += normal;
+        }
+    }
+
+    uint32_t vertexBase = static_cast<uint32_t>(vertices.size());
+    for (size_t i { 0 }; i < positions.size(); i++) {
+        vertices.push_back({ positions[i], packNormal(normals[i]) });
+    }
+
+    uint32_t instance = static_cast<uint32_t>(transforms.size());
+    transforms.push_back(transform);
+
+    for (const Meshlet& meshlet : mesh.meshlets) {
+        GpuMeshlet gpuMeshlet {};
+        gpuMeshlet.sphere = glm::vec4 { meshlet.center, meshlet.radius };
+        gpuMeshlet.cone = glm::vec4 { meshlet.coneAxis, meshlet.coneCutoff };
+        gpuMeshlet.firstIndex = static_cast<uint32_t>(indices.size());
+        gpuMeshlet.indexCount = meshlet.triangleCount * 3;
+        gpuMeshlet.instance = instance;
+        gpuMeshlet.firstVertex = static_cast<uint32_t>(meshletVertices.size());
+        gpuMeshlet.vertexCount = meshlet.vertexCount;
+        meshlets.push_back(gpuMeshlet);
+
+        for (uint32_t i { 0 }; i < meshlet.triangleCount * 3; i++) {
+            indices.push_back(vertexBase + mesh.vertices[meshlet.vertexOffset + mesh.triangles[size_t(meshlet.triangleOffset) * 3 + i]]);
+        }
+
+        if (taskLayout) {
+            for (uint32_t i { 0 }; i < meshlet.vertexCount; i++) {
+                meshletVertices.push_back(vertexBase + mesh.vertices[meshlet.vertexOffset + i]);
+            }
+            for (uint32_t t { 0 }; t < meshlet.triangleCount; t++) {
+                const uint8_t* triangle = &mesh.triangles[size_t(meshlet.triangleOffset + t) * 3];
+                meshletTriangles.push_back(uint32_t(triangle[0]) | uint32_t(triangle[1]) << 8 | uint32_t(triangle[2]) << 16);
+            }
+        }
+    }
+
+    meshletCount = static_cast<uint32_t>(meshlets.size());
+    stats.meshlets = meshletCount;
+    stats.triangles = indices.size() / 3;
+
+    // frames in flight still draw from the old buffers, meshes are added rarely enough to simply wait for them
+    device.waitIdle();
+    destroyBuffers();
+    createBuffers();
+}
+
+void MeshletRenderer::record(vk::CommandBuffer commandBuffer, uint32_t frameIndex, const glm::mat4& viewProjection, const glm::vec3& eye, bool meshShading)
+{
+    if (meshletCount == 0) {
+        return;
+    }
+
+    Frame& frame = frames[frameIndex];
+
+    // the fence of the frame's last cull was waited on, its counts are final
+    if (frame.recorded) {
+        uint32_t counters[2];
+        void* mapped = device.mapMemory(frame.counters.bufferMemory, 0, COUNTER_BYTES);
+        std::memcpy(counters, mapped, COUNTER_BYTES);
+        device.unmapMemory(frame.counters.bufferMemory);
+
+        stats.drawnMeshlets = counters[0];
+        stats.drawnTriangles = counters[1];
+    }
+
+    commandBuffer.fillBuffer(frame.counters.buffer, 0, COUNTER_BYTES, 0);
+    frame.recorded = true;
+
+    vk::MemoryBarrier cleared { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite };
+    if (meshShading && taskLayout) {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTaskShaderEXT,
+            vk::DependencyFlags(), cleared, nullptr, nullptr);
+        return;
+    }
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(), cleared, nullptr, nullptr);
+
+    vkUtil::MeshletCullData data {};
+    Frustum frustum = Frustum::fromMatrix(viewProjection);
+    std::copy(frustum.planes.begin(), frustum.planes.end(), data.planes);
+    data.eye = glm::vec4 { eye, 0.0f };
+    data.counts = glm::uvec4 { meshletCount, 0, 0, 0 };
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullPipelineLayout, 0, frame.cullSet, nullptr);
+    commandBuffer.pushConstants(cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(data), &data);
+    commandBuffer.dispatch((meshletCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    vk::MemoryBarrier culled { vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eHostRead };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eHost,
+        vk::DependencyFlags(), culled, nullptr, nullptr);
+}
+
+void MeshletRenderer::draw(vk::CommandBuffer commandBuffer, uint32_t frameIndex, vk::PipelineLayout layout)
+{
+    if (meshletCount == 0) {
+        return;
+    }
+
+    const Frame& frame = frames[frameIndex];
+    constexpr uint32_t stride { sizeof(vk::DrawIndexedIndirectCommand) };
+
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, geometrySet, nullptr);
+    commandBuffer.bindIndexBuffer(indexBuffer.buffer, 0, vk::IndexType::eUint32);
+
+    for (uint32_t first { 0 }; first < meshletCount; first += drawsPerCall) {
+        commandBuffer.drawIndexedIndirect(frame.draws.buffer, vk::DeviceSize(first) * stride, std::min(drawsPerCall, meshletCount - first), stride);
+    }
+}
+
+void MeshletRenderer::drawMeshTasks(vk::CommandBuffer commandBuffer, uint32_t frameIndex, vk::PipelineLayout layout, const glm::mat4& viewProjection, const glm::vec3& eye)
+{
+    if (meshletCount == 0 || !taskLayout) {
+        return;
+    }
+
+    std::array<vk::DescriptorSet, 2> sets { geometrySet, frames[frameIndex].taskSet };
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, sets, nullptr);
+
+    vkUtil::MeshletTaskData data {};
+    data.viewProjection = viewProjection;
+    data.eye = glm::vec4 { eye, 0.0f };
+
+    vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+    for (uint32_t first { 0 }; first < meshletCount; first += MAX_TASK_GROUPS * TASK_GROUP_SIZE) {
+        uint32_t groups = std::min((meshletCount - first + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, MAX_TASK_GROUPS);
+
+        data.counts = glm::uvec4 { meshletCount, first, 0, 0 };
+        commandBuffer.pushConstants(layout, stages, 0, sizeof(data), &data);
+        drawMeshTasksCommand(static_cast<VkCommandBuffer>(commandBuffer), groups, 1, 1);
+    }
+}
+
+}
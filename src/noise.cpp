@@ -0,0 +1,157 @@
+#include "noise_kernel.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#if VOKEL_X86 && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace VoKel {
+
+namespace {
+
+    struct ScalarOps {
+        using F = float;
+        using I = uint32_t;
+        static constexpr size_t WIDTH { 1 };
+
+        static F load(const float* p) { return *p; }
+        static void store(float* p, F v) { *p = v; }
+        static F set(float v) { return v; }
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+        static F floor(F a) { return std::floor(a); }
+        static I toInt(F a) { return static_cast<uint32_t>(static_cast<int32_t>(a)); }
+
+        static I seti(uint32_t v) { return v; }
+        static I addi(I a, I b) { return a + b; }
+        static I muli(I a, I b) { return a * b; }
+        static I xori(I a, I b) { return a ^ b; }
+        static I andi(I a, I b) { return a & b; }
+        static I ori(I a, I b) { return a | b; }
+        static I srli(I a, int s) { return a >> s; }
+        static I slli(I a, int s) { return a << s; }
+        static I less(I a, I b) { return static_cast<int32_t>(a) < static_cast<int32_t>(b) ? ~0u : 0u; }
+        static I equal(I a, I b) { return a == b ? ~0u : 0u; }
+
+        static F select(I mask, F a, F b) { return mask ? a : b; }
+
+        static F flipSign(F a, I sign)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &a, sizeof(bits));
+            bits ^= sign;
+            std::memcpy(&a, &bits, sizeof(bits));
+            return a;
+        }
+    };
+
+    SimdLevel detectSimdLevel()
+    {
+#if VOKEL_X86 && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        bool sse41 = (info[2] & (1 << 19)) != 0;
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) {
+                return SimdLevel::AVX2;
+            }
+        }
+
+        return sse41 ? SimdLevel::SSE4 : SimdLevel::Scalar;
+#elif VOKEL_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::AVX2;
+        }
+
+        if (__builtin_cpu_supports("sse4.1")) {
+            return SimdLevel::SSE4;
+        }
+
+        return SimdLevel::Scalar;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+}
+
+SimdLevel getSimdLevel()
+{
+    static const SimdLevel level = [] {
+        SimdLevel detected = detectSimdLevel();
+
+        const char* requested = std::getenv("VOKEL_SIMD");
+        if (requested == nullptr) {
+            return detected;
+        }
+
+        std::string_view name { requested };
+        SimdLevel cap = name == "scalar" ? SimdLevel::Scalar : (name == "sse4" ? SimdLevel::SSE4 : SimdLevel::AVX2);
+        return cap < detected ? cap : detected;
+    }();
+
+    return level;
+}
+
+const char* getSimdLevelName(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::SSE4:
+        return "SSE4";
+    default:
+        return "scalar";
+    }
+}
+
+void fbm2D(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed, SimdLevel level)
+{
+#if VOKEL_X86
+    if (level == SimdLevel::AVX2) {
+        noise::fbm2DAvx2(x, y, out, count, settings, seed);
+        return;
+    }
+
+    if (level == SimdLevel::SSE4) {
+        noise::fbm2DSse4(x, y, out, count, settings, seed);
+        return;
+    }
+#endif
+
+    noise::runFbm2D<ScalarOps>(x, y, out, count, settings, seed);
+}
+
+void fbm3D(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed, SimdLevel level)
+{
+#if VOKEL_X86
+    if (level == SimdLevel::AVX2) {
+        noise::fbm3DAvx2(x, y, z, out, count, settings, seed);
+        return;
+    }
+
+    if (level == SimdLevel::SSE4) {
+        noise::fbm3DSse4(x, y, z, out, count, settings, seed);
+        return;
+    }
+#endif
+
+    noise::runFbm3D<ScalarOps>(x, y, z, out, count, settings, seed);
+}
+
+}
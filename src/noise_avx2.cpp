@@ -0,0 +1,59 @@
+// built with -mavx2, only reached when the cpu reports AVX2 (see CMakeLists.txt)
+#include "noise_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <immintrin.h>
+
+namespace VoKel {
+
+namespace noise {
+
+    namespace {
+
+        struct Avx2Ops {
+            using F = __m256;
+            using I = __m256i;
+            static constexpr size_t WIDTH { 8 };
+
+            static F load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+            static F set(float v) { return _mm256_set1_ps(v); }
+            static F add(F a, F b) { return _mm256_add_ps(a, b); }
+            static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+            static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+            static F floor(F a) { return _mm256_floor_ps(a); }
+            static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+
+            static I seti(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+            static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+            static I muli(I a, I b) { return _mm256_mullo_epi32(a, b); }
+            static I xori(I a, I b) { return _mm256_xor_si256(a, b); }
+            static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+            static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+            static I srli(I a, int s) { return _mm256_srli_epi32(a, s); }
+            static I slli(I a, int s) { return _mm256_slli_epi32(a, s); }
+            static I less(I a, I b) { return _mm256_cmpgt_epi32(b, a); }
+            static I equal(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+
+            static F select(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+            static F flipSign(F a, I sign) { return _mm256_xor_ps(a, _mm256_castsi256_ps(sign)); }
+        };
+
+    }
+
+    void fbm2DAvx2(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed)
+    {
+        runFbm2D<Avx2Ops>(x, y, out, count, settings, seed);
+    }
+
+    void fbm3DAvx2(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed)
+    {
+        runFbm3D<Avx2Ops>(x, y, z, out, count, settings, seed);
+    }
+
+}
+
+}
+
+#endif
@@ -0,0 +1,59 @@
+// built with -msse4.1, only reached when the cpu reports SSE4.1 (see CMakeLists.txt)
+#include "noise_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <smmintrin.h>
+
+namespace VoKel {
+
+namespace noise {
+
+    namespace {
+
+        struct Sse4Ops {
+            using F = __m128;
+            using I = __m128i;
+            static constexpr size_t WIDTH { 4 };
+
+            static F load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+            static F set(float v) { return _mm_set1_ps(v); }
+            static F add(F a, F b) { return _mm_add_ps(a, b); }
+            static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+            static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+            static F floor(F a) { return _mm_floor_ps(a); }
+            static I toInt(F a) { return _mm_cvttps_epi32(a); }
+
+            static I seti(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+            static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+            static I muli(I a, I b) { return _mm_mullo_epi32(a, b); }
+            static I xori(I a, I b) { return _mm_xor_si128(a, b); }
+            static I andi(I a, I b) { return _mm_and_si128(a, b); }
+            static I ori(I a, I b) { return _mm_or_si128(a, b); }
+            static I srli(I a, int s) { return _mm_srli_epi32(a, s); }
+            static I slli(I a, int s) { return _mm_slli_epi32(a, s); }
+            static I less(I a, I b) { return _mm_cmplt_epi32(a, b); }
+            static I equal(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+
+            static F select(I mask, F a, F b) { return _mm_blendv_ps(b, a, _mm_castsi128_ps(mask)); }
+            static F flipSign(F a, I sign) { return _mm_xor_ps(a, _mm_castsi128_ps(sign)); }
+        };
+
+    }
+
+    void fbm2DSse4(const float* x, const float* y, float* out, size_t count, const FbmSettings& settings, uint32_t seed)
+    {
+        runFbm2D<Sse4Ops>(x, y, out, count, settings, seed);
+    }
+
+    void fbm3DSse4(const float* x, const float* y, const float* z, float* out, size_t count, const FbmSettings& settings, uint32_t seed)
+    {
+        runFbm3D<Sse4Ops>(x, y, z, out, count, settings, seed);
+    }
+
+}
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include "obj_file.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <string>
+
+namespace VoKel {
+
+namespace {
+
+    std::runtime_error malformed(size_t line, const std::string& reason)
+    {
+        return std::runtime_error { "Malformed .obj file, line " + std::to_string(line) + ": " + reason };
+    }
+
+    void skipSpaces(const char*& cursor, const char* end)
+    {
+        while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+            cursor++;
+        }
+    }
+
+    float readFloat(const char*& cursor, const char* end, size_t line)
+    {
+        skipSpaces(cursor, end);
+        float value { 0.0f };
+        auto [next, error] = std::from_chars(cursor, end, value);
+        if (error != std::errc {}) {
+            throw malformed(line, "expected a number");
+        }
+        cursor = next;
+        return value;
+    }
+
+    // the position of a v/vt/vn reference, made absolute
+    uint32_t readIndex(const char*& cursor, const char* end, size_t vertexCount, size_t line)
+    {
+        int64_t value { 0 };
+        auto [next, error] = std::from_chars(cursor, end, value);
+        if (error != std::errc {}) {
+            throw malformed(line, "expected a vertex index");
+        }
+        cursor = next;
+
+        while (cursor < end && *cursor != ' ' && *cursor != '\t') {
+            cursor++;
+        }
+
+        int64_t index = value < 0 ? int64_t(vertexCount) + value : value - 1;
+        if (value == 0 || index < 0 || index >= int64_t(vertexCount)) {
+            throw malformed(line, "vertex " + std::to_string(value) + " does not exist");
+        }
+        return static_cast<uint32_t>(index);
+    }
+
+}
+
+ObjMesh loadObj(const std::filesystem::path& path)
+{
+    std::ifstream file { path };
+    if (!file) {
+        throw std::runtime_error { "Cannot open " + path.string() };
+    }
+
+    ObjMesh mesh;
+    std::vector<uint32_t> polygon;
+    std::string text;
+    size_t line { 0 };
+
+    while (std::getline(file, text)) {
+        line++;
+        const char* cursor = text.data();
+        const char* end = text.data() + text.size();
+        if (end > cursor && end[-1] == '\r') {
+            end--;
+        }
+        skipSpaces(cursor, end);
+
+        if (end - cursor < 2 || (cursor[1] != ' ' && cursor[1] != '\t')) {
+            continue;
+        }
+
+        if (cursor[0] == 'v') {
+            cursor++;
+            glm::vec3 position;
+            position.x = readFloat(cursor, end, line);
+            position.y = readFloat(cursor, end, line);
+            position.z = readFloat(cursor, end, line);
+            mesh.positions.push_back(position);
+        } else if (cursor[0] == 'f') {
+            cursor++;
+            polygon.clear();
+            for (skipSpaces(cursor, end); cursor < end; skipSpaces(cursor, end)) {
+                polygon.push_back(readIndex(cursor, end, mesh.positions.size(), line));
+            }
+            if (polygon.size() < 3) {
+                throw malformed(line, "face with fewer than three vertices");
+            }
+
+            for (size_t i { 2 }; i < polygon.size(); i++) {
+                mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+            }
+        }
+    }
+
+    return mesh;
+}
+
+}
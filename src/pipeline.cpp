@@ -1,5 +1,4 @@
 #include "pipeline.hpp"
-#include "mesh.hpp"
 #include "render_structs.hpp"
 #include "shaders.hpp"
 #include <array>
@@ -12,40 +11,54 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
     pipelineInfo.flags = vk::PipelineCreateFlags();
 
     std::vector<vk::PipelineShaderStageCreateInfo> shadersStages;
+    std::vector<vk::ShaderModule> shaderModules;
+    bool meshShading = !specification.meshFilePath.empty();
 
-    // vertex input
-    vk::VertexInputBindingDescription bindingDescription = vkMesh::getPosColorBindingDescription();
-    std::array<vk::VertexInputAttributeDescription, 2> attributeDescription = vkMesh::getPosColorAttributeDescriptions();
+    // vertex input, pulling pipelines leave it empty and mesh shading pipelines have none
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo {};
     vertexInputInfo.flags = vk::PipelineVertexInputStateCreateFlags();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = 2;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(specification.bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = specification.bindingDescriptions.data();
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(specification.attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = specification.attributeDescriptions.data();
 
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pVertexInputState = meshShading ? nullptr : &vertexInputInfo;
 
     // input assembly
     vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo {};
     inputAssemblyInfo.flags = vk::PipelineInputAssemblyStateCreateFlags();
     inputAssemblyInfo.topology = vk::PrimitiveTopology::eTriangleList;
 
-    pipelineInfo.pInputAssemblyState = &inputAssemblyInfo;
-
-    // vertex shader
-    if (DEBUG_MODE) {
-        std::cout << "Create vertex shader module\n";
+    pipelineInfo.pInputAssemblyState = meshShading ? nullptr : &inputAssemblyInfo;
+
+    // vertex shader, or the task and mesh shaders
+    std::vector<std::pair<vk::ShaderStageFlagBits, std::string>> geometryStages;
+    if (meshShading) {
+        if (!specification.taskFilePath.empty()) {
+            geometryStages.push_back({ vk::ShaderStageFlagBits::eTaskEXT, specification.taskFilePath });
+        }
+        geometryStages.push_back({ vk::ShaderStageFlagBits::eMeshEXT, specification.meshFilePath });
+    } else {
+        geometryStages.push_back({ vk::ShaderStageFlagBits::eVertex, specification.vertFilePath });
     }
 
-    vk::ShaderModule vertexShader = vkUtil::createShaderModule(specification.vertFilePath, specification.device);
+    vk::ShaderStageFlags pushConstantStages {};
+    for (const auto& [stage, filePath] : geometryStages) {
+        if (DEBUG_MODE) {
+            std::cout << "Create " << vk::to_string(stage) << " shader module\n";
+        }
+
+        shaderModules.push_back(vkUtil::createShaderModule(filePath, specification.device));
 
-    vk::PipelineShaderStageCreateInfo vertexShaderInfo {};
-    vertexShaderInfo = vk::PipelineShaderStageCreateFlags();
-    vertexShaderInfo.stage = vk::ShaderStageFlagBits::eVertex;
-    vertexShaderInfo.module = vertexShader;
-    vertexShaderInfo.pName = "main";
+        vk::PipelineShaderStageCreateInfo shaderInfo {};
+        shaderInfo.flags = vk::PipelineShaderStageCreateFlags();
+        shaderInfo.stage = stage;
+        shaderInfo.module = shaderModules.back();
+        shaderInfo.pName = "main";
 
-    shadersStages.push_back(vertexShaderInfo);
+        shadersStages.push_back(shaderInfo);
+        pushConstantStages |= stage;
+    }
 
     // viewport and scissor
     vk::Viewport viewport {
@@ -79,7 +92,7 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
     rasterizer.polygonMode = vk::PolygonMode::eFill;
     rasterizer.lineWidth = 1.0f;
     rasterizer.cullMode = vk::CullModeFlagBits::eBack;
-    rasterizer.frontFace = vk::FrontFace::eClockwise;
+    rasterizer.frontFace = specification.frontFace;
     rasterizer.depthBiasEnable = VK_FALSE;
 
     pipelineInfo.pRasterizationState = &rasterizer;
@@ -90,6 +103,7 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
     }
 
     vk::ShaderModule fragmentShader = vkUtil::createShaderModule(specification.fragFilePath, specification.device);
+    shaderModules.push_back(fragmentShader);
 
     vk::PipelineShaderStageCreateInfo fragmentShaderInfo {};
     fragmentShaderInfo.flags = vk::PipelineShaderStageCreateFlags();
@@ -110,6 +124,17 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
 
     pipelineInfo.pMultisampleState = &multisampling;
 
+    // depth test
+    vk::PipelineDepthStencilStateCreateInfo depthState {};
+    depthState.flags = vk::PipelineDepthStencilStateCreateFlags();
+    depthState.depthTestEnable = specification.depthTest;
+    depthState.depthWriteEnable = specification.depthTest;
+    depthState.depthCompareOp = vk::CompareOp::eLess;
+    depthState.depthBoundsTestEnable = VK_FALSE;
+    depthState.stencilTestEnable = VK_FALSE;
+
+    pipelineInfo.pDepthStencilState = &depthState;
+
     // color blend
     vk::PipelineColorBlendAttachmentState colorBlendAttachment {};
     colorBlendAttachment.colorWriteMask = vk::ColorComponentFlagBits::eR;
@@ -136,7 +161,7 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
         std::cout << "Creating pipeline layout\n";
     }
 
-    vk::PipelineLayout layout = createPipelineLayout(specification.device);
+    vk::PipelineLayout layout = createPipelineLayout(specification.device, specification.pushConstantSize, specification.descriptorSetLayouts, pushConstantStages);
     pipelineInfo.layout = layout;
 
     // renderpass
@@ -144,7 +169,10 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
         std::cout << "Creating render pass\n";
     }
 
-    vk::RenderPass renderpass = createRenderPass(specification.device, specification.format);
+    vk::RenderPass renderpass = specification.renderpass;
+    if (!renderpass) {
+        renderpass = createRenderPass(specification.device, specification.format, specification.depthFormat);
+    }
     pipelineInfo.renderPass = renderpass;
 
     std::vector<vk::DynamicState> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
@@ -177,23 +205,77 @@ GraphicsPipelineOutBundle createGraphicsPipeline(const GraphicsPipelineInBundle&
     output.renderpass = renderpass;
     output.pipeline = graphicsPipeline;
 
-    specification.device.destroyShaderModule(vertexShader);
-    specification.device.destroyShaderModule(fragmentShader);
+    for (vk::ShaderModule shaderModule : shaderModules) {
+        specification.device.destroyShaderModule(shaderModule);
+    }
 
     return output;
 }
 
-vk::PipelineLayout createPipelineLayout(const vk::Device& device)
+ComputePipelineOutBundle createComputePipeline(const ComputePipelineInBundle& specification)
 {
+    if (DEBUG_MODE) {
+        std::cout << "Create compute shader module\n";
+    }
+
+    vk::ShaderModule computeShader = vkUtil::createShaderModule(specification.compFilePath, specification.device);
+
+    vk::PushConstantRange pushConstantInfo;
+    pushConstantInfo.offset = 0;
+    pushConstantInfo.size = specification.pushConstantSize;
+    pushConstantInfo.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
     vk::PipelineLayoutCreateInfo layoutInfo;
     layoutInfo.flags = vk::PipelineLayoutCreateFlags();
-    layoutInfo.setLayoutCount = 0;
-
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &specification.descriptorSetLayout;
     layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantInfo;
+
+    ComputePipelineOutBundle output {};
+
+    try {
+        output.layout = specification.device.createPipelineLayout(layoutInfo);
+    } catch (const vk::SystemError& err) {
+        std::cout << "Failed to create a pipeline layout: " << err.what() << "\n";
+    }
+
+    vk::ComputePipelineCreateInfo pipelineInfo {};
+    pipelineInfo.flags = vk::PipelineCreateFlags();
+    pipelineInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipelineInfo.stage.module = computeShader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = output.layout;
+
+    if (DEBUG_MODE) {
+        std::cout << "Creating Compute Pipeline\n";
+    }
+
+    try {
+        output.pipeline = (specification.device.createComputePipeline(nullptr, pipelineInfo)).value;
+    } catch (const vk::SystemError& err) {
+        std::cout << "Failed to create a Compute Pipeline: " << err.what() << '\n';
+    }
+
+    specification.device.destroyShaderModule(computeShader);
+
+    return output;
+}
+
+vk::PipelineLayout createPipelineLayout(const vk::Device& device, uint32_t pushConstantSize, const std::vector<vk::DescriptorSetLayout>& descriptorSetLayouts,
+    vk::ShaderStageFlags pushConstantStages)
+{
+    vk::PipelineLayoutCreateInfo layoutInfo;
+    layoutInfo.flags = vk::PipelineLayoutCreateFlags();
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    layoutInfo.pSetLayouts = descriptorSetLayouts.data();
+
+    // pipelines without push constants pass a size of 0
+    layoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
     vk::PushConstantRange pushConstantInfo;
     pushConstantInfo.offset = 0;
-    pushConstantInfo.size = sizeof(vkUtil::ObjectData);
-    pushConstantInfo.stageFlags = vk::ShaderStageFlagBits::eVertex;
+    pushConstantInfo.size = pushConstantSize;
+    pushConstantInfo.stageFlags = pushConstantStages;
     layoutInfo.pPushConstantRanges = &pushConstantInfo;
 
     try {
@@ -205,7 +287,21 @@ vk::PipelineLayout createPipelineLayout(const vk::Device& device)
     return nullptr;
 }
 
-vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swapchainImageFormat)
+vk::DescriptorSetLayout createStorageBufferSetLayout(const vk::Device& device, uint32_t bindingCount, vk::ShaderStageFlags stages)
+{
+    std::vector<vk::DescriptorSetLayoutBinding> bindings(bindingCount);
+    for (uint32_t binding { 0 }; binding < bindingCount; binding++) {
+        bindings[binding] = { binding, vk::DescriptorType::eStorageBuffer, 1, stages };
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.flags = vk::DescriptorSetLayoutCreateFlags();
+    layoutInfo.bindingCount = bindingCount;
+    layoutInfo.pBindings = bindings.data();
+    return device.createDescriptorSetLayout(layoutInfo);
+}
+
+vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swapchainImageFormat, const vk::Format& depthFormat)
 {
     vk::AttachmentDescription colorAttachment {};
     colorAttachment.flags = vk::AttachmentDescriptionFlags();
@@ -222,16 +318,34 @@ vk::RenderPass createRenderPass(const vk::Device& device, const vk::Format& swap
     colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
 
+    vk::AttachmentDescription depthAttachment {};
+    depthAttachment.flags = vk::AttachmentDescriptionFlags();
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = vk::SampleCountFlagBits::e1;
+    depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+    depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+    depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+    depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+    depthAttachment.initialLayout = vk::ImageLayout::eUndefined;
+    depthAttachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+    vk::AttachmentReference depthAttachmentRef {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
     vk::SubpassDescription subpass {};
     subpass.flags = vk::SubpassDescriptionFlags();
     subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    std::array<vk::AttachmentDescription, 2> attachments { colorAttachment, depthAttachment };
 
     vk::RenderPassCreateInfo renderpassInfo {};
     renderpassInfo = vk::RenderPassCreateFlags();
-    renderpassInfo.attachmentCount = 1;
-    renderpassInfo.pAttachments = &colorAttachment;
+    renderpassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderpassInfo.pAttachments = attachments.data();
     renderpassInfo.subpassCount = 1;
     renderpassInfo.pSubpasses = &subpass;
 
@@ -0,0 +1,264 @@
+#include "raycast.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VoKel {
+
+namespace {
+
+    struct ScalarOps {
+        using F = float;
+        using I = int32_t;
+        using M = bool;
+        static constexpr size_t WIDTH { 1 };
+
+        static F load(const float* p) { return *p; }
+        static void store(float* p, F v) { *p = v; }
+        static F set(float v) { return v; }
+        static F add(F a, F b) { return a + b; }
+        static F sub(F a, F b) { return a - b; }
+        static F mul(F a, F b) { return a * b; }
+        static F maxf(F a, F b) { return a > b ? a : b; }
+        static F floor(F a) { return std::floor(a); }
+
+        static I loadi(const int32_t* p) { return *p; }
+        static void storei(int32_t* p, I v) { *p = v; }
+        static I seti(int32_t v) { return v; }
+        static I addi(I a, I b) { return a + b; }
+        static I subi(I a, I b) { return a - b; }
+        static I andi(I a, I b) { return a & b; }
+        static I mini(I a, I b) { return a < b ? a : b; }
+        static I maxi(I a, I b) { return a > b ? a : b; }
+
+        static F toFloat(I a) { return static_cast<float>(a); }
+        static I toInt(F a) { return static_cast<int32_t>(a); }
+
+        static M lessEqual(F a, F b) { return a <= b; }
+        static M maski(I a) { return a != 0; }
+        static M andm(M a, M b) { return a && b; }
+        static M andnotm(M a, M b) { return !a && b; }
+        static M orm(M a, M b) { return a || b; }
+
+        static F select(M mask, F a, F b) { return mask ? a : b; }
+        static I selecti(M mask, I a, I b) { return mask ? a : b; }
+    };
+
+    // rays per job and per batch of the vector interface, keeps the scratch arrays in the cache
+    constexpr size_t RAY_BLOCK { 256 };
+
+    const ChunkOccupancy* lookupOccupancy(const void* context, int32_t x, int32_t y, int32_t z)
+    {
+        return static_cast<const VoxelRaycaster*>(context)->findOccupancy({ x, y, z });
+    }
+
+    // distances along a normalized direction are in voxels
+    glm::vec3 normalizeDirection(const glm::vec3& direction)
+    {
+        float length = glm::length(direction);
+        return length > 0.0f ? direction / length : glm::vec3 { 0.0f };
+    }
+
+    RayHit makeHit(const World& world, const glm::ivec3& voxel, float distance, uint8_t face)
+    {
+        if (face == RAY_MISS) {
+            return { false, glm::ivec3 { 0 }, face, distance, AIR };
+        }
+
+        return { true, voxel, face, distance, world.getVoxel(voxel) };
+    }
+
+    std::unique_ptr<ChunkOccupancy> buildOccupancy(const Chunk& chunk)
+    {
+        if (chunk.isEmpty()) {
+            return nullptr;
+        }
+
+        auto occupancy = std::make_unique<ChunkOccupancy>();
+
+        if (chunk.isFull()) {
+            occupancy->bricks = ~0ull;
+            std::fill(std::begin(occupancy->rows), std::end(occupancy->rows), ~0u);
+            return occupancy;
+        }
+
+        thread_local std::vector<Voxel> voxels(CHUNK_VOLUME);
+        chunk.decode(voxels.data());
+
+        occupancy->bricks = 0;
+        constexpr int BRICK_LOG2 { ChunkOccupancy::BRICK_SIZE_LOG2 };
+
+        for (int row { 0 }; row < CHUNK_AREA; row++) {
+            const Voxel* voxel = voxels.data() + row * CHUNK_SIZE;
+
+            uint32_t bits { 0 };
+            for (int x { 0 }; x < CHUNK_SIZE; x++) {
+                bits |= uint32_t(voxel[x] != AIR) << x;
+            }
+            occupancy->rows[row] = bits;
+
+            int z = row & (CHUNK_SIZE - 1);
+            int y = row >> CHUNK_SIZE_LOG2;
+            for (int bx { 0 }; bx < CHUNK_SIZE >> BRICK_LOG2; bx++) {
+                if ((bits >> (bx << BRICK_LOG2)) & 0xffu) {
+                    occupancy->bricks |= 1ull << (bx | ((z >> BRICK_LOG2) << 2) | ((y >> BRICK_LOG2) << 4));
+                }
+            }
+        }
+
+        return occupancy;
+    }
+
+}
+
+void traceRays(const RayBatch& batch, SimdLevel level)
+{
+#if VOKEL_X86
+    if (level == SimdLevel::AVX2) {
+        raycast::traceRaysAvx2(batch);
+        return;
+    }
+
+    if (level == SimdLevel::SSE4) {
+        raycast::traceRaysSse4(batch);
+        return;
+    }
+#endif
+
+    (void)level;
+    raycast::runTraceRays<ScalarOps>(batch);
+}
+
+VoxelRaycaster::VoxelRaycaster(World& world, JobSystem& jobs)
+    : world { world }
+    , jobs { jobs }
+{
+}
+
+void VoxelRaycaster::chunkChanged(const ChunkCoord& coord)
+{
+    dirtyChunks.insert(packChunkCoord(coord));
+}
+
+void VoxelRaycaster::voxelChanged(const glm::ivec3& voxel)
+{
+    dirtyChunks.insert(packChunkCoord(worldToChunk(voxel)));
+}
+
+void VoxelRaycaster::update()
+{
+    if (dirtyChunks.empty()) {
+        return;
+    }
+
+    std::vector<uint64_t> keys { dirtyChunks.begin(), dirtyChunks.end() };
+    std::vector<std::unique_ptr<ChunkOccupancy>> built(keys.size());
+    dirtyChunks.clear();
+
+    jobs.parallelFor(static_cast<uint32_t>(keys.size()), [&](uint32_t i) {
+        const Chunk* chunk = static_cast<const World&>(world).getChunk(unpackChunkCoord(keys[i]));
+        if (chunk != nullptr) {
+            built[i] = buildOccupancy(*chunk);
+        }
+    });
+
+    // empty and removed chunks keep no entry, rays cross them in one step
+    for (size_t i { 0 }; i < keys.size(); i++) {
+        if (built[i]) {
+            occupancy[keys[i]] = std::move(built[i]);
+        } else {
+            occupancy.erase(keys[i]);
+        }
+    }
+}
+
+const ChunkOccupancy* VoxelRaycaster::findOccupancy(const ChunkCoord& coord) const
+{
+    const std::unique_ptr<ChunkOccupancy>* chunk = occupancy.find(packChunkCoord(coord));
+    return chunk == nullptr ? nullptr : chunk->get();
+}
+
+void VoxelRaycaster::trace(RayBatch batch, SimdLevel level) const
+{
+    batch.lookup = lookupOccupancy;
+    batch.context = this;
+    traceRays(batch, level);
+}
+
+RayHit VoxelRaycaster::cast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+    glm::vec3 normalized = normalizeDirection(direction);
+    float input[7] { origin.x, origin.y, origin.z, normalized.x, normalized.y, normalized.z, maxDistance };
+
+    int32_t voxel[3];
+    float distance;
+    uint8_t face;
+
+    RayBatch batch {
+        { &input[0], &input[1], &input[2] },
+        { &input[3], &input[4], &input[5] },
+        &input[6],
+        1,
+        nullptr,
+        nullptr,
+        { &voxel[0], &voxel[1], &voxel[2] },
+        &distance,
+        &face
+    };
+    trace(batch, SimdLevel::Scalar);
+
+    return makeHit(world, { voxel[0], voxel[1], voxel[2] }, distance, face);
+}
+
+void VoxelRaycaster::cast(const std::vector<Ray>& rays, std::vector<RayHit>& hits, SimdLevel level) const
+{
+    hits.resize(rays.size());
+
+    auto castBlock = [&](uint32_t block) {
+        size_t first = size_t(block) * RAY_BLOCK;
+        size_t count = std::min(RAY_BLOCK, rays.size() - first);
+
+        alignas(32) float input[7][RAY_BLOCK];
+        alignas(32) int32_t voxel[3][RAY_BLOCK];
+        alignas(32) float distance[RAY_BLOCK];
+        uint8_t face[RAY_BLOCK];
+
+        for (size_t i { 0 }; i < count; i++) {
+            const Ray& ray = rays[first + i];
+
+            glm::vec3 direction = normalizeDirection(ray.direction);
+
+            for (int a { 0 }; a < 3; a++) {
+                input[a][i] = ray.origin[a];
+                input[3 + a][i] = direction[a];
+            }
+            input[6][i] = ray.maxDistance;
+        }
+
+        RayBatch batch {
+            { input[0], input[1], input[2] },
+            { input[3], input[4], input[5] },
+            input[6],
+            count,
+            nullptr,
+            nullptr,
+            { voxel[0], voxel[1], voxel[2] },
+            distance,
+            face
+        };
+        trace(batch, level);
+
+        for (size_t i { 0 }; i < count; i++) {
+            hits[first + i] = makeHit(world, { voxel[0][i], voxel[1][i], voxel[2][i] }, distance[i], face[i]);
+        }
+    };
+
+    uint32_t blocks = static_cast<uint32_t>((rays.size() + RAY_BLOCK - 1) / RAY_BLOCK);
+    if (blocks == 1) {
+        castBlock(0);
+    } else if (blocks > 1) {
+        jobs.parallelFor(blocks, castBlock);
+    }
+}
+
+}
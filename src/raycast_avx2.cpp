@@ -0,0 +1,62 @@
+// built with -mavx2, only reached when the cpu reports AVX2 (see CMakeLists.txt)
+#include "raycast_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <immintrin.h>
+
+namespace VoKel {
+
+namespace raycast {
+
+    namespace {
+
+        struct Avx2Ops {
+            using F = __m256;
+            using I = __m256i;
+            using M = __m256;
+            static constexpr size_t WIDTH { 8 };
+
+            static F load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, F v) { _mm256_storeu_ps(p, v); }
+            static F set(float v) { return _mm256_set1_ps(v); }
+            static F add(F a, F b) { return _mm256_add_ps(a, b); }
+            static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+            static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+            static F maxf(F a, F b) { return _mm256_max_ps(a, b); }
+            static F floor(F a) { return _mm256_floor_ps(a); }
+
+            static I loadi(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+            static void storei(int32_t* p, I v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+            static I seti(int32_t v) { return _mm256_set1_epi32(v); }
+            static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+            static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+            static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+            static I mini(I a, I b) { return _mm256_min_epi32(a, b); }
+            static I maxi(I a, I b) { return _mm256_max_epi32(a, b); }
+
+            static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+            static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+
+            static M lessEqual(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+            static M maski(I a) { return _mm256_castsi256_ps(a); }
+            static M andm(M a, M b) { return _mm256_and_ps(a, b); }
+            static M andnotm(M a, M b) { return _mm256_andnot_ps(a, b); }
+            static M orm(M a, M b) { return _mm256_or_ps(a, b); }
+
+            static F select(M mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+            static I selecti(M mask, I a, I b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), mask)); }
+        };
+
+    }
+
+    void traceRaysAvx2(const RayBatch& batch)
+    {
+        runTraceRays<Avx2Ops>(batch);
+    }
+
+}
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+// built with -msse4.1, only reached when the cpu reports SSE4.1 (see CMakeLists.txt)
+#include "raycast_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <smmintrin.h>
+
+namespace VoKel {
+
+namespace raycast {
+
+    namespace {
+
+        struct Sse4Ops {
+            using F = __m128;
+            using I = __m128i;
+            using M = __m128;
+            static constexpr size_t WIDTH { 4 };
+
+            static F load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, F v) { _mm_storeu_ps(p, v); }
+            static F set(float v) { return _mm_set1_ps(v); }
+            static F add(F a, F b) { return _mm_add_ps(a, b); }
+            static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+            static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+            static F maxf(F a, F b) { return _mm_max_ps(a, b); }
+            static F floor(F a) { return _mm_floor_ps(a); }
+
+            static I loadi(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+            static void storei(int32_t* p, I v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+            static I seti(int32_t v) { return _mm_set1_epi32(v); }
+            static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+            static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+            static I andi(I a, I b) { return _mm_and_si128(a, b); }
+            static I mini(I a, I b) { return _mm_min_epi32(a, b); }
+            static I maxi(I a, I b) { return _mm_max_epi32(a, b); }
+
+            static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+            static I toInt(F a) { return _mm_cvttps_epi32(a); }
+
+            static M lessEqual(F a, F b) { return _mm_cmple_ps(a, b); }
+            static M maski(I a) { return _mm_castsi128_ps(a); }
+            static M andm(M a, M b) { return _mm_and_ps(a, b); }
+            static M andnotm(M a, M b) { return _mm_andnot_ps(a, b); }
+            static M orm(M a, M b) { return _mm_or_ps(a, b); }
+
+            static F select(M mask, F a, F b) { return _mm_blendv_ps(b, a, mask); }
+            static I selecti(M mask, I a, I b) { return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b), _mm_castsi128_ps(a), mask)); }
+        };
+
+    }
+
+    void traceRaysSse4(const RayBatch& batch)
+    {
+        runTraceRays<Sse4Ops>(batch);
+    }
+
+}
+
+}
+
+#endif
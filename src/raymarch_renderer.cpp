@@ -0,0 +1,361 @@
+#include "raymarch_renderer.hpp"
+#include "image.hpp"
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr vk::Format OUTPUT_FORMAT { vk::Format::eR8G8B8A8Unorm };
+    constexpr uint32_t GROUP_SIZE { 8 };
+
+    struct Upload {
+        const void* data;
+        vk::DeviceSize size;
+        vk::DeviceSize offset;
+    };
+
+    vkUtil::Buffer createBuffer(vk::Device device, vk::PhysicalDevice physicalDevice, size_t size, vk::BufferUsageFlags usage)
+    {
+        vkUtil::BufferInput input;
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.size = size;
+        input.usage = usage;
+        return vkUtil::createBuffer(input);
+    }
+
+    void destroyBuffer(vk::Device device, vkUtil::Buffer& buffer)
+    {
+        if (buffer.buffer) {
+            device.destroyBuffer(buffer.buffer);
+            device.freeMemory(buffer.bufferMemory);
+        }
+        buffer = {};
+    }
+
+    // sorted runs of consecutive elements, element size in bytes
+    void collectRuns(std::vector<uint32_t> indices, const uint32_t* base, size_t elementSize, std::vector<Upload>& uploads)
+    {
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+        for (size_t i { 0 }; i < indices.size();) {
+            size_t end = i + 1;
+            while (end < indices.size() && indices[end] == indices[end - 1] + 1) {
+                end++;
+            }
+
+            size_t words = elementSize / sizeof(uint32_t);
+            uploads.push_back({ base + size_t(indices[i]) * words, (end - i) * elementSize, indices[i] * elementSize });
+            i = end;
+        }
+    }
+
+    void imageBarrier(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+        vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage)
+    {
+        vk::ImageMemoryBarrier barrier {};
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = vk::ImageSubresourceRange { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+
+        commandBuffer.pipelineBarrier(srcStage, dstStage, vk::DependencyFlags(), nullptr, nullptr, barrier);
+    }
+
+}
+
+RaymarchRenderer::RaymarchRenderer(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Format swapchainFormat)
+    : device { device }
+    , physicalDevice { physicalDevice }
+{
+    vk::FormatFeatureFlags outputFeatures = vk::FormatFeatureFlagBits::eStorageImage | vk::FormatFeatureFlagBits::eBlitSrc;
+    if ((physicalDevice.getFormatProperties(OUTPUT_FORMAT).optimalTilingFeatures & outputFeatures) != outputFeatures) {
+        throw std::runtime_error { "Raymarching needs rgba8 storage images that can be blitted" };
+    }
+
+    if (!(physicalDevice.getFormatProperties(swapchainFormat).optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitDst)) {
+        throw std::runtime_error { "Raymarching needs to blit into the swapchain format" };
+    }
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings {};
+    bindings[0] = { 0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute };
+    bindings[1] = { 1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute };
+    bindings[2] = { 2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute };
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.flags = vk::DescriptorSetLayoutCreateFlags();
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    descriptorSetLayout = device.createDescriptorSetLayout(layoutInfo);
+
+    vkInit::ComputePipelineInBundle specification {};
+    specification.device = device;
+    specification.compFilePath = "../../shaders/bin/raymarch.comp.spv";
+    specification.descriptorSetLayout = descriptorSetLayout;
+    specification.pushConstantSize = sizeof(vkUtil::RaymarchData);
+
+    vkInit::ComputePipelineOutBundle output = vkInit::createComputePipeline(specification);
+    layout = output.layout;
+    pipeline = output.pipeline;
+}
+
+RaymarchRenderer::~RaymarchRenderer()
+{
+    destroyTargets();
+    destroyBuffer(device, cellBuffer);
+    destroyBuffer(device, brickBuffer);
+
+    device.destroyPipeline(pipeline);
+    device.destroyPipelineLayout(layout);
+    device.destroyDescriptorSetLayout(descriptorSetLayout);
+}
+
+void RaymarchRenderer::destroyTargets()
+{
+    for (Frame& frame : frames) {
+        device.destroyImageView(frame.imageView);
+        device.destroyImage(frame.image);
+        device.freeMemory(frame.imageMemory);
+        destroyBuffer(device, frame.staging);
+    }
+    frames.clear();
+
+    if (descriptorPool) {
+        device.destroyDescriptorPool(descriptorPool);
+        descriptorPool = nullptr;
+    }
+}
+
+void RaymarchRenderer::setTargets(vk::Extent2D extent, uint32_t frameCount)
+{
+    destroyTargets();
+    this->extent = extent;
+
+    vkImage::ImageInput imageInput {};
+    imageInput.device = device;
+    imageInput.physicalDevice = physicalDevice;
+    imageInput.width = extent.width;
+    imageInput.height = extent.height;
+    imageInput.tiling = vk::ImageTiling::eOptimal;
+    imageInput.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc;
+    imageInput.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    imageInput.format = OUTPUT_FORMAT;
+
+    frames.resize(frameCount);
+    for (Frame& frame : frames) {
+        frame.image = vkImage::createImage(imageInput);
+        frame.imageMemory = vkImage::createImageMemory(imageInput, frame.image);
+        frame.imageView = vkImage::createImageView(device, frame.image, OUTPUT_FORMAT, vk::ImageAspectFlagBits::eColor);
+        frame.staging = {};
+        frame.stagingSize = 0;
+    }
+
+    std::array<vk::DescriptorPoolSize, 2> poolSizes {};
+    poolSizes[0] = { vk::DescriptorType::eStorageImage, frameCount };
+    poolSizes[1] = { vk::DescriptorType::eStorageBuffer, 2 * frameCount };
+
+    vk::DescriptorPoolCreateInfo poolInfo {};
+    poolInfo.flags = vk::DescriptorPoolCreateFlags();
+    poolInfo.maxSets = frameCount;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    descriptorPool = device.createDescriptorPool(poolInfo);
+
+    std::vector<vk::DescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo {};
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = frameCount;
+    allocInfo.pSetLayouts = layouts.data();
+
+    std::vector<vk::DescriptorSet> sets = device.allocateDescriptorSets(allocInfo);
+    for (uint32_t i { 0 }; i < frameCount; i++) {
+        frames[i].descriptorSet = sets[i];
+    }
+
+    if (cellBuffer.buffer) {
+        updateDescriptorSets();
+    }
+}
+
+void RaymarchRenderer::updateDescriptorSets()
+{
+    for (Frame& frame : frames) {
+        vk::DescriptorImageInfo imageInfo { nullptr, frame.imageView, vk::ImageLayout::eGeneral };
+        vk::DescriptorBufferInfo cellInfo { cellBuffer.buffer, 0, VK_WHOLE_SIZE };
+        vk::DescriptorBufferInfo brickInfo { brickBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+        std::array<vk::WriteDescriptorSet, 3> writes {};
+        writes[0] = { frame.descriptorSet, 0, 0, 1, vk::DescriptorType::eStorageImage, &imageInfo };
+        writes[1] = { frame.descriptorSet, 1, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &cellInfo };
+        writes[2] = { frame.descriptorSet, 2, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &brickInfo };
+
+        device.updateDescriptorSets(writes, nullptr);
+    }
+}
+
+bool RaymarchRenderer::reserveBuffers(const BrickMap& brickMap)
+{
+    size_t cellBytes = brickMap.getCells().size() * sizeof(uint32_t);
+    size_t brickBytes = std::max<size_t>(brickMap.getBricks().size(), BRICK_WORDS) * sizeof(uint32_t);
+
+    if (cellBytes == cellBufferSize && brickBytes <= brickBufferSize) {
+        return false;
+    }
+
+    // frames in flight still read the old buffers, growing is rare enough to simply wait for them
+    device.waitIdle();
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+    if (cellBytes != cellBufferSize) {
+        destroyBuffer(device, cellBuffer);
+        cellBuffer = createBuffer(device, physicalDevice, cellBytes, usage);
+        cellBufferSize = cellBytes;
+    }
+
+    if (brickBytes > brickBufferSize) {
+        destroyBuffer(device, brickBuffer);
+        brickBufferSize = std::max(brickBytes, brickBufferSize * 2);
+        brickBuffer = createBuffer(device, physicalDevice, brickBufferSize, usage);
+    }
+
+    updateDescriptorSets();
+    return true;
+}
+
+void RaymarchRenderer::upload(vk::CommandBuffer commandBuffer, Frame& frame, const BrickMap& brickMap)
+{
+    uploadedBytes = 0;
+
+    bool resized = reserveBuffers(brickMap);
+    bool missed = !synced || brickMap.getRevision() != uploadedRevision + 1;
+    if (!resized && synced && brickMap.getRevision() == uploadedRevision) {
+        return;
+    }
+
+    const std::vector<uint32_t>& cells = brickMap.getCells();
+    const std::vector<uint32_t>& bricks = brickMap.getBricks();
+
+    std::vector<Upload> cellUploads;
+    std::vector<Upload> brickUploads;
+
+    if (resized || missed) {
+        cellUploads.push_back({ cells.data(), cells.size() * sizeof(uint32_t), 0 });
+        if (!bricks.empty()) {
+            brickUploads.push_back({ bricks.data(), bricks.size() * sizeof(uint32_t), 0 });
+        }
+    } else {
+        collectRuns(brickMap.getChangedCells(), cells.data(), sizeof(uint32_t), cellUploads);
+        collectRuns(brickMap.getChangedBricks(), bricks.data(), BRICK_WORDS * sizeof(uint32_t), brickUploads);
+    }
+
+    synced = true;
+    uploadedRevision = brickMap.getRevision();
+
+    size_t total { 0 };
+    for (const auto* uploads : { &cellUploads, &brickUploads }) {
+        for (const Upload& upload : *uploads) {
+            total += upload.size;
+        }
+    }
+
+    if (total == 0) {
+        return;
+    }
+
+    // the frame's fence was waited on, its previous copies are done with the staging buffer
+    if (total > frame.stagingSize) {
+        destroyBuffer(device, frame.staging);
+        frame.stagingSize = std::max(total, frame.stagingSize * 2);
+        frame.staging = createBuffer(device, physicalDevice, frame.stagingSize, vk::BufferUsageFlagBits::eTransferSrc);
+    }
+
+    char* mapped = static_cast<char*>(device.mapMemory(frame.staging.bufferMemory, 0, total));
+
+    std::vector<vk::BufferCopy> cellCopies;
+    std::vector<vk::BufferCopy> brickCopies;
+    size_t offset { 0 };
+
+    for (const Upload& upload : cellUploads) {
+        std::memcpy(mapped + offset, upload.data, upload.size);
+        cellCopies.push_back({ offset, upload.offset, upload.size });
+        offset += upload.size;
+    }
+
+    for (const Upload& upload : brickUploads) {
+        std::memcpy(mapped + offset, upload.data, upload.size);
+        brickCopies.push_back({ offset, upload.offset, upload.size });
+        offset += upload.size;
+    }
+
+    device.unmapMemory(frame.staging.bufferMemory);
+
+    // earlier frames may still be reading the buffers
+    vk::MemoryBarrier before { vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(), before, nullptr, nullptr);
+
+    if (!cellCopies.empty()) {
+        commandBuffer.copyBuffer(frame.staging.buffer, cellBuffer.buffer, cellCopies);
+    }
+    if (!brickCopies.empty()) {
+        commandBuffer.copyBuffer(frame.staging.buffer, brickBuffer.buffer, brickCopies);
+    }
+
+    vk::MemoryBarrier after { vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead };
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(), after, nullptr, nullptr);
+
+    uploadedBytes = total;
+}
+
+void RaymarchRenderer::record(vk::CommandBuffer commandBuffer, uint32_t frameIndex, vk::Image swapchainImage, const BrickMap& brickMap, const vkUtil::RaymarchData& data)
+{
+    Frame& frame = frames[frameIndex];
+
+    imageBarrier(commandBuffer, swapchainImage, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+        vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer);
+
+    if (brickMap.getCells().empty()) {
+        // nothing streamed in yet, show the sky
+        vk::ClearColorValue sky { std::array<float, 4> { 0.55f, 0.7f, 0.9f, 1.0f } };
+        vk::ImageSubresourceRange range { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+        commandBuffer.clearColorImage(swapchainImage, vk::ImageLayout::eTransferDstOptimal, sky, range);
+    } else {
+        upload(commandBuffer, frame, brickMap);
+
+        imageBarrier(commandBuffer, frame.image, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+            vk::AccessFlags(), vk::AccessFlagBits::eShaderWrite, vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eComputeShader);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, frame.descriptorSet, nullptr);
+        commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(data), &data);
+        commandBuffer.dispatch((extent.width + GROUP_SIZE - 1) / GROUP_SIZE, (extent.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+        imageBarrier(commandBuffer, frame.image, vk::ImageLayout::eGeneral, vk::ImageLayout::eTransferSrcOptimal,
+            vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead, vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer);
+
+        vk::ImageBlit blit {};
+        blit.srcSubresource = vk::ImageSubresourceLayers { vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+        blit.srcOffsets[1] = vk::Offset3D { int32_t(extent.width), int32_t(extent.height), 1 };
+        blit.dstSubresource = blit.srcSubresource;
+        blit.dstOffsets[1] = blit.srcOffsets[1];
+
+        commandBuffer.blitImage(frame.image, vk::ImageLayout::eTransferSrcOptimal, swapchainImage, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eNearest);
+    }
+
+    imageBarrier(commandBuffer, swapchainImage, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::ePresentSrcKHR,
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlags(), vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe);
+}
+
+}
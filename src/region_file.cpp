@@ -0,0 +1,860 @@
+#include "region_file.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VoKel {
+
+namespace {
+
+    // every field is stored in host byte order, all supported targets are little endian
+    constexpr char REGION_MAGIC[4] { 'V', 'O', 'K', 'R' };
+    constexpr uint32_t REGION_VERSION { 1 };
+
+    struct TableHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t sequence;
+        uint32_t regionSize;
+        uint32_t sectorSize;
+        uint32_t checksum;
+        uint32_t reserved;
+    };
+
+    constexpr size_t TABLE_BYTES { sizeof(TableHeader) + sizeof(RegionFile::Entry) * REGION_CHUNKS };
+    constexpr uint32_t TABLE_SECTORS { static_cast<uint32_t>((TABLE_BYTES + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE) };
+    constexpr uint32_t DATA_SECTOR { 2 * TABLE_SECTORS };
+
+    struct Crc32Table {
+        std::array<uint32_t, 256> values;
+
+        Crc32Table()
+        {
+            for (uint32_t i { 0 }; i < 256; i++) {
+                uint32_t c { i };
+                for (int k { 0 }; k < 8; k++) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                values[i] = c;
+            }
+        }
+    };
+
+    uint32_t crc32(const void* data, size_t size, uint32_t crc = 0)
+    {
+        static const Crc32Table table;
+
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        crc = ~crc;
+        for (size_t i { 0 }; i < size; i++) {
+            crc = table.values[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t tableChecksum(uint64_t sequence, const std::array<RegionFile::Entry, REGION_CHUNKS>& table)
+    {
+        return crc32(table.data(), sizeof(RegionFile::Entry) * REGION_CHUNKS, crc32(&sequence, sizeof(sequence)));
+    }
+
+    template <typename T>
+    void append(std::vector<uint8_t>& out, const T& value)
+    {
+        size_t offset = out.size();
+        out.resize(offset + sizeof(T));
+        std::memcpy(out.data() + offset, &value, sizeof(T));
+    }
+
+    void appendVarint(std::vector<uint8_t>& out, uint32_t value)
+    {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool readVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value)
+    {
+        value = 0;
+        for (int shift { 0 }; shift < 35; shift += 7) {
+            if (data == end) {
+                return false;
+            }
+
+            uint8_t byte = *data++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // runs shorter than this are cheaper as literals
+    constexpr size_t MIN_RUN { 3 };
+
+}
+
+ChunkCoord chunkToRegion(const ChunkCoord& chunk)
+{
+    return chunk >> REGION_SIZE_LOG2;
+}
+
+uint32_t regionSlot(const ChunkCoord& chunk)
+{
+    ChunkCoord local = chunk & (REGION_SIZE - 1);
+    return static_cast<uint32_t>(local.x | (local.z << REGION_SIZE_LOG2) | (local.y << (2 * REGION_SIZE_LOG2)));
+}
+
+void encodeChunk(const Chunk& chunk, std::vector<uint8_t>& out)
+{
+    const std::vector<Voxel>& palette = chunk.getPalette();
+    const std::vector<uint64_t>& words = chunk.getIndices();
+
+    append(out, static_cast<uint32_t>(palette.size()));
+    append(out, chunk.getBitsPerIndex());
+    append(out, chunk.getSolidCount());
+    for (Voxel voxel : palette) {
+        append(out, voxel);
+    }
+
+    // tokens are (length << 1 | run), a run stores one word, a literal stores length words
+    size_t literalStart { 0 };
+    size_t i { 0 };
+
+    auto flushLiteral = [&](size_t end) {
+        if (end > literalStart) {
+            appendVarint(out, static_cast<uint32_t>(end - literalStart) << 1);
+            for (size_t j { literalStart }; j < end; j++) {
+                append(out, words[j]);
+            }
+        }
+    };
+
+    while (i < words.size()) {
+        size_t run { 1 };
+        while (i + run < words.size() && words[i + run] == words[i]) {
+            run++;
+        }
+
+        if (run >= MIN_RUN) {
+            flushLiteral(i);
+            appendVarint(out, (static_cast<uint32_t>(run) << 1) | 1);
+            append(out, words[i]);
+            literalStart = i + run;
+        }
+
+        i += run;
+    }
+
+    flushLiteral(words.size());
+}
+
+bool decodeChunk(const uint8_t* data, size_t size, Chunk& chunk)
+{
+    const uint8_t* end = data + size;
+
+    uint32_t header[3];
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(header, data, sizeof(header));
+    data += sizeof(header);
+
+    auto [paletteSize, bits, solidCount] = header;
+    if (paletteSize == 0 || paletteSize > 65536 || size_t(end - data) < paletteSize * sizeof(Voxel)) {
+        return false;
+    }
+
+    std::vector<Voxel> palette(paletteSize);
+    std::memcpy(palette.data(), data, paletteSize * sizeof(Voxel));
+    data += paletteSize * sizeof(Voxel);
+
+    uint64_t* words;
+    try {
+        words = chunk.restore(palette.data(), paletteSize, bits, solidCount);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+
+    size_t wordCount = chunk.getIndices().size();
+    size_t written { 0 };
+
+    while (written < wordCount) {
+        uint32_t token;
+        if (!readVarint(data, end, token)) {
+            return false;
+        }
+
+        size_t length = token >> 1;
+        if (length == 0 || written + length > wordCount) {
+            return false;
+        }
+
+        if (token & 1) {
+            uint64_t word;
+            if (size_t(end - data) < sizeof(word)) {
+                return false;
+            }
+            std::memcpy(&word, data, sizeof(word));
+            data += sizeof(word);
+            std::fill_n(words + written, length, word);
+        } else {
+            if (size_t(end - data) < length * sizeof(uint64_t)) {
+                return false;
+            }
+            std::memcpy(words + written, data, length * sizeof(uint64_t));
+            data += length * sizeof(uint64_t);
+        }
+
+        written += length;
+    }
+
+    return data == end;
+}
+
+RegionFile::RegionFile(const std::filesystem::path& path)
+    : path { path }
+{
+    openFile();
+
+    if (fileSize == 0) {
+        usedSectors.assign(DATA_SECTOR, true);
+        commitTable();
+        remap();
+        return;
+    }
+
+    remap();
+
+    uint64_t bestSequence { 0 };
+    int best { -1 };
+    for (uint32_t copy { 0 }; copy < 2; copy++) {
+        if (loadTable(copy) && (best < 0 || sequence > bestSequence)) {
+            best = static_cast<int>(copy);
+            bestSequence = sequence;
+        }
+    }
+
+    if (best < 0) {
+        closeFile();
+        throw std::runtime_error("region file " + path.string() + " has no valid offset table");
+    }
+
+    loadTable(static_cast<uint32_t>(best));
+
+    // entries pointing past the end of the file are dropped, their chunks are generated again
+    uint64_t fileSectors = fileSize / REGION_SECTOR_SIZE + (fileSize % REGION_SECTOR_SIZE != 0);
+    usedSectors.assign(std::max<uint64_t>(fileSectors, DATA_SECTOR), false);
+    std::fill_n(usedSectors.begin(), DATA_SECTOR, true);
+    for (Entry& entry : table) {
+        if (entry.sectorCount == 0) {
+            continue;
+        }
+
+        if (entry.sector < DATA_SECTOR || uint64_t(entry.sector) + entry.sectorCount > fileSectors
+            || uint64_t(entry.size) > uint64_t(entry.sectorCount) * REGION_SECTOR_SIZE) {
+            entry = Entry {};
+            continue;
+        }
+
+        markSectors(entry, true);
+    }
+}
+
+RegionFile::~RegionFile()
+{
+    if (io != nullptr) {
+        io->closeFile(ioFile);
+    }
+
+    closeFile();
+}
+
+bool RegionFile::loadTable(uint32_t copy)
+{
+    uint64_t offset = uint64_t(copy) * TABLE_SECTORS * REGION_SECTOR_SIZE;
+    if (offset + TABLE_BYTES > mappedSize) {
+        return false;
+    }
+
+    TableHeader header;
+    std::memcpy(&header, mapped + offset, sizeof(header));
+
+    if (std::memcmp(header.magic, REGION_MAGIC, sizeof(REGION_MAGIC)) != 0 || header.version != REGION_VERSION
+        || header.regionSize != REGION_SIZE || header.sectorSize != REGION_SECTOR_SIZE) {
+        return false;
+    }
+
+    std::array<Entry, REGION_CHUNKS> entries;
+    std::memcpy(entries.data(), mapped + offset + sizeof(header), sizeof(Entry) * REGION_CHUNKS);
+
+    if (tableChecksum(header.sequence, entries) != header.checksum) {
+        return false;
+    }
+
+    table = entries;
+    sequence = header.sequence;
+    return true;
+}
+
+void RegionFile::commitTable()
+{
+    TableHeader header {};
+    std::memcpy(header.magic, REGION_MAGIC, sizeof(REGION_MAGIC));
+    header.version = REGION_VERSION;
+    header.sequence = sequence + 1;
+    header.regionSize = REGION_SIZE;
+    header.sectorSize = REGION_SECTOR_SIZE;
+    header.checksum = tableChecksum(header.sequence, table);
+
+    std::vector<uint8_t> bytes(TABLE_SECTORS * REGION_SECTOR_SIZE, 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), table.data(), sizeof(Entry) * REGION_CHUNKS);
+
+    // the copy not holding the current table is overwritten, the current one stays valid until this is synced
+    uint32_t copy = static_cast<uint32_t>(header.sequence & 1);
+    writeAt(uint64_t(copy) * TABLE_SECTORS * REGION_SECTOR_SIZE, bytes.data(), bytes.size());
+
+    if (fileSize < uint64_t(DATA_SECTOR) * REGION_SECTOR_SIZE) {
+        std::vector<uint8_t> padding(uint64_t(DATA_SECTOR) * REGION_SECTOR_SIZE - fileSize, 0);
+        writeAt(fileSize, padding.data(), padding.size());
+    }
+
+    sync();
+    sequence = header.sequence;
+}
+
+bool RegionFile::contains(uint32_t slot) const
+{
+    std::shared_lock lock { mutex };
+    return table[slot].sectorCount != 0;
+}
+
+std::unique_ptr<Chunk> RegionFile::read(uint32_t slot, size_t* payloadSize)
+{
+    std::shared_lock lock { mutex };
+
+    const Entry& entry = table[slot];
+    if (entry.sectorCount == 0) {
+        return nullptr;
+    }
+
+    uint64_t offset = uint64_t(entry.sector) * REGION_SECTOR_SIZE;
+    if (offset + entry.size > mappedSize) {
+        return nullptr;
+    }
+
+    const uint8_t* payload = mapped + offset;
+    if (crc32(payload, entry.size) != entry.checksum) {
+        if (DEBUG_MODE) {
+            std::cout << "Damaged chunk payload in " << path.string() << ", slot " << slot << "\n";
+        }
+        return nullptr;
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+    if (!decodeChunk(payload, entry.size, *chunk)) {
+        return nullptr;
+    }
+
+    if (payloadSize != nullptr) {
+        *payloadSize = entry.size;
+    }
+
+    return chunk;
+}
+
+bool RegionFile::locate(uint32_t slot, Entry& entry) const
+{
+    std::shared_lock lock { mutex };
+    entry = table[slot];
+    return entry.sectorCount != 0;
+}
+
+std::unique_ptr<Chunk> RegionFile::decodePayload(const Entry& entry, const uint8_t* data, size_t size)
+{
+    if (size != entry.size || crc32(data, size) != entry.checksum) {
+        return nullptr;
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+    if (!decodeChunk(data, size, *chunk)) {
+        return nullptr;
+    }
+
+    return chunk;
+}
+
+uint32_t RegionFile::getIoFile(AsyncIo& service)
+{
+    std::lock_guard lock { ioMutex };
+
+    if (io == nullptr) {
+        io = &service;
+        ioFile = service.openFile(path);
+    }
+
+    return ioFile;
+}
+
+size_t RegionFile::write(const std::vector<std::pair<uint32_t, const Chunk*>>& chunks)
+{
+    if (chunks.empty()) {
+        return 0;
+    }
+
+    std::unique_lock lock { mutex };
+
+    std::vector<Entry> replaced;
+    std::vector<uint8_t> payload;
+    size_t written { 0 };
+
+    for (const auto& [slot, chunk] : chunks) {
+        payload.clear();
+        encodeChunk(*chunk, payload);
+
+        Entry entry {};
+        entry.size = static_cast<uint32_t>(payload.size());
+        entry.sectorCount = static_cast<uint32_t>((payload.size() + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE);
+        entry.sector = allocateSectors(entry.sectorCount);
+        entry.checksum = crc32(payload.data(), payload.size());
+
+        writeAt(uint64_t(entry.sector) * REGION_SECTOR_SIZE, payload.data(), payload.size());
+        written += payload.size();
+
+        // a slot written twice in one batch frees its first copy as well
+        replaced.push_back(table[slot]);
+        table[slot] = entry;
+    }
+
+    // payloads must be on disk before a table can point at them
+    sync();
+    commitTable();
+
+    for (const Entry& entry : replaced) {
+        markSectors(entry, false);
+    }
+
+    remap();
+    return written;
+}
+
+uint32_t RegionFile::allocateSectors(uint32_t count)
+{
+    uint32_t start { DATA_SECTOR };
+    uint32_t run { 0 };
+
+    for (uint32_t sector { DATA_SECTOR }; sector < usedSectors.size() && run < count; sector++) {
+        if (usedSectors[sector]) {
+            start = sector + 1;
+            run = 0;
+        } else {
+            run++;
+        }
+    }
+
+    // a free run touching the end of the file simply grows past it
+    if (usedSectors.size() < size_t(start) + count) {
+        usedSectors.resize(size_t(start) + count, false);
+    }
+
+    Entry entry { start, count, 0, 0 };
+    markSectors(entry, true);
+    return start;
+}
+
+void RegionFile::markSectors(const Entry& entry, bool used)
+{
+    if (entry.sectorCount == 0) {
+        return;
+    }
+
+    std::fill(usedSectors.begin() + entry.sector, usedSectors.begin() + entry.sector + entry.sectorCount, used);
+}
+
+#ifdef _WIN32
+
+void RegionFile::openFile()
+{
+    HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("failed to open region file " + path.string());
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(handle, &size);
+
+    file = handle;
+    fileSize = static_cast<uint64_t>(size.QuadPart);
+}
+
+void RegionFile::closeFile()
+{
+    if (mapped != nullptr) {
+        UnmapViewOfFile(mapped);
+        mapped = nullptr;
+    }
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file != nullptr) {
+        CloseHandle(file);
+        file = nullptr;
+    }
+    mappedSize = 0;
+}
+
+void RegionFile::remap()
+{
+    if (mapped != nullptr) {
+        UnmapViewOfFile(mapped);
+        CloseHandle(mapping);
+        mapped = nullptr;
+        mapping = nullptr;
+    }
+
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        throw std::runtime_error("failed to map region file " + path.string());
+    }
+
+    mapped = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (mapped == nullptr) {
+        throw std::runtime_error("failed to map region file " + path.string());
+    }
+
+    mappedSize = fileSize;
+}
+
+void RegionFile::writeAt(uint64_t offset, const void* data, size_t size)
+{
+    OVERLAPPED overlapped {};
+    overlapped.Offset = static_cast<DWORD>(offset);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    DWORD written { 0 };
+    if (!WriteFile(file, data, static_cast<DWORD>(size), &written, &overlapped) || written != size) {
+        throw std::runtime_error("failed to write region file " + path.string());
+    }
+
+    fileSize = std::max(fileSize, offset + size);
+}
+
+void RegionFile::sync()
+{
+    FlushFileBuffers(file);
+}
+
+#else
+
+void RegionFile::openFile()
+{
+    file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file < 0) {
+        throw std::runtime_error("failed to open region file " + path.string());
+    }
+
+    struct stat info;
+    fstat(file, &info);
+    fileSize = static_cast<uint64_t>(info.st_size);
+}
+
+void RegionFile::closeFile()
+{
+    if (mapped != nullptr) {
+        munmap(const_cast<uint8_t*>(mapped), mappedSize);
+        mapped = nullptr;
+    }
+    if (file >= 0) {
+        ::close(file);
+        file = -1;
+    }
+    mappedSize = 0;
+}
+
+void RegionFile::remap()
+{
+    if (mapped != nullptr) {
+        munmap(const_cast<uint8_t*>(mapped), mappedSize);
+        mapped = nullptr;
+    }
+
+    void* address = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("failed to map region file " + path.string());
+    }
+
+    mapped = static_cast<const uint8_t*>(address);
+    mappedSize = fileSize;
+}
+
+void RegionFile::writeAt(uint64_t offset, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    while (size > 0) {
+        ssize_t written = pwrite(file, bytes, size, static_cast<off_t>(offset));
+        if (written <= 0) {
+            throw std::runtime_error("failed to write region file " + path.string());
+        }
+
+        fileSize = std::max(fileSize, offset + uint64_t(written));
+        bytes += written;
+        offset += uint64_t(written);
+        size -= size_t(written);
+    }
+}
+
+void RegionFile::sync()
+{
+    fdatasync(file);
+}
+
+#endif
+
+RegionStore::RegionStore(std::filesystem::path directory, size_t maxOpenRegions)
+    : directory { std::move(directory) }
+    , maxOpenRegions { std::max<size_t>(1, maxOpenRegions) }
+{
+}
+
+std::filesystem::path RegionStore::regionPath(const ChunkCoord& region) const
+{
+    return directory / ("r." + std::to_string(region.x) + "." + std::to_string(region.y) + "." + std::to_string(region.z) + ".vkr");
+}
+
+std::shared_ptr<RegionFile> RegionStore::openRegion(const ChunkCoord& region, bool create)
+{
+    uint64_t key = packChunkCoord(region);
+
+    std::lock_guard lock { mutex };
+
+    auto it = regions.find(key);
+    if (it != regions.end()) {
+        it->second.second = ++useCounter;
+        return it->second.first;
+    }
+
+    // two instances of one file would each keep their own offsets and sectors, a file still in use is reused
+    std::shared_ptr<RegionFile> file;
+    auto evicted = evictedRegions.find(key);
+    if (evicted != evictedRegions.end()) {
+        file = evicted->second.lock();
+        evictedRegions.erase(evicted);
+    }
+
+    if (file == nullptr) {
+        if (!create && missingRegions.contains(key)) {
+            return nullptr;
+        }
+
+        std::filesystem::path path = regionPath(region);
+
+        std::error_code error;
+        if (!create && !std::filesystem::exists(path, error)) {
+            missingRegions.insert(key);
+            return nullptr;
+        }
+
+        if (create) {
+            std::filesystem::create_directories(directory, error);
+            missingRegions.erase(key);
+        }
+
+        file = std::make_shared<RegionFile>(path);
+    }
+
+    // files still in use elsewhere stay open until their last reader is done
+    if (regions.size() >= maxOpenRegions) {
+        auto oldest = std::min_element(regions.begin(), regions.end(), [](const auto& a, const auto& b) {
+            return a.second.second < b.second.second;
+        });
+
+        if (oldest->second.first.use_count() > 1) {
+            evictedRegions[oldest->first] = oldest->second.first;
+        }
+        regions.erase(oldest);
+
+        std::erase_if(evictedRegions, [](const auto& entry) { return entry.second.expired(); });
+    }
+
+    regions.emplace(key, std::make_pair(file, ++useCounter));
+    return file;
+}
+
+std::unique_ptr<Chunk> RegionStore::load(const ChunkCoord& coord)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<RegionFile> region;
+    try {
+        region = openRegion(chunkToRegion(coord), false);
+    } catch (const std::runtime_error& error) {
+        if (DEBUG_MODE) {
+            std::cout << error.what() << "\n";
+        }
+        return nullptr;
+    }
+
+    if (region == nullptr) {
+        return nullptr;
+    }
+
+    size_t payloadSize { 0 };
+    std::unique_ptr<Chunk> chunk = region->read(regionSlot(coord), &payloadSize);
+
+    if (chunk != nullptr) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        chunksRead++;
+        bytesRead += payloadSize;
+        readTime += static_cast<uint64_t>(elapsed.count());
+    }
+
+    return chunk;
+}
+
+void RegionStore::enableAsync(AsyncIo& service, uint32_t stagingSlots, uint32_t slotSize)
+{
+    io = &service;
+    stagingSlotSize = slotSize;
+    staging.assign(size_t(stagingSlots) * slotSize, 0);
+
+    freeStagingSlots.clear();
+    for (uint32_t i { stagingSlots }; i > 0; i--) {
+        freeStagingSlots.push_back(i - 1);
+    }
+
+    io->registerBuffers({ { staging.data(), staging.size() } });
+}
+
+bool RegionStore::loadAsync(const ChunkCoord& coord, std::function<void(std::unique_ptr<Chunk> chunk)> done)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<RegionFile> region;
+    try {
+        region = openRegion(chunkToRegion(coord), false);
+    } catch (const std::runtime_error& error) {
+        if (DEBUG_MODE) {
+            std::cout << error.what() << "\n";
+        }
+        return false;
+    }
+
+    uint32_t slot = regionSlot(coord);
+    RegionFile::Entry entry;
+    if (region == nullptr || !region->locate(slot, entry)) {
+        return false;
+    }
+
+    uint32_t file = io == nullptr ? AsyncIo::INVALID_FILE : region->getIoFile(*io);
+    if (file == AsyncIo::INVALID_FILE) {
+        done(load(coord));
+        return true;
+    }
+
+    int32_t stagingSlot { -1 };
+    if (entry.size <= stagingSlotSize) {
+        std::lock_guard lock { stagingMutex };
+        if (!freeStagingSlots.empty()) {
+            stagingSlot = int32_t(freeStagingSlots.back());
+            freeStagingSlots.pop_back();
+        }
+    }
+
+    std::shared_ptr<std::vector<uint8_t>> buffer;
+    void* destination;
+    if (stagingSlot >= 0) {
+        destination = staging.data() + size_t(stagingSlot) * stagingSlotSize;
+    } else {
+        buffer = std::make_shared<std::vector<uint8_t>>(entry.size);
+        destination = buffer->data();
+    }
+
+    ReadRequest request;
+    request.file = file;
+    request.offset = uint64_t(entry.sector) * REGION_SECTOR_SIZE;
+    request.size = entry.size;
+    request.destination = destination;
+    request.buffer = stagingSlot >= 0 ? 0 : -1;
+    request.callback = [this, region, slot, entry, stagingSlot, buffer, start, done = std::move(done)](const ReadResult& result) {
+        std::unique_ptr<Chunk> chunk;
+        if (result.error == 0) {
+            chunk = RegionFile::decodePayload(entry, result.data, result.size);
+        }
+
+        if (stagingSlot >= 0) {
+            std::lock_guard lock { stagingMutex };
+            freeStagingSlots.push_back(uint32_t(stagingSlot));
+        }
+
+        // a save may have relocated the chunk while it was read, the mapping has the current table
+        size_t payloadSize { entry.size };
+        if (chunk == nullptr) {
+            chunk = region->read(slot, &payloadSize);
+        }
+
+        if (chunk != nullptr) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            chunksRead++;
+            bytesRead += payloadSize;
+            readTime += static_cast<uint64_t>(elapsed.count());
+        }
+
+        done(std::move(chunk));
+    };
+
+    io->read(std::move(request));
+    return true;
+}
+
+void RegionStore::save(const std::vector<std::pair<ChunkCoord, const Chunk*>>& chunks)
+{
+    std::unordered_map<uint64_t, std::vector<std::pair<uint32_t, const Chunk*>>> batches;
+    for (const auto& [coord, chunk] : chunks) {
+        batches[packChunkCoord(chunkToRegion(coord))].emplace_back(regionSlot(coord), chunk);
+    }
+
+    for (const auto& [key, batch] : batches) {
+        std::shared_ptr<RegionFile> region = openRegion(unpackChunkCoord(key), true);
+
+        bytesWritten += region->write(batch);
+        chunksWritten += batch.size();
+    }
+}
+
+uint64_t RegionStore::getDiskUsage() const
+{
+    uint64_t total { 0 };
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".vkr") {
+            total += entry.file_size(error);
+        }
+    }
+
+    return total;
+}
+
+RegionStore::Stats RegionStore::getStats() const
+{
+    return { chunksRead.load(), bytesRead.load(), readTime.load(), chunksWritten.load(), bytesWritten.load() };
+}
+
+}
@@ -3,11 +3,149 @@
 namespace VoKel {
 
 Scene::Scene()
+    : regions { "world" }
+    , light { world, jobs }
+    , raycaster { world, jobs }
+    , brickMap { world, jobs }
+    , visibility { world, jobs }
+    , streamer { world, jobs }
+    , lod { world, jobs }
 {
     for (float x = -1.0f; x < 1.0f; x += 0.2f) {
         for (float y = -1.0f; y < 1.0f; y += 0.2f) {
-            trianglePositions.push_back(glm::vec3(x, y, 0.0f));
+            EntityId triangle = entities.create(COMPONENT_BOUNDS | COMPONENT_MESH, glm::vec3(x, y, 0.0f));
+            entities.setBounds(triangle, glm::vec3 { -0.05f, -0.05f, 0.0f }, glm::vec3 { 0.05f, 0.05f, 0.0f });
         }
     }
+
+    world.setGenerator([this](Chunk& chunk, const ChunkCoord& coord, uint32_t level) {
+        terrain.generate(chunk, coord, level);
+    });
+
+    // saved chunks win over the generator, only edited chunks are ever written back
+    world.setLoader([this](const ChunkCoord& coord) {
+        return regions.load(coord);
+    });
+
+    light.setEmission(MATERIAL_LAMP, MAX_LIGHT_LEVEL);
+
+    world.setChunkHandler([this](const ChunkCoord& coord, const Chunk* chunk) {
+        if (chunk != nullptr) {
+            light.chunkInserted(coord);
+        } else {
+            light.chunkRemoved(coord);
+        }
+
+        raycaster.chunkChanged(coord);
+        brickMap.chunkChanged(coord);
+        visibility.chunkChanged(coord);
+    });
+
+    world.setEditHandler([this](const glm::ivec3& voxel, Voxel previous, Voxel value) {
+        light.voxelChanged(voxel, previous, value);
+        raycaster.voxelChanged(voxel);
+        brickMap.voxelChanged(voxel);
+        visibility.voxelChanged(voxel);
+    });
+
+    lod.setLightLookup([this](const ChunkCoord& coord) {
+        return light.getLevels(coord);
+    });
+
+    lod.setDensitySource([this](DensityField& field, const ChunkCoord& coord, uint32_t level) {
+        terrain.generateDensity(field, coord, level);
+    });
+
+    regions.enableAsync(io);
+    streamer.setAsyncLoader([this](const ChunkCoord& coord, std::function<void(std::unique_ptr<Chunk>)> done) {
+        return regions.loadAsync(coord, std::move(done));
+    });
+
+    streamer.setUnloadHandler([this](const ChunkCoord& coord, std::unique_ptr<Chunk> chunk) {
+        if (world.takeUnsaved(coord)) {
+            unsavedChunks.emplace_back(coord, std::move(chunk));
+        }
+    });
+}
+
+Scene::~Scene()
+{
+    streamer.unloadAll();
+    saveUnloadedChunks();
+}
+
+void Scene::update()
+{
+    streamer.update(camera.position, camera.forward());
+    saveUnloadedChunks();
+
+    // light only shows on full resolution meshes
+    light.update();
+    lod.invalidateChunks(light.takeChangedChunks(), 1);
+
+    raycaster.update();
+    brickMap.update(camera.position);
+    visibility.update();
+
+    lod.update(camera.position);
+
+    entities.update(jobs);
+    updateObjects();
+}
+
+void Scene::updateObjects()
+{
+    const BoundsList& bounds = entities.getInstanceBounds();
+    auto boundsOf = [&bounds](uint32_t instance) {
+        return std::pair {
+            glm::vec3 { bounds.getMin(0)[instance], bounds.getMin(1)[instance], bounds.getMin(2)[instance] },
+            glm::vec3 { bounds.getMax(0)[instance], bounds.getMax(1)[instance], bounds.getMax(2)[instance] },
+        };
+    };
+
+    // removals left the last instances in the holes
+    while (objectLeaves.size() > bounds.size()) {
+        objects.remove(objectLeaves.back());
+        objectLeaves.pop_back();
+    }
+
+    if (entities.getRevision() != objectRevision) {
+        for (uint32_t instance : entities.getChangedInstances()) {
+            if (instance < objectLeaves.size()) {
+                auto [min, max] = boundsOf(instance);
+                objects.move(objectLeaves[instance], min, max);
+            }
+        }
+        objectRevision = entities.getRevision();
+    }
+
+    while (objectLeaves.size() < bounds.size()) {
+        auto [min, max] = boundsOf(static_cast<uint32_t>(objectLeaves.size()));
+        objectLeaves.push_back(objects.insert(min, max, static_cast<uint32_t>(objectLeaves.size())));
+    }
+
+    objects.optimize();
+}
+
+void Scene::saveUnloadedChunks()
+{
+    if (unsavedChunks.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<ChunkCoord, const Chunk*>> batch;
+    for (const auto& [coord, chunk] : unsavedChunks) {
+        batch.emplace_back(coord, chunk.get());
+    }
+
+    try {
+        regions.save(batch);
+    } catch (const std::runtime_error& error) {
+        if (DEBUG_MODE) {
+            std::cout << "Failed to save chunks: " << error.what() << "\n";
+        }
+    }
+
+    unsavedChunks.clear();
+}
 }
-}
\ No newline at end of file
@@ -117,7 +117,7 @@ vk::Extent2D chooseSwapchainExtent(const uint32_t width, const uint32_t height,
     }
 }
 
-SwapchainBundle createSwapchain(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const uint32_t width, const uint32_t height)
+SwapchainBundle createSwapchain(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, const vk::SurfaceKHR& surface, const uint32_t width, const uint32_t height, const uint32_t minImageCount)
 {
     SwapchainSupportDetails support = querySwapchainSupport(physicalDevice, surface);
 
@@ -125,9 +125,11 @@ SwapchainBundle createSwapchain(const vk::Device& device, const vk::PhysicalDevi
     vk::PresentModeKHR presentMode = chooseSwapchainPresentMode(support.presentModes);
     vk::Extent2D extent = chooseSwapchainExtent(width, height, support.capabilities);
 
-    uint32_t imageCount = std::min(
-        support.capabilities.maxImageCount,
-        support.capabilities.minImageCount + 1);
+    // a max image count of zero means there is no limit
+    uint32_t imageCount = std::max(support.capabilities.minImageCount + 1, minImageCount);
+    if (support.capabilities.maxImageCount > 0) {
+        imageCount = std::min(imageCount, support.capabilities.maxImageCount);
+    }
 
     vk::SwapchainCreateInfoKHR createInfo {
         vk::SwapchainCreateFlagsKHR(),
@@ -140,6 +142,11 @@ SwapchainBundle createSwapchain(const vk::Device& device, const vk::PhysicalDevi
         vk::ImageUsageFlagBits::eColorAttachment
     };
 
+    // the raymarcher blits its output into the swapchain images
+    if (support.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) {
+        createInfo.imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
+    }
+
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
     uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
@@ -0,0 +1,179 @@
+#include "terrain_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+namespace VoKel {
+
+TerrainGenerator::TerrainGenerator(TerrainSettings settings, SimdLevel simdLevel)
+    : settings { settings }
+    , simdLevel { simdLevel }
+{
+}
+
+void TerrainGenerator::generate(Chunk& chunk, const ChunkCoord& coord, uint32_t lod) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    int step = 1 << lod;
+    float half = 0.5f * float(step);
+    glm::ivec3 origin = coord * (CHUNK_SIZE * step);
+
+    chunk.fill(AIR);
+
+    // surface height per column, sampled at the voxel centers
+    std::array<float, CHUNK_AREA> columnX, columnZ, heights;
+    for (int z { 0 }; z < CHUNK_SIZE; z++) {
+        for (int x { 0 }; x < CHUNK_SIZE; x++) {
+            columnX[z * CHUNK_SIZE + x] = float(origin.x + x * step) + half;
+            columnZ[z * CHUNK_SIZE + x] = float(origin.z + z * step) + half;
+        }
+    }
+
+    fbm2D(columnX.data(), columnZ.data(), heights.data(), CHUNK_AREA, settings.height, settings.seed, simdLevel);
+
+    float maxHeight { -1e30f };
+    for (float& height : heights) {
+        height = settings.baseHeight + settings.heightScale * height;
+        maxHeight = std::max(maxHeight, height);
+    }
+
+    float bottom = float(origin.y) + half;
+
+    if (maxHeight >= bottom) {
+        std::array<float, CHUNK_SIZE> rowX, rowY, rowZ, density;
+        for (int x { 0 }; x < CHUNK_SIZE; x++) {
+            rowX[x] = float(origin.x + x * step) + half;
+        }
+
+        uint32_t caveSeed = settings.seed ^ 0xa511e9b3u;
+
+        for (int y { 0 }; y < CHUNK_SIZE; y++) {
+            float worldY = float(origin.y + y * step) + half;
+            rowY.fill(worldY);
+
+            for (int z { 0 }; z < CHUNK_SIZE; z++) {
+                const float* rowHeights = &heights[z * CHUNK_SIZE];
+
+                if (std::none_of(rowHeights, rowHeights + CHUNK_SIZE, [worldY](float h) { return worldY <= h; })) {
+                    continue;
+                }
+
+                rowZ.fill(float(origin.z + z * step) + half);
+                fbm3D(rowX.data(), rowY.data(), rowZ.data(), density.data(), CHUNK_SIZE, settings.caves, caveSeed, simdLevel);
+
+                for (int x { 0 }; x < CHUNK_SIZE; x++) {
+                    float depth = rowHeights[x] - worldY;
+                    if (depth < 0.0f || density[x] > settings.caveThreshold) {
+                        continue;
+                    }
+
+                    Voxel material;
+                    if (depth < float(step)) {
+                        material = rowHeights[x] < settings.seaLevel + 2.0f ? MATERIAL_SAND : MATERIAL_GRASS;
+                    } else if (depth < 4.0f * float(step)) {
+                        material = rowHeights[x] < settings.seaLevel + 2.0f ? MATERIAL_SAND : MATERIAL_DIRT;
+                    } else {
+                        material = MATERIAL_STONE;
+                    }
+
+                    chunk.set(x, y, z, material);
+                }
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    generatedChunks.fetch_add(1, std::memory_order_relaxed);
+    generationTime.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+}
+
+void TerrainGenerator::generateDensity(DensityField& field, const ChunkCoord& coord, uint32_t lod) const
+{
+    auto start = std::chrono::steady_clock::now();
+
+    constexpr int SIZE { DensityField::SIZE };
+    constexpr int AREA { SIZE * SIZE };
+
+    int step = 1 << lod;
+    glm::ivec3 origin = coord * (CHUNK_SIZE * step);
+
+    thread_local std::vector<float> columnX(AREA), columnZ(AREA), heights(AREA);
+    for (int z { 0 }; z < SIZE; z++) {
+        for (int x { 0 }; x < SIZE; x++) {
+            columnX[z * SIZE + x] = float(origin.x + (x + DensityField::MIN) * step);
+            columnZ[z * SIZE + x] = float(origin.z + (z + DensityField::MIN) * step);
+        }
+    }
+
+    fbm2D(columnX.data(), columnZ.data(), heights.data(), AREA, settings.height, settings.seed, simdLevel);
+
+    for (float& height : heights) {
+        height = settings.baseHeight + settings.heightScale * height;
+    }
+
+    // caves are only sampled below the surface, a whole slice at a time
+    thread_local std::vector<float> caveX(AREA), caveY(AREA), caveZ(AREA), caves(AREA);
+    thread_local std::vector<int> caveSlots(AREA);
+    uint32_t caveSeed = settings.seed ^ 0xa511e9b3u;
+
+    for (int y { 0 }; y < SIZE; y++) {
+        float worldY = float(origin.y + (y + DensityField::MIN) * step);
+        float* density = &field.density[y * AREA];
+        Voxel* material = &field.material[y * AREA];
+
+        size_t count { 0 };
+        for (int i { 0 }; i < AREA; i++) {
+            density[i] = heights[i] - worldY;
+            if (density[i] >= 0.0f) {
+                caveX[count] = columnX[i];
+                caveZ[count] = columnZ[i];
+                caveSlots[count++] = i;
+            }
+        }
+
+        if (count > 0) {
+            std::fill_n(caveY.begin(), count, worldY);
+            fbm3D(caveX.data(), caveY.data(), caveZ.data(), caves.data(), count, settings.caves, caveSeed, simdLevel);
+
+            for (size_t k { 0 }; k < count; k++) {
+                float& value = density[caveSlots[k]];
+                value = std::min(value, (settings.caveThreshold - caves[k]) / settings.caves.frequency);
+            }
+        }
+
+        for (int i { 0 }; i < AREA; i++) {
+            float depth = heights[i] - worldY;
+            bool beach = heights[i] < settings.seaLevel + 2.0f;
+
+            if (density[i] <= 0.0f) {
+                material[i] = AIR;
+            } else if (depth < float(step)) {
+                material[i] = beach ? MATERIAL_SAND : MATERIAL_GRASS;
+            } else if (depth < 4.0f * float(step)) {
+                material[i] = beach ? MATERIAL_SAND : MATERIAL_DIRT;
+            } else {
+                material[i] = MATERIAL_STONE;
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    generatedChunks.fetch_add(1, std::memory_order_relaxed);
+    generationTime.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+}
+
+std::vector<std::unique_ptr<Chunk>> TerrainGenerator::generateChunks(JobSystem& jobs, const std::vector<ChunkCoord>& coords, uint32_t lod) const
+{
+    std::vector<std::unique_ptr<Chunk>> chunks(coords.size());
+
+    jobs.parallelFor(static_cast<uint32_t>(coords.size()), [&](uint32_t i) {
+        chunks[i] = std::make_unique<Chunk>();
+        generate(*chunks[i], coords[i], lod);
+    });
+
+    return chunks;
+}
+
+}
@@ -0,0 +1,264 @@
+#include "tlsf_allocator.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace VoKel {
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity)
+{
+    for (auto& lists : freeLists) {
+        lists.fill(NO_ALLOCATION);
+    }
+
+    grow(capacity);
+}
+
+void TlsfAllocator::mapping(uint64_t size, int& firstLevel, int& secondLevel)
+{
+    if (size < SECOND_LEVEL_COUNT) {
+        firstLevel = 0;
+        secondLevel = static_cast<int>(size);
+        return;
+    }
+
+    int log = 63 - std::countl_zero(size);
+    firstLevel = log - SECOND_LEVEL_BITS + 1;
+    secondLevel = static_cast<int>(size >> (log - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+}
+
+uint32_t TlsfAllocator::newBlock()
+{
+    if (unusedBlocks != NO_ALLOCATION) {
+        uint32_t block = unusedBlocks;
+        unusedBlocks = blocks[block].nextFree;
+        return block;
+    }
+
+    blocks.push_back({});
+    return static_cast<uint32_t>(blocks.size() - 1);
+}
+
+void TlsfAllocator::recycleBlock(uint32_t block)
+{
+    blocks[block].nextFree = unusedBlocks;
+    unusedBlocks = block;
+}
+
+uint32_t TlsfAllocator::split(uint32_t block, uint64_t size)
+{
+    uint32_t rest = newBlock();
+
+    Block& original = blocks[block];
+    blocks[rest] = { original.offset + size, original.size - size, block, original.next, NO_ALLOCATION, NO_ALLOCATION, true };
+
+    if (original.next != NO_ALLOCATION) {
+        blocks[original.next].previous = rest;
+    } else {
+        lastBlock = rest;
+    }
+
+    original.size = size;
+    original.next = rest;
+    return rest;
+}
+
+void TlsfAllocator::merge(uint32_t block)
+{
+    uint32_t next = blocks[block].next;
+
+    blocks[block].size += blocks[next].size;
+    blocks[block].next = blocks[next].next;
+
+    if (blocks[next].next != NO_ALLOCATION) {
+        blocks[blocks[next].next].previous = block;
+    } else {
+        lastBlock = block;
+    }
+
+    recycleBlock(next);
+}
+
+void TlsfAllocator::insertFree(uint32_t block)
+{
+    int firstLevel, secondLevel;
+    mapping(blocks[block].size, firstLevel, secondLevel);
+
+    uint32_t& head = freeLists[firstLevel][secondLevel];
+    blocks[block].free = true;
+    blocks[block].previousFree = NO_ALLOCATION;
+    blocks[block].nextFree = head;
+    if (head != NO_ALLOCATION) {
+        blocks[head].previousFree = block;
+    }
+    head = block;
+
+    firstLevelBitmap |= 1ull << firstLevel;
+    secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::removeFree(uint32_t block)
+{
+    int firstLevel, secondLevel;
+    mapping(blocks[block].size, firstLevel, secondLevel);
+
+    Block& entry = blocks[block];
+    if (entry.previousFree != NO_ALLOCATION) {
+        blocks[entry.previousFree].nextFree = entry.nextFree;
+    } else {
+        freeLists[firstLevel][secondLevel] = entry.nextFree;
+    }
+    if (entry.nextFree != NO_ALLOCATION) {
+        blocks[entry.nextFree].previousFree = entry.previousFree;
+    }
+
+    if (freeLists[firstLevel][secondLevel] == NO_ALLOCATION) {
+        secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (secondLevelBitmaps[firstLevel] == 0) {
+            firstLevelBitmap &= ~(1ull << firstLevel);
+        }
+    }
+
+    entry.free = false;
+}
+
+uint32_t TlsfAllocator::findFree(uint64_t size) const
+{
+    // rounded up to the next class, every range in it or above fits
+    if (size >= SECOND_LEVEL_COUNT) {
+        int log = 63 - std::countl_zero(size);
+        size += (1ull << (log - SECOND_LEVEL_BITS)) - 1;
+    }
+
+    int firstLevel, secondLevel;
+    mapping(size, firstLevel, secondLevel);
+
+    uint32_t secondLevelMap = secondLevel < SECOND_LEVEL_COUNT ? secondLevelBitmaps[firstLevel] & (~0u << secondLevel) : 0;
+    if (secondLevelMap == 0) {
+        uint64_t firstLevelMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0) {
+            return NO_ALLOCATION;
+        }
+
+        firstLevel = std::countr_zero(firstLevelMap);
+        secondLevelMap = secondLevelBitmaps[firstLevel];
+    }
+
+    return freeLists[firstLevel][std::countr_zero(secondLevelMap)];
+}
+
+uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+    size = std::max<uint64_t>(size, 1);
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    uint32_t block = findFree(size + alignment - 1);
+    if (block == NO_ALLOCATION) {
+        return NO_ALLOCATION;
+    }
+
+    removeFree(block);
+
+    // the padding in front stays free, its previous neighbor is never free
+    uint64_t padding = (alignment - blocks[block].offset % alignment) % alignment;
+    if (padding > 0) {
+        uint32_t aligned = split(block, padding);
+        insertFree(block);
+        block = aligned;
+    }
+
+    if (blocks[block].size > size) {
+        insertFree(split(block, size));
+    }
+
+    blocks[block].free = false;
+    used += size;
+    return block;
+}
+
+void TlsfAllocator::free(uint32_t allocation)
+{
+    uint32_t block = allocation;
+    used -= blocks[block].size;
+
+    uint32_t next = blocks[block].next;
+    if (next != NO_ALLOCATION && blocks[next].free) {
+        removeFree(next);
+        merge(block);
+    }
+
+    uint32_t previous = blocks[block].previous;
+    if (previous != NO_ALLOCATION && blocks[previous].free) {
+        removeFree(previous);
+        merge(previous);
+        block = previous;
+    }
+
+    insertFree(block);
+}
+
+void TlsfAllocator::grow(uint64_t newCapacity)
+{
+    if (newCapacity <= capacity) {
+        return;
+    }
+
+    uint64_t extra = newCapacity - capacity;
+
+    if (lastBlock != NO_ALLOCATION && blocks[lastBlock].free) {
+        uint32_t block = lastBlock;
+        removeFree(block);
+        blocks[block].size += extra;
+        insertFree(block);
+    } else {
+        uint32_t block = newBlock();
+        blocks[block] = { capacity, extra, lastBlock, NO_ALLOCATION, NO_ALLOCATION, NO_ALLOCATION, true };
+
+        if (lastBlock != NO_ALLOCATION) {
+            blocks[lastBlock].next = block;
+        }
+        lastBlock = block;
+        insertFree(block);
+    }
+
+    capacity = newCapacity;
+}
+
+uint64_t TlsfAllocator::getLargestFreeSize() const
+{
+    if (firstLevelBitmap == 0) {
+        return 0;
+    }
+
+    // the largest range sits in the highest class, which is not sorted
+    int firstLevel = 63 - std::countl_zero(firstLevelBitmap);
+    int secondLevel = 31 - std::countl_zero(secondLevelBitmaps[firstLevel]);
+
+    uint64_t largest { 0 };
+    for (uint32_t block { freeLists[firstLevel][secondLevel] }; block != NO_ALLOCATION; block = blocks[block].nextFree) {
+        largest = std::max(largest, blocks[block].size);
+    }
+    return largest;
+}
+
+float TlsfAllocator::getFragmentation() const
+{
+    uint64_t free = capacity - used;
+    if (free == 0) {
+        return 0.0f;
+    }
+
+    return 1.0f - float(double(getLargestFreeSize()) / double(free));
+}
+
+uint32_t TlsfAllocator::getLastAllocation() const
+{
+    // free neighbors are always merged, at most one free range ends the list
+    uint32_t block = lastBlock;
+    if (block != NO_ALLOCATION && blocks[block].free) {
+        block = blocks[block].previous;
+    }
+    return block;
+}
+
+}
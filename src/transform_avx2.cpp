@@ -0,0 +1,37 @@
+// built with -mavx2, only reached when the cpu reports AVX2 (see CMakeLists.txt)
+#include "transform_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <immintrin.h>
+
+namespace VoKel {
+
+namespace transform {
+
+    namespace {
+
+        struct Avx2Ops {
+            using F = __m256;
+            static constexpr size_t WIDTH { 8 };
+
+            static F load(const float* p) { return _mm256_loadu_ps(p); }
+            static void store(float* p, F a) { _mm256_storeu_ps(p, a); }
+            static F set(float v) { return _mm256_set1_ps(v); }
+            static F add(F a, F b) { return _mm256_add_ps(a, b); }
+            static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+            static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        };
+
+    }
+
+    void composeTransformsAvx2(const TransformBatch& batch)
+    {
+        runComposeTransforms<Avx2Ops>(batch);
+    }
+
+}
+
+}
+
+#endif
@@ -0,0 +1,37 @@
+// built with -msse4.1, only reached when the cpu reports SSE4.1 (see CMakeLists.txt)
+#include "transform_kernel.hpp"
+
+#if VOKEL_X86
+
+#include <smmintrin.h>
+
+namespace VoKel {
+
+namespace transform {
+
+    namespace {
+
+        struct Sse4Ops {
+            using F = __m128;
+            static constexpr size_t WIDTH { 4 };
+
+            static F load(const float* p) { return _mm_loadu_ps(p); }
+            static void store(float* p, F a) { _mm_storeu_ps(p, a); }
+            static F set(float v) { return _mm_set1_ps(v); }
+            static F add(F a, F b) { return _mm_add_ps(a, b); }
+            static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+            static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+        };
+
+    }
+
+    void composeTransformsSse4(const TransformBatch& batch)
+    {
+        runComposeTransforms<Sse4Ops>(batch);
+    }
+
+}
+
+}
+
+#endif
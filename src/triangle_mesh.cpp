@@ -18,7 +18,7 @@ TriangleMesh::TriangleMesh(vk::Device device, vk::PhysicalDevice physicalDevice)
     bufferInput.device = device;
     bufferInput.physicalDevice = physicalDevice;
     bufferInput.size = sizeof(float) * vertices.size();
-    bufferInput.usage = vk::BufferUsageFlagBits::eVertexBuffer;
+    bufferInput.usage = vk::BufferUsageFlagBits::eStorageBuffer;
 
     buffer = vkUtil::createBuffer(bufferInput);
 
@@ -0,0 +1,524 @@
+#include "vox_file.hpp"
+
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <unordered_map>
+
+namespace VoKel {
+
+namespace {
+
+    constexpr uint32_t chunkId(const char (&id)[5])
+    {
+        return uint32_t(uint8_t(id[0])) | uint32_t(uint8_t(id[1])) << 8 | uint32_t(uint8_t(id[2])) << 16 | uint32_t(uint8_t(id[3])) << 24;
+    }
+
+    // nodes are small, anything bigger than this is a damaged file
+    constexpr uint32_t MAX_CHUNK_CONTENT { 64 << 20 };
+
+    // deeper scene graphs are treated as cycles
+    constexpr int MAX_NODE_DEPTH { 64 };
+
+    std::runtime_error malformed(const std::string& reason)
+    {
+        return std::runtime_error { "Malformed .vox file: " + reason };
+    }
+
+    // bounds checked little endian reads over a chunk's content
+    class Reader {
+    public:
+        Reader(const std::vector<uint8_t>& data)
+            : data { data }
+        {
+        }
+
+        int32_t readInt()
+        {
+            need(4);
+            uint32_t value { 0 };
+            for (int i { 0 }; i < 4; i++) {
+                value |= uint32_t(data[position++]) << (i * 8);
+            }
+            return int32_t(value);
+        }
+
+        std::string readString()
+        {
+            int32_t length = readInt();
+            if (length < 0) {
+                throw malformed("negative string length");
+            }
+            need(size_t(length));
+            std::string value(reinterpret_cast<const char*>(data.data() + position), size_t(length));
+            position += size_t(length);
+            return value;
+        }
+
+        std::unordered_map<std::string, std::string> readDict()
+        {
+            std::unordered_map<std::string, std::string> dict;
+            int32_t count = readInt();
+            for (int32_t i { 0 }; i < count; i++) {
+                std::string key = readString();
+                dict[key] = readString();
+            }
+            return dict;
+        }
+
+    private:
+        const std::vector<uint8_t>& data;
+        size_t position { 0 };
+
+        void need(size_t bytes)
+        {
+            if (data.size() - position < bytes) {
+                throw malformed("chunk content too short");
+            }
+        }
+    };
+
+    struct Node {
+        enum class Type {
+            Transform,
+            Group,
+            Shape
+        } type;
+
+        bool hidden;
+
+        // transforms
+        int32_t child;
+        int32_t layer;
+        uint8_t rotation;
+        glm::ivec3 translation;
+
+        // groups and shapes, child nodes or models
+        std::vector<int32_t> children;
+    };
+
+    bool isHidden(const std::unordered_map<std::string, std::string>& attributes)
+    {
+        auto it = attributes.find("_hidden");
+        return it != attributes.end() && it->second == "1";
+    }
+
+    std::array<glm::ivec3, 3> decodeRotation(uint8_t bits)
+    {
+        int first = bits & 3;
+        int second = (bits >> 2) & 3;
+        if (first > 2 || second > 2 || first == second) {
+            throw malformed("invalid rotation");
+        }
+        int third = 3 - first - second;
+
+        std::array<glm::ivec3, 3> rows {};
+        rows[0][first] = (bits & 0x10) ? -1 : 1;
+        rows[1][second] = (bits & 0x20) ? -1 : 1;
+        rows[2][third] = (bits & 0x40) ? -1 : 1;
+        return rows;
+    }
+
+    // the _r attribute of a transform frame, seven bits of which the first two pairs pick distinct axes
+    uint8_t parseRotation(const std::string& text)
+    {
+        unsigned value { 0 };
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc {} || end != text.data() + text.size() || value > 0x7f) {
+            throw malformed("invalid rotation");
+        }
+
+        decodeRotation(uint8_t(value));
+        return uint8_t(value);
+    }
+
+    glm::ivec3 rotate(const std::array<glm::ivec3, 3>& rows, const glm::ivec3& vector)
+    {
+        glm::ivec3 rotated;
+        for (int r { 0 }; r < 3; r++) {
+            rotated[r] = rows[r].x * vector.x + rows[r].y * vector.y + rows[r].z * vector.z;
+        }
+        return rotated;
+    }
+
+    std::array<glm::ivec3, 3> combine(const std::array<glm::ivec3, 3>& parent, const std::array<glm::ivec3, 3>& child)
+    {
+        std::array<glm::ivec3, 3> rows {};
+        for (int r { 0 }; r < 3; r++) {
+            for (int c { 0 }; c < 3; c++) {
+                rows[r][c] = parent[r].x * child[0][c] + parent[r].y * child[1][c] + parent[r].z * child[2][c];
+            }
+        }
+        return rows;
+    }
+
+    // base colors of the material textures, see generateMaterialTexture, 0 is air and never matched
+    constexpr std::array<std::array<float, 3>, 6> MATERIAL_COLORS { {
+        { 1.0f, 0.0f, 1.0f },
+        { 0.36f, 0.62f, 0.25f },
+        { 0.47f, 0.33f, 0.22f },
+        { 0.5f, 0.5f, 0.52f },
+        { 0.86f, 0.8f, 0.58f },
+        { 1.0f, 0.85f, 0.55f },
+    } };
+
+    struct Placed {
+        uint64_t chunk;
+        // local voxel index | material << CHUNK_SIZE_LOG2 * 3
+        uint32_t voxel;
+    };
+
+}
+
+VoxFile::VoxFile(const std::filesystem::path& path)
+    : file { path, std::ios::binary }
+{
+    if (!file.is_open()) {
+        throw std::runtime_error { "Failed to open file \"" + path.string() + "\"" };
+    }
+
+    file.seekg(0, std::ios::end);
+    fileSize = uint64_t(file.tellg());
+    file.seekg(0);
+
+    for (int i { 1 }; i < 256; i++) {
+        uint32_t grey = uint32_t(i);
+        palette[i] = grey | grey << 8 | grey << 16 | 0xff000000u;
+    }
+    palette[0] = 0;
+
+    auto readHeader = [this](uint64_t position, uint32_t* words, int count) {
+        if (position + uint64_t(count) * 4 > fileSize) {
+            throw malformed("truncated file");
+        }
+        uint8_t bytes[12];
+        file.seekg(std::streamoff(position));
+        file.read(reinterpret_cast<char*>(bytes), count * 4);
+        for (int i { 0 }; i < count; i++) {
+            words[i] = uint32_t(bytes[i * 4]) | uint32_t(bytes[i * 4 + 1]) << 8 | uint32_t(bytes[i * 4 + 2]) << 16 | uint32_t(bytes[i * 4 + 3]) << 24;
+        }
+    };
+
+    uint32_t words[3];
+    readHeader(0, words, 2);
+    if (words[0] != chunkId("VOX ")) {
+        throw malformed("missing VOX header");
+    }
+
+    readHeader(8, words, 3);
+    if (words[0] != chunkId("MAIN")) {
+        throw malformed("missing MAIN chunk");
+    }
+
+    uint64_t position = 20 + uint64_t(words[1]);
+    uint64_t end = position + uint64_t(words[2]);
+    if (end > fileSize) {
+        throw malformed("truncated file");
+    }
+
+    std::unordered_map<int32_t, Node> nodes;
+    std::unordered_map<int32_t, bool> hiddenLayers;
+    glm::ivec3 size { 0 };
+    bool hasSize { false };
+    std::vector<uint8_t> content;
+
+    while (position + 12 <= end) {
+        readHeader(position, words, 3);
+        uint32_t id = words[0];
+        uint64_t contentStart = position + 12;
+        uint64_t next = contentStart + uint64_t(words[1]) + uint64_t(words[2]);
+        if (next > end) {
+            throw malformed("chunk runs past the end of the file");
+        }
+
+        if (id == chunkId("XYZI")) {
+            uint32_t count;
+            readHeader(contentStart, &count, 1);
+            if (!hasSize || uint64_t(count) * 4 + 4 > words[1]) {
+                throw malformed("voxel chunk without size or too short");
+            }
+            models.push_back({ size, contentStart + 4, count });
+            hasSize = false;
+            position = next;
+            continue;
+        }
+
+        bool parsed = id == chunkId("SIZE") || id == chunkId("RGBA") || id == chunkId("nTRN") || id == chunkId("nGRP") || id == chunkId("nSHP") || id == chunkId("LAYR");
+        if (!parsed) {
+            position = next;
+            continue;
+        }
+
+        if (words[1] > MAX_CHUNK_CONTENT) {
+            throw malformed("oversized chunk");
+        }
+        content.resize(words[1]);
+        file.seekg(std::streamoff(contentStart));
+        file.read(reinterpret_cast<char*>(content.data()), std::streamsize(content.size()));
+        Reader reader { content };
+
+        if (id == chunkId("SIZE")) {
+            size.x = reader.readInt();
+            size.y = reader.readInt();
+            size.z = reader.readInt();
+            if (size.x <= 0 || size.y <= 0 || size.z <= 0 || size.x > 256 || size.y > 256 || size.z > 256) {
+                throw malformed("invalid model size");
+            }
+            hasSize = true;
+        } else if (id == chunkId("RGBA")) {
+            // entry i of the chunk is color index i + 1
+            for (int i { 1 }; i < 256; i++) {
+                palette[i] = uint32_t(reader.readInt());
+            }
+        } else if (id == chunkId("LAYR")) {
+            int32_t layer = reader.readInt();
+            hiddenLayers[layer] = isHidden(reader.readDict());
+        } else {
+            int32_t nodeId = reader.readInt();
+            Node node {};
+            node.hidden = isHidden(reader.readDict());
+            node.rotation = 0x04;
+
+            if (id == chunkId("nTRN")) {
+                node.type = Node::Type::Transform;
+                node.child = reader.readInt();
+                reader.readInt();
+                node.layer = reader.readInt();
+
+                // first frame only
+                if (reader.readInt() > 0) {
+                    auto frame = reader.readDict();
+                    if (auto it = frame.find("_r"); it != frame.end()) {
+                        node.rotation = parseRotation(it->second);
+                    }
+                    if (auto it = frame.find("_t"); it != frame.end()) {
+                        std::istringstream translation { it->second };
+                        translation >> node.translation.x >> node.translation.y >> node.translation.z;
+                    }
+                }
+            } else if (id == chunkId("nGRP")) {
+                node.type = Node::Type::Group;
+                int32_t count = reader.readInt();
+                for (int32_t i { 0 }; i < count; i++) {
+                    node.children.push_back(reader.readInt());
+                }
+            } else {
+                node.type = Node::Type::Shape;
+                int32_t count = reader.readInt();
+                for (int32_t i { 0 }; i < count; i++) {
+                    node.children.push_back(reader.readInt());
+                    reader.readDict();
+                }
+            }
+
+            nodes[nodeId] = std::move(node);
+        }
+
+        position = next;
+    }
+
+    if (nodes.empty()) {
+        for (uint32_t model { 0 }; model < models.size(); model++) {
+            instances.push_back({ model, decodeRotation(0x04), models[model].size / 2 });
+        }
+        return;
+    }
+
+    std::function<void(int32_t, const std::array<glm::ivec3, 3>&, const glm::ivec3&, int)> visit;
+    visit = [&](int32_t id, const std::array<glm::ivec3, 3>& rotation, const glm::ivec3& translation, int depth) {
+        auto it = nodes.find(id);
+        if (it == nodes.end()) {
+            throw malformed("missing scene node");
+        }
+        if (depth > MAX_NODE_DEPTH) {
+            throw malformed("scene graph too deep");
+        }
+
+        const Node& node = it->second;
+        if (node.hidden) {
+            return;
+        }
+
+        switch (node.type) {
+        case Node::Type::Transform: {
+            auto layer = hiddenLayers.find(node.layer);
+            if (layer != hiddenLayers.end() && layer->second) {
+                return;
+            }
+            visit(node.child, combine(rotation, decodeRotation(node.rotation)), translation + rotate(rotation, node.translation), depth + 1);
+            break;
+        }
+        case Node::Type::Group:
+            for (int32_t child : node.children) {
+                visit(child, rotation, translation, depth + 1);
+            }
+            break;
+        case Node::Type::Shape:
+            for (int32_t model : node.children) {
+                if (model < 0 || size_t(model) >= models.size()) {
+                    throw malformed("shape refers to a missing model");
+                }
+                instances.push_back({ uint32_t(model), rotation, translation });
+            }
+            break;
+        }
+    };
+
+    visit(0, decodeRotation(0x04), glm::ivec3 { 0 }, 0);
+}
+
+void VoxFile::readVoxels(const Model& model, uint32_t first, uint32_t count, std::vector<uint32_t>& out)
+{
+    count = std::min(count, model.voxelCount - std::min(first, model.voxelCount));
+    out.resize(count);
+
+    file.seekg(std::streamoff(model.voxelOffset + uint64_t(first) * 4));
+    file.read(reinterpret_cast<char*>(out.data()), std::streamsize(count) * 4);
+    if (!file) {
+        throw malformed("truncated voxel data");
+    }
+
+    // stored little endian
+    if constexpr (std::endian::native == std::endian::big) {
+        for (uint32_t& voxel : out) {
+            voxel = (voxel >> 24) | ((voxel >> 8) & 0xff00u) | ((voxel << 8) & 0xff0000u) | (voxel << 24);
+        }
+    }
+}
+
+glm::ivec3 VoxFile::place(const Model& model, const Instance& instance, const glm::ivec3& voxel)
+{
+    // translations move the model's center, rounded down on odd sizes
+    glm::ivec3 position = instance.translation + rotate(instance.rotation, voxel - model.size / 2);
+    return { position.x, position.z, -position.y - 1 };
+}
+
+VoxImporter::VoxImporter(World& world, JobSystem& jobs)
+    : world { world }
+    , jobs { jobs }
+{
+}
+
+std::array<Voxel, 256> VoxImporter::matchPalette(const std::array<uint32_t, 256>& palette)
+{
+    std::array<Voxel, 256> matched {};
+
+    for (int i { 1 }; i < 256; i++) {
+        float color[3] { float(palette[i] & 0xff) / 255.0f, float((palette[i] >> 8) & 0xff) / 255.0f, float((palette[i] >> 16) & 0xff) / 255.0f };
+
+        float best { INFINITY };
+        for (size_t material { 1 }; material < MATERIAL_COLORS.size(); material++) {
+            float distance { 0.0f };
+            for (int c { 0 }; c < 3; c++) {
+                float delta = color[c] - MATERIAL_COLORS[material][c];
+                distance += delta * delta;
+            }
+            if (distance < best) {
+                best = distance;
+                matched[i] = Voxel(material);
+            }
+        }
+    }
+
+    return matched;
+}
+
+VoxImporter::Stats VoxImporter::import(const std::filesystem::path& path, const glm::ivec3& position)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    VoxFile vox { path };
+
+    Stats stats {};
+    stats.models = uint32_t(vox.getModels().size());
+    stats.instances = uint32_t(vox.getInstances().size());
+    stats.parseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.batchBytes = batchSize * (sizeof(uint32_t) + sizeof(Placed));
+
+    std::array<Voxel, 256> palette = customMaterials ? materials : matchPalette(vox.getPalette());
+
+    std::vector<uint32_t> raw;
+    std::vector<Placed> batch;
+    batch.reserve(batchSize);
+
+    auto flush = [&]() {
+        if (batch.empty()) {
+            return;
+        }
+
+        // later voxels win where instances overlap
+        std::stable_sort(batch.begin(), batch.end(), [](const Placed& a, const Placed& b) {
+            return a.chunk < b.chunk;
+        });
+
+        std::vector<ChunkCoord> coords;
+        std::vector<size_t> firsts;
+        for (size_t i { 0 }; i < batch.size(); i++) {
+            if (i == 0 || batch[i].chunk != batch[i - 1].chunk) {
+                coords.push_back(unpackChunkCoord(batch[i].chunk));
+                firsts.push_back(i);
+            }
+        }
+        firsts.push_back(batch.size());
+
+        world.editChunks(coords, jobs, [&](uint32_t index, Chunk& chunk) {
+            for (size_t i { firsts[index] }; i < firsts[index + 1]; i++) {
+                uint32_t voxel = batch[i].voxel;
+                chunk.setIndex(int(voxel & (CHUNK_VOLUME - 1)), Voxel(voxel >> (3 * CHUNK_SIZE_LOG2)));
+            }
+            chunk.compact();
+        });
+
+        stats.chunkEdits += coords.size();
+        batch.clear();
+    };
+
+    for (const VoxFile::Instance& instance : vox.getInstances()) {
+        const VoxFile::Model& model = vox.getModels()[instance.model];
+
+        for (uint32_t first { 0 }; first < model.voxelCount;) {
+            uint32_t count = uint32_t(std::min<size_t>(batchSize - batch.size(), model.voxelCount - first));
+            vox.readVoxels(model, first, count, raw);
+            first += count;
+
+            size_t offset = batch.size();
+            batch.resize(offset + count);
+
+            // placing is independent per voxel, split between the job threads in blocks
+            constexpr uint32_t PLACE_BLOCK { 4096 };
+            jobs.parallelFor((count + PLACE_BLOCK - 1) / PLACE_BLOCK, [&](uint32_t block) {
+                uint32_t end = std::min(count, (block + 1) * PLACE_BLOCK);
+                for (uint32_t i { block * PLACE_BLOCK }; i < end; i++) {
+                    uint32_t packed = raw[i];
+                    glm::ivec3 local { int(packed & 0xff), int((packed >> 8) & 0xff), int((packed >> 16) & 0xff) };
+                    glm::ivec3 voxel = position + VoxFile::place(model, instance, local);
+
+                    glm::ivec3 inChunk = worldToLocal(voxel);
+                    uint32_t index = uint32_t(Chunk::index(inChunk.x, inChunk.y, inChunk.z));
+                    batch[offset + i] = { packChunkCoord(worldToChunk(voxel)), index | uint32_t(palette[packed >> 24]) << (3 * CHUNK_SIZE_LOG2) };
+                }
+            });
+
+            stats.voxels += count;
+            if (batch.size() >= batchSize) {
+                flush();
+            }
+        }
+    }
+
+    flush();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (DEBUG_MODE) {
+        std::cout << "Imported " << path.string() << ": " << stats.voxels << " voxels of " << stats.instances << " instances into "
+                  << stats.chunkEdits << " chunk edits in " << stats.seconds * 1e3 << " ms\n";
+    }
+
+    return stats;
+}
+
+}
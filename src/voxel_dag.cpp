@@ -0,0 +1,607 @@
+#include "voxel_dag.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace VoKel {
+
+namespace {
+
+    // levels from the leaves up to a whole chunk
+    constexpr int CHUNK_LEVEL { CHUNK_SIZE_LOG2 - DAG_LEAF_SIZE_LOG2 };
+    constexpr int LEAVES_PER_AXIS { CHUNK_SIZE / DAG_LEAF_SIZE };
+
+    constexpr uint32_t NO_NODE { ~0u };
+
+    // chunks turned into subtrees per parallel pass, bounds the memory held by the subtrees
+    constexpr size_t BUILD_BATCH { 256 };
+
+    uint64_t hashWords(const uint32_t* words, size_t count)
+    {
+        uint64_t hash { 0x9e3779b97f4a7c15ull ^ count };
+        for (size_t i { 0 }; i < count; i++) {
+            hash = (hash ^ words[i]) * 0xff51afd7ed558ccdull;
+            hash ^= hash >> 32;
+        }
+        return hash;
+    }
+
+    size_t nodeLength(const uint32_t* node, bool leaf)
+    {
+        if (leaf) {
+            int solid = std::popcount(node[0]) + std::popcount(node[1]);
+            return 2 + size_t(solid + 3) / 4;
+        }
+        return 1 + size_t(std::popcount(node[0] & 0xffu));
+    }
+
+    // nodes of one level of the graph, every distinct node stored once
+    struct Level {
+        bool leaf { false };
+        std::vector<uint32_t> words;
+        std::unordered_multimap<uint64_t, uint32_t> lookup;
+        uint64_t nodes { 0 };
+
+        // word offset of the node within the level
+        uint32_t insert(const uint32_t* node, size_t length, uint64_t hash)
+        {
+            auto [begin, end] = lookup.equal_range(hash);
+            for (auto it = begin; it != end; ++it) {
+                const uint32_t* stored = words.data() + it->second;
+                if (nodeLength(stored, leaf) == length && std::memcmp(stored, node, length * sizeof(uint32_t)) == 0) {
+                    return it->second;
+                }
+            }
+
+            if (words.size() + length > NO_NODE) {
+                throw std::runtime_error { "Voxel DAG does not fit in 32-bit offsets" };
+            }
+
+            uint32_t offset = uint32_t(words.size());
+            words.insert(words.end(), node, node + length);
+            lookup.emplace(hash, offset);
+            nodes++;
+            return offset;
+        }
+    };
+
+    // octree of one chunk before merging, children refer to the position of their node in the level below
+    struct ChunkTree {
+        // set when the whole chunk is a single solid material, no nodes are built then
+        Voxel uniform;
+        uint64_t solidVoxels;
+
+        std::array<std::vector<uint32_t>, CHUNK_LEVEL + 1> words;
+        std::array<std::vector<uint32_t>, CHUNK_LEVEL + 1> starts;
+        std::vector<uint64_t> leafHashes;
+
+        // node index per position of each level, NO_NODE for air
+        std::array<std::vector<uint32_t>, CHUNK_LEVEL + 1> grid;
+    };
+
+    uint32_t gridIndex(int x, int y, int z, int size)
+    {
+        return uint32_t(x + size * (z + size * y));
+    }
+
+    uint32_t octant(int x, int y, int z)
+    {
+        return uint32_t(x | (z << 1) | (y << 2));
+    }
+
+    void buildLeaf(const Voxel* voxels, int lx, int ly, int lz, std::vector<uint32_t>& out)
+    {
+        uint64_t mask { 0 };
+        uint8_t materials[DAG_LEAF_SIZE * DAG_LEAF_SIZE * DAG_LEAF_SIZE];
+        int count { 0 };
+
+        for (int i { 0 }; i < DAG_LEAF_SIZE * DAG_LEAF_SIZE * DAG_LEAF_SIZE; i++) {
+            int x = lx * DAG_LEAF_SIZE + (i & 3);
+            int z = lz * DAG_LEAF_SIZE + ((i >> 2) & 3);
+            int y = ly * DAG_LEAF_SIZE + (i >> 4);
+
+            Voxel voxel = voxels[Chunk::index(x, y, z)];
+            if (voxel != AIR) {
+                mask |= 1ull << i;
+                materials[count++] = uint8_t(std::min<Voxel>(voxel, 0xff));
+            }
+        }
+
+        out.push_back(uint32_t(mask));
+        out.push_back(uint32_t(mask >> 32));
+        for (int i { 0 }; i < count; i += 4) {
+            uint32_t word { 0 };
+            for (int j { i }; j < std::min(count, i + 4); j++) {
+                word |= uint32_t(materials[j]) << ((j - i) * 8);
+            }
+            out.push_back(word);
+        }
+    }
+
+    void buildChunkTree(const Chunk& chunk, ChunkTree& tree)
+    {
+        for (int level { 0 }; level <= CHUNK_LEVEL; level++) {
+            tree.words[level].clear();
+            tree.starts[level].clear();
+            tree.grid[level].clear();
+        }
+        tree.leafHashes.clear();
+        tree.uniform = AIR;
+        tree.solidVoxels = chunk.getSolidCount();
+
+        if (chunk.isEmpty()) {
+            return;
+        }
+
+        if (chunk.getPalette().size() == 1) {
+            tree.uniform = std::max<Voxel>(1, std::min<Voxel>(chunk.getPalette()[0], 0xff));
+            return;
+        }
+
+        thread_local std::vector<Voxel> voxels(CHUNK_VOLUME);
+        chunk.decode(voxels.data());
+
+        std::vector<uint32_t>& leafGrid = tree.grid[0];
+        leafGrid.assign(LEAVES_PER_AXIS * LEAVES_PER_AXIS * LEAVES_PER_AXIS, NO_NODE);
+
+        for (int ly { 0 }; ly < LEAVES_PER_AXIS; ly++) {
+            for (int lz { 0 }; lz < LEAVES_PER_AXIS; lz++) {
+                for (int lx { 0 }; lx < LEAVES_PER_AXIS; lx++) {
+                    std::vector<uint32_t>& words = tree.words[0];
+                    size_t start = words.size();
+                    buildLeaf(voxels.data(), lx, ly, lz, words);
+
+                    if (words[start] == 0 && words[start + 1] == 0) {
+                        words.resize(start);
+                        continue;
+                    }
+
+                    leafGrid[gridIndex(lx, ly, lz, LEAVES_PER_AXIS)] = uint32_t(tree.starts[0].size());
+                    tree.starts[0].push_back(uint32_t(start));
+                    tree.leafHashes.push_back(hashWords(words.data() + start, words.size() - start));
+                }
+            }
+        }
+
+        for (int level { 1 }; level <= CHUNK_LEVEL; level++) {
+            int size = LEAVES_PER_AXIS >> level;
+            const std::vector<uint32_t>& below = tree.grid[level - 1];
+            std::vector<uint32_t>& grid = tree.grid[level];
+            grid.assign(size_t(size) * size * size, NO_NODE);
+
+            for (int y { 0 }; y < size; y++) {
+                for (int z { 0 }; z < size; z++) {
+                    for (int x { 0 }; x < size; x++) {
+                        uint32_t node[9];
+                        uint32_t mask { 0 };
+                        int count { 0 };
+
+                        for (uint32_t child { 0 }; child < 8; child++) {
+                            int cx = 2 * x + int(child & 1);
+                            int cz = 2 * z + int((child >> 1) & 1);
+                            int cy = 2 * y + int(child >> 2);
+
+                            uint32_t index = below[gridIndex(cx, cy, cz, 2 * size)];
+                            if (index != NO_NODE) {
+                                mask |= 1u << child;
+                                node[1 + count++] = index;
+                            }
+                        }
+
+                        if (mask == 0) {
+                            continue;
+                        }
+
+                        node[0] = mask;
+                        grid[gridIndex(x, y, z, size)] = uint32_t(tree.starts[level].size());
+                        tree.starts[level].push_back(uint32_t(tree.words[level].size()));
+                        tree.words[level].insert(tree.words[level].end(), node, node + 1 + count);
+                    }
+                }
+            }
+        }
+    }
+
+    class DagBuilder {
+    public:
+        DagBuilder(int topLevel)
+            : levels(topLevel + 1)
+        {
+            levels[0].leaf = true;
+            uniformRoots.fill(NO_NODE);
+        }
+
+        std::vector<Level> levels;
+        uint64_t treeWords { 0 };
+
+        // word offset of the chunk's root in the chunk level, NO_NODE when the chunk is air
+        uint32_t merge(const ChunkTree& tree)
+        {
+            if (tree.uniform != AIR) {
+                return mergeUniform(tree.uniform);
+            }
+
+            if (tree.starts[CHUNK_LEVEL].empty()) {
+                return NO_NODE;
+            }
+
+            std::vector<uint32_t> offsets(tree.starts[0].size());
+            for (size_t i { 0 }; i < offsets.size(); i++) {
+                const uint32_t* leaf = tree.words[0].data() + tree.starts[0][i];
+                size_t length = nodeLength(leaf, true);
+                offsets[i] = levels[0].insert(leaf, length, tree.leafHashes[i]);
+                treeWords += length;
+            }
+
+            for (int level { 1 }; level <= CHUNK_LEVEL; level++) {
+                std::vector<uint32_t> merged(tree.starts[level].size());
+
+                for (size_t i { 0 }; i < merged.size(); i++) {
+                    const uint32_t* local = tree.words[level].data() + tree.starts[level][i];
+                    size_t length = nodeLength(local, false);
+
+                    uint32_t node[9];
+                    node[0] = local[0];
+                    for (size_t c { 1 }; c < length; c++) {
+                        node[c] = offsets[local[c]];
+                    }
+
+                    merged[i] = levels[level].insert(node, length, hashWords(node, length));
+                    treeWords += length;
+                }
+
+                offsets = std::move(merged);
+            }
+
+            return offsets[0];
+        }
+
+        // inner node above the given children, NO_NODE when they are all air
+        uint32_t mergeInner(int level, const uint32_t* children)
+        {
+            uint32_t node[9];
+            uint32_t mask { 0 };
+            int count { 0 };
+
+            for (uint32_t child { 0 }; child < 8; child++) {
+                if (children[child] != NO_NODE) {
+                    mask |= 1u << child;
+                    node[1 + count++] = children[child];
+                }
+            }
+
+            if (mask == 0) {
+                return NO_NODE;
+            }
+
+            node[0] = mask;
+            treeWords += 1 + count;
+            return levels[level].insert(node, 1 + count, hashWords(node, 1 + count));
+        }
+
+    private:
+        std::array<uint32_t, 256> uniformRoots;
+        std::array<uint64_t, 256> uniformTreeWords {};
+
+        uint32_t mergeUniform(Voxel material)
+        {
+            if (uniformRoots[material] != NO_NODE) {
+                treeWords += uniformTreeWords[material];
+                return uniformRoots[material];
+            }
+
+            uint64_t before = treeWords;
+
+            uint32_t leaf[2 + 16];
+            leaf[0] = ~0u;
+            leaf[1] = ~0u;
+            std::fill(leaf + 2, leaf + 18, material * 0x01010101u);
+
+            uint32_t offset = levels[0].insert(leaf, 18, hashWords(leaf, 18));
+            treeWords += 18ull * LEAVES_PER_AXIS * LEAVES_PER_AXIS * LEAVES_PER_AXIS;
+
+            for (int level { 1 }; level <= CHUNK_LEVEL; level++) {
+                uint32_t children[8];
+                std::fill(children, children + 8, offset);
+
+                uint64_t nodesAtLevel = uint64_t(1) << (3 * (CHUNK_LEVEL - level));
+                offset = mergeInner(level, children);
+                treeWords += 9 * (nodesAtLevel - 1);
+            }
+
+            uniformRoots[material] = offset;
+            uniformTreeWords[material] = treeWords - before;
+            return offset;
+        }
+    };
+
+    int ceilLog2(int value)
+    {
+        return value <= 1 ? 0 : std::bit_width(unsigned(value - 1));
+    }
+
+}
+
+void SparseVoxelDag::build(JobSystem& jobs, const ChunkCoord& first, const glm::ivec3& chunkCount, const Source& source)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    int gridLog2 = ceilLog2(std::max({ chunkCount.x, chunkCount.y, chunkCount.z, 1 }));
+    int gridSize = 1 << gridLog2;
+    int topLevel = CHUNK_LEVEL + gridLog2;
+
+    origin = first * CHUNK_SIZE;
+    sizeLog2 = CHUNK_SIZE_LOG2 + gridLog2;
+    nodes.clear();
+    stats = {};
+    stats.voxels = uint64_t(chunkCount.x) * chunkCount.y * chunkCount.z * CHUNK_VOLUME;
+
+    DagBuilder builder { topLevel };
+
+    // chunk roots, padded with air up to the power of two cube
+    std::vector<uint32_t> roots(size_t(gridSize) * gridSize * gridSize, NO_NODE);
+
+    std::vector<glm::ivec3> coords;
+    coords.reserve(size_t(chunkCount.x) * chunkCount.y * chunkCount.z);
+    for (int y { 0 }; y < chunkCount.y; y++) {
+        for (int z { 0 }; z < chunkCount.z; z++) {
+            for (int x { 0 }; x < chunkCount.x; x++) {
+                coords.push_back({ x, y, z });
+            }
+        }
+    }
+
+    std::vector<ChunkTree> trees(std::min(coords.size(), BUILD_BATCH));
+
+    for (size_t batch { 0 }; batch < coords.size(); batch += BUILD_BATCH) {
+        uint32_t count = uint32_t(std::min(BUILD_BATCH, coords.size() - batch));
+
+        jobs.parallelFor(count, [&](uint32_t i) {
+            thread_local Chunk scratch;
+            const Chunk* chunk = source(first + coords[batch + i], scratch);
+
+            if (chunk == nullptr) {
+                scratch.fill(AIR);
+                chunk = &scratch;
+            }
+
+            buildChunkTree(*chunk, trees[i]);
+        });
+
+        // merging is serial, the graph is shared by every chunk
+        for (uint32_t i { 0 }; i < count; i++) {
+            const glm::ivec3& coord = coords[batch + i];
+            roots[gridIndex(coord.x, coord.y, coord.z, gridSize)] = builder.merge(trees[i]);
+            stats.solidVoxels += trees[i].solidVoxels;
+        }
+    }
+
+    for (int level { CHUNK_LEVEL + 1 }; level <= topLevel; level++) {
+        int size = gridSize >> (level - CHUNK_LEVEL);
+        std::vector<uint32_t> parents(size_t(size) * size * size, NO_NODE);
+
+        for (int y { 0 }; y < size; y++) {
+            for (int z { 0 }; z < size; z++) {
+                for (int x { 0 }; x < size; x++) {
+                    uint32_t children[8];
+                    for (int child { 0 }; child < 8; child++) {
+                        int cx = 2 * x + (child & 1);
+                        int cz = 2 * z + ((child >> 1) & 1);
+                        int cy = 2 * y + (child >> 2);
+                        children[child] = roots[gridIndex(cx, cy, cz, 2 * size)];
+                    }
+                    parents[gridIndex(x, y, z, size)] = builder.mergeInner(level, children);
+                }
+            }
+        }
+
+        roots = std::move(parents);
+    }
+
+    if (roots[0] != NO_NODE) {
+        // root level first, inner node offsets become absolute
+        std::vector<size_t> base(topLevel + 1);
+        size_t total { 0 };
+        for (int level { topLevel }; level >= 0; level--) {
+            base[level] = total;
+            total += builder.levels[level].words.size();
+        }
+
+        if (total > NO_NODE) {
+            throw std::runtime_error { "Voxel DAG does not fit in 32-bit offsets" };
+        }
+
+        nodes.reserve(total);
+        for (int level { topLevel }; level >= 0; level--) {
+            Level& source = builder.levels[level];
+
+            if (level > 0) {
+                for (size_t node { 0 }; node < source.words.size();) {
+                    size_t length = nodeLength(source.words.data() + node, false);
+                    for (size_t c { 1 }; c < length; c++) {
+                        source.words[node + c] += uint32_t(base[level - 1]);
+                    }
+                    node += length;
+                }
+            }
+
+            nodes.insert(nodes.end(), source.words.begin(), source.words.end());
+            stats.nodes += source.nodes;
+        }
+
+        stats.leaves = builder.levels[0].nodes;
+        stats.words = nodes.size();
+        stats.treeWords = builder.treeWords;
+    }
+
+    stats.buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SparseVoxelDag::build(JobSystem& jobs, const World& world, const ChunkCoord& first, const glm::ivec3& chunkCount)
+{
+    build(jobs, first, chunkCount, [&world](const ChunkCoord& coord, Chunk&) {
+        return world.getChunk(coord);
+    });
+}
+
+Voxel SparseVoxelDag::getVoxel(const glm::ivec3& voxel) const
+{
+    glm::ivec3 local = voxel - origin;
+    int size = getSize();
+
+    if (nodes.empty() || local.x < 0 || local.y < 0 || local.z < 0 || local.x >= size || local.y >= size || local.z >= size) {
+        return AIR;
+    }
+
+    uint32_t node { 0 };
+    for (int level { sizeLog2 - 1 }; level >= DAG_LEAF_SIZE_LOG2; level--) {
+        uint32_t mask = nodes[node];
+        uint32_t child = octant((local.x >> level) & 1, (local.y >> level) & 1, (local.z >> level) & 1);
+
+        if ((mask & (1u << child)) == 0) {
+            return AIR;
+        }
+        node = nodes[node + 1 + std::popcount(mask & ((1u << child) - 1))];
+    }
+
+    uint64_t mask = nodes[node] | uint64_t(nodes[node + 1]) << 32;
+    int index = (local.x & 3) | ((local.z & 3) << 2) | ((local.y & 3) << 4);
+
+    if ((mask & (1ull << index)) == 0) {
+        return AIR;
+    }
+
+    int rank = std::popcount(mask & ((1ull << index) - 1));
+    return Voxel((nodes[node + 2 + rank / 4] >> ((rank & 3) * 8)) & 0xff);
+}
+
+RayHit SparseVoxelDag::cast(const glm::vec3& rayOrigin, const glm::vec3& direction, float maxDistance) const
+{
+    RayHit miss { false, glm::ivec3 { 0 }, RAY_MISS, maxDistance, AIR };
+
+    float length = glm::length(direction);
+    if (nodes.empty() || length == 0.0f) {
+        return miss;
+    }
+
+    glm::vec3 dir = direction / length;
+    glm::vec3 start = rayOrigin - glm::vec3(origin);
+    float size = float(getSize());
+
+    glm::vec3 inverse;
+    for (int a { 0 }; a < 3; a++) {
+        inverse[a] = dir[a] != 0.0f ? 1.0f / dir[a] : 0.0f;
+    }
+
+    // clip to the covered cube
+    float tEnter { 0.0f };
+    float tExit { maxDistance };
+    int axis { -1 };
+
+    for (int a { 0 }; a < 3; a++) {
+        if (dir[a] == 0.0f) {
+            if (start[a] < 0.0f || start[a] >= size) {
+                return miss;
+            }
+            continue;
+        }
+
+        float t0 = (0.0f - start[a]) * inverse[a];
+        float t1 = (size - start[a]) * inverse[a];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        if (t0 > tEnter) {
+            tEnter = t0;
+            axis = a;
+        }
+        tExit = std::min(tExit, t1);
+    }
+
+    if (tEnter > tExit) {
+        return miss;
+    }
+
+    int cellMax = getSize() - 1;
+    glm::ivec3 cell;
+    for (int a { 0 }; a < 3; a++) {
+        cell[a] = std::clamp(int(std::floor(start[a] + dir[a] * tEnter)), 0, cellMax);
+    }
+
+    float t = tEnter;
+
+    for (;;) {
+        // descend to the voxel, or to the largest empty cube around it
+        uint32_t node { 0 };
+        int emptyLog2 { -1 };
+
+        for (int level { sizeLog2 - 1 }; level >= DAG_LEAF_SIZE_LOG2; level--) {
+            uint32_t mask = nodes[node];
+            uint32_t child = octant((cell.x >> level) & 1, (cell.y >> level) & 1, (cell.z >> level) & 1);
+
+            if ((mask & (1u << child)) == 0) {
+                emptyLog2 = level;
+                break;
+            }
+            node = nodes[node + 1 + std::popcount(mask & ((1u << child) - 1))];
+        }
+
+        if (emptyLog2 < 0) {
+            uint64_t mask = nodes[node] | uint64_t(nodes[node + 1]) << 32;
+            int index = (cell.x & 3) | ((cell.z & 3) << 2) | ((cell.y & 3) << 4);
+
+            if (mask & (1ull << index)) {
+                int rank = std::popcount(mask & ((1ull << index) - 1));
+                Voxel material = Voxel((nodes[node + 2 + rank / 4] >> ((rank & 3) * 8)) & 0xff);
+                uint8_t face = axis < 0 ? RAY_INSIDE : uint8_t(axis * 2 + (dir[axis] > 0.0f ? 1 : 0));
+                return { true, cell + origin, face, t, material };
+            }
+
+            // the 2x2x2 corner of the leaf holding the voxel
+            int corner = (cell.x & 2) | ((cell.z & 2) << 2) | ((cell.y & 2) << 4);
+            emptyLog2 = ((mask >> corner) & 0x330033ull) == 0 ? 1 : 0;
+        }
+
+        // leave the empty cube through the nearest side
+        int cube = 1 << emptyLog2;
+        glm::ivec3 low = cell & ~(cube - 1);
+
+        float next { INFINITY };
+        axis = -1;
+        for (int a { 0 }; a < 3; a++) {
+            if (dir[a] == 0.0f) {
+                continue;
+            }
+            float side = float(dir[a] > 0.0f ? low[a] + cube : low[a]);
+            float ta = (side - start[a]) * inverse[a];
+            if (ta < next) {
+                next = ta;
+                axis = a;
+            }
+        }
+
+        t = std::max(t, next);
+        if (t > maxDistance) {
+            return miss;
+        }
+
+        cell[axis] = dir[axis] > 0.0f ? low[axis] + cube : low[axis] - 1;
+        if (cell[axis] < 0 || cell[axis] > cellMax) {
+            return miss;
+        }
+
+        for (int a { 0 }; a < 3; a++) {
+            if (a != axis) {
+                cell[a] = std::clamp(int(std::floor(start[a] + dir[a] * t)), low[a], low[a] + cube - 1);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,514 @@
+#include "voxelizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+
+namespace VoKel {
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // one bit per voxel of a chunk, in chunk index order
+    using ChunkBits = std::array<uint64_t, CHUNK_VOLUME / 64>;
+    using BitMap = std::unordered_map<uint64_t, std::unique_ptr<ChunkBits>>;
+
+    // triangles binned per pass, bounds the memory of the per-thread lists
+    constexpr uint32_t BIN_BLOCK { 4096 };
+
+    struct Triangle {
+        glm::vec3 v[3];
+    };
+
+    double secondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void setBit(ChunkBits& bits, int index)
+    {
+        bits[index >> 6] |= 1ull << (index & 63);
+    }
+
+    uint64_t countBits(const ChunkBits& bits)
+    {
+        uint64_t count { 0 };
+        for (uint64_t word : bits) {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+    // separating axis test of a triangle against the cube center +- half, touching counts as overlap
+    bool triangleBoxOverlap(const Triangle& triangle, const glm::vec3& center, float half)
+    {
+        glm::vec3 v0 = triangle.v[0] - center;
+        glm::vec3 v1 = triangle.v[1] - center;
+        glm::vec3 v2 = triangle.v[2] - center;
+
+        // box faces first, they reject most candidates
+        for (int a { 0 }; a < 3; a++) {
+            if (std::min({ v0[a], v1[a], v2[a] }) > half || std::max({ v0[a], v1[a], v2[a] }) < -half) {
+                return false;
+            }
+        }
+
+        auto separates = [&](const glm::vec3& axis) {
+            float p0 = glm::dot(axis, v0);
+            float p1 = glm::dot(axis, v1);
+            float p2 = glm::dot(axis, v2);
+            float radius = half * (std::abs(axis.x) + std::abs(axis.y) + std::abs(axis.z));
+            return std::min({ p0, p1, p2 }) > radius || std::max({ p0, p1, p2 }) < -radius;
+        };
+
+        glm::vec3 edges[3] { v1 - v0, v2 - v1, v0 - v2 };
+        if (separates(glm::cross(edges[0], edges[1]))) {
+            return false;
+        }
+
+        for (const glm::vec3& edge : edges) {
+            if (separates({ 0.0f, -edge.z, edge.y }) || separates({ edge.z, 0.0f, -edge.x }) || separates({ -edge.y, edge.x, 0.0f })) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    glm::ivec3 floorVoxel(const glm::vec3& position)
+    {
+        return { int(std::floor(position.x)), int(std::floor(position.y)), int(std::floor(position.z)) };
+    }
+
+    glm::ivec3 floorChunk(const glm::ivec3& voxel)
+    {
+        return voxel >> CHUNK_SIZE_LOG2;
+    }
+
+    // triangle indices per tile key, gathered by per-thread lists and sorted once
+    struct Bins {
+        std::vector<uint64_t> keys;
+        std::vector<size_t> firsts;
+        std::vector<uint32_t> triangles;
+    };
+
+    Bins binTriangles(JobSystem& jobs, const std::vector<Triangle>& triangles, const std::function<void(const Triangle&, std::vector<uint64_t>&)>& tiles)
+    {
+        uint32_t blocks = uint32_t((triangles.size() + BIN_BLOCK - 1) / BIN_BLOCK);
+        std::vector<std::vector<std::pair<uint64_t, uint32_t>>> lists(blocks);
+
+        jobs.parallelFor(blocks, [&](uint32_t block) {
+            std::vector<uint64_t> keys;
+            uint32_t end = uint32_t(std::min<size_t>(triangles.size(), size_t(block + 1) * BIN_BLOCK));
+
+            for (uint32_t i { block * BIN_BLOCK }; i < end; i++) {
+                keys.clear();
+                tiles(triangles[i], keys);
+                for (uint64_t key : keys) {
+                    lists[block].emplace_back(key, i);
+                }
+            }
+        });
+
+        std::vector<std::pair<uint64_t, uint32_t>> all;
+        for (auto& list : lists) {
+            all.insert(all.end(), list.begin(), list.end());
+            list = {};
+        }
+        std::sort(all.begin(), all.end());
+
+        Bins bins;
+        bins.triangles.reserve(all.size());
+        for (size_t i { 0 }; i < all.size(); i++) {
+            if (i == 0 || all[i].first != all[i - 1].first) {
+                bins.keys.push_back(all[i].first);
+                bins.firsts.push_back(i);
+            }
+            bins.triangles.push_back(all[i].second);
+        }
+        bins.firsts.push_back(all.size());
+        return bins;
+    }
+
+    void rasterizeSurface(const std::vector<Triangle>& triangles, const uint32_t* indices, size_t count, const ChunkCoord& coord, ChunkBits& bits)
+    {
+        glm::ivec3 chunkMin = coord * CHUNK_SIZE;
+        glm::ivec3 chunkMax = chunkMin + CHUNK_SIZE - 1;
+
+        for (size_t t { 0 }; t < count; t++) {
+            const Triangle& triangle = triangles[indices[t]];
+
+            glm::vec3 low = glm::min(triangle.v[0], glm::min(triangle.v[1], triangle.v[2]));
+            glm::vec3 high = glm::max(triangle.v[0], glm::max(triangle.v[1], triangle.v[2]));
+
+            // a triangle ending exactly on a voxel boundary still touches the voxel past it
+            glm::ivec3 first = glm::max(floorVoxel(low) - 1, chunkMin);
+            glm::ivec3 last = glm::min(floorVoxel(high), chunkMax);
+
+            for (int y { first.y }; y <= last.y; y++) {
+                for (int z { first.z }; z <= last.z; z++) {
+                    for (int x { first.x }; x <= last.x; x++) {
+                        if (triangleBoxOverlap(triangle, glm::vec3 { x, y, z } + 0.5f, 0.5f)) {
+                            setBit(bits, Chunk::index(x - chunkMin.x, y - chunkMin.y, z - chunkMin.z));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // crossings of the vertical lines through the voxel centers of one chunk column, filled between pairs
+    void fillColumns(const std::vector<Triangle>& triangles, const uint32_t* indices, size_t count, int chunkX, int chunkZ,
+        std::unordered_map<int, std::unique_ptr<ChunkBits>>& out)
+    {
+        std::vector<std::vector<float>> crossings(CHUNK_AREA);
+        int originX = chunkX * CHUNK_SIZE;
+        int originZ = chunkZ * CHUNK_SIZE;
+
+        for (size_t t { 0 }; t < count; t++) {
+            const Triangle& triangle = triangles[indices[t]];
+
+            glm::dvec2 a { triangle.v[0].x, triangle.v[0].z };
+            glm::dvec2 b { triangle.v[1].x, triangle.v[1].z };
+            glm::dvec2 c { triangle.v[2].x, triangle.v[2].z };
+            double ya = triangle.v[0].y;
+            double yb = triangle.v[1].y;
+            double yc = triangle.v[2].y;
+
+            double area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if (area == 0.0) {
+                continue;
+            }
+            if (area < 0.0) {
+                std::swap(b, c);
+                std::swap(yb, yc);
+                area = -area;
+            }
+
+            // shared edges count for exactly one of their triangles, top-left rule
+            auto edge = [](const glm::dvec2& p, const glm::dvec2& q, const glm::dvec2& s) {
+                return (q.x - p.x) * (s.y - p.y) - (q.y - p.y) * (s.x - p.x);
+            };
+            auto owns = [](const glm::dvec2& p, const glm::dvec2& q) {
+                return q.y < p.y || (q.y == p.y && q.x < p.x);
+            };
+            bool ownsA = owns(b, c);
+            bool ownsB = owns(c, a);
+            bool ownsC = owns(a, b);
+
+            double minX = std::min({ a.x, b.x, c.x });
+            double maxX = std::max({ a.x, b.x, c.x });
+            double minZ = std::min({ a.y, b.y, c.y });
+            double maxZ = std::max({ a.y, b.y, c.y });
+
+            int firstX = std::max(int(std::ceil(minX - 0.5)), originX);
+            int lastX = std::min(int(std::floor(maxX - 0.5)), originX + CHUNK_SIZE - 1);
+            int firstZ = std::max(int(std::ceil(minZ - 0.5)), originZ);
+            int lastZ = std::min(int(std::floor(maxZ - 0.5)), originZ + CHUNK_SIZE - 1);
+
+            for (int z { firstZ }; z <= lastZ; z++) {
+                for (int x { firstX }; x <= lastX; x++) {
+                    glm::dvec2 sample { x + 0.5, z + 0.5 };
+                    double wa = edge(b, c, sample);
+                    double wb = edge(c, a, sample);
+                    double wc = edge(a, b, sample);
+
+                    bool inside = (wa > 0.0 || (wa == 0.0 && ownsA)) && (wb > 0.0 || (wb == 0.0 && ownsB)) && (wc > 0.0 || (wc == 0.0 && ownsC));
+                    if (inside) {
+                        crossings[(x - originX) + (z - originZ) * CHUNK_SIZE].push_back(float((wa * ya + wb * yb + wc * yc) / area));
+                    }
+                }
+            }
+        }
+
+        for (int column { 0 }; column < CHUNK_AREA; column++) {
+            std::vector<float>& ys = crossings[column];
+            std::sort(ys.begin(), ys.end());
+
+            for (size_t i { 0 }; i + 1 < ys.size(); i += 2) {
+                int first = int(std::ceil(ys[i] - 0.5f));
+                int last = int(std::ceil(ys[i + 1] - 0.5f)) - 1;
+
+                for (int y { first }; y <= last; y++) {
+                    auto& bits = out[y >> CHUNK_SIZE_LOG2];
+                    if (bits == nullptr) {
+                        bits = std::make_unique<ChunkBits>();
+                        bits->fill(0);
+                    }
+                    setBit(*bits, Chunk::index(column & (CHUNK_SIZE - 1), y & (CHUNK_SIZE - 1), column >> CHUNK_SIZE_LOG2));
+                }
+            }
+        }
+    }
+
+    // scanline flood of the voxels reachable from the first corner without crossing a blocked voxel
+    void floodOutside(const glm::ivec3& size, const std::vector<uint64_t>& blocked, std::vector<uint64_t>& outside)
+    {
+        auto index = [&size](int x, int y, int z) {
+            return uint64_t(x) + uint64_t(size.x) * (uint64_t(z) + uint64_t(size.z) * uint64_t(y));
+        };
+        auto test = [](const std::vector<uint64_t>& bits, uint64_t i) {
+            return (bits[i >> 6] >> (i & 63)) & 1;
+        };
+        auto open = [&](int x, int y, int z) {
+            uint64_t i = index(x, y, z);
+            return !test(blocked, i) && !test(outside, i);
+        };
+
+        std::vector<glm::ivec3> stack { glm::ivec3 { 0 } };
+
+        while (!stack.empty()) {
+            glm::ivec3 seed = stack.back();
+            stack.pop_back();
+
+            if (!open(seed.x, seed.y, seed.z)) {
+                continue;
+            }
+
+            int first = seed.x;
+            while (first > 0 && open(first - 1, seed.y, seed.z)) {
+                first--;
+            }
+            int last = seed.x;
+            while (last + 1 < size.x && open(last + 1, seed.y, seed.z)) {
+                last++;
+            }
+
+            for (int x { first }; x <= last; x++) {
+                uint64_t i = index(x, seed.y, seed.z);
+                outside[i >> 6] |= 1ull << (i & 63);
+            }
+
+            // one seed per open run of each neighboring row
+            const glm::ivec2 neighbors[4] { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+            for (const glm::ivec2& step : neighbors) {
+                int y = seed.y + step.x;
+                int z = seed.z + step.y;
+                if (y < 0 || z < 0 || y >= size.y || z >= size.z) {
+                    continue;
+                }
+
+                bool inRun { false };
+                for (int x { first }; x <= last; x++) {
+                    bool isOpen = open(x, y, z);
+                    if (isOpen && !inRun) {
+                        stack.push_back({ x, y, z });
+                    }
+                    inRun = isOpen;
+                }
+            }
+        }
+    }
+
+}
+
+MeshVoxelizer::MeshVoxelizer(World& world, JobSystem& jobs)
+    : world { world }
+    , jobs { jobs }
+{
+}
+
+MeshVoxelizer::Stats MeshVoxelizer::voxelize(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const glm::mat4& transform, Voxel material, Fill fill)
+{
+    auto start = Clock::now();
+    Stats stats {};
+
+    std::vector<Triangle> triangles(indices.size() / 3);
+    for (size_t i { 0 }; i < triangles.size(); i++) {
+        for (int v { 0 }; v < 3; v++) {
+            uint32_t index = indices[i * 3 + v];
+            if (index >= positions.size()) {
+                throw std::runtime_error { "Mesh index out of range" };
+            }
+            triangles[i].v[v] = glm::vec3 { transform * glm::vec4 { positions[index], 1.0f } };
+        }
+    }
+    stats.triangles = uint32_t(triangles.size());
+
+    // surface, one job per chunk
+    Bins chunkBins = binTriangles(jobs, triangles, [](const Triangle& triangle, std::vector<uint64_t>& keys) {
+        glm::vec3 low = glm::min(triangle.v[0], glm::min(triangle.v[1], triangle.v[2]));
+        glm::vec3 high = glm::max(triangle.v[0], glm::max(triangle.v[1], triangle.v[2]));
+        glm::ivec3 first = floorChunk(floorVoxel(low) - 1);
+        glm::ivec3 last = floorChunk(floorVoxel(high));
+
+        for (int y { first.y }; y <= last.y; y++) {
+            for (int z { first.z }; z <= last.z; z++) {
+                for (int x { first.x }; x <= last.x; x++) {
+                    // the chunk grown by a voxel, the rasterizer looks one voxel past the bounds
+                    glm::vec3 center = glm::vec3 { x, y, z } * float(CHUNK_SIZE) + float(CHUNK_SIZE) * 0.5f;
+                    if (triangleBoxOverlap(triangle, center, float(CHUNK_SIZE) * 0.5f + 1.0f)) {
+                        keys.push_back(packChunkCoord({ x, y, z }));
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<std::unique_ptr<ChunkBits>> surface(chunkBins.keys.size());
+    jobs.parallelFor(uint32_t(chunkBins.keys.size()), [&](uint32_t i) {
+        surface[i] = std::make_unique<ChunkBits>();
+        surface[i]->fill(0);
+
+        size_t first = chunkBins.firsts[i];
+        rasterizeSurface(triangles, chunkBins.triangles.data() + first, chunkBins.firsts[i + 1] - first, unpackChunkCoord(chunkBins.keys[i]), *surface[i]);
+    });
+
+    BitMap solid;
+    for (size_t i { 0 }; i < surface.size(); i++) {
+        uint64_t count = countBits(*surface[i]);
+        if (count > 0) {
+            stats.surfaceVoxels += count;
+            solid[chunkBins.keys[i]] = std::move(surface[i]);
+        }
+    }
+    surface.clear();
+
+    stats.surfaceSeconds = secondsSince(start);
+    auto fillStart = Clock::now();
+
+    auto addInterior = [&](uint64_t key, const ChunkBits& bits) {
+        auto& target = solid[key];
+        if (target == nullptr) {
+            target = std::make_unique<ChunkBits>();
+            target->fill(0);
+        }
+
+        for (size_t w { 0 }; w < bits.size(); w++) {
+            stats.interiorVoxels += std::popcount(bits[w] & ~(*target)[w]);
+            (*target)[w] |= bits[w];
+        }
+    };
+
+    if (fill == Fill::Parity) {
+        Bins columnBins = binTriangles(jobs, triangles, [](const Triangle& triangle, std::vector<uint64_t>& keys) {
+            glm::vec3 low = glm::min(triangle.v[0], glm::min(triangle.v[1], triangle.v[2]));
+            glm::vec3 high = glm::max(triangle.v[0], glm::max(triangle.v[1], triangle.v[2]));
+            glm::ivec3 first = floorChunk(floorVoxel(low));
+            glm::ivec3 last = floorChunk(floorVoxel(high));
+
+            for (int z { first.z }; z <= last.z; z++) {
+                for (int x { first.x }; x <= last.x; x++) {
+                    keys.push_back(packChunkCoord({ x, 0, z }));
+                }
+            }
+        });
+
+        std::vector<std::unordered_map<int, std::unique_ptr<ChunkBits>>> columns(columnBins.keys.size());
+        jobs.parallelFor(uint32_t(columnBins.keys.size()), [&](uint32_t i) {
+            ChunkCoord coord = unpackChunkCoord(columnBins.keys[i]);
+            size_t first = columnBins.firsts[i];
+            fillColumns(triangles, columnBins.triangles.data() + first, columnBins.firsts[i + 1] - first, coord.x, coord.z, columns[i]);
+        });
+
+        for (size_t i { 0 }; i < columns.size(); i++) {
+            ChunkCoord coord = unpackChunkCoord(columnBins.keys[i]);
+            for (const auto& [chunkY, bits] : columns[i]) {
+                addInterior(packChunkCoord({ coord.x, chunkY, coord.z }), *bits);
+            }
+        }
+    } else if (fill == Fill::FloodFill && !solid.empty()) {
+        // voxel bounds of the surface with a free border the flood starts in
+        glm::ivec3 low { INT32_MAX };
+        glm::ivec3 high { INT32_MIN };
+        for (const auto& [key, bits] : solid) {
+            glm::ivec3 origin = unpackChunkCoord(key) * CHUNK_SIZE;
+            low = glm::min(low, origin);
+            high = glm::max(high, origin + CHUNK_SIZE);
+        }
+        low -= 1;
+        high += 1;
+
+        glm::ivec3 size = high - low;
+        uint64_t volume = uint64_t(size.x) * uint64_t(size.y) * uint64_t(size.z);
+        if (volume > floodFillLimit) {
+            throw std::runtime_error { "Mesh too large to flood fill, use parity" };
+        }
+
+        auto gridIndex = [&](const glm::ivec3& voxel) {
+            glm::ivec3 local = voxel - low;
+            return uint64_t(local.x) + uint64_t(size.x) * (uint64_t(local.z) + uint64_t(size.z) * uint64_t(local.y));
+        };
+
+        std::vector<uint64_t> blocked((volume + 63) / 64, 0);
+        std::vector<uint64_t> outside((volume + 63) / 64, 0);
+
+        for (const auto& [key, bits] : solid) {
+            glm::ivec3 origin = unpackChunkCoord(key) * CHUNK_SIZE;
+            for (int i { 0 }; i < CHUNK_VOLUME; i++) {
+                if ((*bits)[i >> 6] >> (i & 63) & 1) {
+                    uint64_t g = gridIndex(origin + glm::ivec3 { i & (CHUNK_SIZE - 1), i >> (2 * CHUNK_SIZE_LOG2), (i >> CHUNK_SIZE_LOG2) & (CHUNK_SIZE - 1) });
+                    blocked[g >> 6] |= 1ull << (g & 63);
+                }
+            }
+        }
+
+        floodOutside(size, blocked, outside);
+
+        // interior chunks lie inside the bounds, one job per chunk
+        glm::ivec3 firstChunk = floorChunk(low + 1);
+        glm::ivec3 chunkCount = floorChunk(high - 2) - firstChunk + 1;
+        uint32_t total = uint32_t(chunkCount.x * chunkCount.y * chunkCount.z);
+
+        std::vector<std::unique_ptr<ChunkBits>> interior(total);
+        jobs.parallelFor(total, [&](uint32_t i) {
+            ChunkCoord coord = firstChunk + glm::ivec3 { int(i) % chunkCount.x, int(i) / (chunkCount.x * chunkCount.z), int(i) / chunkCount.x % chunkCount.z };
+            glm::ivec3 origin = coord * CHUNK_SIZE;
+
+            ChunkBits bits;
+            bits.fill(0);
+            bool any { false };
+
+            for (int v { 0 }; v < CHUNK_VOLUME; v++) {
+                uint64_t g = gridIndex(origin + glm::ivec3 { v & (CHUNK_SIZE - 1), v >> (2 * CHUNK_SIZE_LOG2), (v >> CHUNK_SIZE_LOG2) & (CHUNK_SIZE - 1) });
+                if (!((outside[g >> 6] >> (g & 63)) & 1) && !((blocked[g >> 6] >> (g & 63)) & 1)) {
+                    setBit(bits, v);
+                    any = true;
+                }
+            }
+
+            if (any) {
+                interior[i] = std::make_unique<ChunkBits>(bits);
+            }
+        });
+
+        for (uint32_t i { 0 }; i < total; i++) {
+            if (interior[i] != nullptr) {
+                ChunkCoord coord = firstChunk + glm::ivec3 { int(i) % chunkCount.x, int(i) / (chunkCount.x * chunkCount.z), int(i) / chunkCount.x % chunkCount.z };
+                addInterior(packChunkCoord(coord), *interior[i]);
+            }
+        }
+    }
+
+    stats.fillSeconds = secondsSince(fillStart);
+    auto writeStart = Clock::now();
+
+    std::vector<ChunkCoord> coords;
+    std::vector<const ChunkBits*> bits;
+    for (const auto& [key, chunkBits] : solid) {
+        coords.push_back(unpackChunkCoord(key));
+        bits.push_back(chunkBits.get());
+    }
+
+    world.editChunks(coords, jobs, [&](uint32_t index, Chunk& chunk) {
+        const ChunkBits& set = *bits[index];
+        for (int w { 0 }; w < int(set.size()); w++) {
+            for (uint64_t word = set[w]; word != 0; word &= word - 1) {
+                chunk.setIndex(w * 64 + std::countr_zero(word), material);
+            }
+        }
+        chunk.compact();
+    });
+
+    stats.chunks = uint32_t(coords.size());
+    stats.writeSeconds = secondsSince(writeStart);
+    stats.seconds = secondsSince(start);
+    return stats;
+}
+
+}
@@ -0,0 +1,340 @@
+#include "world.hpp"
+
+#include <algorithm>
+
+namespace VoKel {
+
+void downsampleChunk(const std::array<const Chunk*, 8>& children, Chunk& out)
+{
+    constexpr int HALF { CHUNK_SIZE / 2 };
+
+    std::vector<Voxel> dense(CHUNK_VOLUME);
+
+    out.fill(AIR);
+
+    for (int child { 0 }; child < 8; child++) {
+        if (children[child] == nullptr || children[child]->isEmpty()) {
+            continue;
+        }
+
+        children[child]->decode(dense.data());
+
+        glm::ivec3 base { (child & 1) * HALF, ((child >> 1) & 1) * HALF, ((child >> 2) & 1) * HALF };
+
+        for (int y { 0 }; y < HALF; y++) {
+            for (int z { 0 }; z < HALF; z++) {
+                for (int x { 0 }; x < HALF; x++) {
+                    std::array<Voxel, 8> block;
+                    int solid { 0 };
+
+                    for (int i { 0 }; i < 8; i++) {
+                        Voxel voxel = dense[Chunk::index(2 * x + (i & 1), 2 * y + ((i >> 1) & 1), 2 * z + ((i >> 2) & 1))];
+                        if (voxel != AIR) {
+                            block[solid++] = voxel;
+                        }
+                    }
+
+                    if (solid < 4) {
+                        continue;
+                    }
+
+                    // most common material, ties go to the smallest id to stay deterministic
+                    std::sort(block.begin(), block.begin() + solid);
+                    Voxel best { block[0] };
+                    int bestCount { 0 };
+                    for (int i { 0 }; i < solid;) {
+                        int j { i };
+                        while (j < solid && block[j] == block[i]) {
+                            j++;
+                        }
+                        if (j - i > bestCount) {
+                            best = block[i];
+                            bestCount = j - i;
+                        }
+                        i = j;
+                    }
+
+                    out.set(base.x + x, base.y + y, base.z + z, best);
+                }
+            }
+        }
+    }
+}
+
+Chunk* World::getChunk(const ChunkCoord& coord)
+{
+    std::unique_ptr<Chunk>* chunk = chunks.find(packChunkCoord(coord));
+    return chunk == nullptr ? nullptr : chunk->get();
+}
+
+const Chunk* World::getChunk(const ChunkCoord& coord) const
+{
+    const std::unique_ptr<Chunk>* chunk = chunks.find(packChunkCoord(coord));
+    return chunk == nullptr ? nullptr : chunk->get();
+}
+
+std::array<const Chunk*, 27> World::getNeighborhood(const ChunkCoord& coord) const
+{
+    std::array<const std::unique_ptr<Chunk>*, 27> found;
+    chunks.gatherNeighborhood(coord, found);
+
+    std::array<const Chunk*, 27> neighborhood;
+    for (int i { 0 }; i < 27; i++) {
+        neighborhood[i] = found[i] == nullptr ? nullptr : found[i]->get();
+    }
+    return neighborhood;
+}
+
+Chunk& World::loadChunk(const ChunkCoord& coord)
+{
+    if (Chunk* chunk = getChunk(coord)) {
+        return *chunk;
+    }
+
+    if (loader) {
+        if (std::unique_ptr<Chunk> stored = loader(coord)) {
+            return insertChunk(coord, std::move(stored));
+        }
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+    if (generator) {
+        generator(*chunk, coord, 0);
+    }
+
+    return insertChunk(coord, std::move(chunk));
+}
+
+Chunk& World::insertChunk(const ChunkCoord& coord, std::unique_ptr<Chunk> chunk)
+{
+    auto& slot = chunks[packChunkCoord(coord)];
+    slot = std::move(chunk);
+
+    if (chunkHandler) {
+        chunkHandler(coord, slot.get());
+    }
+
+    return *slot;
+}
+
+void World::removeChunk(const ChunkCoord& coord)
+{
+    if (chunks.erase(packChunkCoord(coord)) && chunkHandler) {
+        chunkHandler(coord, nullptr);
+    }
+}
+
+std::unique_ptr<Chunk> World::releaseChunk(const ChunkCoord& coord)
+{
+    uint64_t key = packChunkCoord(coord);
+    std::unique_ptr<Chunk>* slot = chunks.find(key);
+    if (slot == nullptr) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Chunk> chunk = std::move(*slot);
+    chunks.erase(key);
+
+    if (chunkHandler) {
+        chunkHandler(coord, nullptr);
+    }
+
+    return chunk;
+}
+
+Voxel World::getVoxel(const glm::ivec3& voxel) const
+{
+    const Chunk* chunk = getChunk(worldToChunk(voxel));
+    if (chunk == nullptr) {
+        return AIR;
+    }
+
+    glm::ivec3 local = worldToLocal(voxel);
+    return chunk->get(local.x, local.y, local.z);
+}
+
+void World::setVoxel(const glm::ivec3& voxel, Voxel value)
+{
+    ChunkCoord coord = worldToChunk(voxel);
+    glm::ivec3 local = worldToLocal(voxel);
+
+    Chunk& chunk = loadChunk(coord);
+    Voxel previous = chunk.get(local.x, local.y, local.z);
+    if (previous == value) {
+        return;
+    }
+
+    chunk.set(local.x, local.y, local.z, value);
+
+    if (modifiedChunks.empty() || modifiedChunks.back() != coord) {
+        modifiedChunks.push_back(coord);
+    }
+
+    unsavedChunks.insert(packChunkCoord(coord));
+
+    invalidateLod(coord);
+
+    if (editHandler) {
+        editHandler(voxel, previous, value);
+    }
+}
+
+void World::editChunks(const std::vector<ChunkCoord>& coords, JobSystem& jobs, const std::function<void(uint32_t index, Chunk& chunk)>& edit)
+{
+    std::vector<Chunk*> edited(coords.size());
+    for (size_t i { 0 }; i < coords.size(); i++) {
+        edited[i] = &loadChunk(coords[i]);
+    }
+
+    jobs.parallelFor(static_cast<uint32_t>(coords.size()), [&](uint32_t i) {
+        edit(i, *edited[i]);
+    });
+
+    for (size_t i { 0 }; i < coords.size(); i++) {
+        modifiedChunks.push_back(coords[i]);
+        unsavedChunks.insert(packChunkCoord(coords[i]));
+        invalidateLod(coords[i]);
+
+        if (chunkHandler) {
+            chunkHandler(coords[i], edited[i]);
+        }
+    }
+}
+
+std::vector<ChunkCoord> World::takeModifiedChunks()
+{
+    std::vector<ChunkCoord> modified;
+    modified.swap(modifiedChunks);
+    return modified;
+}
+
+const Chunk* World::findLodChunk(const ChunkCoord& coord, uint32_t lod) const
+{
+    if (lod == 0) {
+        return getChunk(coord);
+    }
+
+    auto it = lodCache[lod].find(packChunkCoord(coord));
+    return it == lodCache[lod].end() ? nullptr : it->second.get();
+}
+
+bool World::hasAllChildren(const ChunkCoord& coord, uint32_t lod) const
+{
+    for (int i { 0 }; i < 8; i++) {
+        if (findLodChunk(coord * 2 + ChunkCoord { i & 1, (i >> 1) & 1, (i >> 2) & 1 }, lod - 1) == nullptr) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void World::invalidateLod(const ChunkCoord& coord)
+{
+    for (uint32_t lod { 1 }; lod < MAX_LOD_LEVELS; lod++) {
+        uint64_t key = packChunkCoord(coord >> static_cast<int>(lod));
+        lodCache[lod].erase(key);
+        editedLod[lod].insert(key);
+    }
+}
+
+const Chunk* World::getLodChunk(const ChunkCoord& coord, uint32_t lod)
+{
+    if (lod == 0) {
+        return generator ? &loadChunk(coord) : getChunk(coord);
+    }
+
+    if (lod >= MAX_LOD_LEVELS) {
+        return nullptr;
+    }
+
+    uint64_t key = packChunkCoord(coord);
+    if (const Chunk* cached = findLodChunk(coord, lod)) {
+        return cached;
+    }
+
+    // edited regions always come from their children, so the edit shows up at every level
+    bool edited = editedLod[lod].erase(key) > 0;
+
+    std::array<const Chunk*, 8> children {};
+    for (int i { 0 }; i < 8; i++) {
+        children[i] = findLodChunk(coord * 2 + ChunkCoord { i & 1, (i >> 1) & 1, (i >> 2) & 1 }, lod - 1);
+    }
+
+    auto chunk = std::make_unique<Chunk>();
+
+    if (edited || !generator) {
+        for (int i { 0 }; i < 8; i++) {
+            if (children[i] == nullptr) {
+                children[i] = getLodChunk(coord * 2 + ChunkCoord { i & 1, (i >> 1) & 1, (i >> 2) & 1 }, lod - 1);
+            }
+        }
+        downsampleChunk(children, *chunk);
+    } else if (hasAllChildren(coord, lod)) {
+        downsampleChunk(children, *chunk);
+    } else {
+        generator(*chunk, coord, lod);
+    }
+
+    chunk->compact();
+
+    auto& slot = lodCache[lod][key];
+    slot = std::move(chunk);
+    return slot.get();
+}
+
+void World::pruneLodCache(const std::function<bool(const ChunkCoord& coord, uint32_t lod)>& keep)
+{
+    for (uint32_t lod { 1 }; lod < MAX_LOD_LEVELS; lod++) {
+        std::erase_if(lodCache[lod], [&](const auto& entry) {
+            return !keep(unpackChunkCoord(entry.first), lod);
+        });
+    }
+}
+
+void World::prefetchLodChunks(const std::vector<std::pair<ChunkCoord, uint32_t>>& requests, JobSystem& jobs)
+{
+    if (!generator) {
+        return;
+    }
+
+    std::array<std::unordered_set<uint64_t>, MAX_LOD_LEVELS> seen;
+    std::vector<std::pair<ChunkCoord, uint32_t>> missing;
+
+    for (const auto& [coord, lod] : requests) {
+        if (lod >= MAX_LOD_LEVELS) {
+            continue;
+        }
+
+        uint64_t key = packChunkCoord(coord);
+        if (!seen[lod].insert(key).second || findLodChunk(coord, lod) != nullptr) {
+            continue;
+        }
+
+        // downsampled levels stay on the calling thread, they read the caches
+        if (lod > 0 && (editedLod[lod].contains(key) || hasAllChildren(coord, lod))) {
+            continue;
+        }
+
+        missing.emplace_back(coord, lod);
+    }
+
+    std::vector<std::unique_ptr<Chunk>> generated(missing.size());
+    jobs.parallelFor(static_cast<uint32_t>(missing.size()), [&](uint32_t i) {
+        generated[i] = std::make_unique<Chunk>();
+        generator(*generated[i], missing[i].first, missing[i].second);
+        generated[i]->compact();
+    });
+
+    for (size_t i { 0 }; i < missing.size(); i++) {
+        const auto& [coord, lod] = missing[i];
+
+        if (lod == 0) {
+            insertChunk(coord, std::move(generated[i]));
+        } else {
+            lodCache[lod][packChunkCoord(coord)] = std::move(generated[i]);
+        }
+    }
+}
+
+}
\ No newline at end of file